@@ -0,0 +1,103 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fakecam.hpp>
+#include <string>
+#include <utility.hpp>
+#include <vector>
+
+class Timer {
+  public:
+    Timer() : start(std::chrono::system_clock::now()) {}
+    uint32_t elapsed_us() {
+        return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - this->start).count();
+    }
+
+  private:
+    std::chrono::system_clock::time_point start;
+};
+
+using Kernel = void (*)(
+        float*, float*, const void*, const void*, const void*, const void*, const uint32_t, const uint32_t, const uint32_t,
+        const float, const tofcam::Threshold&);
+
+// a positive `threshold` also invalidates the pixels below it and writes the validity mask
+void run(
+        const char* name, Kernel kernel, tofcam::FakeCamera& camera, const uint32_t width, const uint32_t height,
+        const uint32_t bytesperline, const float threshold = 0.0f) {
+    constexpr uint32_t ITER = 30 * 1000;
+    std::vector<float> depth(width * height, 0.0f);
+    std::vector<float> confidence(width * height, 0.0f);
+    std::vector<uint8_t> mask((width + 7) / 8 * height);
+    const tofcam::Threshold thresh = {threshold, threshold > 0.0f ? mask.data() : nullptr};
+    auto timer = Timer();
+    for (int i = 0; i < ITER; i++) {
+        std::pair<void*, uint32_t> frames[4];
+        for (int j = 0; j < 4; j++) {
+            frames[j] = camera.dequeue();
+        }
+        kernel(
+                depth.data(), confidence.data(), frames[0].first, frames[1].first, frames[2].first, frames[3].first, width,
+                height, bytesperline, 75'000'000, thresh);
+        for (const auto& [data, index] : frames) {
+            camera.enqueue(index);
+        }
+    }
+    auto proctime = timer.elapsed_us();
+    printf("%-32s %u us (%.2f rawframes/s)\n", name, proctime, (double)ITER * 1'000'000 * 4 / proctime);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 5) {
+        fprintf(stderr, "usage: %s <source> <width> <height> <bytesperline>\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    const char* dir = argv[1];
+    const uint32_t width = std::stoi(argv[2]);
+    const uint32_t height = std::stoi(argv[3]);
+    const uint32_t bytesperline = std::stoi(argv[4]);
+    auto camera = tofcam::FakeCamera(dir, width, height, bytesperline, 8);
+    camera.stream_on();
+    using tofcam::Atan2;
+    using tofcam::Rotation;
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        run("avx2", tofcam::compute_depth_confidence_from_y12p_avx2<true>, camera, width, height, bytesperline);
+        run("avx2 (depth only)", tofcam::compute_depth_confidence_from_y12p_avx2<false>, camera, width, height, bytesperline);
+        run(
+                "avx2 (depth only, Fast)", tofcam::compute_depth_confidence_from_y12p_avx2<false, Rotation::Zero, Atan2::Fast>,
+                camera, width, height, bytesperline);
+        run(
+                "avx2 (depth only, Poly3)",
+                tofcam::compute_depth_confidence_from_y12p_avx2<false, Rotation::Zero, Atan2::Poly3>, camera, width, height,
+                bytesperline);
+        run(
+                "avx2 (depth only, Poly5)",
+                tofcam::compute_depth_confidence_from_y12p_avx2<false, Rotation::Zero, Atan2::Poly5>, camera, width, height,
+                bytesperline);
+        run(
+                "avx2 (threshold and mask)", tofcam::compute_depth_confidence_from_y12p_avx2<true>, camera, width, height,
+                bytesperline, 16.0f);
+    }
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+        run("avx512", tofcam::compute_depth_confidence_from_y12p_avx512<true>, camera, width, height, bytesperline);
+        run(
+                "avx512 (depth only)", tofcam::compute_depth_confidence_from_y12p_avx512<false>, camera, width, height,
+                bytesperline);
+        run(
+                "avx512 (depth only, Fast)",
+                tofcam::compute_depth_confidence_from_y12p_avx512<false, Rotation::Zero, Atan2::Fast>, camera, width, height,
+                bytesperline);
+        run(
+                "avx512 (depth only, Poly3)",
+                tofcam::compute_depth_confidence_from_y12p_avx512<false, Rotation::Zero, Atan2::Poly3>, camera, width, height,
+                bytesperline);
+        run(
+                "avx512 (depth only, Poly5)",
+                tofcam::compute_depth_confidence_from_y12p_avx512<false, Rotation::Zero, Atan2::Poly5>, camera, width, height,
+                bytesperline);
+        run(
+                "avx512 (threshold and mask)", tofcam::compute_depth_confidence_from_y12p_avx512<true>, camera, width,
+                height, bytesperline, 16.0f);
+    }
+    camera.stream_off();
+}
@@ -1,6 +1,5 @@
 #include <bo548.hpp>
 #include <chrono>
-#include <cstring>
 #include <fstream>
 #include <vector>
 
@@ -28,23 +27,15 @@ int main(int argc, char* argv[]) {
     const char* sensornode = argv[3];
     const char* directory = argv[4];
     const uint32_t iter = 100;
-    std::vector<std::vector<float>> depth_frames;
-    std::vector<std::vector<float>> confidence_frames;
+    std::vector<tofcam::DepthFrame<float>> frames;
     auto camera = tofcam::BO548(devnode, csinode, sensornode, true, true, 1000, tofcam::MemType::DMABUF, tofcam::Mode::Double);
     const auto [width, height] = camera.get_size();
+    camera.set_frame_pool(iter);
     camera.stream_on();
 
     auto begin = std::chrono::system_clock::now();
     for (int i = 0; i < iter; i++) {
-        auto [depth, confidence] = camera.get_frame();
-        depth_frames.emplace_back(width * height);
-        std::memcpy(depth_frames.back().data(), (float*)depth, sizeof(float) * width * height);
-        confidence_frames.emplace_back(width * height);
-        std::memcpy(confidence_frames.back().data(), (float*)confidence, sizeof(float) * width * height);
-        depth_frames.emplace_back(width * height);
-        std::memcpy(depth_frames.back().data(), ((float*)depth) + width * height, sizeof(float) * width * height);
-        confidence_frames.emplace_back(width * height);
-        std::memcpy(confidence_frames.back().data(), ((float*)confidence) + width * height, sizeof(float) * width * height);
+        frames.push_back(camera.acquire_frame());
         fprintf(stderr, "frame: %4d\n", i);
     }
     auto end = std::chrono::system_clock::now();
@@ -53,14 +44,15 @@ int main(int argc, char* argv[]) {
             (double)iter / (elapsed / 1'000'000.0));
 
     camera.stream_off();
-    for (int i = 0; i < depth_frames.size(); i++) {
+    // the 90MHz and 15MHz planes of each frame
+    for (int i = 0; i < frames.size() * 2; i++) {
         char path[256];
         snprintf(path, sizeof(path), "%s/depth_%03d.bin", directory, i);
-        save_bytes(path, depth_frames[i].data(), sizeof(float) * width * height);
+        save_bytes(path, frames[i / 2].depth() + width * height * (i % 2), sizeof(float) * width * height);
     }
-    for (int i = 0; i < confidence_frames.size(); i++) {
+    for (int i = 0; i < frames.size() * 2; i++) {
         char path[256];
         snprintf(path, sizeof(path), "%s/confidence_%03d.bin", directory, i);
-        save_bytes(path, confidence_frames[i].data(), sizeof(float) * width * height);
+        save_bytes(path, frames[i / 2].confidence() + width * height * (i % 2), sizeof(float) * width * height);
     }
 }
@@ -1,6 +1,5 @@
 #include <bo548.hpp>
 #include <chrono>
-#include <cstring>
 #include <fstream>
 #include <vector>
 
@@ -31,33 +30,16 @@ int main(int argc, char* argv[]) {
     const auto [width, height] = camera.get_size();
     const auto [sizeimage, bytesperline] = camera.get_bytes();
     const uint32_t bytesplane = bytesperline * height;
-    std::vector<std::vector<uint8_t>> rawframes;
 
     camera.stream_on();
     for (int i = 0; i < 8; i++) {
-        const auto ptr = camera.get_rawframe();
-
-        rawframes.emplace_back(bytesplane);
-        const auto phase0 = static_cast<uint8_t*>(ptr) + bytesplane * 0;
-        std::memcpy(rawframes.back().data(), phase0, bytesplane);
-
-        rawframes.emplace_back(bytesplane);
-        const auto phase1 = static_cast<uint8_t*>(ptr) + bytesplane * 1;
-        std::memcpy(rawframes.back().data(), phase1, bytesplane);
-
-        rawframes.emplace_back(bytesplane);
-        const auto phase2 = static_cast<uint8_t*>(ptr) + bytesplane * 2;
-        std::memcpy(rawframes.back().data(), phase2, bytesplane);
-
-        rawframes.emplace_back(bytesplane);
-        const auto phase3 = static_cast<uint8_t*>(ptr) + bytesplane * 3;
-        std::memcpy(rawframes.back().data(), phase3, bytesplane);
+        // saved straight from the buffer of the driver, which gets it back at the end of the iteration
+        const auto frame = camera.acquire_rawframe();
+        for (int phase = 0; phase < 4; phase++) {
+            char path[256];
+            snprintf(path, sizeof(path), "%s/frame_%04d.raw", directory, i * 4 + phase);
+            save_bytes(path, static_cast<uint8_t*>(frame.data()) + bytesplane * phase, bytesplane);
+        }
     }
     camera.stream_off();
-
-    for (int i = 0; i < rawframes.size(); i++) {
-        char path[256];
-        snprintf(path, sizeof(path), "%s/frame_%04d.raw", directory, i);
-        save_bytes(path, rawframes[i].data(), bytesplane);
-    }
 }
@@ -0,0 +1,36 @@
+#include <chrono>
+#include <cstdio>
+#include <group.hpp>
+#include <thread>
+
+int main(int argc, char* argv[]) {
+    if (argc < 4 || (argc - 1) % 3 != 0) {
+        fprintf(stderr, "usage: %s <device> <csi> <sensor> [<device> <csi> <sensor> ...]\n", argv[0]);
+        return 0;
+    }
+    const uint32_t num_cameras = (argc - 1) / 3;
+    const int num_cpus = std::thread::hardware_concurrency();
+    tofcam::CameraGroup group;
+    for (uint32_t i = 0; i < num_cameras; i++) {
+        auto camera = std::make_unique<tofcam::BO548>(argv[1 + i * 3], argv[2 + i * 3], argv[3 + i * 3]);
+        // the loop stays on CPU 0, one camera per core from CPU 1 on
+        group.add<float>(std::move(camera), (1 + i) % num_cpus, [](const uint32_t camera, tofcam::DepthFrame<float> frame) {
+            const auto [width, height] = frame.size();
+            if (frame.info().sequence % 30 == 0) {
+                printf("camera %u frame %u, center %.1fmm\n", camera, frame.info().sequence,
+                       frame.depth()[height / 2 * width + width / 2]);
+            }
+        });
+    }
+    group.start(0);
+    for (int seconds = 0; seconds < 10; seconds++) {
+        std::this_thread::sleep_for(std::chrono::seconds(1));
+        group.check();
+        for (uint32_t i = 0; i < num_cameras; i++) {
+            const auto stats = group.get_stats(i);
+            printf("camera %u: %.1f fps, %lu frames, %lu dropped, %lu skipped\n", i, stats.fps, stats.frames, stats.dropped,
+                   stats.skipped);
+        }
+    }
+    group.stop();
+}
@@ -0,0 +1,42 @@
+#include <bo548.hpp>
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+// latency from the end of the capture (driver timestamp) to the converted frame
+static void run(tofcam::BO548& camera, const uint32_t iter, const char* name) {
+    tofcam::Histogram latency;
+    camera.stream_on();
+    for (uint32_t i = 0; i < iter; i++) {
+        camera.get_frame();
+        latency.record(std::chrono::steady_clock::now() - camera.get_info().timestamp);
+    }
+    camera.stream_off();
+    const auto us = [](const std::chrono::nanoseconds ns) { return ns.count() / 1000.0; };
+    printf("%-9s p50 %8.1fus  p99 %8.1fus  p99.9 %8.1fus  max %8.1fus  (dropped %lu)\n", name,
+           us(latency.percentile(0.5)), us(latency.percentile(0.99)), us(latency.percentile(0.999)), us(latency.max()),
+           camera.get_telemetry().dropped.load());
+}
+
+int main(int argc, char* argv[]) {
+    if (argc < 4 || argc > 7) {
+        fprintf(stderr, "usage: %s <device> <csi> <sensor> [frames] [cpu] [priority]\n", argv[0]);
+        return 0;
+    }
+    const uint32_t iter = argc > 4 ? std::stoi(argv[4]) : 30 * 60;
+    tofcam::RealtimeOptions options;
+    options.cpu = argc > 5 ? std::stoi(argv[5]) : 2;
+    options.priority = argc > 6 ? std::stoi(argv[6]) : 50;
+    options.lock = true;
+    options.prewarm = true;
+    {
+        auto camera = tofcam::BO548(argv[1], argv[2], argv[3]);
+        run(camera, iter, "default");
+    }
+    {
+        // a fresh camera, so that nothing is warm from the first run
+        auto camera = tofcam::BO548(argv[1], argv[2], argv[3]);
+        camera.set_realtime(options);
+        run(camera, iter, "realtime");
+    }
+}
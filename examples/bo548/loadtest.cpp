@@ -16,6 +16,9 @@ int main(int argc, char* argv[]) {
 
     for (int i = 0; i < iter; i++) {
         auto [depth, confidence] = camera.get_frame();
+        if (i % 300 == 299) {
+            camera.get_telemetry().dump(stderr);
+        }
     }
     camera.stream_off();
 }
@@ -0,0 +1,41 @@
+#include <bo548.hpp>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+int main(int argc, char* argv[]) {
+    if (argc != 4 && argc != 5) {
+        fprintf(stderr, "usage: %s <device> <csi> <sensor> [frames]\n", argv[0]);
+        return 0;
+    }
+    const char* devnode = argv[1];
+    const char* csinode = argv[2];
+    const char* sensornode = argv[3];
+    const uint32_t iter = argc == 5 ? std::stoi(argv[4]) : 30 * 20;
+    const std::pair<const char*, tofcam::MemType> memtypes[] = {
+            {"MMAP", tofcam::MemType::MMAP}, {"DMABUF", tofcam::MemType::DMABUF}, {"USERPTR", tofcam::MemType::USERPTR}};
+    for (const auto& [name, memtype] : memtypes) {
+        printf("== %s\n", name);
+        try {
+            auto camera = tofcam::BO548(devnode, csinode, sensornode, true, true, 1000, memtype, tofcam::Mode::Single);
+            camera.stream_on();
+            // the first frames fault in the buffers and warm up the caches
+            for (int i = 0; i < 30; i++) {
+                camera.get_frame();
+            }
+            auto& telemetry = camera.get_telemetry();
+            telemetry.reset();
+            const auto begin = std::chrono::steady_clock::now();
+            for (int i = 0; i < iter; i++) {
+                camera.get_frame();
+            }
+            const auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - begin).count();
+            camera.stream_off();
+            printf("%.1f fps\n", iter / elapsed);
+            telemetry.dump(stdout);
+        } catch (const std::exception& e) {
+            printf("not supported: %s\n", e.what());
+        }
+    }
+}
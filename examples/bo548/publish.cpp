@@ -0,0 +1,26 @@
+#include <bo548.hpp>
+#include <cstdio>
+#include <share.hpp>
+
+int main(int argc, char* argv[]) {
+    if (argc != 5) {
+        fprintf(stderr, "usage: %s <device> <csi> <sensor> <socket>\n", argv[0]);
+        return 0;
+    }
+    const char* devnode = argv[1];
+    const char* csinode = argv[2];
+    const char* sensornode = argv[3];
+    const char* socket = argv[4];
+    const uint32_t iter = 30 * 100;
+    auto camera = tofcam::BO548(devnode, csinode, sensornode, true, true, 1000, tofcam::MemType::DMABUF);
+    auto publisher = tofcam::FramePublisher(socket, 4, camera.get_layout<float>());
+    camera.stream_on();
+
+    for (int i = 0; i < iter; i++) {
+        // converted straight into the ring, the subscribers never hold the camera back
+        camera.get_frame(publisher.begin<float>());
+        publisher.publish();
+    }
+    camera.stream_off();
+    printf("%lu frames published\n", publisher.get_published());
+}
@@ -0,0 +1,50 @@
+#include <bo548.hpp>
+#include <chrono>
+#include <cstdio>
+#include <linux/videodev2.h>
+#include <recorder.hpp>
+#include <string>
+
+// Records the raw frames at the full rate of the camera, each phase a frame of the recording as FakeCamera(path)
+// replays it. The buffer goes back to the driver as soon as its phases are copied, the disk is written on its own thread.
+int main(int argc, char* argv[]) {
+    if (argc < 5 || argc > 7) {
+        fprintf(stderr, "usage: %s <device> <csi> <sensor> <recording> [seconds] [cpu]\n", argv[0]);
+        return 0;
+    }
+    const auto duration = std::chrono::seconds(argc > 5 ? std::stoi(argv[5]) : 10);
+    const int cpu = argc > 6 ? std::stoi(argv[6]) : -1;
+    auto camera = tofcam::BO548(argv[1], argv[2], argv[3], true, true, 1000, tofcam::MemType::DMABUF, tofcam::Mode::Single);
+    const auto [width, height] = camera.get_size();
+    const auto [sizeimage, bytesperline] = camera.get_bytes();
+
+    tofcam::RecordingFormat format;
+    format.width = width;
+    format.height = height;
+    format.bytesperline = bytesperline;
+    format.sizeimage = bytesperline * height;
+    format.pixelformat = v4l2_fourcc('Y', '1', '2', 'P');
+    format.mode = static_cast<uint32_t>(tofcam::Mode::Single);
+    format.modfreq_hz[0] = 90e6f;
+    tofcam::Recorder recorder(argv[4], format, 64, cpu);
+
+    camera.stream_on();
+    const auto end = std::chrono::steady_clock::now() + duration;
+    while (std::chrono::steady_clock::now() < end) {
+        const auto frame = camera.acquire_rawframe();
+        const tofcam::FrameInfo& info = frame.info();
+        for (uint32_t phase = 0; phase < 4; phase++) {
+            const uint8_t* data = static_cast<const uint8_t*>(frame.data()) + format.sizeimage * phase;
+            recorder.record(data, {info.sequence * 4 + phase, info.timestamp});
+        }
+    }
+    camera.stream_off();
+    recorder.finish();
+
+    const auto stats = recorder.get_stats();
+    const auto& latency = recorder.get_write_latency();
+    printf("written %lu, dropped %lu (driver %lu), max pending %u of 64\n", stats.written, stats.dropped,
+           camera.get_telemetry().dropped.load(), stats.max_pending);
+    printf("write p50 %.1fus  p99 %.1fus  max %.1fus\n", latency.percentile(0.5).count() / 1000.0,
+           latency.percentile(0.99).count() / 1000.0, latency.max().count() / 1000.0);
+}
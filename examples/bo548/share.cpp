@@ -0,0 +1,40 @@
+#include <bo548.hpp>
+#include <cstdio>
+#include <cstring>
+#include <share.hpp>
+
+int main(int argc, char* argv[]) {
+    if (argc != 5 && argc != 6) {
+        fprintf(stderr, "usage: %s <device> <csi> <sensor> <socket> [raw]\n", argv[0]);
+        return 0;
+    }
+    const char* devnode = argv[1];
+    const char* csinode = argv[2];
+    const char* sensornode = argv[3];
+    const char* socket = argv[4];
+    const bool raw = argc == 6 && strcmp(argv[5], "raw") == 0;
+    const uint32_t iter = 30 * 100;
+    auto camera = tofcam::BO548(devnode, csinode, sensornode, true, true, 1000, tofcam::MemType::DMABUF);
+    const auto layout = raw ? tofcam::FrameLayout::raw(camera.get_bytes().first) : camera.get_layout<float>();
+    auto server = raw ? tofcam::FrameServer(socket, camera.export_rawframes(), layout) : tofcam::FrameServer(socket, 4, layout);
+    camera.stream_on();
+
+    uint32_t skipped = 0;
+    for (int i = 0; i < iter; i++) {
+        if (raw) {
+            skipped += !server.publish(camera.acquire_rawframe());
+            continue;
+        }
+        // the readers hold all the slots: the frame is captured and not shared
+        const auto slot = server.acquire();
+        if (!slot) {
+            camera.get_frame();
+            skipped++;
+            continue;
+        }
+        camera.get_frame(server.view<float>(*slot));
+        server.publish(*slot);
+    }
+    camera.stream_off();
+    printf("%u frames to %u readers, %u skipped\n", iter, server.get_num_readers(), skipped);
+}
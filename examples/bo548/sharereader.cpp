@@ -0,0 +1,27 @@
+#include <chrono>
+#include <cstdio>
+#include <share.hpp>
+
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <socket>\n", argv[0]);
+        return 0;
+    }
+    auto client = tofcam::FrameClient(argv[1]);
+    const auto& layout = client.get_layout();
+    printf("%u slots of %lu bytes, %ux%u\n", client.get_num_slots(), layout.size, layout.width, layout.height);
+    while (true) {
+        // the frame is released when the handle goes out of scope
+        const auto frame = client.receive(std::chrono::milliseconds(1000));
+        if (!frame) {
+            break;
+        }
+        const auto latency = std::chrono::steady_clock::now() - frame->info().timestamp;
+        printf("frame %u in slot %u, %.1fms after the capture", frame->info().sequence, frame->slot(),
+               std::chrono::duration<double, std::milli>(latency).count());
+        if (layout.element_size == sizeof(float)) {
+            printf(", center %.1fmm", frame->depth<float>()[layout.height / 2 * layout.width + layout.width / 2]);
+        }
+        printf("\n");
+    }
+}
@@ -0,0 +1,21 @@
+#include <chrono>
+#include <cstdio>
+#include <share.hpp>
+
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s <socket>\n", argv[0]);
+        return 0;
+    }
+    auto subscriber = tofcam::FrameSubscriber(argv[1]);
+    const auto& layout = subscriber.get_layout();
+    while (subscriber.wait(std::chrono::milliseconds(1000))) {
+        const auto frame = subscriber.latest();
+        const float center = frame->depth<float>()[layout.height / 2 * layout.width + layout.width / 2];
+        // the frame is read in place, the publisher may have overwritten it meanwhile
+        if (!frame->valid()) {
+            continue;
+        }
+        printf("frame %lu (%u), center %.1fmm\n", frame->number(), frame->info().sequence, center);
+    }
+}
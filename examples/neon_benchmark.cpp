@@ -19,27 +19,20 @@ class Timer {
     std::chrono::system_clock::time_point start;
 };
 
-int main(int argc, char* argv[]) {
-    if (argc != 5) {
-        fprintf(stderr, "usage: %s <source> <width> <height> <bytesperline>\n", argv[0]);
-        exit(EXIT_FAILURE);
-    }
-    const char* dir = argv[1];
-    const uint32_t width = std::stoi(argv[2]);
-    const uint32_t height = std::stoi(argv[3]);
-    const uint32_t bytesperline = std::stoi(argv[4]);
+template <tofcam::Atan2 accuracy>
+void run(
+        const char* name, tofcam::FakeCamera& camera, const uint32_t width, const uint32_t height,
+        const uint32_t bytesperline) {
     constexpr uint32_t ITER = 30 * 1000;
-    auto camera = tofcam::FakeCamera(dir, width, height, bytesperline, 8);
     std::vector<float> depth(width * height, 0.0f);
     std::vector<float> confidence(width * height, 0.0f);
-    camera.stream_on();
     auto timer = Timer();
     for (int i = 0; i < ITER; i++) {
         std::pair<void*, uint32_t> frames[4];
         for (int j = 0; j < 4; j++) {
             frames[j] = camera.dequeue();
         }
-        tofcam::compute_depth_confidence_from_y12p_neon<false, tofcam::Rotation::Zero>(
+        tofcam::compute_depth_confidence_from_y12p_neon<false, tofcam::Rotation::Zero, accuracy>(
                 depth.data(), confidence.data(), frames[0].first, frames[1].first, frames[2].first, frames[3].first, width,
                 height, bytesperline, 75'000'000);
         for (const auto& [data, index] : frames) {
@@ -47,6 +40,23 @@ int main(int argc, char* argv[]) {
         }
     }
     auto proctime = timer.elapsed_us();
-    printf("%u us (%.2f rawframes/s)\n", proctime, (double)ITER * 1'000'000 * 4 / proctime);
+    printf("%-8s %u us (%.2f rawframes/s)\n", name, proctime, (double)ITER * 1'000'000 * 4 / proctime);
+}
+
+int main(int argc, char* argv[]) {
+    if (argc != 5) {
+        fprintf(stderr, "usage: %s <source> <width> <height> <bytesperline>\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    const char* dir = argv[1];
+    const uint32_t width = std::stoi(argv[2]);
+    const uint32_t height = std::stoi(argv[3]);
+    const uint32_t bytesperline = std::stoi(argv[4]);
+    auto camera = tofcam::FakeCamera(dir, width, height, bytesperline, 8);
+    camera.stream_on();
+    run<tofcam::Atan2::Fast>("Fast", camera, width, height, bytesperline);
+    run<tofcam::Atan2::Default>("Default", camera, width, height, bytesperline);
+    run<tofcam::Atan2::Poly3>("Poly3", camera, width, height, bytesperline);
+    run<tofcam::Atan2::Poly5>("Poly5", camera, width, height, bytesperline);
     camera.stream_off();
 }
@@ -0,0 +1,66 @@
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fakecam.hpp>
+#include <string>
+#include <utility.hpp>
+#include <vector>
+
+// Replays a recording at the rate of the camera into a few modeled buffers and converts every four phases, to see the
+// latency and the frames lost by a pipeline as it would run on the camera.
+int main(int argc, char* argv[]) {
+    if (argc < 3 || argc > 6) {
+        fprintf(stderr, "usage: %s <recording> <fps> [jitter us] [buffers] [seconds]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    tofcam::ReplayPacing pacing;
+    pacing.fps = std::stod(argv[2]);
+    pacing.jitter = std::chrono::microseconds(argc > 3 ? std::stoi(argv[3]) : 0);
+    pacing.num_buffers = argc > 4 ? std::stoi(argv[4]) : 8;
+    const auto duration = std::chrono::seconds(argc > 5 ? std::stoi(argv[5]) : 10);
+    auto camera = tofcam::FakeCamera(argv[1]);
+    camera.set_pacing(pacing);
+    const auto [width, height] = camera.get_size();
+    const auto [sizeimage, bytesperline] = camera.get_bytes();
+    // the recordings packed by torecording carry no modulation frequency
+    const float modfreq_hz = camera.get_format()->modfreq_hz[0] > 0.0f ? camera.get_format()->modfreq_hz[0] : 75'000'000;
+    std::vector<float> depth(width * height, 0.0f);
+    std::vector<float> confidence(width * height, 0.0f);
+    tofcam::Histogram latency;
+
+    camera.stream_on();
+    const auto end = std::chrono::steady_clock::now() + duration;
+    std::vector<std::pair<void*, uint32_t>> phases;
+    while (std::chrono::steady_clock::now() < end) {
+        const auto frame = camera.dequeue();
+        // a lost frame breaks the four phases, they start again at the next phase 0
+        if (camera.get_info().sequence % 4 != phases.size()) {
+            for (const auto& phase : phases) {
+                camera.enqueue(phase.second);
+            }
+            phases.clear();
+            if (camera.get_info().sequence % 4 != 0) {
+                camera.enqueue(frame.second);
+                continue;
+            }
+        }
+        phases.push_back(frame);
+        if (phases.size() < 4) {
+            continue;
+        }
+        tofcam::compute_depth_confidence_from_y12p<true>(
+                depth.data(), confidence.data(), phases[0].first, phases[1].first, phases[2].first, phases[3].first,
+                width, height, bytesperline, modfreq_hz);
+        latency.record(std::chrono::steady_clock::now() - camera.get_info().timestamp);
+        for (const auto& phase : phases) {
+            camera.enqueue(phase.second);
+        }
+        phases.clear();
+    }
+    camera.stream_off();
+
+    const auto us = [](const std::chrono::nanoseconds ns) { return ns.count() / 1000.0; };
+    printf("depth frames %lu, latency p50 %.1fus p99 %.1fus max %.1fus\n", latency.count(), us(latency.percentile(0.5)),
+           us(latency.percentile(0.99)), us(latency.max()));
+    camera.get_telemetry().dump(stdout);
+}
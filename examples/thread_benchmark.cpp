@@ -0,0 +1,56 @@
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <fakecam.hpp>
+#include <string>
+#include <thread>
+#include <threadpool.hpp>
+#include <utility.hpp>
+#include <vector>
+
+int main(int argc, char* argv[]) {
+    if (argc != 5 && argc != 6) {
+        fprintf(stderr, "usage: %s <source> <width> <height> <bytesperline> [max threads]\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    const char* dir = argv[1];
+    const uint32_t width = std::stoi(argv[2]);
+    const uint32_t height = std::stoi(argv[3]);
+    const uint32_t bytesperline = std::stoi(argv[4]);
+    const uint32_t max_threads = argc == 6 ? std::stoi(argv[5]) : std::max(1u, std::thread::hardware_concurrency());
+    constexpr uint32_t ITER = 5 * 1000;
+    auto camera = tofcam::FakeCamera(dir, width, height, bytesperline, 8);
+    std::vector<float> depth(width * height, 0.0f);
+    std::vector<float> confidence(width * height, 0.0f);
+    std::vector<uint32_t> latency(ITER);
+    camera.stream_on();
+    printf("threads      mean       p50       p99       max (us per depth frame)\n");
+    for (uint32_t num_threads = 1; num_threads <= max_threads; num_threads++) {
+        auto pool = tofcam::ThreadPool(num_threads);
+        for (uint32_t i = 0; i < ITER; i++) {
+            std::pair<void*, uint32_t> frames[4];
+            for (int j = 0; j < 4; j++) {
+                frames[j] = camera.dequeue();
+            }
+            const auto start = std::chrono::steady_clock::now();
+            tofcam::compute_depth_confidence_from_y12p<true>(
+                    depth.data(), confidence.data(), frames[0].first, frames[1].first, frames[2].first, frames[3].first,
+                    width, height, bytesperline, 75'000'000, pool);
+            const auto elapsed = std::chrono::steady_clock::now() - start;
+            latency[i] = std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+            for (const auto& [data, index] : frames) {
+                camera.enqueue(index);
+            }
+        }
+        uint64_t total = 0;
+        for (const auto us : latency) {
+            total += us;
+        }
+        std::sort(latency.begin(), latency.end());
+        printf(
+                "%7u %9.1f %9u %9u %9u\n", num_threads, (double)total / ITER, latency[ITER / 2], latency[ITER * 99 / 100],
+                latency.back());
+    }
+    camera.stream_off();
+}
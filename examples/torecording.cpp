@@ -0,0 +1,35 @@
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <linux/videodev2.h>
+#include <recording.hpp>
+#include <string>
+#include <vector>
+
+// packs the frame_%04d.raw files of a directory into one recording, which FakeCamera(path) replays
+int main(int argc, char* argv[]) {
+    if (argc != 6) {
+        fprintf(stderr, "usage: %s <directory> <width> <height> <bytesperline> <recording>\n", argv[0]);
+        exit(EXIT_FAILURE);
+    }
+    tofcam::RecordingFormat format;
+    format.width = std::stoi(argv[2]);
+    format.height = std::stoi(argv[3]);
+    format.bytesperline = std::stoi(argv[4]);
+    format.sizeimage = format.bytesperline * format.height;
+    format.pixelformat = v4l2_fourcc('Y', '1', '2', 'P');
+    tofcam::RecordingWriter writer(argv[5], format);
+    std::vector<char> frame(format.sizeimage);
+    for (uint32_t i = 0;; i++) {
+        char path[256];
+        snprintf(path, sizeof(path), "%s/frame_%04d.raw", argv[1], i);
+        std::ifstream ifs(path, std::ios::binary);
+        if (!ifs || !ifs.read(frame.data(), frame.size())) {
+            break;
+        }
+        // the files carry no capture info, the frames are numbered in order
+        writer.write(frame.data(), {i, {}});
+    }
+    writer.finish();
+    printf("%lu frames written.\n", writer.get_num_frames());
+}
@@ -1,13 +1,47 @@
 #pragma once
 
 #include <camera.hpp>
+#include <frame.hpp>
+#include <memory>
 #include <optional>
+#include <realtime.hpp>
+#include <threadpool.hpp>
+#include <utility.hpp>
 
 namespace tofcam {
 
+// The phase of the raw frames of a BO410 from their driver sequence numbers. The sensor cycles through the phases from
+// the start of the stream, where the driver restarts the sequence at 0, and the driver counts the frames it loses: the
+// phase of a frame is its sequence modulo 4. A frame that is not the next phase of the frame being captured means that
+// phases were lost, the phases held are discarded and so are the frames up to the next phase 0.
+class PhaseTracker {
+  public:
+    enum class Step {
+        Next,    // the frame is the next phase, size() - 1
+        Restart, // the phases held are discarded, the frame is phase 0
+        Discard, // the phases held and the frame are discarded
+    };
+
+    // Takes the frame of `sequence`, counting the resynchronizations and the frames discarded in `telemetry`.
+    Step take(const uint32_t sequence, Telemetry& telemetry);
+
+    uint32_t size() const; // the phases held, 4 for a complete frame
+
+    // the phases held are converted or dropped, the next frame starts at phase 0
+    void clear();
+
+  private:
+    uint32_t num_phases = 0;    // the phases held
+    uint32_t last_sequence = 0; // of the last phase held
+    bool resyncing = false;     // discarding frames up to the next phase 0
+};
+
 class BO410 {
   public:
-    BO410(const char* device, const char* subdevice, const int range, const MemType memtype = MemType::DMABUF);
+    // `num_buffers` V4L2 buffers: a frame holds its four phases at once, fewer than 4 buffers need set_incremental()
+    // (the default then), which holds one
+    BO410(const char* device, const char* subdevice, const int range, const MemType memtype = MemType::DMABUF,
+          const uint32_t num_buffers = 8);
 
     ~BO410();
 
@@ -15,14 +49,143 @@ class BO410 {
 
     void stream_off();
 
-    std::pair<float*, float*> get_frame();
+    // {depth, confidence}, T is float or uint16_t (millimetres and amplitude, rounded and saturated)
+    template <class T = float>
+    std::pair<T*, T*> get_frame();
+
+    // std::nullopt when the four phases are not captured within `timeout`, 0 to only take the phases already there.
+    // The phases captured so far are kept for the next call.
+    template <class T = float>
+    std::optional<std::pair<T*, T*>> get_frame(const std::chrono::milliseconds timeout);
+
+    // Converts the next frame into buffers of the caller, which hold get_size() pixels of depth and confidence and
+    // (width + 7) / 8 bytes per row of mask when it is enabled.
+    template <class T = float>
+    void get_frame(const FrameView<T>& out);
+
+    // false when the four phases are not captured within `timeout`, they are kept for the next call
+    template <class T = float>
+    bool get_frame(const FrameView<T>& out, const std::chrono::milliseconds timeout);
+
+    // Converts the next frame into buffers lent by a pool of set_frame_pool() frames (4 by default), which the handle
+    // gives back when it is destroyed. Throws when all the frames of the pool are held. get_mask() is not affected.
+    template <class T = float>
+    DepthFrame<T> acquire_frame();
+
+    // std::nullopt when the four phases are not captured within `timeout`
+    template <class T = float>
+    std::optional<DepthFrame<T>> acquire_frame(const std::chrono::milliseconds timeout);
+
+    // A new pool of `capacity` frames for acquire_frame(), the frames held from the previous one stay valid.
+    void set_frame_pool(const uint32_t capacity);
+
+    uint32_t get_free_frames() const; // the frames of the pool that acquire_frame() can still lend
+
+    // Dequeues the next frame and gives it back to the driver unconverted, e.g. when all the frames of the pool are
+    // held, false when no frame is captured within `timeout`.
+    bool drop_frame(const std::chrono::milliseconds timeout);
+
+    std::pair<uint32_t, uint32_t> get_size() const; // {width, height}
+
+    FrameInfo get_info() const; // of the last phase of the last get_frame()
+
+    // counters and latencies of the capture (of the phases) and the conversion, see Telemetry
+    Telemetry& get_telemetry();
+
+    const Telemetry& get_telemetry() const;
+
+    // readable (POLLIN / EPOLLIN) while a phase can be dequeued, see Camera::get_fd()
+    int get_fd() const;
+
+    // Writes depth 0 for the pixels whose amplitude is below `amplitude` (0 disables it), in the same pass as the
+    // conversion. With `mask`, get_mask() returns the validity bits of the last frame, (width + 7) / 8 bytes per row.
+    void set_threshold(const float amplitude, const bool mask = false);
+
+    const uint8_t* get_mask() const; // nullptr without a mask
+
+    // Temporal filter of the depth (see TemporalFilter), std::nullopt to disable it. The history restarts here.
+    void set_temporal_filter(const std::optional<TemporalFilter>& filter);
+
+    // Spatial filter of the depth (see SpatialFilter), run before the temporal filter, std::nullopt to disable it.
+    void set_spatial_filter(const std::optional<SpatialFilter>& filter);
+
+    // Folds each phase into the cos (I0 - I2) and sin (I3 - I1) planes as soon as it is dequeued and re-queues its
+    // buffer at once, so that only the depth and amplitude are left to compute after the last phase, and the camera
+    // holds one buffer at most. Takes effect from the next frame on, false needs 4 buffers.
+    void set_incremental(const bool incremental);
+
+    // Converts frames on num_threads pinned threads (see ThreadPool), 1 to go back to a single thread.
+    void set_num_threads(const uint32_t num_threads, const std::vector<int>& cpus = {});
+
+    // Pins the calling thread, which should be the one calling get_frame(), and gives it and the conversion threads a
+    // SCHED_FIFO priority. stream_on() then converts a frame once and locks the buffers in memory when enabled, see
+    // RealtimeOptions. The default options unpin the thread and put it and the conversion threads back to SCHED_OTHER.
+    void set_realtime(const RealtimeOptions& options);
 
   private:
+    // dequeues the missing phases, false when they are not captured within `timeout` (std::nullopt: no limit)
+    bool dequeue_phases(const std::optional<std::chrono::milliseconds> timeout);
+
+    // Keeps the frame as the next phase, or discards the phases held when it is not the next one (see PhaseTracker).
+    void take_phase(RawFrame frame);
+
+    // folds the frame into the cos and sin planes as `phase` and re-queues it
+    void fold_phase(RawFrame frame, const uint32_t phase);
+
+    // re-queues the phases held
+    void clear_phases();
+
+    // runs `task(begin, end, line)` over bands of rows, on the pool when there is one, `line` holds `width` values
+    template <class F>
+    void run_rows(const F& task);
+
+    // converts the first capture buffers as a frame with both output types, then the history restarts; not recorded
+    // in the telemetry
+    void prewarm();
+
+    // locks the capture buffers and the outputs in memory, lend_frame() the frames of the pool as it allocates them
+    void lock_buffers();
+
+    // sizes the buffers of `out` for get_frame<T>() with the current settings
+    template <class T>
+    void allocate(FrameBuffers& out) const;
+
+    template <class T>
+    FrameInfo convert_frame(const FrameView<T>& out);
+
+    template <class T>
+    DepthFrame<T> lend_frame();
+
     Camera camera;
     int subfd = -1;
     int range = 2000;
-    std::vector<float> depth;
-    std::vector<float> confidence;
+    uint32_t num_buffers = 8;
+    RawFrame phases[4];
+    PhaseTracker tracker; // of the phases dequeued so far
+    bool incremental = false;
+    bool folding = false;        // the phases of the current frame are folded
+    FrameInfo folded_info = {};  // of the last phase folded
+    std::vector<int16_t> cosine; // I0 - I2
+    std::vector<int16_t> sine;   // I3 - I1
+    std::vector<int16_t> zeros;  // one row, for the phases already folded
+    std::vector<int16_t> lines;  // one row per band
+    FrameBuffers frame;
+    const uint8_t* last_mask = nullptr;
+    FrameInfo last_info = {};
+    std::shared_ptr<FramePool> frame_pool = std::make_shared<FramePool>(4);
+    float threshold = 0.0f;
+    bool masked = false;
+    std::optional<TemporalFilter> temporal = std::nullopt;
+    std::vector<float> history;
+    std::vector<float> history_amplitude;
+    std::optional<SpatialFilter> spatial = std::nullopt;
+    std::vector<float> unfiltered;
+    std::vector<uint16_t> unfiltered_u16;
+    std::unique_ptr<ThreadPool> pool;
+    uint32_t num_threads = 1;
+    std::vector<int> cpus; // of the pool
+    RealtimeOptions realtime;
+    bool prewarming = false; // the conversions are not recorded in the telemetry
 };
 
 } // namespace tofcam
@@ -1,13 +1,23 @@
 #pragma once
 
+#include <atomic>
 #include <camera.hpp>
+#include <exception>
+#include <frame.hpp>
+#include <framering.hpp>
+#include <memory>
 #include <optional>
+#include <realtime.hpp>
+#include <thread>
+#include <threadpool.hpp>
+#include <utility.hpp>
 
 namespace tofcam {
 
 enum class Mode {
-    Single,
-    Double,
+    Single,    // 90MHz
+    Double,    // 90MHz and 15MHz, two depth maps stacked in one frame
+    Unwrapped, // 90MHz unwrapped by 15MHz, one depth map over the 15MHz range
 };
 
 class BO548 {
@@ -22,26 +32,198 @@ class BO548 {
 
     void stream_off();
 
-    std::pair<float*, float*> get_frame(); // {depth, confidence}
+    // {depth, confidence}, T is float or uint16_t (millimetres and amplitude, rounded and saturated)
+    template <class T = float>
+    std::pair<T*, T*> get_frame();
 
-    std::pair<uint32_t, uint32_t> get_size() const; // {width, height}
+    // std::nullopt when no frame is captured within `timeout`, 0 to only take a frame that is already there
+    template <class T = float>
+    std::optional<std::pair<T*, T*>> get_frame(const std::chrono::milliseconds timeout);
+
+    // Converts the next frame into buffers of the caller, which hold get_size() pixels of depth and confidence per plane,
+    // (width + 7) / 8 bytes per row of mask and 3 points per pixel (mask and points only when they are enabled).
+    template <class T = float>
+    void get_frame(const FrameView<T>& out);
+
+    // false when no frame is captured within `timeout`
+    template <class T = float>
+    bool get_frame(const FrameView<T>& out, const std::chrono::milliseconds timeout);
+
+    // Where get_frame<T>() writes its outputs with the current settings when they are packed in one buffer, e.g. to
+    // convert frames into the slots of a FrameServer (see FrameServer::view()).
+    template <class T = float>
+    FrameLayout get_layout() const;
+
+    // Converts the next frame into buffers lent by a pool of set_frame_pool() frames (4 by default), which the handle
+    // gives back when it is destroyed: several frames can be kept or handed to other threads without copying them.
+    // Throws when all the frames of the pool are held. get_mask() and get_points() are not affected.
+    template <class T = float>
+    DepthFrame<T> acquire_frame();
+
+    // std::nullopt when no frame is captured within `timeout`
+    template <class T = float>
+    std::optional<DepthFrame<T>> acquire_frame(const std::chrono::milliseconds timeout);
+
+    // A new pool of `capacity` frames for acquire_frame(), the frames held from the previous one stay valid.
+    void set_frame_pool(const uint32_t capacity);
+
+    uint32_t get_free_frames() const; // the frames of the pool that acquire_frame() can still lend
+
+    // Dequeues the next frame and gives it back to the driver unconverted, e.g. when all the frames of the pool are
+    // held, false when no frame is captured within `timeout`.
+    bool drop_frame(const std::chrono::milliseconds timeout);
+
+    // readable (POLLIN / EPOLLIN) while get_frame(0ms) returns a frame, see Camera::get_fd()
+    int get_fd() const;
+
+    // Starts a capture thread that converts every frame, as get_frame<T>() does, into one of `num_slots` frames
+    // allocated here and hands them over through a lock-free FrameRing. get_frame<T>(), get_mask(), get_points() and
+    // get_fd() then read the converted frames, each frame is valid until the next get_frame(). With
+    // Overflow::DropOldest get_frame() returns the newest frame and the older ones are dropped, with Overflow::Block the
+    // thread waits for the caller. The settings can not change while streaming.
+    template <class T = float>
+    void start_streaming(const uint32_t num_slots = 3, const Overflow overflow = Overflow::DropOldest);
+
+    void stop_streaming();
+
+    uint64_t get_dropped() const; // frames dropped since start_streaming()
+
+    FrameInfo get_info() const; // of the last get_frame()
+
+    // counters and latencies of the capture and the conversion, see Telemetry
+    Telemetry& get_telemetry();
+
+    const Telemetry& get_telemetry() const;
+
+    std::pair<uint32_t, uint32_t> get_size() const; // {width, height} of the depth map
+
+    // Converts only `roi` of the 640x480 image (of each plane in Double mode), get_size() returns its size.
+    // Not supported in Unwrapped mode.
+    void set_roi(const Roi& roi);
+
+    // 2x2 binning of the image or the ROI, e.g. 320x240: the phases of each 2x2 block are summed before the atan2.
+    // Not supported in Unwrapped mode.
+    void set_binning(const bool binning);
+
+    // Writes depth 0 for the pixels whose amplitude is below `amplitude` (0 disables it), in the same pass as the
+    // conversion. With `mask`, get_mask() returns the validity bits of the last frame, (width + 7) / 8 bytes per row.
+    void set_threshold(const float amplitude, const bool mask = false);
+
+    const uint8_t* get_mask() const; // nullptr without a mask
+
+    // Temporal filter of the depth (see TemporalFilter), run on each row band right after its conversion while it is
+    // still in cache, std::nullopt to disable it. The history restarts here and on set_roi/set_binning.
+    void set_temporal_filter(const std::optional<TemporalFilter>& filter);
+
+    // Spatial filter of the depth (see SpatialFilter), run on the rows right after their conversion and before the
+    // temporal filter and the point cloud, std::nullopt to disable it.
+    void set_spatial_filter(const std::optional<SpatialFilter>& filter);
+
+    // get_frame() also converts the depth map into an organized XYZ (mm) point cloud with these intrinsics, band by band
+    // while the depth is still in cache; the rays of the pixels are computed once here (and on set_roi/set_binning).
+    void set_intrinsics(const Intrinsics& intrinsics);
+
+    // Point cloud of the last frame, 3 values per pixel of the depth map (of each plane in Double mode): P is float for
+    // get_frame<float>() and int16_t for get_frame<uint16_t>(). nullptr without intrinsics.
+    template <class P = float>
+    const P* get_points() const;
 
     std::pair<uint32_t, uint32_t> get_bytes() const; // {sizeimage, bytesused}
 
+    // the raw frame, valid until the next call
     void* get_rawframe();
 
+    // the raw frame in a handle that re-queues it when destroyed, it must not outlive the camera
+    RawFrame acquire_rawframe();
+
+    // DMA-BUF fds of the capture buffers, indexed as RawFrame::index(), to share the raw frames with other processes
+    // (see FrameServer). Not supported with MemType::USERPTR. The caller closes them.
+    std::vector<int> export_rawframes() const;
+
     void set_exposure(const int exposure);
 
+    // Converts frames on num_threads pinned threads (see ThreadPool), 1 to go back to a single thread.
+    // In Double mode both modulation frequencies are converted concurrently.
+    void set_num_threads(const uint32_t num_threads, const std::vector<int>& cpus = {});
+
+    // Pins the capture thread and gives it and the conversion threads a SCHED_FIFO priority (see RealtimeOptions). The
+    // capture thread is the calling thread, which should be the one calling get_frame(), and the thread of
+    // start_streaming(). stream_on() then converts a frame once and locks the buffers in memory when enabled, as
+    // start_streaming() does with its frames: call them after the settings, which may reallocate the outputs. The default
+    // options unpin the capture thread and put it and the conversion threads back to SCHED_OTHER.
+    void set_realtime(const RealtimeOptions& options);
+
   private:
+    // sizes the buffers of `out` for get_frame<T>() with the current settings
+    template <class T>
+    void allocate(FrameBuffers& out) const;
+
+    // throws if `out` lacks a buffer that the current settings write
+    template <class T>
+    void check_buffers(const FrameView<T>& out) const;
+
+    template <class T>
+    FrameInfo convert_frame(RawFrame raw, const FrameView<T>& out);
+
+    // the outputs of the last get_frame(), for get_mask(), get_points() and get_info()
+    template <class T>
+    void set_last(const FrameView<T>& out, const FrameInfo& info);
+
+    // buffers of the frame pool in a handle, sized for get_frame<T>()
+    template <class T>
+    DepthFrame<T> lend_frame();
+
+    template <class T>
+    void stream_loop();
+
+    template <class T>
+    std::optional<std::pair<T*, T*>> pop_frame(const std::chrono::milliseconds timeout);
+
+    void throw_if_streaming() const;
+
+    // converts a frame of the first capture buffer with both output types, then the history restarts; not recorded
+    // in the telemetry
+    void prewarm();
+
+    // locks the capture buffers and the outputs in memory, lend_frame() the frames of the pool as it allocates them
+    void lock_buffers();
+
     Camera camera;
     Mode mode;
     int csi_fd = -1;
     int sensor_fd = -1;
     uint32_t width = 0;
     uint32_t height = 0;
-    std::vector<float> depth;
-    std::vector<float> confidence;
-    std::optional<uint32_t> locked_index = std::nullopt;
+    Roi roi = {0, 0, 640, 480};
+    bool binning = false;
+    float threshold = 0.0f;
+    bool masked = false;
+    std::optional<TemporalFilter> temporal = std::nullopt;
+    std::vector<float> history;
+    std::vector<float> history_amplitude;
+    std::optional<SpatialFilter> spatial = std::nullopt;
+    std::vector<float> unfiltered;
+    std::vector<uint16_t> unfiltered_u16;
+    std::optional<Intrinsics> intrinsics = std::nullopt;
+    std::vector<float> rays;
+    FrameBuffers frame;
+    FrameView<float> last = {};
+    FrameView<uint16_t> last_u16 = {};
+    FrameInfo last_info = {};
+    std::shared_ptr<FramePool> frame_pool = std::make_shared<FramePool>(4);
+    RawFrame locked;
+    std::unique_ptr<ThreadPool> pool;
+    uint32_t num_threads = 1;
+    std::vector<int> cpus; // of the pool
+    RealtimeOptions realtime;
+    bool prewarming = false; // the conversions are not recorded in the telemetry
+    // streaming
+    std::vector<FrameBuffers> slots;
+    std::unique_ptr<FrameRing> ring;
+    bool streamed_u16 = false;
+    std::atomic<bool> stopping{false};
+    std::exception_ptr failure;
+    std::thread capture;
 };
 
 } // namespace tofcam
@@ -1,5 +1,6 @@
 #pragma once
 
+#include <cstddef>
 #include <cstdint>
 #include <tuple>
 #include <utility>
@@ -13,6 +14,11 @@ class BufferPool {
 
     virtual void* sync_start(const uint32_t index) = 0;
     virtual int sync_end(const uint32_t index) = 0;
+
+    virtual void* get_address(const uint32_t index) const = 0;
+
+    // a new DMA-BUF fd of the buffer to share it with other processes, closed by the caller
+    virtual int export_fd(const uint32_t index) const = 0;
 };
 
 class MmapBufferPool final : public BufferPool {
@@ -28,7 +34,12 @@ class MmapBufferPool final : public BufferPool {
     void* sync_start(const uint32_t index) override;
     int sync_end(const uint32_t index) override;
 
+    void* get_address(const uint32_t index) const override;
+
+    int export_fd(const uint32_t index) const override;
+
   private:
+    int device = -1; // not owned, for VIDIOC_EXPBUF
     // addr, length
     std::vector<std::pair<void*, uint32_t>> buffers;
 };
@@ -46,10 +57,45 @@ class DmaBufferPool final : public BufferPool {
     void* sync_start(const uint32_t index) override;
     int sync_end(const uint32_t index) override;
 
+    void* get_address(const uint32_t index) const override;
+
+    int export_fd(const uint32_t index) const override;
+
   private:
     int fd = -1;
     // addr, length, fd
     std::vector<std::tuple<void*, uint32_t, int>> buffers;
 };
 
+// Buffers for V4L2_MEMORY_USERPTR carved from one arena of 2MB huge pages (hugetlbfs if pages are reserved, otherwise
+// transparent huge pages), so that the strided reads of the phase planes need a few TLB entries, without a DMA heap.
+// The driver does the cache maintenance on QBUF / DQBUF, sync_start and sync_end do nothing. Without an IOMMU,
+// vb2-dma-contig rejects a buffer that spans huge pages that are not physically contiguous, see Camera::get_memtype().
+class UserptrBufferPool final : public BufferPool {
+  public:
+    UserptrBufferPool(const uint32_t num_buffers, const uint32_t length);
+    ~UserptrBufferPool() noexcept;
+
+    UserptrBufferPool(UserptrBufferPool&& other) noexcept;
+    UserptrBufferPool& operator=(UserptrBufferPool&& other) noexcept;
+    UserptrBufferPool(const UserptrBufferPool&) = delete;
+    UserptrBufferPool& operator=(const UserptrBufferPool&) = delete;
+
+    void* sync_start(const uint32_t index) override;
+    int sync_end(const uint32_t index) override;
+
+    void* get_address(const uint32_t index) const override;
+
+    int export_fd(const uint32_t index) const override;
+
+    // true when the arena is in hugetlbfs pages, false when it relies on transparent huge pages
+    bool is_hugetlb() const;
+
+  private:
+    void* arena = nullptr;
+    size_t size = 0;
+    size_t stride = 0; // buffers are page aligned
+    bool hugetlb = false;
+};
+
 } // namespace tofcam
@@ -1,17 +1,21 @@
 #pragma once
 
 #include <buffpool.hpp>
+#include <chrono>
 #include <cstdint>
+#include <frame.hpp>
 #include <memory>
 #include <optional>
+#include <telemetry.hpp>
 #include <utility>
 #include <vector>
 
 namespace tofcam {
 
 enum class MemType {
-    MMAP,
-    DMABUF,
+    MMAP,    // buffers of the driver
+    DMABUF,  // buffers of the CMA heap (/dev/dma_heap/linux,cma)
+    USERPTR, // user memory in huge pages, see UserptrBufferPool, MMAP when the driver rejects it
 };
 
 class Camera {
@@ -20,8 +24,9 @@ class Camera {
            std::optional<const std::pair<uint32_t, uint32_t>> imagesize = std::nullopt);
     ~Camera() noexcept;
 
-    Camera(Camera&& other) noexcept;
-    Camera& operator=(Camera&& other) noexcept;
+    // not movable, the RawFrame handles point to the camera
+    Camera(Camera&&) = delete;
+    Camera& operator=(Camera&&) = delete;
     Camera(const Camera&) = delete;
     Camera& operator=(const Camera&) = delete;
 
@@ -29,8 +34,28 @@ class Camera {
 
     void stream_off();
 
+    // blocks until a frame is captured
     std::pair<void*, uint32_t> dequeue();
 
+    // std::nullopt when no frame is captured within `timeout`
+    std::optional<std::pair<void*, uint32_t>> dequeue(const std::chrono::milliseconds timeout);
+
+    // std::nullopt when no frame is ready, never blocks
+    std::optional<std::pair<void*, uint32_t>> try_dequeue();
+
+    // dequeue() into a handle that re-queues the buffer when it is destroyed, see RawFrame
+    RawFrame acquire();
+
+    // std::nullopt when no frame is captured within `timeout`
+    std::optional<RawFrame> acquire(const std::chrono::milliseconds timeout);
+
+    // std::nullopt when no frame is ready, never blocks
+    std::optional<RawFrame> try_acquire();
+
+    // The device is opened non-blocking and its fd is readable (POLLIN / EPOLLIN) while a frame can be dequeued, so
+    // that it can be multiplexed with other fds in an event loop (poll, epoll) and drained with try_dequeue().
+    int get_fd() const;
+
     void enqueue(const uint32_t index);
 
     // {width, height}
@@ -41,8 +66,34 @@ class Camera {
 
     uint32_t get_format() const;
 
+    // the memory of the buffers, MemType::MMAP when MemType::USERPTR was asked for and the driver rejected the user
+    // memory (vb2-dma-contig without an IOMMU)
+    MemType get_memtype() const;
+
+    // DMA-BUF fds of the buffers, by index, to share the frames with other processes. Not supported with
+    // MemType::USERPTR. The caller closes them.
+    std::vector<int> export_buffers() const;
+
+    // the data of buffer `index`, whatever it holds, e.g. to convert a frame before streaming
+    void* get_buffer(const uint32_t index) const;
+
+    // faults in and locks the buffers in memory, see lock_memory()
+    void lock_buffers() const;
+
+    // counters and latencies of the capture path, see Telemetry
+    Telemetry& get_telemetry();
+
+    const Telemetry& get_telemetry() const;
+
   private:
+    // waits up to timeout_ms (-1: no limit) for a frame, false on timeout
+    bool wait(const int timeout_ms) const;
+
+    // VIDIOC_REQBUFS of `count` buffers of this->memorytype, 0 frees them
+    void request_buffers(const uint32_t count);
+
     uint32_t memorytype;
+    uint32_t num_buffers = 0;
     int fd = -1;
     uint32_t width = 0;
     uint32_t height = 0;
@@ -51,6 +102,8 @@ class Camera {
     uint32_t pixelformat = 0;
 
     std::unique_ptr<BufferPool> buffers;
+    std::optional<uint32_t> sequence = std::nullopt; // of the last frame since stream_on()
+    std::unique_ptr<Telemetry> telemetry = std::make_unique<Telemetry>();
 };
 
 } // namespace tofcam
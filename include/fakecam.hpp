@@ -1,10 +1,27 @@
 #pragma once
 
+#include <chrono>
 #include <cstdint>
+#include <deque>
+#include <frame.hpp>
+#include <memory>
+#include <optional>
+#include <random>
+#include <recording.hpp>
+#include <telemetry.hpp>
 #include <utility>
 #include <vector>
 
 namespace tofcam {
+
+// Replay in real time, see FakeCamera::set_pacing().
+struct ReplayPacing {
+    double fps = 0.0;                    // frames per second, 0: unpaced
+    std::chrono::microseconds jitter{0}; // each frame completes up to `jitter` late, uniformly distributed
+    uint32_t num_buffers = 4;            // buffers of the modeled driver
+    uint64_t seed = 0;                   // of the jitter
+};
+
 class FakeCamera {
   public:
     ~FakeCamera() = default;
@@ -13,28 +30,88 @@ class FakeCamera {
             const char* dir, const uint32_t width, const uint32_t height, const uint32_t bytesperline,
             const uint32_t max_frames);
 
+    // Replays a recording (see RecordingWriter) in a loop: its frames are mapped and read ahead as they are dequeued,
+    // not loaded, so that the memory stays constant whatever its length.
+    explicit FakeCamera(const char* recording);
+
+    // Paces the replay like a capture at `pacing.fps` into `pacing.num_buffers` buffers, from the next stream_on(): a
+    // frame completes into the oldest queued buffer, or is lost when the caller holds every buffer (a gap in the
+    // sequence numbers, as the driver does), dequeue() blocks until a frame completed and enqueue() gives a buffer
+    // back. The buffers are indexed 0 to num_buffers - 1 and point to the replayed frames, which are not copied.
+    // Unpaced by default: every frame is ready at once and enqueue() does nothing, for throughput.
+    void set_pacing(const ReplayPacing& pacing);
+
+    // queues all the buffers and starts the clock of the pacing
     void stream_on();
 
     void stream_off();
 
     std::pair<void*, uint32_t> dequeue();
 
+    // std::nullopt when no frame completes within `timeout`, unpaced frames are always ready
+    std::optional<std::pair<void*, uint32_t>> dequeue(const std::chrono::milliseconds timeout);
+
+    std::optional<std::pair<void*, uint32_t>> try_dequeue();
+
     void enqueue(const uint32_t index);
 
+    // of the last dequeue(): the frame count since stream_on() and, when paced, the time the frame completed
+    FrameInfo get_info() const;
+
+    // frames, dropped, wait and kernel (from the completion of a frame to its dequeue) as in Camera
+    Telemetry& get_telemetry();
+
     // {width, height}
     std::pair<uint32_t, uint32_t> get_size() const;
 
     // {sizeimage, bytesperline}
     std::pair<uint32_t, uint32_t> get_bytes() const;
 
+    // the format of the recording (mode, modulation frequencies), nullptr when replaying a directory
+    const RecordingFormat* get_format() const;
+
   private:
     const uint32_t width;
     const uint32_t height;
     const uint32_t bytesperline;
     const uint32_t sizeimage;
-    uint32_t index = 0;
 
     std::vector<std::vector<uint8_t>> frames;
+    std::unique_ptr<Recording> recording;
+
+    // the pacing and the modeled buffers
+    ReplayPacing pacing;
+    std::chrono::nanoseconds period{0}; // 0: unpaced
+    bool streaming = false;
+    uint64_t next = 0;                           // sequence number of the next frame
+    std::chrono::steady_clock::time_point start; // of the stream
+    std::chrono::steady_clock::time_point due;   // of the next frame
+    std::deque<uint32_t> queued;                 // buffers waiting for a frame
+    std::deque<uint32_t> done;                   // buffers holding a frame, in order
+    std::vector<std::pair<void*, FrameInfo>> buffers;
+    std::vector<bool> held; // dequeued and not enqueued yet
+    std::mt19937_64 random;
+
+    FrameInfo info = {};
+    std::optional<uint32_t> sequence = std::nullopt; // of the last frame since stream_on()
+    std::unique_ptr<Telemetry> telemetry = std::make_unique<Telemetry>();
+
+    explicit FakeCamera(std::unique_ptr<Recording> recording);
+
+    // the replayed frame `index`, wrapped around
+    void* source(const uint64_t index);
+
+    // completes the frames due by `now` into the queued buffers
+    void advance(const std::chrono::steady_clock::time_point now);
+
+    // the time the frame `next` completes
+    void schedule();
+
+    // the frame of the oldest done buffer, std::nullopt when none is done by `deadline`
+    std::optional<std::pair<void*, uint32_t>> wait(const std::chrono::steady_clock::time_point deadline);
+
+    // counts the frame in the telemetry
+    void received(const FrameInfo& info, const std::chrono::steady_clock::time_point now);
 
     void reset() noexcept;
 
@@ -0,0 +1,253 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace tofcam {
+
+class Camera;
+
+// What the driver reports about a captured frame.
+struct FrameInfo {
+    uint32_t sequence = 0;                           // frame counter of the driver, gaps are frames it lost
+    std::chrono::steady_clock::time_point timestamp; // end of the capture (CLOCK_MONOTONIC, as steady_clock)
+};
+
+// A raw frame dequeued from a Camera, re-queued when the handle is destroyed or reset(). Move-only, it can be handed
+// to another thread; the camera must outlive it.
+class RawFrame {
+  public:
+    RawFrame() = default;
+    RawFrame(Camera* camera, void* data, const uint32_t index, const FrameInfo& info);
+    ~RawFrame() noexcept;
+
+    RawFrame(RawFrame&& other) noexcept;
+    RawFrame& operator=(RawFrame&& other) noexcept;
+    RawFrame(const RawFrame&) = delete;
+    RawFrame& operator=(const RawFrame&) = delete;
+
+    void* data() const;
+
+    uint32_t index() const;
+
+    const FrameInfo& info() const;
+
+    explicit operator bool() const;
+
+    // re-queues the buffer now, unlike the destructor it reports the errors
+    void reset();
+
+    // gives up the buffer {data, index} without re-queuing it, the caller enqueues it
+    std::pair<void*, uint32_t> release();
+
+  private:
+    Camera* camera = nullptr;
+    void* ptr = nullptr;
+    uint32_t idx = 0;
+    FrameInfo frame_info = {};
+};
+
+// The outputs of a depth frame; mask and points are only filled when enabled.
+struct FrameBuffers {
+    std::vector<float> depth;
+    std::vector<float> confidence;
+    std::vector<uint16_t> depth_u16;
+    std::vector<uint16_t> confidence_u16;
+    std::vector<uint8_t> mask;
+    std::vector<float> points;
+    std::vector<int16_t> points_i16;
+    FrameInfo info = {};
+};
+
+// Pointers to the outputs of a depth frame, T is float or uint16_t (then the points are int16_t). Also used to
+// convert frames into buffers of the caller, mask and points may be null when they are disabled, info when unused.
+template <class T>
+struct FrameView {
+    using P = std::conditional_t<std::is_same_v<T, float>, float, int16_t>;
+    T* depth = nullptr;
+    T* confidence = nullptr;
+    uint8_t* mask = nullptr;
+    P* points = nullptr;
+    FrameInfo* info = nullptr;
+};
+
+// the outputs of get_frame<T>() in `buffers`, null for the empty ones
+template <class T>
+FrameView<T> make_view(FrameBuffers& buffers) {
+    const auto data = [](auto& v) { return v.empty() ? nullptr : v.data(); };
+    if constexpr (std::is_same_v<T, float>) {
+        return {data(buffers.depth), data(buffers.confidence), data(buffers.mask), data(buffers.points), &buffers.info};
+    } else {
+        return {
+                data(buffers.depth_u16), data(buffers.confidence_u16), data(buffers.mask), data(buffers.points_i16),
+                &buffers.info};
+    }
+}
+
+// The outputs of a depth frame packed in one buffer, e.g. a shared memory slot (see FrameServer): offsets aligned to
+// 64 bytes and sizes in bytes, 0 for the disabled outputs. A raw frame only has a size.
+struct FrameLayout {
+    struct Region {
+        uint64_t offset = 0;
+        uint64_t size = 0;
+    };
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t num_planes = 0;
+    uint32_t element_size = 0; // of depth and confidence: 4 (float) or 2 (uint16_t), 0 for a raw frame
+    Region depth;
+    Region confidence;
+    Region mask;
+    Region points;
+    uint64_t size = 0;
+
+    // `elements` values of depth and of confidence, `mask_size` bytes of mask and `num_points` points
+    template <class T>
+    static FrameLayout pack(
+            const uint32_t width, const uint32_t height, const uint32_t num_planes, const uint64_t elements,
+            const uint64_t mask_size, const uint64_t num_points) {
+        FrameLayout layout = {width, height, num_planes, sizeof(T), {}, {}, {}, {}, 0};
+        const auto add = [&layout](Region& region, const uint64_t size) {
+            if (size) {
+                region = {layout.size, size};
+                layout.size = (layout.size + size + 63) & ~uint64_t(63);
+            }
+        };
+        add(layout.depth, elements * sizeof(T));
+        add(layout.confidence, elements * sizeof(T));
+        add(layout.mask, mask_size);
+        add(layout.points, num_points * 3 * sizeof(typename FrameView<T>::P));
+        return layout;
+    }
+
+    static FrameLayout raw(const uint64_t size) {
+        FrameLayout layout = {};
+        layout.size = size;
+        return layout;
+    }
+
+    // the outputs in the buffer at `base`
+    template <class T>
+    FrameView<T> view(void* base, FrameInfo* info = nullptr) const {
+        using P = typename FrameView<T>::P;
+        if (this->element_size != sizeof(T)) {
+            throw std::invalid_argument("The layout does not hold frames of this type.");
+        }
+        uint8_t* const data = static_cast<uint8_t*>(base);
+        const auto at = [data](const Region& region) { return region.size ? data + region.offset : nullptr; };
+        return {reinterpret_cast<T*>(at(this->depth)), reinterpret_cast<T*>(at(this->confidence)), at(this->mask),
+                reinterpret_cast<P*>(at(this->points)), info};
+    }
+};
+
+// A fixed number of FrameBuffers lent to DepthFrame handles, which give them back from any thread.
+class FramePool {
+  public:
+    explicit FramePool(const uint32_t capacity);
+
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    // nullptr when all the buffers are lent
+    FrameBuffers* acquire();
+
+    void release(FrameBuffers* buffers);
+
+    uint32_t capacity() const;
+
+    uint32_t num_available() const; // the buffers not lent
+
+  private:
+    mutable std::mutex mutex;
+    std::vector<FrameBuffers> buffers;
+    std::vector<FrameBuffers*> available;
+};
+
+// A depth frame converted into buffers of a FramePool, given back to the pool when the handle is destroyed or reset().
+// Move-only, it keeps the pool alive and can be handed to another thread without copying the frame.
+template <class T>
+class DepthFrame {
+  public:
+    using P = typename FrameView<T>::P;
+
+    DepthFrame() = default;
+
+    DepthFrame(std::shared_ptr<FramePool> pool, FrameBuffers* buffers, const uint32_t width, const uint32_t height)
+        : pool(std::move(pool)), buffers(buffers), width(width), height(height) {}
+
+    ~DepthFrame() noexcept {
+        this->reset();
+    }
+
+    DepthFrame(DepthFrame&& other) noexcept
+        : pool(std::move(other.pool)), buffers(std::exchange(other.buffers, nullptr)), width(other.width),
+          height(other.height) {}
+
+    DepthFrame& operator=(DepthFrame&& other) noexcept {
+        if (this != &other) {
+            this->reset();
+            this->pool = std::move(other.pool);
+            this->buffers = std::exchange(other.buffers, nullptr);
+            this->width = other.width;
+            this->height = other.height;
+        }
+        return *this;
+    }
+
+    DepthFrame(const DepthFrame&) = delete;
+    DepthFrame& operator=(const DepthFrame&) = delete;
+
+    FrameView<T> view() const {
+        return this->buffers ? make_view<T>(*this->buffers) : FrameView<T>{};
+    }
+
+    T* depth() const {
+        return this->view().depth;
+    }
+
+    T* confidence() const {
+        return this->view().confidence;
+    }
+
+    const uint8_t* mask() const {
+        return this->view().mask;
+    }
+
+    const P* points() const {
+        return this->view().points;
+    }
+
+    const FrameInfo& info() const {
+        return this->buffers->info;
+    }
+
+    // {width, height} of the depth map
+    std::pair<uint32_t, uint32_t> size() const {
+        return {this->width, this->height};
+    }
+
+    explicit operator bool() const {
+        return this->buffers != nullptr;
+    }
+
+    void reset() {
+        if (this->buffers) {
+            this->pool->release(std::exchange(this->buffers, nullptr));
+            this->pool = nullptr;
+        }
+    }
+
+  private:
+    std::shared_ptr<FramePool> pool;
+    FrameBuffers* buffers = nullptr;
+    uint32_t width = 0;
+    uint32_t height = 0;
+};
+
+} // namespace tofcam
@@ -0,0 +1,85 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <optional>
+#include <utility>
+
+namespace tofcam {
+
+// What the producer of a FrameRing does when all the slots hold frames that were not read yet.
+enum class Overflow {
+    DropOldest, // reuses the slot of the oldest unread frame, the consumer always gets recent frames
+    Block,      // waits for the consumer, no frame is lost
+};
+
+// Lock-free hand-over of frames from one producer thread to one consumer thread through a fixed number of slots, whose
+// payload is owned by the caller and indexed by the slot number. A slot is free, written by the producer, ready, or
+// read by the consumer; the frames are read in the order they were published.
+// Only the waits sleep: the producer on an atomic (Overflow::Block), the consumer on an eventfd, which is readable
+// while a frame is ready and can be polled in an event loop.
+class FrameRing {
+  public:
+    FrameRing(const uint32_t num_slots, const Overflow overflow);
+    ~FrameRing() noexcept;
+
+    FrameRing(const FrameRing&) = delete;
+    FrameRing& operator=(const FrameRing&) = delete;
+
+    // Producer: a slot to write the next frame into, std::nullopt once closed.
+    std::optional<uint32_t> acquire();
+
+    // Producer: acquire() without waiting, std::nullopt when every slot is taken (Overflow::Block) or once closed.
+    std::optional<uint32_t> try_acquire();
+
+    // Producer: hands the slot returned by acquire() to the consumer.
+    void publish(const uint32_t slot);
+
+    // Consumer: the oldest ready frame (the newest with Overflow::DropOldest, which drops the older ones), std::nullopt
+    // when none is published within `timeout`. The slot is read until the next pop() or release().
+    std::optional<uint32_t> pop(const std::chrono::milliseconds timeout);
+
+    // Consumer: pop() without waiting.
+    std::optional<uint32_t> try_pop();
+
+    // Consumer: gives the slot of the last pop() back to the producer.
+    void release();
+
+    // Wakes the producer and the consumer, acquire() returns std::nullopt from then on and pop() once the ready frames
+    // are read.
+    void close();
+
+    bool is_closed() const;
+
+    // readable while a frame is ready
+    int get_fd() const;
+
+    // frames overwritten before they were read (Overflow::DropOldest)
+    uint64_t get_dropped() const;
+
+  private:
+    // the state of a slot: FREE, WRITING, READING, or READY | (sequence number << 2)
+    static constexpr uint64_t FREE = 0;
+    static constexpr uint64_t WRITING = 1;
+    static constexpr uint64_t READING = 2;
+    static constexpr uint64_t READY = 3;
+
+    const uint32_t num_slots;
+    const Overflow overflow;
+    std::unique_ptr<std::atomic<uint64_t>[]> states;
+    std::atomic<uint32_t> released{0}; // incremented on every release, the producer waits on it
+    std::atomic<bool> closed{false};
+    uint64_t sequence = 0;                       // producer only
+    std::optional<uint32_t> held = std::nullopt; // consumer only
+    std::atomic<uint64_t> dropped{0};
+    int fd = -1;
+
+    // the ready slot with the oldest (or the newest) frame and its state
+    std::optional<std::pair<uint32_t, uint64_t>> find_ready(const bool newest) const;
+
+    void signal();
+};
+
+} // namespace tofcam
@@ -0,0 +1,101 @@
+#pragma once
+
+#include <atomic>
+#include <bo410.hpp>
+#include <bo548.hpp>
+#include <chrono>
+#include <cstdint>
+#include <exception>
+#include <frame.hpp>
+#include <functional>
+#include <memory>
+#include <thread>
+#include <vector>
+
+namespace tofcam {
+
+// called on the worker of the camera with every frame it converts, the frame goes back to the pool of the camera
+// when it is destroyed
+template <class T = float>
+using FrameCallback = std::function<void(const uint32_t camera, DepthFrame<T> frame)>;
+
+struct CameraStats {
+    uint64_t frames = 0;  // frames handed to the callback
+    uint64_t dropped = 0; // frames lost by the driver, see Telemetry
+    uint64_t skipped = 0; // frames given back to the driver unconverted while the callbacks held the whole pool
+    double fps = 0.0;     // frames handed to the callback per second since the previous get_stats() (or start())
+};
+
+// Drives several cameras from one epoll loop: the loop thread waits on the fds of all the cameras and wakes the worker
+// of a camera when a capture completes, which converts the frames already captured (acquire_frame<T>(0ms)) and hands
+// them to the callback. While the callbacks hold every frame of the pool of a camera its frames are skipped. Each
+// camera has its own worker, pinned to a CPU of its own so that the cameras do not contend for the cores, and is only
+// used by it between start() and stop(): the settings can not change meanwhile.
+class CameraGroup {
+  public:
+    CameraGroup();
+    ~CameraGroup() noexcept;
+
+    CameraGroup(const CameraGroup&) = delete;
+    CameraGroup& operator=(const CameraGroup&) = delete;
+
+    // Takes over a camera, converted on a worker pinned to `cpu` (-1: not pinned) with the SCHED_FIFO `priority` (0:
+    // SCHED_OTHER, see RealtimeOptions) into a pool of `num_frames` frames (see set_frame_pool()), and returns its
+    // index. Only before start(). The worker is the capture thread of the camera: set_realtime() of the camera only
+    // applies to its conversion threads here.
+    template <class T = float>
+    uint32_t add(
+            std::unique_ptr<BO548> camera, const int cpu, FrameCallback<T> callback, const uint32_t num_frames = 4,
+            const int priority = 0);
+
+    template <class T = float>
+    uint32_t add(
+            std::unique_ptr<BO410> camera, const int cpu, FrameCallback<T> callback, const uint32_t num_frames = 4,
+            const int priority = 0);
+
+    // streams all the cameras and starts the workers and the loop, which is pinned to `cpu` (-1: not pinned)
+    void start(const int cpu = -1);
+
+    // stops the loop and the workers and the streams, the frames held by the callbacks stay valid
+    void stop();
+
+    uint32_t size() const;
+
+    CameraStats get_stats(const uint32_t camera);
+
+    Telemetry& get_telemetry(const uint32_t camera);
+
+    // Rethrows the first error of a worker (or a callback), whose camera is not converted anymore. Every worker is
+    // still running otherwise.
+    void check() const;
+
+  private:
+    struct Member;
+
+    template <class Device, class T>
+    struct Driver;
+
+    // add() of either camera
+    template <class Device, class T>
+    uint32_t add_member(
+            std::unique_ptr<Device> camera, const int cpu, FrameCallback<T> callback, const uint32_t num_frames,
+            const int priority);
+
+    void worker_loop(Member& member);
+
+    void event_loop();
+
+    // wakes the loop up, for stop()
+    void signal();
+
+    std::vector<std::unique_ptr<Member>> members;
+    int epoll = -1;
+    int event = -1; // eventfd of stop()
+    std::thread loop;
+    std::atomic<bool> stopping{false};
+    std::exception_ptr failure; // of the loop
+    std::atomic<bool> failed{false};
+    bool running = false;
+};
+
+} // namespace tofcam
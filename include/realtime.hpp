@@ -0,0 +1,27 @@
+#pragma once
+
+#include <cstddef>
+#include <frame.hpp>
+#include <pthread.h>
+
+namespace tofcam {
+
+// Options of the capture path against latency spikes, all off by default, see BO548::set_realtime().
+struct RealtimeOptions {
+    int cpu = -1;         // CPU of the capture thread, -1: not pinned (the conversion threads: set_num_threads())
+    int priority = 0;     // SCHED_FIFO priority (1 to 99) of the capture and conversion threads, 0: SCHED_OTHER
+    bool lock = false;    // pre-faults and locks (mlock) the capture buffers and the outputs in memory
+    bool prewarm = false; // converts one frame before streaming, to fault in the code, the tables and the outputs
+};
+
+// Pins `thread` to `cpu` (-1: any CPU of the process) and gives it the SCHED_FIFO `priority` (0: SCHED_OTHER), which
+// needs CAP_SYS_NICE or an RLIMIT_RTPRIO. -1 and 0 undo an earlier call.
+void set_thread_realtime(const pthread_t thread, const int cpu, const int priority);
+
+// faults in and locks the pages of [addr, addr + size), which needs CAP_IPC_LOCK or an RLIMIT_MEMLOCK above it
+void lock_memory(const void* addr, const size_t size);
+
+// lock_memory() of the outputs allocated in `buffers`
+void lock_memory(const FrameBuffers& buffers);
+
+} // namespace tofcam
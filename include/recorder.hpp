@@ -0,0 +1,73 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <exception>
+#include <frame.hpp>
+#include <framering.hpp>
+#include <recording.hpp>
+#include <telemetry.hpp>
+#include <thread>
+#include <vector>
+
+namespace tofcam {
+
+struct RecorderStats {
+    uint64_t recorded = 0;    // frames accepted by record()
+    uint64_t written = 0;     // frames written to the file
+    uint64_t dropped = 0;     // frames refused by record() because every slot was queued (back-pressure)
+    uint32_t pending = 0;     // frames queued and not written yet
+    uint32_t max_pending = 0; // the most frames queued at once
+};
+
+// Records raw frames at the full rate of the camera: record() copies the frame into one of `num_slots` page aligned
+// slots and returns at once, and a writer thread appends the queued frames to a recording (see RecordingWriter) with
+// O_DIRECT, so that neither the disk nor the page cache ever delays the capture. When the disk falls `num_slots`
+// frames behind, record() drops the frame instead of waiting.
+class Recorder {
+  public:
+    // the writer thread is pinned to `cpu` (-1: not pinned)
+    Recorder(const char* path, const RecordingFormat& format, const uint32_t num_slots = 32, const int cpu = -1);
+
+    // finishes the recording, ignoring the errors
+    ~Recorder() noexcept;
+
+    Recorder(const Recorder&) = delete;
+    Recorder& operator=(const Recorder&) = delete;
+
+    // Queues a frame of format.sizeimage bytes, false when it is dropped. Rethrows the error of the writer thread,
+    // which stops writing on the first one.
+    bool record(const void* data, const FrameInfo& info);
+
+    // writes the queued frames, the index and the header and closes the file, then rethrows the error of the writer
+    void finish();
+
+    RecorderStats get_stats() const;
+
+    // of the writes of one frame, on the writer thread
+    const Histogram& get_write_latency() const;
+
+  private:
+    void writer_loop();
+
+    void write(const uint32_t slot);
+
+    RecordingWriter writer;
+    FrameRing ring;
+    const uint64_t stride; // bytes of a slot
+    const uint32_t sizeimage;
+    void* slots = nullptr; // num_slots * stride bytes
+    size_t length = 0;
+    std::vector<FrameInfo> infos; // of the slots
+    std::thread thread;
+    bool finished = false;
+    std::atomic<uint64_t> recorded{0};
+    std::atomic<uint64_t> written{0};
+    std::atomic<uint64_t> dropped{0};
+    std::atomic<uint32_t> max_pending{0};
+    Histogram latency;
+    std::exception_ptr failure; // of the writer thread
+    std::atomic<bool> failed{false};
+};
+
+} // namespace tofcam
@@ -0,0 +1,117 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <frame.hpp>
+#include <string>
+#include <vector>
+
+namespace tofcam {
+
+// The format of the raw frames of a recording.
+struct RecordingFormat {
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t bytesperline = 0;
+    uint32_t sizeimage = 0;   // bytes per frame
+    uint32_t pixelformat = 0; // V4L2 fourcc, Y12P
+    uint32_t mode = 0;        // of the camera, e.g. the BO548 Mode or the BO410 range
+    float modfreq_hz[2] = {}; // modulation frequencies, 0 when unused
+};
+
+// One file of raw frames: a header page, the frames page aligned one after the other (so that they can be mapped and
+// written with O_DIRECT), then the index of their offsets and FrameInfo. The header and the index are written last:
+// a recording that was not finished has no frames.
+struct RecordingHeader {
+    static constexpr char MAGIC[8] = {'T', 'O', 'F', 'R', 'E', 'C', '0', '1'};
+    static constexpr uint64_t PAGE = 4096;
+
+    char magic[8] = {};
+    uint32_t header_size = sizeof(RecordingHeader);
+    uint32_t entry_size = 0; // of RecordingEntry
+    RecordingFormat format;
+    uint32_t reserved[2] = {}; // zero, and no implicit padding before num_frames
+    uint64_t num_frames = 0;
+    uint64_t index_offset = 0; // of num_frames RecordingEntry
+};
+
+struct RecordingEntry {
+    uint64_t offset = 0;   // of the frame in the file
+    uint32_t sequence = 0; // FrameInfo
+    uint32_t reserved = 0;
+    int64_t timestamp_ns = 0; // steady_clock
+};
+
+// the layout of the file, without padding bytes
+static_assert(sizeof(RecordingFormat) == 32);
+static_assert(offsetof(RecordingHeader, format) == 16 && offsetof(RecordingHeader, reserved) == 48);
+static_assert(offsetof(RecordingHeader, num_frames) == 56 && offsetof(RecordingHeader, index_offset) == 64);
+static_assert(sizeof(RecordingHeader) == 72);
+static_assert(offsetof(RecordingEntry, sequence) == 8 && offsetof(RecordingEntry, timestamp_ns) == 16);
+static_assert(sizeof(RecordingEntry) == 24);
+
+// Writes a recording with pwrite(): each frame takes round_up(sizeimage, 4096) bytes, and the index is kept in memory
+// until finish(). With `direct` the frames bypass the page cache (O_DIRECT, unless the file system does not support
+// it), and write() then takes page aligned frames of round_up(sizeimage, 4096) bytes.
+class RecordingWriter {
+  public:
+    RecordingWriter(const char* path, const RecordingFormat& format, const bool direct = false);
+
+    // finishes the recording, ignoring the errors
+    ~RecordingWriter() noexcept;
+
+    RecordingWriter(const RecordingWriter&) = delete;
+    RecordingWriter& operator=(const RecordingWriter&) = delete;
+
+    // appends a frame of format.sizeimage bytes
+    void write(const void* data, const FrameInfo& info);
+
+    uint64_t get_stride() const; // round_up(sizeimage, 4096), the bytes of a frame in the file
+
+    // writes the index and the header and closes the file, no frame can be written anymore
+    void finish();
+
+    uint64_t get_num_frames() const;
+
+  private:
+    std::string path;
+    int fd = -1;
+    RecordingFormat format;
+    uint64_t stride = 0; // of the frames in the file
+    bool direct = false; // O_DIRECT
+    std::vector<RecordingEntry> index;
+    std::vector<uint8_t> padding; // zeros up to the next page
+};
+
+// A recording mapped read-only (copy on write): the frames are read from the page cache as they are accessed,
+// whatever the size of the file. Read the frames in order and call advise() to keep the memory constant.
+class Recording {
+  public:
+    explicit Recording(const char* path);
+    ~Recording() noexcept;
+
+    Recording(const Recording&) = delete;
+    Recording& operator=(const Recording&) = delete;
+
+    const RecordingFormat& get_format() const;
+
+    uint64_t size() const; // number of frames
+
+    // the frame `index`, its writes stay private
+    void* frame(const uint64_t index) const;
+
+    FrameInfo info(const uint64_t index) const;
+
+    // Starts to read the frames [index, index + count) ahead (MADV_WILLNEED), and drops the frames [index - 2 * count,
+    // index - count) from the mapping and the page cache: they are read again from the file when accessed.
+    void advise(const uint64_t index, const uint64_t count) const;
+
+  private:
+    int fd = -1;
+    void* base = nullptr;
+    size_t length = 0;
+    RecordingHeader header;
+    const RecordingEntry* entries = nullptr;
+};
+
+} // namespace tofcam
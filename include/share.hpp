@@ -0,0 +1,296 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <frame.hpp>
+#include <optional>
+#include <string>
+#include <vector>
+
+namespace tofcam {
+
+// Shares frames with other local processes without copying them: the slots are memfds (depth frames) or DMA-BUFs
+// (raw frames, see BO548::export_rawframes()), sent once to each reader over a Unix domain socket (SCM_RIGHTS) and
+// mapped read-only there. Then only the slot of each frame is sent, and the reader sends it back once it is done with
+// it: a slot is written again only after every reader it was sent to has released it, a reader that disconnects
+// releases its slots. Up to 64 slots. Not thread-safe, dispatch() is also called by acquire() and publish().
+class FrameServer {
+  public:
+    // `num_slots` memfds of `layout.size` bytes for depth frames, e.g. layout = BO548::get_layout<T>()
+    FrameServer(const char* path, const uint32_t num_slots, const FrameLayout& layout);
+
+    // The buffers `fds` (taken over) of `layout.size` bytes, e.g. BO548::export_rawframes() and
+    // FrameLayout::raw(BO548::get_bytes().first), their frames are published with publish(RawFrame).
+    FrameServer(const char* path, std::vector<int> fds, const FrameLayout& layout);
+
+    ~FrameServer() noexcept;
+
+    FrameServer(const FrameServer&) = delete;
+    FrameServer& operator=(const FrameServer&) = delete;
+
+    // a slot that no reader holds, to write the next frame into, std::nullopt when the readers hold all of them
+    std::optional<uint32_t> acquire();
+
+    // The outputs in an acquired slot, e.g. for BO548::get_frame(view). The info of the frame is written to the slot
+    // too and sent by publish().
+    template <class T>
+    FrameView<T> view(const uint32_t slot) {
+        return this->layout.view<T>(this->addresses.at(slot), &this->infos.at(slot));
+    }
+
+    void* get_address(const uint32_t slot) const;
+
+    // sends an acquired slot to the readers, it can be acquired again once they all released it
+    void publish(const uint32_t slot);
+
+    // Sends the raw frame to the readers, it is re-queued once they all released it (or now without readers). One
+    // buffer always stays with the driver: false when the readers hold all the others, the frame is re-queued unsent.
+    bool publish(RawFrame frame);
+
+    // accepts the new readers and reads the releases, never blocks
+    void dispatch();
+
+    // readable (POLLIN / EPOLLIN) while dispatch() has something to do
+    int get_fd() const;
+
+    uint32_t get_num_readers() const;
+
+  private:
+    struct Reader {
+        int fd = -1;
+        uint64_t held = 0; // bitmask of the slots sent and not released yet
+    };
+
+    FrameServer(const char* path, const FrameLayout& layout);
+
+    // sends the slot to every reader that has room for it
+    void send(const uint32_t slot);
+
+    void release(const uint32_t slot);
+
+    // releases the slots of the reader
+    void drop(const size_t index);
+
+    std::string path;
+    int listener = -1;
+    int epoll = -1;
+    FrameLayout layout;
+    std::vector<int> fds;
+    std::vector<void*> addresses;     // memfd slots, mapped here
+    std::vector<FrameInfo> infos;     // of the frame in each slot
+    std::vector<uint32_t> references; // readers holding each slot
+    std::vector<bool> writing;        // acquired and not published yet
+    std::vector<RawFrame> raws;       // raw frames published and not released yet
+    std::vector<Reader> readers;
+};
+
+class FrameClient;
+
+// A frame received from a FrameServer, released when the handle is destroyed or reset(). Move-only, the client must
+// outlive it.
+class SharedFrame {
+  public:
+    SharedFrame() = default;
+    SharedFrame(FrameClient* client, const uint32_t slot, const FrameInfo& info);
+    ~SharedFrame() noexcept;
+
+    SharedFrame(SharedFrame&& other) noexcept;
+    SharedFrame& operator=(SharedFrame&& other) noexcept;
+    SharedFrame(const SharedFrame&) = delete;
+    SharedFrame& operator=(const SharedFrame&) = delete;
+
+    const void* data() const;
+
+    // The outputs of a depth frame (see FrameClient::get_layout()), nullptr for the disabled ones. T is the type of the
+    // published frames, float or uint16_t, and P float or int16_t.
+    template <class T = float>
+    const T* depth() const;
+
+    template <class T = float>
+    const T* confidence() const;
+
+    const uint8_t* mask() const;
+
+    template <class P = float>
+    const P* points() const;
+
+    uint32_t slot() const;
+
+    const FrameInfo& info() const;
+
+    explicit operator bool() const;
+
+    void reset() noexcept;
+
+  private:
+    // the region of the frame, nullptr when it is empty
+    const void* find(const FrameLayout::Region FrameLayout::*region, const uint32_t element_size) const;
+
+    FrameClient* client = nullptr;
+    uint32_t index = 0;
+    FrameInfo frame_info = {};
+};
+
+// A reader of a FrameServer, which maps the slots read-only when it connects.
+class FrameClient {
+  public:
+    explicit FrameClient(const char* path);
+    ~FrameClient() noexcept;
+
+    FrameClient(const FrameClient&) = delete;
+    FrameClient& operator=(const FrameClient&) = delete;
+
+    // blocks until a frame is published, throws when the server is gone
+    SharedFrame receive();
+
+    // std::nullopt when no frame is published within `timeout`
+    std::optional<SharedFrame> receive(const std::chrono::milliseconds timeout);
+
+    // readable (POLLIN / EPOLLIN) while a frame can be received
+    int get_fd() const;
+
+    const FrameLayout& get_layout() const;
+
+    uint32_t get_num_slots() const;
+
+    const void* get_address(const uint32_t slot) const;
+
+  private:
+    friend class SharedFrame;
+
+    // sends the slot back, errors are ignored: the server releases the slots of the readers it lost
+    void release(const uint32_t slot) noexcept;
+
+    int fd = -1;
+    FrameLayout layout;
+    std::vector<void*> addresses;
+};
+
+// Publishes depth frames to any number of local subscribers through one memfd: a ring of `num_slots` frames with a
+// seqlock version each. The frames are converted straight into the ring (see begin()), the subscribers map it read-only
+// and read the frames in place without syscalls. Nothing waits for the subscribers: a frame is overwritten
+// `num_slots` - 1 frames later whether it is read or not, and a subscriber detects it with PublishedFrame::valid().
+// The memfd is sent to the subscribers when they connect to the Unix domain socket `path`. Not thread-safe.
+class FramePublisher {
+  public:
+    // 2 to 64 slots of `layout`, e.g. BO548::get_layout<T>()
+    FramePublisher(const char* path, const uint32_t num_slots, const FrameLayout& layout);
+    ~FramePublisher() noexcept;
+
+    FramePublisher(const FramePublisher&) = delete;
+    FramePublisher& operator=(const FramePublisher&) = delete;
+
+    // The outputs in the slot of the next frame, e.g. for BO548::get_frame(view), which the subscribers see as being
+    // overwritten until publish(). Again the same slot until then.
+    template <class T>
+    FrameView<T> begin() {
+        return this->layout.view<T>(this->start(), &this->info);
+    }
+
+    // the frame written since begin() becomes the newest one, with the info that get_frame() wrote to the view
+    void publish();
+
+    // sends the ring to the subscribers that connected, never blocks, also called by publish()
+    void dispatch();
+
+    // readable (POLLIN / EPOLLIN) when a subscriber connects
+    int get_fd() const;
+
+    uint64_t get_published() const; // frames published
+
+  private:
+    // the data of the slot of the next frame, marked as being written
+    void* start();
+
+    std::string path;
+    int listener = -1;
+    int fd = -1; // memfd of the ring
+    uint32_t num_slots = 0;
+    FrameLayout layout;
+    size_t size = 0;
+    void* ring = nullptr;
+    bool writing = false;
+    FrameInfo info = {};
+};
+
+class FrameSubscriber;
+
+// A frame read in place from a FramePublisher ring, which the publisher may overwrite meanwhile: what is read from it
+// is only consistent if valid() is still true afterwards. Valid as long as the subscriber.
+class PublishedFrame {
+  public:
+    PublishedFrame(const FrameSubscriber* subscriber, const uint32_t slot, const uint64_t version, const uint64_t number,
+                   const FrameInfo& info);
+
+    const void* data() const;
+
+    // see SharedFrame
+    template <class T = float>
+    const T* depth() const;
+
+    template <class T = float>
+    const T* confidence() const;
+
+    const uint8_t* mask() const;
+
+    template <class P = float>
+    const P* points() const;
+
+    uint64_t number() const; // 1 for the first frame published
+
+    const FrameInfo& info() const;
+
+    // false once the publisher started to overwrite the frame, then what was read may be torn
+    bool valid() const;
+
+  private:
+    const FrameSubscriber* subscriber;
+    uint32_t slot;
+    uint64_t version;
+    uint64_t frame_number;
+    FrameInfo frame_info;
+};
+
+// A subscriber of a FramePublisher, which maps its ring read-only when it connects and then reads the frames without
+// syscalls (except to wait for one). Only one thread may use it.
+class FrameSubscriber {
+  public:
+    explicit FrameSubscriber(const char* path);
+    ~FrameSubscriber() noexcept;
+
+    FrameSubscriber(const FrameSubscriber&) = delete;
+    FrameSubscriber& operator=(const FrameSubscriber&) = delete;
+
+    // the newest frame, std::nullopt when none is published yet
+    std::optional<PublishedFrame> latest();
+
+    // The frame after the last one read, or the oldest one still in the ring when the subscriber lagged behind (see
+    // get_lost()). std::nullopt when it is not published yet.
+    std::optional<PublishedFrame> next();
+
+    // false when no frame newer than the last one read is published within `timeout`
+    bool wait(const std::chrono::milliseconds timeout) const;
+
+    uint64_t get_lost() const; // frames skipped by next() because they were overwritten
+
+    const FrameLayout& get_layout() const;
+
+  private:
+    friend class PublishedFrame;
+
+    // frame `number`, std::nullopt when it is not in the ring anymore
+    std::optional<PublishedFrame> read(const uint64_t number) const;
+
+    const void* get_address(const uint32_t slot) const;
+
+    uint64_t get_version(const uint32_t slot) const;
+
+    uint32_t num_slots = 0;
+    FrameLayout layout;
+    size_t size = 0;
+    const void* ring = nullptr;
+    uint64_t last = 0; // number of the last frame read
+    uint64_t lost = 0;
+};
+
+} // namespace tofcam
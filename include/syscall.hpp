@@ -1,6 +1,7 @@
 #pragma once
 
 #include <fcntl.h>
+#include <poll.h>
 
 namespace tofcam::syscall {
 
@@ -14,4 +15,8 @@ void* mmap(void* addr, size_t length, int prot, int flags, int fd, off_t offset)
 
 int munmap(void* addr, size_t length);
 
+int madvise(void* addr, size_t length, int advice);
+
+int poll(struct pollfd* fds, nfds_t nfds, int timeout);
+
 } // namespace tofcam::syscall
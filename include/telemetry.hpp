@@ -0,0 +1,63 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+namespace tofcam {
+
+// Latency histogram with logarithmic buckets, each power of two split into 8 linear sub-buckets (HDR-style, within
+// 12.5% from 1ns to 2^40ns). Recording is a few relaxed atomic increments, it can be read from any thread meanwhile.
+class Histogram {
+  public:
+    void record(const std::chrono::nanoseconds value);
+
+    uint64_t count() const;
+
+    std::chrono::nanoseconds mean() const;
+
+    std::chrono::nanoseconds max() const;
+
+    // upper bound of the bucket of the `quantile` (0 to 1) of the recorded values, 0 when empty
+    std::chrono::nanoseconds percentile(const double quantile) const;
+
+    // not atomic with the concurrent record() calls, which may be half counted
+    void reset();
+
+  private:
+    static constexpr uint32_t SUB_BITS = 3;
+    static constexpr uint32_t MAX_BITS = 40;
+    // and one more for the values from 2^MAX_BITS on
+    static constexpr uint32_t NUM_BUCKETS = ((MAX_BITS - SUB_BITS + 1) << SUB_BITS) + 1;
+
+    static uint32_t bucket_of(const uint64_t value);
+
+    static uint64_t upper_bound(const uint32_t bucket);
+
+    std::atomic<uint64_t> buckets[NUM_BUCKETS] = {};
+    std::atomic<uint64_t> total{0};
+    std::atomic<uint64_t> sum{0};
+    std::atomic<uint64_t> maximum{0};
+};
+
+// Counters and latency histograms of the capture path, updated lock-free by the thread that captures and readable at
+// any time from the others.
+struct Telemetry {
+    std::atomic<uint64_t> frames{0};    // frames dequeued
+    std::atomic<uint64_t> dropped{0};   // frames lost by the driver, from the gaps in the sequence numbers
+    std::atomic<uint64_t> resyncs{0};   // BO410 phase misalignments, each resynchronized at the next phase 0
+    std::atomic<uint64_t> discarded{0}; // frames discarded by the resynchronizations
+    Histogram wait;                     // waiting in dequeue() / acquire() for a frame
+    Histogram kernel;                   // from the driver timestamp (end of the frame) to its dequeue
+    Histogram sync;                     // cache maintenance of the buffer before it is read and before it is queued
+    Histogram queue;                    // VIDIOC_QBUF
+    Histogram convert;                  // conversion into depth (BO548, BO410)
+
+    void reset();
+
+    // counters and mean / p50 / p99 / p99.9 / max of the histograms, one line each
+    void dump(FILE* fp) const;
+};
+
+} // namespace tofcam
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace tofcam {
+
+// Persistent workers for splitting a frame into row bands.
+// The threads are created once and sleep between frames; the calling thread takes part in every run().
+class ThreadPool {
+  public:
+    // Spawns num_threads - 1 workers. Worker i is pinned to cpus[i % cpus.size()],
+    // or to the (i + 1)-th CPU of the process affinity mask if cpus is empty.
+    // The workers run with the SCHED_FIFO `priority` unless it is 0 (see set_thread_realtime()).
+    ThreadPool(const uint32_t num_threads, const std::vector<int>& cpus = {}, const int priority = 0);
+    ~ThreadPool() noexcept;
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // number of threads running tasks, including the caller
+    uint32_t size() const;
+
+    // Calls task(i) for every i in [0, num_tasks) and returns once all of them finished.
+    // The task must not throw, and run() must not be called from several threads at once.
+    template <class Task>
+    void run(const uint32_t num_tasks, Task&& task) {
+        this->dispatch(num_tasks, &task, [](void* task, const uint32_t i) {
+            (*static_cast<std::remove_reference_t<Task>*>(task))(i);
+        });
+    }
+
+  private:
+    using Trampoline = void (*)(void*, const uint32_t);
+
+    std::vector<std::thread> workers;
+    void* task = nullptr;
+    Trampoline trampoline = nullptr;
+    uint32_t num_tasks = 0;
+    std::atomic<uint32_t> next{0};
+    std::atomic<uint32_t> generation{0};
+    std::atomic<uint32_t> running{0};
+    bool stopping = false;
+
+    void dispatch(const uint32_t num_tasks, void* task, Trampoline trampoline);
+
+    void drain();
+
+    void worker_loop();
+
+    void shutdown() noexcept;
+};
+
+} // namespace tofcam
@@ -3,10 +3,6 @@
 #include <cstddef>
 #include <cstdint>
 
-#if defined(__ARM_NEON)
-#include <arm_neon.h>
-#endif
-
 namespace tofcam {
 
 enum class Rotation {
@@ -16,19 +12,376 @@ enum class Rotation {
     ThreeQuarters,
 };
 
+// Accuracy of the atan2 approximation in the depth kernels, with the max depth error against std::atan2 at 90 / 15MHz.
+enum class Atan2 {
+    Fast,    // first-order approximation, with a reciprocal estimate instead of the division on SIMD, 1.0 / 6.0mm
+    Default, // first-order approximation atan(t) = pi/4 t + 0.273 t (1 - t), 1.0 / 6.0mm
+    Poly3,   // 3rd-order minimax polynomial, 0.35 / 2.1mm
+    Poly5,   // 5th-order minimax polynomial, 0.007 / 0.04mm
+};
+
+// A rectangle of the frame in pixels, any position and size.
+struct Roi {
+    uint32_t x = 0;
+    uint32_t y = 0;
+    uint32_t width = 0;
+    uint32_t height = 0;
+};
+
+// Invalidates the pixels whose amplitude is below `amplitude` (0 disables it): their depth is written as 0 in the same
+// pass as the conversion. `mask`, if not null, receives a validity bit per pixel, set where the depth is kept:
+// bit x % 8 of byte x / 8 of each row, (width + 7) / 8 bytes per row of the depth map.
+struct Threshold {
+    float amplitude = 0.0f;
+    uint8_t* mask = nullptr;
+};
+
+// Pinhole intrinsics of the full sensor image in pixels and Brown-Conrady distortion coefficients, in OpenCV's order.
+struct Intrinsics {
+    float fx = 0.0f;
+    float fy = 0.0f;
+    float cx = 0.0f;
+    float cy = 0.0f;
+    float k1 = 0.0f;
+    float k2 = 0.0f;
+    float p1 = 0.0f;
+    float p2 = 0.0f;
+    float k3 = 0.0f;
+};
+
+// Exponential moving average of the depth over consecutive frames, restarted per pixel where the depth or the amplitude
+// jumps (motion, edges) and where the depth is invalid (0).
+struct TemporalFilter {
+    float alpha = 0.25f;         // weight of the new frame
+    float depth_jump = 50.0f;    // mm, a larger change of depth restarts the average
+    float amplitude_jump = 0.5f; // a change of amplitude by more than this fraction of the previous one restarts it
+};
+
+// Spatial filter of the depth, in up to three stages (each disabled by 0) run in one pass over the rows: flying pixel
+// rejection and median of the raw neighbourhood, then an edge-preserving smoothing of their result. Invalid pixels (0)
+// stay invalid.
+struct SpatialFilter {
+    // mm, invalidates the pixels further than this from both of their horizontal or both of their vertical neighbours
+    float flying_pixel = 0.0f;
+    // 3 or 5, median of the 3x3 or 5x5 neighbourhood, whose invalid pixels count as 0
+    uint32_t median = 0;
+    // mm, mean of the 3x3 neighbours within this distance of the depth of the pixel, weighted by their squared amplitude
+    float smoothing = 0.0f;
+};
+
+enum class Isa {
+    Scalar,
+    NEON,
+    AVX2,
+    AVX512,
+};
+
+// The entry points below run on the fastest instruction set the CPU supports.
+// It is probed once; TOFCAM_ISA=scalar|neon|avx2|avx512 in the environment overrides it.
+
+// the probed instruction set
+Isa detect_isa();
+
+// the instruction set the dispatched kernels currently run on
+Isa get_isa();
+
+// forces the dispatched kernels onto `isa` (e.g. for benchmarking), throws if the CPU does not support it
+void set_isa(const Isa isa);
+
+bool is_supported(const Isa isa);
+
 void unpack_y12p(int16_t* dst, const void* src, const uint32_t width, const uint32_t height, const uint32_t bytesperline);
 
-template <bool EnableConfidence = true, Rotation rotation = Rotation::Zero>
+// The depth (mm) and confidence are written as float, or as uint16_t rounded and saturated to 16 bits.
+template <bool EnableConfidence = true, Rotation rotation = Rotation::Zero, Atan2 accuracy = Atan2::Default, class T = float>
 void compute_depth_confidence(
-        float* depth, float* confidence, const int16_t* frame0, const int16_t* frame1, const int16_t* frame2,
-        const int16_t* frame3, const uint32_t num_pixels, const float modfreq_hz);
+        T* depth, T* confidence, const int16_t* frame0, const int16_t* frame1, const int16_t* frame2, const int16_t* frame3,
+        const uint32_t num_pixels, const float modfreq_hz, const Threshold& threshold = {});
+
+template <bool EnableConfidence = true, Rotation rotation = Rotation::Zero, Atan2 accuracy = Atan2::Default, class T = float>
+void compute_depth_confidence_from_y12p(
+        T* depth, T* confidence, const void* frame0, const void* frame1, const void* frame2, const void* frame3,
+        const uint32_t width, const uint32_t height, const uint32_t bytesperline, const float modfreq_hz,
+        const Threshold& threshold = {});
+
+// Dual frequency unwrapping: `fine` and `coarse` are the four phases captured at two modulation frequencies,
+// the fine one an integer multiple of the coarse one. The coarse depth selects the wrap of the fine depth, which
+// gives the precision of the fine frequency over the range of the coarse one in a single pass.
+// confidence is the smaller of the two amplitudes, depth is 0 where either measurement is invalid.
+template <bool EnableConfidence = true, Rotation rotation = Rotation::Zero, Atan2 accuracy = Atan2::Default, class T = float>
+void compute_unwrapped_depth_confidence_from_y12p(
+        T* depth, T* confidence, const void* const fine[4], const void* const coarse[4], const uint32_t width,
+        const uint32_t height, const uint32_t bytesperline, const float fine_modfreq_hz, const float coarse_modfreq_hz,
+        const Threshold& threshold = {});
+
+// Converts only `roi` of the width x height frames, depth and confidence hold roi.width x roi.height pixels.
+template <bool EnableConfidence = true, Rotation rotation = Rotation::Zero, Atan2 accuracy = Atan2::Default, class T = float>
+void compute_depth_confidence_from_y12p(
+        T* depth, T* confidence, const void* frame0, const void* frame1, const void* frame2, const void* frame3,
+        const uint32_t width, const uint32_t height, const uint32_t bytesperline, const float modfreq_hz, const Roi& roi,
+        const Threshold& threshold = {});
+
+// 2x2 binning: the phase samples of each 2x2 block are summed before the atan2, which quarters the work and doubles
+// the SNR. depth and confidence hold (width / 2) x (height / 2) pixels, confidence is the mean amplitude of the block.
+template <bool EnableConfidence = true, Rotation rotation = Rotation::Zero, Atan2 accuracy = Atan2::Default, class T = float>
+void compute_binned_depth_confidence_from_y12p(
+        T* depth, T* confidence, const void* frame0, const void* frame1, const void* frame2, const void* frame3,
+        const uint32_t width, const uint32_t height, const uint32_t bytesperline, const float modfreq_hz,
+        const Threshold& threshold = {});
+
+// 2x2 binning of only `roi`, depth and confidence hold (roi.width / 2) x (roi.height / 2) pixels.
+template <bool EnableConfidence = true, Rotation rotation = Rotation::Zero, Atan2 accuracy = Atan2::Default, class T = float>
+void compute_binned_depth_confidence_from_y12p(
+        T* depth, T* confidence, const void* frame0, const void* frame1, const void* frame2, const void* frame3,
+        const uint32_t width, const uint32_t height, const uint32_t bytesperline, const float modfreq_hz, const Roi& roi,
+        const Threshold& threshold = {});
+
+// Undistorted unit ray (x, y, z) of every pixel of the depth map of `roi`, or of its 2x2 binned map (the ray through
+// the centre of each block): 3 floats per pixel. Computed once and passed to compute_xyz.
+void compute_rays(float* rays, const Intrinsics& intrinsics, const Roi& roi, const bool binning = false);
+
+// Organized point cloud of a (radial) depth map: xyz = depth * ray in mm, 3 values per pixel, the invalid pixels
+// (depth 0) at the origin. T is float or uint16_t, P is float or int16_t (rounded and saturated).
+template <class T, class P>
+void compute_xyz(P* xyz, const T* depth, const float* rays, const uint32_t num_pixels);
+
+// Filters `depth` in place. `history` (the filtered depth) and `history_amplitude` (the amplitude of the previous
+// frame) hold the state, one float per pixel, zero initialized by the caller; zeros restart every pixel.
+// confidence may be null, then history_amplitude is not used and only depth jumps restart the average.
+template <class T>
+void compute_temporal_filter(
+        T* depth, const T* confidence, float* history, float* history_amplitude, const uint32_t num_pixels,
+        const TemporalFilter& filter);
+
+// Filters the width x height `depth` into `dst`, which must not overlap it. confidence may be null, then the smoothing
+// weights the neighbours equally.
+template <class T>
+void compute_spatial_filter(
+        T* dst, const T* depth, const T* confidence, const uint32_t width, const uint32_t height,
+        const SpatialFilter& filter);
+
+// Filters only the rows [begin, end) of dst, e.g. the rows a depth kernel has just written and the ones around them:
+// up to 3 rows beyond them are read from depth.
+template <class T>
+void compute_spatial_filter(
+        T* dst, const T* depth, const T* confidence, const uint32_t width, const uint32_t height, const uint32_t begin,
+        const uint32_t end, const SpatialFilter& filter);
+
+class ThreadPool;
+
+// Same as above, with the frame split into row bands that run on `pool`.
+
+template <bool EnableConfidence = true, Rotation rotation = Rotation::Zero, Atan2 accuracy = Atan2::Default, class T = float>
+void compute_depth_confidence(
+        T* depth, T* confidence, const int16_t* frame0, const int16_t* frame1, const int16_t* frame2, const int16_t* frame3,
+        const uint32_t num_pixels, const float modfreq_hz, ThreadPool& pool, const Threshold& threshold = {});
+
+template <bool EnableConfidence = true, Rotation rotation = Rotation::Zero, Atan2 accuracy = Atan2::Default, class T = float>
+void compute_depth_confidence_from_y12p(
+        T* depth, T* confidence, const void* frame0, const void* frame1, const void* frame2, const void* frame3,
+        const uint32_t width, const uint32_t height, const uint32_t bytesperline, const float modfreq_hz, ThreadPool& pool,
+        const Threshold& threshold = {});
+
+template <bool EnableConfidence = true, Rotation rotation = Rotation::Zero, Atan2 accuracy = Atan2::Default, class T = float>
+void compute_unwrapped_depth_confidence_from_y12p(
+        T* depth, T* confidence, const void* const fine[4], const void* const coarse[4], const uint32_t width,
+        const uint32_t height, const uint32_t bytesperline, const float fine_modfreq_hz, const float coarse_modfreq_hz,
+        ThreadPool& pool, const Threshold& threshold = {});
+
+template <bool EnableConfidence = true, Rotation rotation = Rotation::Zero, Atan2 accuracy = Atan2::Default, class T = float>
+void compute_depth_confidence_from_y12p(
+        T* depth, T* confidence, const void* frame0, const void* frame1, const void* frame2, const void* frame3,
+        const uint32_t width, const uint32_t height, const uint32_t bytesperline, const float modfreq_hz, const Roi& roi,
+        ThreadPool& pool, const Threshold& threshold = {});
+
+template <bool EnableConfidence = true, Rotation rotation = Rotation::Zero, Atan2 accuracy = Atan2::Default, class T = float>
+void compute_binned_depth_confidence_from_y12p(
+        T* depth, T* confidence, const void* frame0, const void* frame1, const void* frame2, const void* frame3,
+        const uint32_t width, const uint32_t height, const uint32_t bytesperline, const float modfreq_hz, const Roi& roi,
+        ThreadPool& pool, const Threshold& threshold = {});
 
-#if defined(__ARM_NEON)
+template <bool EnableConfidence = true, Rotation rotation = Rotation::Zero, Atan2 accuracy = Atan2::Default, class T = float>
+void compute_binned_depth_confidence_from_y12p(
+        T* depth, T* confidence, const void* frame0, const void* frame1, const void* frame2, const void* frame3,
+        const uint32_t width, const uint32_t height, const uint32_t bytesperline, const float modfreq_hz, ThreadPool& pool,
+        const Threshold& threshold = {});
 
-template <bool EnableConfidence = true, Rotation rotation = Rotation::Zero>
+template <class T, class P>
+void compute_xyz(P* xyz, const T* depth, const float* rays, const uint32_t num_pixels, ThreadPool& pool);
+
+template <class T>
+void compute_temporal_filter(
+        T* depth, const T* confidence, float* history, float* history_amplitude, const uint32_t num_pixels,
+        const TemporalFilter& filter, ThreadPool& pool);
+
+template <class T>
+void compute_spatial_filter(
+        T* dst, const T* depth, const T* confidence, const uint32_t width, const uint32_t height,
+        const SpatialFilter& filter, ThreadPool& pool);
+
+// Per instruction set implementations of the entry points above.
+
+void unpack_y12p_scalar(
+        int16_t* dst, const void* src, const uint32_t width, const uint32_t height, const uint32_t bytesperline);
+
+template <bool EnableConfidence = true, Rotation rotation = Rotation::Zero, Atan2 accuracy = Atan2::Default, class T = float>
+void compute_depth_confidence_scalar(
+        T* depth, T* confidence, const int16_t* frame0, const int16_t* frame1, const int16_t* frame2, const int16_t* frame3,
+        const uint32_t num_pixels, const float modfreq_hz, const Threshold& threshold = {});
+
+template <bool EnableConfidence = true, Rotation rotation = Rotation::Zero, Atan2 accuracy = Atan2::Default, class T = float>
+void compute_depth_confidence_from_y12p_scalar(
+        T* depth, T* confidence, const void* frame0, const void* frame1, const void* frame2, const void* frame3,
+        const uint32_t width, const uint32_t height, const uint32_t bytesperline, const float modfreq_hz,
+        const Threshold& threshold = {});
+
+template <bool EnableConfidence = true, Rotation rotation = Rotation::Zero, Atan2 accuracy = Atan2::Default, class T = float>
+void compute_unwrapped_depth_confidence_from_y12p_scalar(
+        T* depth, T* confidence, const void* const fine[4], const void* const coarse[4], const uint32_t width,
+        const uint32_t height, const uint32_t bytesperline, const float fine_modfreq_hz, const float coarse_modfreq_hz,
+        const Threshold& threshold = {});
+
+template <bool EnableConfidence = true, Rotation rotation = Rotation::Zero, Atan2 accuracy = Atan2::Default, class T = float>
+void compute_binned_depth_confidence_from_y12p_scalar(
+        T* depth, T* confidence, const void* frame0, const void* frame1, const void* frame2, const void* frame3,
+        const uint32_t width, const uint32_t height, const uint32_t bytesperline, const float modfreq_hz,
+        const Threshold& threshold = {});
+
+template <class T, class P>
+void compute_xyz_scalar(P* xyz, const T* depth, const float* rays, const uint32_t num_pixels);
+
+template <class T>
+void compute_temporal_filter_scalar(
+        T* depth, const T* confidence, float* history, float* history_amplitude, const uint32_t num_pixels,
+        const TemporalFilter& filter);
+
+template <class T>
+void compute_spatial_filter_scalar(
+        T* dst, const T* depth, const T* confidence, const uint32_t width, const uint32_t height, const uint32_t begin,
+        const uint32_t end, const SpatialFilter& filter);
+
+#if defined(__aarch64__)
+
+void unpack_y12p_neon(int16_t* dst, const void* src, const uint32_t width, const uint32_t height, const uint32_t bytesperline);
+
+template <bool EnableConfidence = true, Rotation rotation = Rotation::Zero, Atan2 accuracy = Atan2::Default, class T = float>
+void compute_depth_confidence_neon(
+        T* depth, T* confidence, const int16_t* frame0, const int16_t* frame1, const int16_t* frame2, const int16_t* frame3,
+        const uint32_t num_pixels, const float modfreq_hz, const Threshold& threshold = {});
+
+template <bool EnableConfidence = true, Rotation rotation = Rotation::Zero, Atan2 accuracy = Atan2::Default, class T = float>
 void compute_depth_confidence_from_y12p_neon(
-        float* depth, float* confidence, const void* frame0, const void* frame1, const void* frame2, const void* frame3,
-        const uint32_t width, const uint32_t height, const uint32_t bytesperline, const float modfreq_hz);
+        T* depth, T* confidence, const void* frame0, const void* frame1, const void* frame2, const void* frame3,
+        const uint32_t width, const uint32_t height, const uint32_t bytesperline, const float modfreq_hz,
+        const Threshold& threshold = {});
+
+template <bool EnableConfidence = true, Rotation rotation = Rotation::Zero, Atan2 accuracy = Atan2::Default, class T = float>
+void compute_unwrapped_depth_confidence_from_y12p_neon(
+        T* depth, T* confidence, const void* const fine[4], const void* const coarse[4], const uint32_t width,
+        const uint32_t height, const uint32_t bytesperline, const float fine_modfreq_hz, const float coarse_modfreq_hz,
+        const Threshold& threshold = {});
+
+template <bool EnableConfidence = true, Rotation rotation = Rotation::Zero, Atan2 accuracy = Atan2::Default, class T = float>
+void compute_binned_depth_confidence_from_y12p_neon(
+        T* depth, T* confidence, const void* frame0, const void* frame1, const void* frame2, const void* frame3,
+        const uint32_t width, const uint32_t height, const uint32_t bytesperline, const float modfreq_hz,
+        const Threshold& threshold = {});
+
+template <class T, class P>
+void compute_xyz_neon(P* xyz, const T* depth, const float* rays, const uint32_t num_pixels);
+
+template <class T>
+void compute_temporal_filter_neon(
+        T* depth, const T* confidence, float* history, float* history_amplitude, const uint32_t num_pixels,
+        const TemporalFilter& filter);
+
+template <class T>
+void compute_spatial_filter_neon(
+        T* dst, const T* depth, const T* confidence, const uint32_t width, const uint32_t height, const uint32_t begin,
+        const uint32_t end, const SpatialFilter& filter);
+
+#endif
+
+#if defined(__x86_64__)
+
+// requires AVX2 and FMA
+void unpack_y12p_avx2(int16_t* dst, const void* src, const uint32_t width, const uint32_t height, const uint32_t bytesperline);
+
+template <bool EnableConfidence = true, Rotation rotation = Rotation::Zero, Atan2 accuracy = Atan2::Default, class T = float>
+void compute_depth_confidence_avx2(
+        T* depth, T* confidence, const int16_t* frame0, const int16_t* frame1, const int16_t* frame2, const int16_t* frame3,
+        const uint32_t num_pixels, const float modfreq_hz, const Threshold& threshold = {});
+
+template <bool EnableConfidence = true, Rotation rotation = Rotation::Zero, Atan2 accuracy = Atan2::Default, class T = float>
+void compute_depth_confidence_from_y12p_avx2(
+        T* depth, T* confidence, const void* frame0, const void* frame1, const void* frame2, const void* frame3,
+        const uint32_t width, const uint32_t height, const uint32_t bytesperline, const float modfreq_hz,
+        const Threshold& threshold = {});
+
+template <bool EnableConfidence = true, Rotation rotation = Rotation::Zero, Atan2 accuracy = Atan2::Default, class T = float>
+void compute_unwrapped_depth_confidence_from_y12p_avx2(
+        T* depth, T* confidence, const void* const fine[4], const void* const coarse[4], const uint32_t width,
+        const uint32_t height, const uint32_t bytesperline, const float fine_modfreq_hz, const float coarse_modfreq_hz,
+        const Threshold& threshold = {});
+
+template <bool EnableConfidence = true, Rotation rotation = Rotation::Zero, Atan2 accuracy = Atan2::Default, class T = float>
+void compute_binned_depth_confidence_from_y12p_avx2(
+        T* depth, T* confidence, const void* frame0, const void* frame1, const void* frame2, const void* frame3,
+        const uint32_t width, const uint32_t height, const uint32_t bytesperline, const float modfreq_hz,
+        const Threshold& threshold = {});
+
+template <class T, class P>
+void compute_xyz_avx2(P* xyz, const T* depth, const float* rays, const uint32_t num_pixels);
+
+template <class T>
+void compute_temporal_filter_avx2(
+        T* depth, const T* confidence, float* history, float* history_amplitude, const uint32_t num_pixels,
+        const TemporalFilter& filter);
+
+template <class T>
+void compute_spatial_filter_avx2(
+        T* dst, const T* depth, const T* confidence, const uint32_t width, const uint32_t height, const uint32_t begin,
+        const uint32_t end, const SpatialFilter& filter);
+
+// requires AVX-512F and AVX-512BW
+void unpack_y12p_avx512(
+        int16_t* dst, const void* src, const uint32_t width, const uint32_t height, const uint32_t bytesperline);
+
+template <bool EnableConfidence = true, Rotation rotation = Rotation::Zero, Atan2 accuracy = Atan2::Default, class T = float>
+void compute_depth_confidence_avx512(
+        T* depth, T* confidence, const int16_t* frame0, const int16_t* frame1, const int16_t* frame2, const int16_t* frame3,
+        const uint32_t num_pixels, const float modfreq_hz, const Threshold& threshold = {});
+
+template <bool EnableConfidence = true, Rotation rotation = Rotation::Zero, Atan2 accuracy = Atan2::Default, class T = float>
+void compute_depth_confidence_from_y12p_avx512(
+        T* depth, T* confidence, const void* frame0, const void* frame1, const void* frame2, const void* frame3,
+        const uint32_t width, const uint32_t height, const uint32_t bytesperline, const float modfreq_hz,
+        const Threshold& threshold = {});
+
+template <bool EnableConfidence = true, Rotation rotation = Rotation::Zero, Atan2 accuracy = Atan2::Default, class T = float>
+void compute_unwrapped_depth_confidence_from_y12p_avx512(
+        T* depth, T* confidence, const void* const fine[4], const void* const coarse[4], const uint32_t width,
+        const uint32_t height, const uint32_t bytesperline, const float fine_modfreq_hz, const float coarse_modfreq_hz,
+        const Threshold& threshold = {});
+
+template <bool EnableConfidence = true, Rotation rotation = Rotation::Zero, Atan2 accuracy = Atan2::Default, class T = float>
+void compute_binned_depth_confidence_from_y12p_avx512(
+        T* depth, T* confidence, const void* frame0, const void* frame1, const void* frame2, const void* frame3,
+        const uint32_t width, const uint32_t height, const uint32_t bytesperline, const float modfreq_hz,
+        const Threshold& threshold = {});
+
+template <class T, class P>
+void compute_xyz_avx512(P* xyz, const T* depth, const float* rays, const uint32_t num_pixels);
+
+template <class T>
+void compute_temporal_filter_avx512(
+        T* depth, const T* confidence, float* history, float* history_amplitude, const uint32_t num_pixels,
+        const TemporalFilter& filter);
+
+template <class T>
+void compute_spatial_filter_avx512(
+        T* dst, const T* depth, const T* confidence, const uint32_t width, const uint32_t height, const uint32_t begin,
+        const uint32_t end, const SpatialFilter& filter);
 
 #endif
 
@@ -0,0 +1,27 @@
+#pragma once
+
+#include <iterator>
+#include <numbers>
+#include <utility.hpp>
+
+// Coefficients of the atan(t) / pi approximations for t in [0, 1] used by the Atan2 tiers, lowest order first.
+// Poly3 and Poly5 are minimax fits of t * (c0 + c1 t + ...), max error 4.2e-4 and 7.7e-6 (in units of pi).
+
+namespace tofcam {
+
+inline constexpr float ATAN_R = 0.273 * std::numbers::inv_pi;
+
+inline constexpr float ATAN_POLY3[] = {0.326947114f, -0.0529218524f, -0.0244427472f};
+
+inline constexpr float ATAN_POLY5[] = {0.3179039f, 0.00663206369f, -0.141450187f, 0.0818443603f, -0.0149223962f};
+
+template <Atan2 accuracy>
+constexpr const auto& atan_poly() {
+    if constexpr (accuracy == Atan2::Poly3) {
+        return ATAN_POLY3;
+    } else {
+        return ATAN_POLY5;
+    }
+}
+
+} // namespace tofcam
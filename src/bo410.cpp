@@ -1,15 +1,22 @@
+#include <algorithm>
 #include <bo410.hpp>
 #include <linux/videodev2.h>
 #include <syscall.hpp>
+#include <type_traits>
 #include <utility.hpp>
 
 namespace tofcam {
 
-BO410::BO410(const char* device, const char* subdevice, const int range, const MemType memtype)
-    : camera(device, 8, memtype, std::nullopt) {
+BO410::BO410(const char* device, const char* subdevice, const int range, const MemType memtype, const uint32_t num_buffers)
+    : camera(device, num_buffers, memtype, std::nullopt) {
     if (range != 2000 && range != 4000) {
         throw std::invalid_argument("Invalid range mode.");
     }
+    if (num_buffers < 2) {
+        throw std::invalid_argument("BO410 needs 2 buffers at least.");
+    }
+    this->num_buffers = num_buffers;
+    this->incremental = num_buffers < 4;
     this->subfd = syscall::open(subdevice, O_RDWR, 0);
     if (this->subfd < 0) {
         throw std::system_error(errno, std::generic_category(), "Failed to open the subdevice.");
@@ -23,10 +30,8 @@ BO410::BO410(const char* device, const char* subdevice, const int range, const M
             syscall::close(this->subfd);
             throw std::system_error(errno, std::generic_category(), "ioctl VIDIOC_S_CTRL failed.");
         }
-        auto [width, height] = this->camera.get_size();
         this->range = range;
-        this->depth = std::vector<float>(width * height);
-        this->confidence = std::vector<float>(width * height);
+        this->allocate<float>(this->frame);
     } catch (...) {
         if (this->subfd >= 0) {
             syscall::close(this->subfd);
@@ -44,6 +49,14 @@ BO410::~BO410() {
 }
 
 void BO410::stream_on() {
+    // the sequence restarts, a frame captured before can not be completed
+    this->clear_phases();
+    if (this->realtime.prewarm) {
+        this->prewarm();
+    }
+    if (this->realtime.lock) {
+        this->lock_buffers();
+    }
     this->camera.stream_on();
 }
 
@@ -51,27 +64,477 @@ void BO410::stream_off() {
     this->camera.stream_off();
 }
 
-std::pair<float*, float*> BO410::get_frame() {
+template <class T>
+std::pair<T*, T*> BO410::get_frame() {
+    this->dequeue_phases(std::nullopt);
+    this->allocate<T>(this->frame);
+    const auto out = make_view<T>(this->frame);
+    this->last_info = this->convert_frame<T>(out);
+    this->last_mask = out.mask;
+    return {out.depth, out.confidence};
+}
+
+template <class T>
+std::optional<std::pair<T*, T*>> BO410::get_frame(const std::chrono::milliseconds timeout) {
+    if (!this->dequeue_phases(timeout)) {
+        return std::nullopt;
+    }
+    this->allocate<T>(this->frame);
+    const auto out = make_view<T>(this->frame);
+    this->last_info = this->convert_frame<T>(out);
+    this->last_mask = out.mask;
+    return std::pair<T*, T*>{out.depth, out.confidence};
+}
+
+template <class T>
+void BO410::get_frame(const FrameView<T>& out) {
+    if (!out.depth || !out.confidence || (this->masked && !out.mask)) {
+        throw std::invalid_argument("The frame needs depth and confidence, and mask when it is enabled.");
+    }
+    this->dequeue_phases(std::nullopt);
+    this->last_info = this->convert_frame<T>(out);
+    this->last_mask = out.mask;
+}
+
+template <class T>
+bool BO410::get_frame(const FrameView<T>& out, const std::chrono::milliseconds timeout) {
+    if (!out.depth || !out.confidence || (this->masked && !out.mask)) {
+        throw std::invalid_argument("The frame needs depth and confidence, and mask when it is enabled.");
+    }
+    if (!this->dequeue_phases(timeout)) {
+        return false;
+    }
+    this->last_info = this->convert_frame<T>(out);
+    this->last_mask = out.mask;
+    return true;
+}
+
+template <class T>
+DepthFrame<T> BO410::acquire_frame() {
+    auto frame = this->lend_frame<T>();
+    this->dequeue_phases(std::nullopt);
+    this->convert_frame<T>(frame.view());
+    return frame;
+}
+
+template <class T>
+std::optional<DepthFrame<T>> BO410::acquire_frame(const std::chrono::milliseconds timeout) {
+    auto frame = this->lend_frame<T>();
+    if (!this->dequeue_phases(timeout)) {
+        return std::nullopt;
+    }
+    this->convert_frame<T>(frame.view());
+    return frame;
+}
+
+template <class T>
+DepthFrame<T> BO410::lend_frame() {
+    FrameBuffers* const buffers = this->frame_pool->acquire();
+    if (!buffers) {
+        throw std::runtime_error("All the frames of the pool are held, release one or enlarge the pool.");
+    }
+    const auto [width, height] = this->get_size();
+    DepthFrame<T> frame(this->frame_pool, buffers, width, height);
+    const FrameView<T> before = make_view<T>(*buffers);
+    this->allocate<T>(*buffers);
+    const FrameView<T> after = make_view<T>(*buffers);
+    // the pool allocates on the first lend and after a setting, only the new outputs are locked
+    if (this->realtime.lock &&
+        (before.depth != after.depth || before.mask != after.mask || before.points != after.points)) {
+        lock_memory(*buffers);
+    }
+    return frame;
+}
+
+void BO410::set_frame_pool(const uint32_t capacity) {
+    this->frame_pool = std::make_shared<FramePool>(capacity);
+}
+
+uint32_t BO410::get_free_frames() const {
+    return this->frame_pool->num_available();
+}
+
+bool BO410::drop_frame(const std::chrono::milliseconds timeout) {
+    // the phases captured before a timeout are kept for the next call, as in get_frame()
+    if (!this->dequeue_phases(timeout)) {
+        return false;
+    }
+    this->clear_phases();
+    return true;
+}
+
+bool BO410::dequeue_phases(const std::optional<std::chrono::milliseconds> timeout) {
+    if (!timeout) {
+        while (this->tracker.size() < 4) {
+            this->take_phase(this->camera.acquire());
+        }
+        return true;
+    }
+    // the phases dequeued before a timeout are kept for the next call
+    const auto deadline = std::chrono::steady_clock::now() + timeout.value();
+    while (this->tracker.size() < 4) {
+        const auto left = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        auto frame = this->camera.acquire(std::max(left, std::chrono::milliseconds(0)));
+        if (!frame) {
+            return false;
+        }
+        this->take_phase(std::move(frame.value()));
+    }
+    return true;
+}
+
+PhaseTracker::Step PhaseTracker::take(const uint32_t sequence, Telemetry& telemetry) {
+    const uint32_t phase = sequence % 4;
+    if (phase == this->num_phases && (this->num_phases == 0 || sequence == this->last_sequence + 1)) {
+        this->resyncing = false;
+        this->last_sequence = sequence;
+        this->num_phases++;
+        return Step::Next;
+    }
+    if (!this->resyncing) {
+        this->resyncing = true;
+        telemetry.resyncs.fetch_add(1, std::memory_order_relaxed);
+    }
+    telemetry.discarded.fetch_add(this->num_phases, std::memory_order_relaxed);
+    this->num_phases = 0;
+    if (phase != 0) {
+        telemetry.discarded.fetch_add(1, std::memory_order_relaxed);
+        return Step::Discard;
+    }
+    this->resyncing = false;
+    this->last_sequence = sequence;
+    this->num_phases = 1;
+    return Step::Restart;
+}
+
+uint32_t PhaseTracker::size() const {
+    return this->num_phases;
+}
+
+void PhaseTracker::clear() {
+    this->num_phases = 0;
+}
+
+void BO410::take_phase(RawFrame frame) {
+    const auto step = this->tracker.take(frame.info().sequence, this->camera.get_telemetry());
+    if (step != PhaseTracker::Step::Next) {
+        for (auto& held : this->phases) {
+            held.reset();
+        }
+    }
+    if (step == PhaseTracker::Step::Discard) {
+        return;
+    }
+    const uint32_t phase = this->tracker.size() - 1;
+    // a frame is folded or not from its first phase on
+    if (phase == 0) {
+        this->folding = this->incremental;
+    }
+    if (this->folding) {
+        this->fold_phase(std::move(frame), phase);
+    } else {
+        this->phases[phase] = std::move(frame);
+    }
+}
+
+void BO410::clear_phases() {
+    for (auto& phase : this->phases) {
+        phase.reset();
+    }
+    this->tracker.clear();
+}
+
+template <class F>
+void BO410::run_rows(const F& task) {
+    const auto [width, height] = this->camera.get_size();
+    const uint32_t bands = this->pool ? std::max(1u, std::min(height, this->pool->size() * 4)) : 1;
+    if (this->lines.size() < size_t(width) * bands) {
+        this->lines.resize(size_t(width) * bands);
+    }
+    if (!this->pool) {
+        task(0, height, this->lines.data());
+        return;
+    }
+    this->pool->run(bands, [&](const uint32_t band) {
+        task(height * band / bands, height * (band + 1) / bands, this->lines.data() + size_t(width) * band);
+    });
+}
+
+void BO410::fold_phase(RawFrame frame, const uint32_t phase) {
+    const auto [width, height] = this->camera.get_size();
+    const auto [bytesused, bytesperline] = this->camera.get_bytes();
+    if (this->cosine.size() != size_t(width) * height) {
+        this->cosine.resize(size_t(width) * height);
+        this->sine.resize(size_t(width) * height);
+        this->zeros.assign(width, 0);
+    }
+    const uint8_t* const data = static_cast<const uint8_t*>(frame.data());
+    // phases 0 and 1 are unpacked into the planes, phases 2 and 3 one row at a time and subtracted
+    this->run_rows([&](const uint32_t begin, const uint32_t end, int16_t* line) {
+        for (uint32_t y = begin; y < end; y++) {
+            int16_t* const cos = this->cosine.data() + size_t(y) * width;
+            int16_t* const sin = this->sine.data() + size_t(y) * width;
+            const uint8_t* const src = data + size_t(y) * bytesperline;
+            if (phase == 0) {
+                unpack_y12p(cos, src, width, 1, bytesperline);
+            } else if (phase == 1) {
+                unpack_y12p(sin, src, width, 1, bytesperline);
+            } else if (phase == 2) {
+                unpack_y12p(line, src, width, 1, bytesperline);
+                for (uint32_t x = 0; x < width; x++) {
+                    cos[x] -= line[x];
+                }
+            } else {
+                unpack_y12p(line, src, width, 1, bytesperline);
+                for (uint32_t x = 0; x < width; x++) {
+                    sin[x] = line[x] - sin[x];
+                }
+            }
+        }
+    });
+    this->folded_info = frame.info();
+    frame.reset();
+}
+
+template <class T>
+void BO410::allocate(FrameBuffers& out) const {
+    const auto [width, height] = this->get_size();
+    if constexpr (std::is_same_v<T, float>) {
+        out.depth.resize(width * height);
+        out.confidence.resize(width * height);
+    } else {
+        out.depth_u16.resize(width * height);
+        out.confidence_u16.resize(width * height);
+    }
+    if (this->masked) {
+        out.mask.resize((width + 7) / 8 * height);
+    } else {
+        out.mask = std::vector<uint8_t>();
+    }
+}
+
+template <class T>
+FrameInfo BO410::convert_frame(const FrameView<T>& out) {
+    const auto start = std::chrono::steady_clock::now();
+    const FrameInfo info = this->folding ? this->folded_info : this->phases[3].info();
+    if (out.info) {
+        *out.info = info;
+    }
+    T* const depth = out.depth;
+    T* const confidence = out.confidence;
+    std::vector<T>* unfiltered = nullptr;
+    if constexpr (std::is_same_v<T, float>) {
+        unfiltered = &this->unfiltered;
+    } else {
+        unfiltered = &this->unfiltered_u16;
+    }
     const auto [width, height] = this->camera.get_size();
     const auto [bytesused, bytesperline] = this->camera.get_bytes();
     const int modfreq_hz = 300'000'000 / this->range / 2 * 1000;
-    std::pair<void*, uint32_t> frames[4];
-    for (int i = 0; i < 4; i++) {
-        frames[i] = this->camera.dequeue();
-    }
-    if (this->range == 2000) {
-        compute_depth_confidence_from_y12p_neon<true, Rotation::Zero>(
-                this->depth.data(), this->confidence.data(), frames[0].first, frames[1].first, frames[2].first, frames[3].first,
-                width, height, bytesperline, modfreq_hz);
+    // with the spatial filter the kernels write the depth into `unfiltered`, the filter writes it into `depth`
+    if (this->spatial) {
+        unfiltered->resize(width * height);
+    }
+    T* const converted = this->spatial ? unfiltered->data() : depth;
+    const Threshold threshold = {this->threshold, this->masked ? out.mask : nullptr};
+    const void* frames[4];
+    for (uint32_t i = 0; i < 4; i++) {
+        frames[i] = this->phases[i].data();
+    }
+    if (this->folding) {
+        // the kernel takes cos as I0 - 0 and sin as I3 - 0, one row at a time for the rows of the mask
+        const int16_t* const zeros = this->zeros.data();
+        const bool quarter = this->range == 4000;
+        this->run_rows([&](const uint32_t begin, const uint32_t end, int16_t*) {
+            for (uint32_t y = begin; y < end; y++) {
+                const size_t offset = size_t(y) * width;
+                const Threshold row = {threshold.amplitude, threshold.mask ? threshold.mask + (width + 7) / 8 * y : nullptr};
+                const int16_t* const cos = this->cosine.data() + offset;
+                const int16_t* const sin = this->sine.data() + offset;
+                if (quarter) {
+                    compute_depth_confidence<true, Rotation::Quarter>(
+                            converted + offset, confidence + offset, cos, zeros, zeros, sin, width, modfreq_hz, row);
+                } else {
+                    compute_depth_confidence<true, Rotation::Zero>(
+                            converted + offset, confidence + offset, cos, zeros, zeros, sin, width, modfreq_hz, row);
+                }
+            }
+        });
+    } else if (this->pool) {
+        if (this->range == 2000) {
+            compute_depth_confidence_from_y12p<true, Rotation::Zero>(
+                    converted, confidence, frames[0], frames[1], frames[2], frames[3], width, height, bytesperline, modfreq_hz,
+                    *this->pool, threshold);
+        } else {
+            compute_depth_confidence_from_y12p<true, Rotation::Quarter>(
+                    converted, confidence, frames[0], frames[1], frames[2], frames[3], width, height, bytesperline, modfreq_hz,
+                    *this->pool, threshold);
+        }
+    } else if (this->range == 2000) {
+        compute_depth_confidence_from_y12p<true, Rotation::Zero>(
+                converted, confidence, frames[0], frames[1], frames[2], frames[3], width, height, bytesperline, modfreq_hz,
+                threshold);
     } else {
-        compute_depth_confidence_from_y12p_neon<true, Rotation::Quarter>(
-                this->depth.data(), this->confidence.data(), frames[0].first, frames[1].first, frames[2].first, frames[3].first,
-                width, height, bytesperline, modfreq_hz);
+        compute_depth_confidence_from_y12p<true, Rotation::Quarter>(
+                converted, confidence, frames[0], frames[1], frames[2], frames[3], width, height, bytesperline, modfreq_hz,
+                threshold);
+    }
+    this->clear_phases();
+    if (this->spatial && this->pool) {
+        compute_spatial_filter(depth, converted, confidence, width, height, *this->spatial, *this->pool);
+    } else if (this->spatial) {
+        compute_spatial_filter(depth, converted, confidence, width, height, *this->spatial);
+    }
+    if (this->temporal) {
+        if (this->history.size() != width * height) {
+            this->history.assign(width * height, 0.0f);
+            this->history_amplitude.assign(width * height, 0.0f);
+        }
+        if (this->pool) {
+            compute_temporal_filter(
+                    depth, confidence, this->history.data(), this->history_amplitude.data(), width * height, *this->temporal,
+                    *this->pool);
+        } else {
+            compute_temporal_filter(
+                    depth, confidence, this->history.data(), this->history_amplitude.data(), width * height, *this->temporal);
+        }
+    }
+    if (!this->prewarming) {
+        this->camera.get_telemetry().convert.record(std::chrono::steady_clock::now() - start);
+    }
+    return info;
+}
+
+template std::pair<float*, float*> BO410::get_frame<float>();
+template std::pair<uint16_t*, uint16_t*> BO410::get_frame<uint16_t>();
+template std::optional<std::pair<float*, float*>> BO410::get_frame<float>(const std::chrono::milliseconds);
+template std::optional<std::pair<uint16_t*, uint16_t*>> BO410::get_frame<uint16_t>(const std::chrono::milliseconds);
+template void BO410::get_frame<float>(const FrameView<float>&);
+template void BO410::get_frame<uint16_t>(const FrameView<uint16_t>&);
+template bool BO410::get_frame<float>(const FrameView<float>&, const std::chrono::milliseconds);
+template bool BO410::get_frame<uint16_t>(const FrameView<uint16_t>&, const std::chrono::milliseconds);
+template DepthFrame<float> BO410::acquire_frame<float>();
+template DepthFrame<uint16_t> BO410::acquire_frame<uint16_t>();
+template std::optional<DepthFrame<float>> BO410::acquire_frame<float>(const std::chrono::milliseconds);
+template std::optional<DepthFrame<uint16_t>> BO410::acquire_frame<uint16_t>(const std::chrono::milliseconds);
+
+std::pair<uint32_t, uint32_t> BO410::get_size() const {
+    return this->camera.get_size();
+}
+
+FrameInfo BO410::get_info() const {
+    return this->last_info;
+}
+
+Telemetry& BO410::get_telemetry() {
+    return this->camera.get_telemetry();
+}
+
+const Telemetry& BO410::get_telemetry() const {
+    return this->camera.get_telemetry();
+}
+
+int BO410::get_fd() const {
+    return this->camera.get_fd();
+}
+
+void BO410::set_threshold(const float amplitude, const bool mask) {
+    if (!(amplitude >= 0.0f)) {
+        throw std::invalid_argument("The threshold must be non-negative.");
+    }
+    this->threshold = amplitude;
+    this->masked = mask;
+}
+
+const uint8_t* BO410::get_mask() const {
+    return this->masked ? this->last_mask : nullptr;
+}
+
+void BO410::set_temporal_filter(const std::optional<TemporalFilter>& filter) {
+    this->temporal = filter;
+    this->history.clear();
+}
+
+void BO410::set_spatial_filter(const std::optional<SpatialFilter>& filter) {
+    if (filter && filter->median != 0 && filter->median != 3 && filter->median != 5) {
+        throw std::invalid_argument("The median must be 3 (3x3), 5 (5x5) or 0.");
+    }
+    this->spatial = filter;
+    if (!filter) {
+        this->unfiltered = std::vector<float>();
+        this->unfiltered_u16 = std::vector<uint16_t>();
     }
-    for (int i = 0; i < 4; i++) {
-        this->camera.enqueue(frames[i].second);
+}
+
+void BO410::set_incremental(const bool incremental) {
+    if (!incremental && this->num_buffers < 4) {
+        throw std::invalid_argument("Converting the four phases at once needs 4 buffers at least.");
     }
-    return {this->depth.data(), this->confidence.data()};
+    this->incremental = incremental;
+}
+
+void BO410::set_num_threads(const uint32_t num_threads, const std::vector<int>& cpus) {
+    if (num_threads == 0) {
+        throw std::invalid_argument("The number of threads must be positive.");
+    }
+    this->pool = num_threads == 1 ? nullptr : std::make_unique<ThreadPool>(num_threads, cpus, this->realtime.priority);
+    this->num_threads = num_threads;
+    this->cpus = cpus;
+}
+
+void BO410::set_realtime(const RealtimeOptions& options) {
+    set_thread_realtime(pthread_self(), options.cpu, options.priority);
+    this->realtime = options;
+    if (this->pool) {
+        this->pool = std::make_unique<ThreadPool>(this->num_threads, this->cpus, options.priority);
+    }
+}
+
+void BO410::prewarm() {
+    // the buffers are not queued to a streaming driver yet, and whatever they hold is converted
+    this->prewarming = true;
+    try {
+        for (const bool u16 : {false, true}) {
+            this->folding = this->incremental;
+            for (uint32_t i = 0; i < 4; i++) {
+                const uint32_t index = i % this->num_buffers;
+                RawFrame phase(nullptr, this->camera.get_buffer(index), index, {});
+                if (this->folding) {
+                    this->fold_phase(std::move(phase), i);
+                } else {
+                    this->phases[i] = std::move(phase);
+                }
+            }
+            if (u16) {
+                this->allocate<uint16_t>(this->frame);
+                this->convert_frame<uint16_t>(make_view<uint16_t>(this->frame));
+            } else {
+                this->allocate<float>(this->frame);
+                this->convert_frame<float>(make_view<float>(this->frame));
+            }
+        }
+    } catch (...) {
+        this->prewarming = false;
+        throw;
+    }
+    this->prewarming = false;
+    // a history of zeros is a restart, without reallocating it
+    std::fill(this->history.begin(), this->history.end(), 0.0f);
+    std::fill(this->history_amplitude.begin(), this->history_amplitude.end(), 0.0f);
+}
+
+void BO410::lock_buffers() {
+    this->camera.lock_buffers();
+    lock_memory(this->frame);
+    const auto lock = [](const auto& v) { lock_memory(v.data(), v.size() * sizeof(v[0])); };
+    lock(this->history);
+    lock(this->history_amplitude);
+    lock(this->unfiltered);
+    lock(this->unfiltered_u16);
+    lock(this->cosine);
+    lock(this->sine);
+    lock(this->zeros);
+    lock(this->lines);
 }
 
 } // namespace tofcam
@@ -1,11 +1,20 @@
+#include <algorithm>
 #include <bo548.hpp>
 #include <linux/v4l2-subdev.h>
 #include <linux/videodev2.h>
 #include <syscall.hpp>
+#include <type_traits>
 #include <utility.hpp>
 
 namespace tofcam {
 
+static std::vector<float> make_rays(const Intrinsics& intrinsics, const Roi& roi, const bool binning) {
+    const uint32_t factor = binning ? 2 : 1;
+    std::vector<float> rays(roi.width / factor * (roi.height / factor) * 3);
+    compute_rays(rays.data(), intrinsics, roi, binning);
+    return rays;
+}
+
 BO548::BO548(
         const char* device, const char* csi_device, const char* sensor_device, const bool vflip, const bool hflip,
         const int exposure, const MemType memtype, const Mode mode)
@@ -77,13 +86,7 @@ BO548::BO548(
                 throw std::system_error(errno, std::generic_category(), "ioctl VIDIOC_SUBDEV_S_FMT failed.");
             }
         }
-        if (this->mode == Mode::Single) {
-            this->depth = std::vector<float>(width * height);
-            this->confidence = std::vector<float>(width * height);
-        } else {
-            this->depth = std::vector<float>(width * height * 2);
-            this->confidence = std::vector<float>(width * height * 2);
-        }
+        this->allocate<float>(this->frame);
     } catch (...) {
         if (this->csi_fd < 0) {
             syscall::close(this->csi_fd);
@@ -103,6 +106,7 @@ BO548::BO548(
 }
 
 BO548::~BO548() {
+    this->stop_streaming();
     if (this->csi_fd >= 0) {
         syscall::close(this->csi_fd);
     }
@@ -112,6 +116,12 @@ BO548::~BO548() {
 }
 
 void BO548::stream_on() {
+    if (this->realtime.prewarm) {
+        this->prewarm();
+    }
+    if (this->realtime.lock) {
+        this->lock_buffers();
+    }
     this->camera.stream_on();
 }
 
@@ -119,34 +129,530 @@ void BO548::stream_off() {
     this->camera.stream_off();
 }
 
-std::pair<float*, float*> BO548::get_frame() {
+template <class T>
+std::pair<T*, T*> BO548::get_frame() {
+    if (this->ring) {
+        while (true) {
+            if (const auto frame = this->pop_frame<T>(std::chrono::seconds(1))) {
+                return frame.value();
+            }
+        }
+    }
+    this->allocate<T>(this->frame);
+    const auto out = make_view<T>(this->frame);
+    this->set_last(out, this->convert_frame<T>(this->camera.acquire(), out));
+    return {out.depth, out.confidence};
+}
+
+template <class T>
+std::optional<std::pair<T*, T*>> BO548::get_frame(const std::chrono::milliseconds timeout) {
+    if (this->ring) {
+        return this->pop_frame<T>(timeout);
+    }
+    auto raw = this->camera.acquire(timeout);
+    if (!raw) {
+        return std::nullopt;
+    }
+    this->allocate<T>(this->frame);
+    const auto out = make_view<T>(this->frame);
+    this->set_last(out, this->convert_frame<T>(std::move(raw.value()), out));
+    return std::pair<T*, T*>{out.depth, out.confidence};
+}
+
+template <class T>
+void BO548::get_frame(const FrameView<T>& out) {
+    this->throw_if_streaming();
+    this->check_buffers(out);
+    this->set_last(out, this->convert_frame<T>(this->camera.acquire(), out));
+}
+
+template <class T>
+bool BO548::get_frame(const FrameView<T>& out, const std::chrono::milliseconds timeout) {
+    this->throw_if_streaming();
+    this->check_buffers(out);
+    auto raw = this->camera.acquire(timeout);
+    if (!raw) {
+        return false;
+    }
+    this->set_last(out, this->convert_frame<T>(std::move(raw.value()), out));
+    return true;
+}
+
+template <class T>
+DepthFrame<T> BO548::acquire_frame() {
+    this->throw_if_streaming();
+    auto frame = this->lend_frame<T>();
+    this->convert_frame<T>(this->camera.acquire(), frame.view());
+    return frame;
+}
+
+template <class T>
+std::optional<DepthFrame<T>> BO548::acquire_frame(const std::chrono::milliseconds timeout) {
+    this->throw_if_streaming();
+    auto frame = this->lend_frame<T>();
+    auto raw = this->camera.acquire(timeout);
+    if (!raw) {
+        return std::nullopt;
+    }
+    this->convert_frame<T>(std::move(raw.value()), frame.view());
+    return frame;
+}
+
+template <class T>
+DepthFrame<T> BO548::lend_frame() {
+    FrameBuffers* const buffers = this->frame_pool->acquire();
+    if (!buffers) {
+        throw std::runtime_error("All the frames of the pool are held, release one or enlarge the pool.");
+    }
     const auto [width, height] = this->get_size();
+    DepthFrame<T> frame(this->frame_pool, buffers, width, height);
+    const FrameView<T> before = make_view<T>(*buffers);
+    this->allocate<T>(*buffers);
+    const FrameView<T> after = make_view<T>(*buffers);
+    // the pool allocates on the first lend and after a setting, only the new outputs are locked
+    if (this->realtime.lock &&
+        (before.depth != after.depth || before.mask != after.mask || before.points != after.points)) {
+        lock_memory(*buffers);
+    }
+    return frame;
+}
+
+void BO548::set_frame_pool(const uint32_t capacity) {
+    this->frame_pool = std::make_shared<FramePool>(capacity);
+}
+
+uint32_t BO548::get_free_frames() const {
+    return this->frame_pool->num_available();
+}
+
+bool BO548::drop_frame(const std::chrono::milliseconds timeout) {
+    this->throw_if_streaming();
+    // the handle re-queues the buffer
+    return this->camera.acquire(timeout).has_value();
+}
+
+template <class T>
+void BO548::set_last(const FrameView<T>& out, const FrameInfo& info) {
+    this->last_info = info;
+    if constexpr (std::is_same_v<T, float>) {
+        this->last = out;
+        this->last_u16 = {};
+    } else {
+        this->last = {};
+        this->last_u16 = out;
+    }
+}
+
+template <class T>
+void BO548::check_buffers(const FrameView<T>& out) const {
+    if (!out.depth || !out.confidence || (this->masked && !out.mask) || (!this->rays.empty() && !out.points)) {
+        throw std::invalid_argument("The frame needs depth and confidence, and mask and points when they are enabled.");
+    }
+}
+
+template <class T>
+void BO548::allocate(FrameBuffers& out) const {
+    const auto [out_width, out_height] = this->get_size();
+    // Unwrapped converts both frequencies into one plane
+    const uint32_t num_planes = this->mode == Mode::Double ? 2 : 1;
+    const uint32_t elements = out_width * out_height * num_planes;
+    if constexpr (std::is_same_v<T, float>) {
+        out.depth.resize(elements);
+        out.confidence.resize(elements);
+    } else {
+        out.depth_u16.resize(elements);
+        out.confidence_u16.resize(elements);
+    }
+    // the disabled outputs are freed, so that make_view() leaves them null
+    if (this->masked) {
+        out.mask.resize((out_width + 7) / 8 * out_height * num_planes);
+    } else {
+        out.mask = std::vector<uint8_t>();
+    }
+    if (this->rays.empty()) {
+        out.points = std::vector<float>();
+        out.points_i16 = std::vector<int16_t>();
+    } else if constexpr (std::is_same_v<T, float>) {
+        out.points.resize(this->rays.size() * num_planes);
+    } else {
+        out.points_i16.resize(this->rays.size() * num_planes);
+    }
+}
+
+template <class T>
+FrameLayout BO548::get_layout() const {
+    // the sizes of allocate()
+    const auto [out_width, out_height] = this->get_size();
+    const uint32_t num_planes = this->mode == Mode::Double ? 2 : 1;
+    const uint32_t elements = out_width * out_height * num_planes;
+    const uint32_t mask_size = this->masked ? (out_width + 7) / 8 * out_height * num_planes : 0;
+    return FrameLayout::pack<T>(out_width, out_height, num_planes, elements, mask_size, this->rays.size() / 3 * num_planes);
+}
+
+template <class T>
+FrameInfo BO548::convert_frame(RawFrame raw, const FrameView<T>& out) {
+    const auto start = std::chrono::steady_clock::now();
+    const FrameInfo info = raw.info();
+    if (out.info) {
+        *out.info = info;
+    }
+    T* const depth = out.depth;
+    T* const confidence = out.confidence;
+    std::vector<T>* unfiltered = nullptr;
+    if constexpr (std::is_same_v<T, float>) {
+        unfiltered = &this->unfiltered;
+    } else {
+        unfiltered = &this->unfiltered_u16;
+    }
+    const uint32_t width = 640;
+    const uint32_t height = 480;
     const auto [sizeimage, bytesperline] = this->camera.get_bytes();
-    const auto [ptr, idx] = this->camera.dequeue();
-    {
-        const auto phase0 = static_cast<uint8_t*>(ptr) + bytesperline * height * 0;
-        const auto phase1 = static_cast<uint8_t*>(ptr) + bytesperline * height * 1;
-        const auto phase2 = static_cast<uint8_t*>(ptr) + bytesperline * height * 2;
-        const auto phase3 = static_cast<uint8_t*>(ptr) + bytesperline * height * 3;
-        compute_depth_confidence_from_y12p_neon<true, Rotation::Zero>(
-                this->depth.data(), this->confidence.data(), phase0, phase1, phase2, phase3, width, height, bytesperline,
-                90'000'000);
-    }
-    if (this->mode == Mode::Double) {
-        const auto phase0 = static_cast<uint8_t*>(ptr) + bytesperline * 2405 + bytesperline * height * 0;
-        const auto phase1 = static_cast<uint8_t*>(ptr) + bytesperline * 2405 + bytesperline * height * 1;
-        const auto phase2 = static_cast<uint8_t*>(ptr) + bytesperline * 2405 + bytesperline * height * 2;
-        const auto phase3 = static_cast<uint8_t*>(ptr) + bytesperline * 2405 + bytesperline * height * 3;
-        compute_depth_confidence_from_y12p_neon<true, Rotation::Zero>(
-                this->depth.data() + width * height, this->confidence.data() + width * height, phase0, phase1, phase2, phase3,
-                width, height, bytesperline, 15'000'000);
-    }
-    this->camera.enqueue(idx);
-    return {this->depth.data(), this->confidence.data()};
+    const auto [out_width, out_height] = this->get_size();
+    const uint32_t num_planes = this->mode == Mode::Double ? 2 : 1;
+    const uint32_t mask_stride = (out_width + 7) / 8;
+    uint8_t* const mask = this->masked ? out.mask : nullptr;
+    // with the spatial filter the kernels write the depth into `unfiltered`, the filter writes it into `depth`
+    if (this->spatial && unfiltered->size() < out_width * out_height * num_planes) {
+        unfiltered->resize(out_width * out_height * num_planes);
+    }
+    T* const converted = this->spatial ? unfiltered->data() : depth;
+    if (this->temporal && this->history.size() != out_width * out_height * num_planes) {
+        this->history.assign(out_width * out_height * num_planes, 0.0f);
+        this->history_amplitude.assign(out_width * out_height * num_planes, 0.0f);
+    }
+    const auto points = this->rays.empty() ? nullptr : out.points;
+    void* const ptr = raw.data();
+    if (this->mode == Mode::Unwrapped) {
+        const auto base = static_cast<uint8_t*>(ptr);
+        const void* fine[4];
+        const void* coarse[4];
+        for (uint32_t i = 0; i < 4; i++) {
+            fine[i] = base + bytesperline * height * i;
+            coarse[i] = base + bytesperline * 2405 + bytesperline * height * i;
+        }
+        if (this->pool) {
+            compute_unwrapped_depth_confidence_from_y12p<true, Rotation::Zero>(
+                    converted, confidence, fine, coarse, width, height, bytesperline, 90'000'000, 15'000'000, *this->pool,
+                    Threshold{this->threshold, mask});
+        } else {
+            compute_unwrapped_depth_confidence_from_y12p<true, Rotation::Zero>(
+                    converted, confidence, fine, coarse, width, height, bytesperline, 90'000'000, 15'000'000,
+                    Threshold{this->threshold, mask});
+        }
+        if (this->spatial && this->pool) {
+            compute_spatial_filter(depth, converted, confidence, width, height, *this->spatial, *this->pool);
+        } else if (this->spatial) {
+            compute_spatial_filter(depth, converted, confidence, width, height, *this->spatial);
+        }
+        if (this->temporal && this->pool) {
+            compute_temporal_filter(
+                    depth, confidence, this->history.data(), this->history_amplitude.data(), width * height, *this->temporal,
+                    *this->pool);
+        } else if (this->temporal) {
+            compute_temporal_filter(
+                    depth, confidence, this->history.data(), this->history_amplitude.data(), width * height, *this->temporal);
+        }
+        if (points && this->pool) {
+            compute_xyz(points, depth, this->rays.data(), width * height, *this->pool);
+        } else if (points) {
+            compute_xyz(points, depth, this->rays.data(), width * height);
+        }
+        if (!this->prewarming) {
+            this->camera.get_telemetry().convert.record(std::chrono::steady_clock::now() - start);
+        }
+        raw.reset();
+        return info;
+    }
+    const float modfreq_hz[2] = {90'000'000, 15'000'000};
+    const Roi roi = this->roi;
+    // converts the rows [begin, end) of the depth map of a plane
+    const auto convert = [&](const uint32_t plane, const uint32_t begin, const uint32_t end) {
+        const auto phase0 = static_cast<uint8_t*>(ptr) + bytesperline * (2405 * plane + height * 0);
+        const auto phase1 = static_cast<uint8_t*>(ptr) + bytesperline * (2405 * plane + height * 1);
+        const auto phase2 = static_cast<uint8_t*>(ptr) + bytesperline * (2405 * plane + height * 2);
+        const auto phase3 = static_cast<uint8_t*>(ptr) + bytesperline * (2405 * plane + height * 3);
+        const uint32_t offset = out_width * (out_height * plane + begin);
+        const Threshold threshold = {this->threshold, mask ? mask + mask_stride * (out_height * plane + begin) : nullptr};
+        if (this->binning) {
+            compute_binned_depth_confidence_from_y12p<true, Rotation::Zero>(
+                    converted + offset, confidence + offset, phase0, phase1, phase2, phase3, width, height, bytesperline,
+                    modfreq_hz[plane], Roi{roi.x, roi.y + begin * 2, roi.width, (end - begin) * 2}, threshold);
+        } else {
+            compute_depth_confidence_from_y12p<true, Rotation::Zero>(
+                    converted + offset, confidence + offset, phase0, phase1, phase2, phase3, width, height, bytesperline,
+                    modfreq_hz[plane], Roi{roi.x, roi.y + begin, roi.width, end - begin}, threshold);
+        }
+    };
+    // filters the rows [begin, end) of the depth map of a plane, and converts them into points
+    const auto finish = [&](const uint32_t plane, const uint32_t begin, const uint32_t end) {
+        const uint32_t offset = out_width * (out_height * plane + begin);
+        if (this->spatial) {
+            const uint32_t first = out_width * out_height * plane;
+            compute_spatial_filter(
+                    depth + first, converted + first, confidence + first, out_width, out_height, begin, end, *this->spatial);
+        }
+        if (this->temporal) {
+            compute_temporal_filter(
+                    depth + offset, confidence + offset, this->history.data() + offset, this->history_amplitude.data() + offset,
+                    out_width * (end - begin), *this->temporal);
+        }
+        if (points) {
+            compute_xyz(
+                    points + offset * 3, depth + offset, this->rays.data() + out_width * begin * 3, out_width * (end - begin));
+        }
+    };
+    if (this->pool) {
+        // one task list over the row bands of both planes, so that they run concurrently
+        const uint32_t bands = std::min(out_height, this->pool->size() * 4);
+        const auto run = [&](const auto& stage) {
+            this->pool->run(num_planes * bands, [&](const uint32_t i) {
+                const uint32_t band = i % bands;
+                stage(i / bands, out_height * band / bands, out_height * (band + 1) / bands);
+            });
+        };
+        if (this->spatial) {
+            // the spatial filter reads the rows around its band, converted by the neighbouring tasks
+            run(convert);
+            run(finish);
+        } else {
+            run([&](const uint32_t plane, const uint32_t begin, const uint32_t end) {
+                convert(plane, begin, end);
+                finish(plane, begin, end);
+            });
+        }
+    } else {
+        // bands of 16 rows, the spatial filter follows the conversion by the 3 rows below a row it reads so that its
+        // input is still in cache
+        const uint32_t rows = 16;
+        const uint32_t lag = this->spatial ? 3 : 0;
+        for (uint32_t plane = 0; plane < num_planes; plane++) {
+            uint32_t finished = 0;
+            for (uint32_t begin = 0; begin < out_height; begin += rows) {
+                const uint32_t end = std::min(begin + rows, out_height);
+                convert(plane, begin, end);
+                const uint32_t ready = end == out_height ? end : end - std::min(end, lag);
+                if (ready > finished) {
+                    finish(plane, finished, ready);
+                    finished = ready;
+                }
+            }
+        }
+    }
+    if (!this->prewarming) {
+        this->camera.get_telemetry().convert.record(std::chrono::steady_clock::now() - start);
+    }
+    raw.reset();
+    return info;
+}
+
+template std::pair<float*, float*> BO548::get_frame<float>();
+template std::pair<uint16_t*, uint16_t*> BO548::get_frame<uint16_t>();
+template std::optional<std::pair<float*, float*>> BO548::get_frame<float>(const std::chrono::milliseconds);
+template std::optional<std::pair<uint16_t*, uint16_t*>> BO548::get_frame<uint16_t>(const std::chrono::milliseconds);
+template void BO548::get_frame<float>(const FrameView<float>&);
+template void BO548::get_frame<uint16_t>(const FrameView<uint16_t>&);
+template bool BO548::get_frame<float>(const FrameView<float>&, const std::chrono::milliseconds);
+template bool BO548::get_frame<uint16_t>(const FrameView<uint16_t>&, const std::chrono::milliseconds);
+template DepthFrame<float> BO548::acquire_frame<float>();
+template DepthFrame<uint16_t> BO548::acquire_frame<uint16_t>();
+template std::optional<DepthFrame<float>> BO548::acquire_frame<float>(const std::chrono::milliseconds);
+template std::optional<DepthFrame<uint16_t>> BO548::acquire_frame<uint16_t>(const std::chrono::milliseconds);
+template FrameLayout BO548::get_layout<float>() const;
+template FrameLayout BO548::get_layout<uint16_t>() const;
+
+int BO548::get_fd() const {
+    return this->ring ? this->ring->get_fd() : this->camera.get_fd();
+}
+
+template <class T>
+void BO548::start_streaming(const uint32_t num_slots, const Overflow overflow) {
+    if (this->ring) {
+        throw std::runtime_error("The camera is already streaming.");
+    }
+    this->slots = std::vector<FrameBuffers>(num_slots);
+    for (auto& slot : this->slots) {
+        this->allocate<T>(slot);
+    }
+    if (this->realtime.lock) {
+        this->lock_buffers();
+    }
+    this->ring = std::make_unique<FrameRing>(num_slots, overflow);
+    this->streamed_u16 = std::is_same_v<T, uint16_t>;
+    this->stopping.store(false, std::memory_order_relaxed);
+    this->failure = nullptr;
+    this->capture = std::thread(&BO548::stream_loop<T>, this);
+    try {
+        set_thread_realtime(this->capture.native_handle(), this->realtime.cpu, this->realtime.priority);
+    } catch (...) {
+        this->stop_streaming();
+        throw;
+    }
+}
+
+template void BO548::start_streaming<float>(const uint32_t, const Overflow);
+template void BO548::start_streaming<uint16_t>(const uint32_t, const Overflow);
+
+void BO548::stop_streaming() {
+    if (!this->ring) {
+        return;
+    }
+    this->stopping.store(true, std::memory_order_relaxed);
+    this->ring->close();
+    this->capture.join();
+    this->ring = nullptr;
+    this->slots = std::vector<FrameBuffers>();
+    this->last = {};
+    this->last_u16 = {};
+}
+
+uint64_t BO548::get_dropped() const {
+    return this->ring ? this->ring->get_dropped() : 0;
+}
+
+FrameInfo BO548::get_info() const {
+    return this->last_info;
+}
+
+Telemetry& BO548::get_telemetry() {
+    return this->camera.get_telemetry();
+}
+
+const Telemetry& BO548::get_telemetry() const {
+    return this->camera.get_telemetry();
+}
+
+template <class T>
+void BO548::stream_loop() {
+    try {
+        while (!this->stopping.load(std::memory_order_relaxed)) {
+            // waits in short steps to notice stop_streaming()
+            auto raw = this->camera.acquire(std::chrono::milliseconds(100));
+            if (!raw) {
+                continue;
+            }
+            const auto slot = this->ring->acquire();
+            if (!slot) {
+                return;
+            }
+            this->convert_frame<T>(std::move(raw.value()), make_view<T>(this->slots[slot.value()]));
+            this->ring->publish(slot.value());
+        }
+    } catch (...) {
+        this->failure = std::current_exception();
+        this->ring->close();
+    }
+}
+
+template <class T>
+std::optional<std::pair<T*, T*>> BO548::pop_frame(const std::chrono::milliseconds timeout) {
+    if (this->streamed_u16 != std::is_same_v<T, uint16_t>) {
+        throw std::invalid_argument("The frames must be read with the type given to start_streaming.");
+    }
+    const auto slot = this->ring->pop(timeout);
+    if (!slot) {
+        // the capture thread only closes the ring when it fails
+        if (this->ring->is_closed()) {
+            std::rethrow_exception(this->failure);
+        }
+        return std::nullopt;
+    }
+    const auto out = make_view<T>(this->slots[slot.value()]);
+    this->set_last(out, *out.info);
+    return std::pair<T*, T*>{out.depth, out.confidence};
+}
+
+void BO548::throw_if_streaming() const {
+    if (this->ring) {
+        throw std::runtime_error("The camera is streaming, stop_streaming() first.");
+    }
 }
 
 std::pair<uint32_t, uint32_t> BO548::get_size() const {
-    return {640, 480};
+    const uint32_t factor = this->binning ? 2 : 1;
+    return {this->roi.width / factor, this->roi.height / factor};
+}
+
+void BO548::set_roi(const Roi& roi) {
+    this->throw_if_streaming();
+    if (roi.width == 0 || roi.height == 0 || roi.x >= 640 || roi.width > 640 - roi.x || roi.y >= 480 ||
+        roi.height > 480 - roi.y) {
+        throw std::invalid_argument("The ROI must be a non-empty rectangle within the 640x480 image.");
+    }
+    if (this->mode == Mode::Unwrapped && (roi.x != 0 || roi.y != 0 || roi.width != 640 || roi.height != 480)) {
+        throw std::invalid_argument("ROI is not supported in Unwrapped mode.");
+    }
+    if (this->intrinsics) {
+        this->rays = make_rays(*this->intrinsics, roi, this->binning);
+    }
+    this->roi = roi;
+    this->history.clear();
+}
+
+void BO548::set_binning(const bool binning) {
+    this->throw_if_streaming();
+    if (this->mode == Mode::Unwrapped && binning) {
+        throw std::invalid_argument("Binning is not supported in Unwrapped mode.");
+    }
+    if (this->intrinsics) {
+        this->rays = make_rays(*this->intrinsics, this->roi, binning);
+    }
+    this->binning = binning;
+    this->history.clear();
+}
+
+void BO548::set_temporal_filter(const std::optional<TemporalFilter>& filter) {
+    this->throw_if_streaming();
+    this->temporal = filter;
+    this->history.clear();
+}
+
+void BO548::set_spatial_filter(const std::optional<SpatialFilter>& filter) {
+    this->throw_if_streaming();
+    if (filter && filter->median != 0 && filter->median != 3 && filter->median != 5) {
+        throw std::invalid_argument("The median must be 3 (3x3), 5 (5x5) or 0.");
+    }
+    this->spatial = filter;
+    if (!filter) {
+        this->unfiltered = std::vector<float>();
+        this->unfiltered_u16 = std::vector<uint16_t>();
+    }
+}
+
+void BO548::set_intrinsics(const Intrinsics& intrinsics) {
+    this->throw_if_streaming();
+    this->rays = make_rays(intrinsics, this->roi, this->binning);
+    this->intrinsics = intrinsics;
+}
+
+template <class P>
+const P* BO548::get_points() const {
+    if (this->rays.empty()) {
+        return nullptr;
+    }
+    if constexpr (std::is_same_v<P, float>) {
+        return this->last.points;
+    } else {
+        return this->last_u16.points;
+    }
+}
+
+template const float* BO548::get_points<float>() const;
+template const int16_t* BO548::get_points<int16_t>() const;
+
+void BO548::set_threshold(const float amplitude, const bool mask) {
+    this->throw_if_streaming();
+    if (!(amplitude >= 0.0f)) {
+        throw std::invalid_argument("The threshold must be non-negative.");
+    }
+    this->threshold = amplitude;
+    this->masked = mask;
+}
+
+const uint8_t* BO548::get_mask() const {
+    if (!this->masked) {
+        return nullptr;
+    }
+    return this->last.mask ? this->last.mask : this->last_u16.mask;
 }
 
 void BO548::set_exposure(const int exposure) {
@@ -162,14 +668,72 @@ std::pair<uint32_t, uint32_t> BO548::get_bytes() const {
     return this->camera.get_bytes();
 }
 
-void* BO548::get_rawframe() {
-    if (this->locked_index) {
-        this->camera.enqueue(this->locked_index.value());
-        this->locked_index = std::nullopt;
+void BO548::set_num_threads(const uint32_t num_threads, const std::vector<int>& cpus) {
+    this->throw_if_streaming();
+    if (num_threads == 0) {
+        throw std::invalid_argument("The number of threads must be positive.");
+    }
+    this->pool = num_threads == 1 ? nullptr : std::make_unique<ThreadPool>(num_threads, cpus, this->realtime.priority);
+    this->num_threads = num_threads;
+    this->cpus = cpus;
+}
+
+void BO548::set_realtime(const RealtimeOptions& options) {
+    this->throw_if_streaming();
+    set_thread_realtime(pthread_self(), options.cpu, options.priority);
+    this->realtime = options;
+    if (this->pool) {
+        this->pool = std::make_unique<ThreadPool>(this->num_threads, this->cpus, options.priority);
+    }
+}
+
+void BO548::prewarm() {
+    // the buffer is not queued to a streaming driver yet, and whatever it holds is converted
+    void* const data = this->camera.get_buffer(0);
+    this->prewarming = true;
+    try {
+        this->allocate<float>(this->frame);
+        this->convert_frame<float>(RawFrame(nullptr, data, 0, {}), make_view<float>(this->frame));
+        this->allocate<uint16_t>(this->frame);
+        this->convert_frame<uint16_t>(RawFrame(nullptr, data, 0, {}), make_view<uint16_t>(this->frame));
+    } catch (...) {
+        this->prewarming = false;
+        throw;
     }
-    const auto [ptr, idx] = this->camera.dequeue();
-    this->locked_index = idx;
-    return ptr;
+    this->prewarming = false;
+    // a history of zeros is a restart, without reallocating it
+    std::fill(this->history.begin(), this->history.end(), 0.0f);
+    std::fill(this->history_amplitude.begin(), this->history_amplitude.end(), 0.0f);
+}
+
+void BO548::lock_buffers() {
+    this->camera.lock_buffers();
+    lock_memory(this->frame);
+    for (const FrameBuffers& slot : this->slots) {
+        lock_memory(slot);
+    }
+    const auto lock = [](const auto& v) { lock_memory(v.data(), v.size() * sizeof(v[0])); };
+    lock(this->history);
+    lock(this->history_amplitude);
+    lock(this->unfiltered);
+    lock(this->unfiltered_u16);
+    lock(this->rays);
+}
+
+void* BO548::get_rawframe() {
+    this->throw_if_streaming();
+    this->locked.reset();
+    this->locked = this->camera.acquire();
+    return this->locked.data();
+}
+
+RawFrame BO548::acquire_rawframe() {
+    this->throw_if_streaming();
+    return this->camera.acquire();
+}
+
+std::vector<int> BO548::export_rawframes() const {
+    return this->camera.export_buffers();
 }
 
 } // namespace tofcam
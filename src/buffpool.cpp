@@ -1,15 +1,17 @@
 #include <buffpool.hpp>
+#include <cstdint>
 #include <linux/dma-buf.h>
 #include <linux/dma-heap.h>
 #include <linux/videodev2.h>
 #include <sys/mman.h>
+#include <stdexcept>
 #include <syscall.hpp>
 #include <system_error>
 #include <unistd.h>
 
 namespace tofcam {
 
-MmapBufferPool::MmapBufferPool(const int fd, const uint32_t num_buffers) {
+MmapBufferPool::MmapBufferPool(const int fd, const uint32_t num_buffers) : device(fd) {
     this->buffers.reserve(num_buffers);
     try {
         for (uint32_t i = 0; i < num_buffers; i++) {
@@ -46,7 +48,8 @@ MmapBufferPool::~MmapBufferPool() noexcept {
     this->buffers.clear();
 }
 
-MmapBufferPool::MmapBufferPool(MmapBufferPool&& other) noexcept : buffers(std::move(other.buffers)) {
+MmapBufferPool::MmapBufferPool(MmapBufferPool&& other) noexcept
+    : device(other.device), buffers(std::move(other.buffers)) {
     other.buffers.clear();
 }
 
@@ -58,6 +61,7 @@ MmapBufferPool& MmapBufferPool::operator=(MmapBufferPool&& other) noexcept {
             }
         }
         this->buffers.clear();
+        this->device = other.device;
         this->buffers = std::move(other.buffers);
         other.buffers.clear();
     }
@@ -72,6 +76,21 @@ int MmapBufferPool::sync_end(const uint32_t) {
     return 0;
 }
 
+void* MmapBufferPool::get_address(const uint32_t index) const {
+    return this->buffers[index].first;
+}
+
+int MmapBufferPool::export_fd(const uint32_t index) const {
+    struct v4l2_exportbuffer expbuf = {};
+    expbuf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    expbuf.index = index;
+    expbuf.flags = O_RDONLY | O_CLOEXEC;
+    if (syscall::ioctl(this->device, VIDIOC_EXPBUF, &expbuf) < 0) {
+        throw std::system_error(errno, std::generic_category(), "ioctl VIDIOC_EXPBUF failed.");
+    }
+    return expbuf.fd;
+}
+
 DmaBufferPool::DmaBufferPool(const char* allocator, const uint32_t num_buffers, const uint32_t length) {
     this->fd = syscall::open(allocator, O_RDWR | O_CLOEXEC, 0);
     if (this->fd < 0) {
@@ -178,4 +197,96 @@ int DmaBufferPool::sync_end(const uint32_t index) {
     return bfd;
 }
 
+void* DmaBufferPool::get_address(const uint32_t index) const {
+    return std::get<0>(this->buffers[index]);
+}
+
+int DmaBufferPool::export_fd(const uint32_t index) const {
+    const int fd = ::fcntl(std::get<2>(this->buffers[index]), F_DUPFD_CLOEXEC, 0);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "fcntl F_DUPFD_CLOEXEC failed.");
+    }
+    return fd;
+}
+
+static constexpr size_t HUGE_PAGE_SIZE = 2 << 20;
+
+UserptrBufferPool::UserptrBufferPool(const uint32_t num_buffers, const uint32_t length)
+    : stride((length + 4095) & ~size_t(4095)) {
+    if (num_buffers == 0 || length == 0) {
+        throw std::invalid_argument("The pool needs at least one non-empty buffer.");
+    }
+    this->size = (this->stride * num_buffers + HUGE_PAGE_SIZE - 1) & ~(HUGE_PAGE_SIZE - 1);
+    // hugetlbfs pages, only available when they are reserved (vm.nr_hugepages)
+    this->arena = syscall::mmap(
+            nullptr, this->size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB | MAP_POPULATE, -1, 0);
+    this->hugetlb = this->arena != MAP_FAILED;
+    if (!this->hugetlb) {
+        // transparent huge pages: a 2MB aligned range taken out of a larger mapping
+        const size_t mapped = this->size + HUGE_PAGE_SIZE;
+        void* const addr = syscall::mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (addr == MAP_FAILED) {
+            throw std::system_error(errno, std::generic_category(), "mmap failed.");
+        }
+        const uintptr_t begin = reinterpret_cast<uintptr_t>(addr);
+        const uintptr_t aligned = (begin + HUGE_PAGE_SIZE - 1) & ~uintptr_t(HUGE_PAGE_SIZE - 1);
+        if (aligned > begin) {
+            syscall::munmap(addr, aligned - begin);
+        }
+        if (begin + mapped > aligned + this->size) {
+            syscall::munmap(reinterpret_cast<void*>(aligned + this->size), begin + mapped - aligned - this->size);
+        }
+        this->arena = reinterpret_cast<void*>(aligned);
+        // best effort, the arena still works with small pages
+        syscall::madvise(this->arena, this->size, MADV_HUGEPAGE);
+        // faults the pages in now rather than during the first captures
+        for (size_t offset = 0; offset < this->size; offset += 4096) {
+            static_cast<volatile uint8_t*>(this->arena)[offset] = 0;
+        }
+    }
+}
+
+UserptrBufferPool::~UserptrBufferPool() noexcept {
+    if (this->arena) {
+        syscall::munmap(this->arena, this->size);
+        this->arena = nullptr;
+    }
+}
+
+UserptrBufferPool::UserptrBufferPool(UserptrBufferPool&& other) noexcept
+    : arena(std::exchange(other.arena, nullptr)), size(other.size), stride(other.stride), hugetlb(other.hugetlb) {}
+
+UserptrBufferPool& UserptrBufferPool::operator=(UserptrBufferPool&& other) noexcept {
+    if (this != &other) {
+        if (this->arena) {
+            syscall::munmap(this->arena, this->size);
+        }
+        this->arena = std::exchange(other.arena, nullptr);
+        this->size = other.size;
+        this->stride = other.stride;
+        this->hugetlb = other.hugetlb;
+    }
+    return *this;
+}
+
+void* UserptrBufferPool::sync_start(const uint32_t index) {
+    return this->get_address(index);
+}
+
+int UserptrBufferPool::sync_end(const uint32_t) {
+    return 0;
+}
+
+void* UserptrBufferPool::get_address(const uint32_t index) const {
+    return static_cast<uint8_t*>(this->arena) + this->stride * index;
+}
+
+int UserptrBufferPool::export_fd(const uint32_t) const {
+    throw std::runtime_error("USERPTR buffers can not be exported.");
+}
+
+bool UserptrBufferPool::is_hugetlb() const {
+    return this->hugetlb;
+}
+
 } // namespace tofcam
@@ -1,5 +1,10 @@
+#include <algorithm>
 #include <camera.hpp>
+#include <cerrno>
+#include <limits>
 #include <linux/videodev2.h>
+#include <realtime.hpp>
+#include <stdexcept>
 #include <sys/mman.h>
 #include <syscall.hpp>
 #include <system_error>
@@ -7,11 +12,23 @@
 
 namespace tofcam {
 
+static uint32_t memory_type(const MemType memtype) {
+    switch (memtype) {
+    case MemType::MMAP:
+        return V4L2_MEMORY_MMAP;
+    case MemType::DMABUF:
+        return V4L2_MEMORY_DMABUF;
+    case MemType::USERPTR:
+        return V4L2_MEMORY_USERPTR;
+    }
+    throw std::invalid_argument("Unknown memory type.");
+}
+
 Camera::Camera(
         const char* device, const uint32_t num_buffers, const MemType memtype,
         std::optional<const std::pair<uint32_t, uint32_t>> imagesize)
-    : memorytype(memtype == MemType::MMAP ? V4L2_MEMORY_MMAP : V4L2_MEMORY_DMABUF) {
-    this->fd = syscall::open(device, O_RDWR, 0);
+    : memorytype(memory_type(memtype)), num_buffers(num_buffers) {
+    this->fd = syscall::open(device, O_RDWR | O_NONBLOCK, 0);
     if (this->fd < 0) {
         throw std::system_error(errno, std::generic_category(), "Failed to open camera device.");
     }
@@ -60,25 +77,30 @@ Camera::Camera(
                 throw std::system_error(errno, std::generic_category(), "ioctl VIDIOC_S_FMT failed.");
             }
         }
-        { // setup buffers
-            struct v4l2_requestbuffers req = {};
-            req.count = num_buffers;
-            req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
-            req.memory = this->memorytype;
-            if (syscall::ioctl(this->fd, VIDIOC_REQBUFS, &req) < 0) {
-                throw std::system_error(errno, std::generic_category(), "ioctl VIDIOC_REQBUFS failed.");
-            }
-            if (req.count != num_buffers) {
-                throw std::runtime_error("Buffer request failed.");
-            }
-        }
+        this->request_buffers(num_buffers);
         // allocate buffers
         if (this->memorytype == V4L2_MEMORY_MMAP) {
             this->buffers = std::make_unique<MmapBufferPool>(this->fd, num_buffers);
+        } else if (this->memorytype == V4L2_MEMORY_USERPTR) {
+            this->buffers = std::make_unique<UserptrBufferPool>(num_buffers, this->sizeimage);
         } else {
             this->buffers = std::make_unique<DmaBufferPool>("/dev/dma_heap/linux,cma", num_buffers, this->sizeimage);
         }
-        { // enqueue all buffers
+        try { // enqueue all buffers
+            for (uint32_t i = 0; i < num_buffers; i++) {
+                this->enqueue(i);
+            }
+        } catch (const std::system_error& e) {
+            // without an IOMMU, vb2-dma-contig fails QBUF with EINVAL on user memory that is not physically contiguous
+            // (huge pages are only within 2MB): the driver buffers are used instead
+            if (this->memorytype != V4L2_MEMORY_USERPTR || e.code().value() != EINVAL) {
+                throw;
+            }
+            this->request_buffers(0);
+            this->buffers.reset();
+            this->memorytype = V4L2_MEMORY_MMAP;
+            this->request_buffers(num_buffers);
+            this->buffers = std::make_unique<MmapBufferPool>(this->fd, num_buffers);
             for (uint32_t i = 0; i < num_buffers; i++) {
                 this->enqueue(i);
             }
@@ -92,6 +114,19 @@ Camera::Camera(
     }
 }
 
+void Camera::request_buffers(const uint32_t count) {
+    struct v4l2_requestbuffers req = {};
+    req.count = count;
+    req.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    req.memory = this->memorytype;
+    if (syscall::ioctl(this->fd, VIDIOC_REQBUFS, &req) < 0) {
+        throw std::system_error(errno, std::generic_category(), "ioctl VIDIOC_REQBUFS failed.");
+    }
+    if (req.count != count) {
+        throw std::runtime_error("Buffer request failed.");
+    }
+}
+
 Camera::~Camera() noexcept {
     if (this->fd >= 0) {
         syscall::close(this->fd);
@@ -99,29 +134,12 @@ Camera::~Camera() noexcept {
     }
 }
 
-Camera::Camera(Camera&& other) noexcept
-    : memorytype(other.memorytype), fd(other.fd), sizeimage(other.sizeimage), bytesperline(other.bytesperline),
-      buffers(std::move(other.buffers)) {}
-
-Camera& Camera::operator=(Camera&& other) noexcept {
-    if (this != &other) {
-        this->memorytype = other.memorytype;
-        if (this->fd >= 0) {
-            syscall::close(this->fd);
-        }
-        this->fd = other.fd;
-        this->sizeimage = other.sizeimage;
-        this->bytesperline = other.bytesperline;
-        this->buffers = std::move(other.buffers);
-    }
-    return *this;
-}
-
 void Camera::stream_on() {
     uint32_t type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
     if (syscall::ioctl(this->fd, VIDIOC_STREAMON, &type) < 0) {
         throw std::system_error(errno, std::generic_category(), "ioctl VIDIOC_STREAMON failed.");
     }
+    this->sequence = std::nullopt;
 }
 
 void Camera::stream_off() {
@@ -131,17 +149,108 @@ void Camera::stream_off() {
     }
 }
 
+bool Camera::wait(const int timeout_ms) const {
+    struct pollfd pfd = {};
+    pfd.fd = this->fd;
+    pfd.events = POLLIN;
+    int r;
+    do {
+        r = syscall::poll(&pfd, 1, timeout_ms);
+    } while (r < 0 && errno == EINTR);
+    if (r < 0) {
+        throw std::system_error(errno, std::generic_category(), "poll failed.");
+    }
+    // the driver reports POLLERR while the stream is off or no buffer is queued, a frame would never come
+    if (pfd.revents & POLLERR) {
+        throw std::runtime_error("No frame can be captured: the stream is off or no buffer is queued.");
+    }
+    return r > 0;
+}
+
 std::pair<void*, uint32_t> Camera::dequeue() {
+    return this->acquire().release();
+}
+
+std::optional<std::pair<void*, uint32_t>> Camera::dequeue(const std::chrono::milliseconds timeout) {
+    auto frame = this->acquire(timeout);
+    if (!frame) {
+        return std::nullopt;
+    }
+    return frame->release();
+}
+
+std::optional<std::pair<void*, uint32_t>> Camera::try_dequeue() {
+    auto frame = this->try_acquire();
+    if (!frame) {
+        return std::nullopt;
+    }
+    return frame->release();
+}
+
+RawFrame Camera::acquire() {
+    std::chrono::nanoseconds waited(0);
+    while (true) {
+        if (auto frame = this->try_acquire()) {
+            this->telemetry->wait.record(waited);
+            return std::move(frame.value());
+        }
+        const auto start = std::chrono::steady_clock::now();
+        this->wait(-1);
+        waited += std::chrono::steady_clock::now() - start;
+    }
+}
+
+std::optional<RawFrame> Camera::acquire(const std::chrono::milliseconds timeout) {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    std::chrono::nanoseconds waited(0);
+    while (true) {
+        if (auto frame = this->try_acquire()) {
+            this->telemetry->wait.record(waited);
+            return frame;
+        }
+        const auto start = std::chrono::steady_clock::now();
+        const auto left = std::chrono::ceil<std::chrono::milliseconds>(deadline - start);
+        if (left.count() <= 0 || !this->wait(std::min<int64_t>(left.count(), std::numeric_limits<int>::max()))) {
+            return std::nullopt;
+        }
+        waited += std::chrono::steady_clock::now() - start;
+    }
+}
+
+std::optional<RawFrame> Camera::try_acquire() {
     struct v4l2_buffer buf = {};
     buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
     buf.memory = this->memorytype;
     if (syscall::ioctl(this->fd, VIDIOC_DQBUF, &buf) < 0) {
+        if (errno == EAGAIN) {
+            return std::nullopt;
+        }
         throw std::system_error(errno, std::generic_category(), "ioctl VIDIOC_DQBUF failed.");
     }
+    const auto dequeued = std::chrono::steady_clock::now();
+    const auto timestamp = std::chrono::seconds(buf.timestamp.tv_sec) + std::chrono::microseconds(buf.timestamp.tv_usec);
+    const FrameInfo info = {buf.sequence, std::chrono::steady_clock::time_point(timestamp)};
+    this->telemetry->frames.fetch_add(1, std::memory_order_relaxed);
+    if (this->sequence) {
+        // unsigned, so that the wrap of the counter is a gap as well
+        const uint32_t gap = buf.sequence - this->sequence.value() - 1;
+        if (gap < (1u << 31)) {
+            this->telemetry->dropped.fetch_add(gap, std::memory_order_relaxed);
+        }
+    }
+    this->sequence = buf.sequence;
+    if ((buf.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) == V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC) {
+        this->telemetry->kernel.record(dequeued - info.timestamp);
+    }
+    void* const ptr = this->buffers->sync_start(buf.index);
+    this->telemetry->sync.record(std::chrono::steady_clock::now() - dequeued);
+    RawFrame frame(this, ptr, buf.index, info);
     if (buf.bytesused < this->width * this->height * 3 / 2) {
+        // the buffer goes back to the driver, so that a short frame does not starve the stream
+        frame.reset();
         throw std::runtime_error("bytesused is too small.");
     }
-    return {this->buffers->sync_start(buf.index), buf.index};
+    return frame;
 }
 
 void Camera::enqueue(const uint32_t index) {
@@ -149,11 +258,20 @@ void Camera::enqueue(const uint32_t index) {
     buf.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
     buf.memory = this->memorytype;
     buf.index = index;
-    buf.m.fd = this->buffers->sync_end(index);
+    const auto start = std::chrono::steady_clock::now();
+    const int bfd = this->buffers->sync_end(index);
+    if (this->memorytype == V4L2_MEMORY_USERPTR) {
+        buf.m.userptr = reinterpret_cast<unsigned long>(this->buffers->get_address(index));
+    } else {
+        buf.m.fd = bfd;
+    }
     buf.length = this->sizeimage;
+    const auto synced = std::chrono::steady_clock::now();
     if (syscall::ioctl(this->fd, VIDIOC_QBUF, &buf) < 0) {
         throw std::system_error(errno, std::generic_category(), "ioctl VIDIOC_QBUF failed.");
     }
+    this->telemetry->sync.record(synced - start);
+    this->telemetry->queue.record(std::chrono::steady_clock::now() - synced);
 }
 
 std::pair<uint32_t, uint32_t> Camera::get_size() const {
@@ -168,4 +286,55 @@ uint32_t Camera::get_format() const {
     return this->pixelformat;
 }
 
+MemType Camera::get_memtype() const {
+    switch (this->memorytype) {
+    case V4L2_MEMORY_DMABUF:
+        return MemType::DMABUF;
+    case V4L2_MEMORY_USERPTR:
+        return MemType::USERPTR;
+    default:
+        return MemType::MMAP;
+    }
+}
+
+std::vector<int> Camera::export_buffers() const {
+    std::vector<int> fds;
+    try {
+        for (uint32_t i = 0; i < this->num_buffers; i++) {
+            fds.push_back(this->buffers->export_fd(i));
+        }
+    } catch (...) {
+        for (const int bfd : fds) {
+            syscall::close(bfd);
+        }
+        throw;
+    }
+    return fds;
+}
+
+void* Camera::get_buffer(const uint32_t index) const {
+    if (index >= this->num_buffers) {
+        throw std::out_of_range("No such buffer.");
+    }
+    return this->buffers->get_address(index);
+}
+
+void Camera::lock_buffers() const {
+    for (uint32_t i = 0; i < this->num_buffers; i++) {
+        lock_memory(this->buffers->get_address(i), this->sizeimage);
+    }
+}
+
+int Camera::get_fd() const {
+    return this->fd;
+}
+
+Telemetry& Camera::get_telemetry() {
+    return *this->telemetry;
+}
+
+const Telemetry& Camera::get_telemetry() const {
+    return *this->telemetry;
+}
+
 } // namespace tofcam
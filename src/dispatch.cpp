@@ -0,0 +1,88 @@
+#include <atomic>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <utility.hpp>
+#include <utility>
+
+#if defined(__aarch64__)
+#include <asm/hwcap.h>
+#include <sys/auxv.h>
+#endif
+
+namespace tofcam {
+
+static Isa probe_isa() {
+#if defined(__aarch64__)
+    if (getauxval(AT_HWCAP) & HWCAP_ASIMD) {
+        return Isa::NEON;
+    }
+#elif defined(__x86_64__)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) {
+        return Isa::AVX512;
+    }
+    if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+        return Isa::AVX2;
+    }
+#endif
+    return Isa::Scalar;
+}
+
+static std::atomic<Isa>& active_isa() {
+    static std::atomic<Isa> isa = [] {
+        const Isa detected = detect_isa();
+        const char* name = std::getenv("TOFCAM_ISA");
+        if (name == nullptr) {
+            return detected;
+        }
+        const std::pair<const char*, Isa> names[] = {
+                {"scalar", Isa::Scalar},
+                {"neon", Isa::NEON},
+                {"avx2", Isa::AVX2},
+                {"avx512", Isa::AVX512},
+        };
+        for (const auto& [key, value] : names) {
+            if (std::strcmp(name, key) == 0 && is_supported(value)) {
+                return value;
+            }
+        }
+        fprintf(stderr, "TOFCAM_ISA=%s is not supported, ignored.\n", name);
+        return detected;
+    }();
+    return isa;
+}
+
+Isa detect_isa() {
+    static const Isa isa = probe_isa();
+    return isa;
+}
+
+Isa get_isa() {
+    return active_isa().load(std::memory_order_relaxed);
+}
+
+void set_isa(const Isa isa) {
+    if (!is_supported(isa)) {
+        throw std::invalid_argument("Instruction set is not supported on this CPU.");
+    }
+    active_isa().store(isa, std::memory_order_relaxed);
+}
+
+bool is_supported(const Isa isa) {
+    const Isa detected = detect_isa();
+    switch (isa) {
+    case Isa::Scalar:
+        return true;
+    case Isa::NEON:
+        return detected == Isa::NEON;
+    case Isa::AVX2:
+        return detected == Isa::AVX2 || detected == Isa::AVX512;
+    case Isa::AVX512:
+        return detected == Isa::AVX512;
+    }
+    return false;
+}
+
+} // namespace tofcam
@@ -1,8 +1,14 @@
+#include <algorithm>
 #include <fakecam.hpp>
 #include <fstream>
+#include <stdexcept>
+#include <thread>
 
 namespace tofcam {
 
+// frames of a recording read ahead
+static constexpr uint32_t READ_AHEAD = 8;
+
 FakeCamera::FakeCamera(
         const char* dir, const uint32_t width, const uint32_t height, const uint32_t bytesperline, const uint32_t max_frames)
     : width(width), height(height), bytesperline(bytesperline), sizeimage(bytesperline * height) {
@@ -14,16 +20,181 @@ FakeCamera::FakeCamera(
     }
 }
 
-void FakeCamera::stream_on() {}
-void FakeCamera::stream_off() {}
+FakeCamera::FakeCamera(const char* recording) : FakeCamera(std::make_unique<Recording>(recording)) {}
+
+FakeCamera::FakeCamera(std::unique_ptr<Recording> recording)
+    : width(recording->get_format().width), height(recording->get_format().height),
+      bytesperline(recording->get_format().bytesperline), sizeimage(recording->get_format().sizeimage),
+      recording(std::move(recording)) {
+    if (this->recording->size() == 0) {
+        throw std::runtime_error("no frames");
+    }
+    if (this->recording->size() > UINT32_MAX) {
+        throw std::runtime_error("too many frames");
+    }
+}
+
+void FakeCamera::set_pacing(const ReplayPacing& pacing) {
+    if (this->streaming) {
+        throw std::runtime_error("The pacing can not change while streaming.");
+    }
+    if (pacing.fps < 0.0 || pacing.jitter.count() < 0) {
+        throw std::invalid_argument("The frame rate and the jitter can not be negative.");
+    }
+    if (pacing.fps > 0.0 && pacing.num_buffers == 0) {
+        throw std::invalid_argument("A paced replay needs at least 1 buffer.");
+    }
+    this->pacing = pacing;
+    this->period = std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::duration<double>(pacing.fps > 0.0 ? 1.0 / pacing.fps : 0.0));
+    this->random.seed(pacing.seed);
+}
+
+void FakeCamera::stream_on() {
+    this->streaming = true;
+    this->next = 0;
+    this->sequence = std::nullopt;
+    if (this->period.count() == 0) {
+        return;
+    }
+    this->buffers.assign(this->pacing.num_buffers, {nullptr, {}});
+    this->held.assign(this->pacing.num_buffers, false);
+    this->queued.clear();
+    this->done.clear();
+    for (uint32_t i = 0; i < this->pacing.num_buffers; i++) {
+        this->queued.push_back(i);
+    }
+    // the first frame completes one period later, as a capture started now
+    this->start = std::chrono::steady_clock::now();
+    this->due = this->start;
+    this->schedule();
+}
+
+void FakeCamera::stream_off() {
+    this->streaming = false;
+}
+
+void* FakeCamera::source(const uint64_t index) {
+    if (this->recording) {
+        // reads a few frames ahead and drops the ones behind
+        const uint64_t frame = index % this->recording->size();
+        this->recording->advise(frame + 1, READ_AHEAD);
+        return this->recording->frame(frame);
+    }
+    return this->frames[index % this->frames.size()].data();
+}
+
+void FakeCamera::advance(const std::chrono::steady_clock::time_point now) {
+    while (this->due <= now) {
+        if (this->queued.empty()) {
+            this->next++; // lost, every buffer is held or done
+        } else {
+            const uint32_t index = this->queued.front();
+            this->queued.pop_front();
+            this->buffers[index] = {this->source(this->next), {uint32_t(this->next), this->due}};
+            this->done.push_back(index);
+            this->next++;
+        }
+        this->schedule();
+    }
+}
+
+void FakeCamera::schedule() {
+    const auto jitter = std::uniform_int_distribution<int64_t>(
+            0, std::chrono::nanoseconds(this->pacing.jitter).count())(this->random);
+    // late frames do not overtake each other
+    this->due = std::max(this->due, this->start + this->period * int64_t(this->next + 1) + std::chrono::nanoseconds(jitter));
+}
+
+std::optional<std::pair<void*, uint32_t>> FakeCamera::wait(const std::chrono::steady_clock::time_point deadline) {
+    while (true) {
+        if (!this->streaming || (this->queued.empty() && this->done.empty())) {
+            throw std::runtime_error("No frame can be captured: the stream is off or no buffer is queued.");
+        }
+        const auto now = std::chrono::steady_clock::now();
+        this->advance(now);
+        if (!this->done.empty()) {
+            const uint32_t index = this->done.front();
+            this->done.pop_front();
+            this->held[index] = true;
+            this->received(this->buffers[index].second, now);
+            return std::pair<void*, uint32_t>{this->buffers[index].first, index};
+        }
+        if (now >= deadline) {
+            return std::nullopt;
+        }
+        std::this_thread::sleep_until(std::min(this->due, deadline));
+    }
+}
+
+void FakeCamera::received(const FrameInfo& info, const std::chrono::steady_clock::time_point now) {
+    this->telemetry->frames.fetch_add(1, std::memory_order_relaxed);
+    if (this->sequence) {
+        this->telemetry->dropped.fetch_add(info.sequence - this->sequence.value() - 1, std::memory_order_relaxed);
+    }
+    this->sequence = info.sequence;
+    if (this->period.count() > 0) {
+        this->telemetry->kernel.record(now - info.timestamp);
+    }
+    this->info = info;
+}
 
 std::pair<void*, uint32_t> FakeCamera::dequeue() {
-    auto ret = std::pair<void*, uint32_t>{this->frames[this->index].data(), this->index};
-    this->index = index >= (this->frames.size() - 1) ? 0 : index + 1;
+    const auto start = std::chrono::steady_clock::now();
+    if (this->period.count() > 0) {
+        const auto frame = this->wait(std::chrono::steady_clock::time_point::max());
+        this->telemetry->wait.record(std::chrono::steady_clock::now() - start);
+        return frame.value();
+    }
+    // unpaced, the frames are indexed in the replay
+    const uint32_t index = this->next % (this->recording ? this->recording->size() : this->frames.size());
+    auto ret = std::pair<void*, uint32_t>{this->source(this->next), index};
+    this->received({uint32_t(this->next), start}, start);
+    this->next++;
     return ret;
 }
 
-void FakeCamera::enqueue(const uint32_t) {}
+std::optional<std::pair<void*, uint32_t>> FakeCamera::dequeue(const std::chrono::milliseconds timeout) {
+    if (this->period.count() == 0) {
+        return this->dequeue();
+    }
+    const auto start = std::chrono::steady_clock::now();
+    const auto frame = this->wait(start + timeout);
+    if (frame) {
+        this->telemetry->wait.record(std::chrono::steady_clock::now() - start);
+    }
+    return frame;
+}
+
+std::optional<std::pair<void*, uint32_t>> FakeCamera::try_dequeue() {
+    if (this->period.count() == 0) {
+        return this->dequeue();
+    }
+    return this->wait(std::chrono::steady_clock::now());
+}
+
+void FakeCamera::enqueue(const uint32_t index) {
+    if (this->period.count() == 0) {
+        return;
+    }
+    if (index >= this->held.size() || !this->held[index]) {
+        throw std::invalid_argument("The buffer is not dequeued.");
+    }
+    // the frames completed meanwhile could not use it
+    if (this->streaming) {
+        this->advance(std::chrono::steady_clock::now());
+    }
+    this->held[index] = false;
+    this->queued.push_back(index);
+}
+
+FrameInfo FakeCamera::get_info() const {
+    return this->info;
+}
+
+Telemetry& FakeCamera::get_telemetry() {
+    return *this->telemetry;
+}
 
 std::pair<uint32_t, uint32_t> FakeCamera::get_size() const {
     return {this->width, this->height};
@@ -33,6 +204,10 @@ std::pair<uint32_t, uint32_t> FakeCamera::get_bytes() const {
     return {this->sizeimage, this->bytesperline};
 }
 
+const RecordingFormat* FakeCamera::get_format() const {
+    return this->recording ? &this->recording->get_format() : nullptr;
+}
+
 void FakeCamera::load_frames(const char* dir, const uint32_t max_frames) {
     uint32_t count = 0;
     while (count < max_frames) {
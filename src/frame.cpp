@@ -0,0 +1,99 @@
+#include <camera.hpp>
+#include <frame.hpp>
+#include <stdexcept>
+
+namespace tofcam {
+
+RawFrame::RawFrame(Camera* camera, void* data, const uint32_t index, const FrameInfo& info)
+    : camera(camera), ptr(data), idx(index), frame_info(info) {}
+
+RawFrame::~RawFrame() noexcept {
+    try {
+        this->reset();
+    } catch (...) {
+        // the buffer is lost for this stream, the driver gets it back on stream_off()
+    }
+}
+
+RawFrame::RawFrame(RawFrame&& other) noexcept
+    : camera(std::exchange(other.camera, nullptr)), ptr(std::exchange(other.ptr, nullptr)), idx(other.idx),
+      frame_info(other.frame_info) {}
+
+RawFrame& RawFrame::operator=(RawFrame&& other) noexcept {
+    if (this != &other) {
+        try {
+            this->reset();
+        } catch (...) {
+        }
+        this->camera = std::exchange(other.camera, nullptr);
+        this->ptr = std::exchange(other.ptr, nullptr);
+        this->idx = other.idx;
+        this->frame_info = other.frame_info;
+    }
+    return *this;
+}
+
+void* RawFrame::data() const {
+    return this->ptr;
+}
+
+uint32_t RawFrame::index() const {
+    return this->idx;
+}
+
+const FrameInfo& RawFrame::info() const {
+    return this->frame_info;
+}
+
+RawFrame::operator bool() const {
+    return this->camera != nullptr;
+}
+
+void RawFrame::reset() {
+    if (this->camera) {
+        Camera* const camera = std::exchange(this->camera, nullptr);
+        this->ptr = nullptr;
+        camera->enqueue(this->idx);
+    }
+}
+
+std::pair<void*, uint32_t> RawFrame::release() {
+    this->camera = nullptr;
+    return {std::exchange(this->ptr, nullptr), this->idx};
+}
+
+FramePool::FramePool(const uint32_t capacity) : buffers(capacity) {
+    if (capacity == 0) {
+        throw std::invalid_argument("The pool needs at least one frame.");
+    }
+    this->available.reserve(capacity);
+    for (auto& buffers : this->buffers) {
+        this->available.push_back(&buffers);
+    }
+}
+
+FrameBuffers* FramePool::acquire() {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    if (this->available.empty()) {
+        return nullptr;
+    }
+    FrameBuffers* const buffers = this->available.back();
+    this->available.pop_back();
+    return buffers;
+}
+
+void FramePool::release(FrameBuffers* buffers) {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    this->available.push_back(buffers);
+}
+
+uint32_t FramePool::capacity() const {
+    return this->buffers.size();
+}
+
+uint32_t FramePool::num_available() const {
+    std::lock_guard<std::mutex> lock(this->mutex);
+    return this->available.size();
+}
+
+} // namespace tofcam
@@ -0,0 +1,185 @@
+#include <algorithm>
+#include <cerrno>
+#include <framering.hpp>
+#include <limits>
+#include <stdexcept>
+#include <sys/eventfd.h>
+#include <syscall.hpp>
+#include <system_error>
+#include <unistd.h>
+
+namespace tofcam {
+
+FrameRing::FrameRing(const uint32_t num_slots, const Overflow overflow)
+    : num_slots(num_slots), overflow(overflow), states(std::make_unique<std::atomic<uint64_t>[]>(num_slots)) {
+    // one slot written, one read and at least one ready
+    if (num_slots < 3) {
+        throw std::invalid_argument("A frame ring needs at least 3 slots.");
+    }
+    this->fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (this->fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "eventfd failed.");
+    }
+}
+
+FrameRing::~FrameRing() noexcept {
+    syscall::close(this->fd);
+}
+
+std::optional<std::pair<uint32_t, uint64_t>> FrameRing::find_ready(const bool newest) const {
+    std::optional<std::pair<uint32_t, uint64_t>> found = std::nullopt;
+    for (uint32_t i = 0; i < this->num_slots; i++) {
+        // READY states compare by sequence number
+        const uint64_t state = this->states[i].load(std::memory_order_relaxed);
+        if ((state & 3) == READY && (!found || (newest ? state > found->second : state < found->second))) {
+            found = {i, state};
+        }
+    }
+    return found;
+}
+
+std::optional<uint32_t> FrameRing::acquire() {
+    while (true) {
+        // read before the scan, so that a release during the scan ends the wait
+        const uint32_t released = this->released.load(std::memory_order_acquire);
+        if (this->closed.load(std::memory_order_acquire)) {
+            return std::nullopt;
+        }
+        for (uint32_t i = 0; i < this->num_slots; i++) {
+            uint64_t state = FREE;
+            if (this->states[i].compare_exchange_strong(state, WRITING, std::memory_order_acquire, std::memory_order_relaxed)) {
+                return i;
+            }
+        }
+        if (this->overflow == Overflow::DropOldest) {
+            // the consumer reads one slot at most, so one is ready
+            if (auto ready = this->find_ready(false)) {
+                auto [slot, state] = ready.value();
+                if (this->states[slot].compare_exchange_strong(
+                            state, WRITING, std::memory_order_acquire, std::memory_order_relaxed)) {
+                    this->dropped.fetch_add(1, std::memory_order_relaxed);
+                    return slot;
+                }
+            }
+            continue;
+        }
+        this->released.wait(released, std::memory_order_acquire);
+    }
+}
+
+std::optional<uint32_t> FrameRing::try_acquire() {
+    // Overflow::DropOldest never waits
+    if (this->overflow == Overflow::DropOldest) {
+        return this->acquire();
+    }
+    if (this->closed.load(std::memory_order_acquire)) {
+        return std::nullopt;
+    }
+    for (uint32_t i = 0; i < this->num_slots; i++) {
+        uint64_t state = FREE;
+        if (this->states[i].compare_exchange_strong(state, WRITING, std::memory_order_acquire, std::memory_order_relaxed)) {
+            return i;
+        }
+    }
+    return std::nullopt;
+}
+
+void FrameRing::publish(const uint32_t slot) {
+    this->states[slot].store(READY | (++this->sequence << 2), std::memory_order_release);
+    this->signal();
+}
+
+std::optional<uint32_t> FrameRing::try_pop() {
+    this->release();
+    // clears the readiness of the fd, set again below while frames are left
+    uint64_t count;
+    if (::read(this->fd, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+        throw std::system_error(errno, std::generic_category(), "read eventfd failed.");
+    }
+    const bool newest = this->overflow == Overflow::DropOldest;
+    while (auto ready = this->find_ready(newest)) {
+        auto [slot, state] = ready.value();
+        if (!this->states[slot].compare_exchange_strong(state, READING, std::memory_order_acquire, std::memory_order_relaxed)) {
+            continue; // taken by the producer
+        }
+        this->held = slot;
+        if (newest) {
+            // drops the older frames, the producer may have published newer ones meanwhile
+            for (uint32_t i = 0; i < this->num_slots; i++) {
+                uint64_t older = this->states[i].load(std::memory_order_relaxed);
+                if ((older & 3) == READY && older < state &&
+                    this->states[i].compare_exchange_strong(
+                            older, FREE, std::memory_order_release, std::memory_order_relaxed)) {
+                    this->dropped.fetch_add(1, std::memory_order_relaxed);
+                    this->released.fetch_add(1, std::memory_order_release);
+                    this->released.notify_one();
+                }
+            }
+        } else if (this->find_ready(false)) {
+            this->signal();
+        }
+        return slot;
+    }
+    return std::nullopt;
+}
+
+std::optional<uint32_t> FrameRing::pop(const std::chrono::milliseconds timeout) {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (true) {
+        if (const auto slot = this->try_pop()) {
+            return slot;
+        }
+        if (this->closed.load(std::memory_order_acquire)) {
+            return std::nullopt;
+        }
+        const auto left = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (left.count() <= 0) {
+            return std::nullopt;
+        }
+        struct pollfd pfd = {};
+        pfd.fd = this->fd;
+        pfd.events = POLLIN;
+        if (syscall::poll(&pfd, 1, std::min<int64_t>(left.count(), std::numeric_limits<int>::max())) < 0 &&
+            errno != EINTR) {
+            throw std::system_error(errno, std::generic_category(), "poll failed.");
+        }
+    }
+}
+
+void FrameRing::release() {
+    if (!this->held) {
+        return;
+    }
+    this->states[this->held.value()].store(FREE, std::memory_order_release);
+    this->held = std::nullopt;
+    this->released.fetch_add(1, std::memory_order_release);
+    this->released.notify_one();
+}
+
+void FrameRing::close() {
+    this->closed.store(true, std::memory_order_release);
+    this->released.fetch_add(1, std::memory_order_release);
+    this->released.notify_all();
+    this->signal();
+}
+
+bool FrameRing::is_closed() const {
+    return this->closed.load(std::memory_order_acquire);
+}
+
+int FrameRing::get_fd() const {
+    return this->fd;
+}
+
+uint64_t FrameRing::get_dropped() const {
+    return this->dropped.load(std::memory_order_relaxed);
+}
+
+void FrameRing::signal() {
+    const uint64_t one = 1;
+    if (::write(this->fd, &one, sizeof(one)) < 0) {
+        throw std::system_error(errno, std::generic_category(), "write eventfd failed.");
+    }
+}
+
+} // namespace tofcam
@@ -0,0 +1,328 @@
+#include <cerrno>
+#include <group.hpp>
+#include <limits>
+#include <realtime.hpp>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <syscall.hpp>
+#include <system_error>
+#include <unistd.h>
+
+namespace tofcam {
+
+// data of the eventfd in the epoll set, the cameras are their index
+static constexpr uint32_t STOP = std::numeric_limits<uint32_t>::max();
+
+struct CameraGroup::Member {
+    virtual ~Member() = default;
+
+    virtual int get_fd() const = 0;
+
+    virtual void stream_on() = 0;
+
+    virtual void stream_off() = 0;
+
+    // converts a frame already captured and hands it to the callback, or skips it when the pool is empty, false when
+    // there is none
+    virtual bool convert() = 0;
+
+    virtual Telemetry& get_telemetry() = 0;
+
+    uint32_t index = 0;
+    int cpu = -1;
+    int priority = 0;
+    std::thread worker;
+    std::atomic<uint32_t> ready{0}; // set by the loop when the fd is readable
+    std::atomic<uint64_t> frames{0};
+    std::atomic<uint64_t> skipped{0};
+    std::exception_ptr failure;
+    std::atomic<bool> failed{false};
+    // get_stats()
+    uint64_t last_frames = 0;
+    std::chrono::steady_clock::time_point last_time;
+};
+
+template <class Device, class T>
+struct CameraGroup::Driver : CameraGroup::Member {
+    Driver(std::unique_ptr<Device> camera, FrameCallback<T> callback)
+        : camera(std::move(camera)), callback(std::move(callback)) {}
+
+    int get_fd() const override {
+        return this->camera->get_fd();
+    }
+
+    void stream_on() override {
+        this->camera->stream_on();
+    }
+
+    void stream_off() override {
+        this->camera->stream_off();
+    }
+
+    bool convert() override {
+        // only this worker takes frames from the pool, the callbacks only give them back
+        if (this->camera->get_free_frames() == 0) {
+            if (!this->camera->drop_frame(std::chrono::milliseconds(0))) {
+                return false;
+            }
+            this->skipped.fetch_add(1, std::memory_order_relaxed);
+            return true;
+        }
+        auto frame = this->camera->template acquire_frame<T>(std::chrono::milliseconds(0));
+        if (!frame) {
+            return false;
+        }
+        this->callback(this->index, std::move(frame.value()));
+        this->frames.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    Telemetry& get_telemetry() override {
+        return this->camera->get_telemetry();
+    }
+
+    std::unique_ptr<Device> camera;
+    FrameCallback<T> callback;
+};
+
+CameraGroup::CameraGroup() {
+    this->epoll = ::epoll_create1(EPOLL_CLOEXEC);
+    if (this->epoll < 0) {
+        throw std::system_error(errno, std::generic_category(), "epoll_create1 failed.");
+    }
+    this->event = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (this->event < 0) {
+        syscall::close(this->epoll);
+        throw std::system_error(errno, std::generic_category(), "eventfd failed.");
+    }
+    struct epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.u32 = STOP;
+    if (::epoll_ctl(this->epoll, EPOLL_CTL_ADD, this->event, &event) < 0) {
+        syscall::close(this->event);
+        syscall::close(this->epoll);
+        throw std::system_error(errno, std::generic_category(), "epoll_ctl failed.");
+    }
+}
+
+CameraGroup::~CameraGroup() noexcept {
+    try {
+        this->stop();
+    } catch (...) {
+    }
+    syscall::close(this->event);
+    syscall::close(this->epoll);
+}
+
+template <class Device, class T>
+uint32_t CameraGroup::add_member(
+        std::unique_ptr<Device> camera, const int cpu, FrameCallback<T> callback, const uint32_t num_frames,
+        const int priority) {
+    if (this->running) {
+        throw std::runtime_error("Cameras can only be added before start().");
+    }
+    if (priority < 0 || priority > 99) {
+        throw std::invalid_argument("The SCHED_FIFO priority must be 1 to 99, or 0.");
+    }
+    camera->set_frame_pool(num_frames);
+    auto member = std::make_unique<Driver<Device, T>>(std::move(camera), std::move(callback));
+    member->index = this->members.size();
+    member->cpu = cpu;
+    member->priority = priority;
+    this->members.push_back(std::move(member));
+    return this->members.size() - 1;
+}
+
+template <class T>
+uint32_t CameraGroup::add(
+        std::unique_ptr<BO548> camera, const int cpu, FrameCallback<T> callback, const uint32_t num_frames,
+        const int priority) {
+    return this->add_member(std::move(camera), cpu, std::move(callback), num_frames, priority);
+}
+
+template <class T>
+uint32_t CameraGroup::add(
+        std::unique_ptr<BO410> camera, const int cpu, FrameCallback<T> callback, const uint32_t num_frames,
+        const int priority) {
+    return this->add_member(std::move(camera), cpu, std::move(callback), num_frames, priority);
+}
+
+template uint32_t CameraGroup::add<float>(
+        std::unique_ptr<BO548>, const int, FrameCallback<float>, const uint32_t, const int);
+template uint32_t CameraGroup::add<uint16_t>(
+        std::unique_ptr<BO548>, const int, FrameCallback<uint16_t>, const uint32_t, const int);
+template uint32_t CameraGroup::add<float>(
+        std::unique_ptr<BO410>, const int, FrameCallback<float>, const uint32_t, const int);
+template uint32_t CameraGroup::add<uint16_t>(
+        std::unique_ptr<BO410>, const int, FrameCallback<uint16_t>, const uint32_t, const int);
+
+void CameraGroup::start(const int cpu) {
+    if (this->running) {
+        throw std::runtime_error("The group is already started.");
+    }
+    if (this->members.empty()) {
+        throw std::runtime_error("The group has no camera.");
+    }
+    this->running = true;
+    this->stopping.store(false, std::memory_order_relaxed);
+    this->failed.store(false, std::memory_order_relaxed);
+    this->failure = nullptr;
+    try {
+        const auto now = std::chrono::steady_clock::now();
+        for (auto& member : this->members) {
+            member->ready.store(0, std::memory_order_relaxed);
+            member->failed.store(false, std::memory_order_relaxed);
+            member->failure = nullptr;
+            member->last_frames = member->frames.load(std::memory_order_relaxed);
+            member->last_time = now;
+            member->stream_on();
+            member->worker = std::thread(&CameraGroup::worker_loop, this, std::ref(*member));
+            set_thread_realtime(member->worker.native_handle(), member->cpu, member->priority);
+            // one shot: the worker re-arms the fd once it converted the frames captured so far
+            struct epoll_event event = {};
+            event.events = EPOLLIN | EPOLLONESHOT;
+            event.data.u32 = member->index;
+            if (::epoll_ctl(this->epoll, EPOLL_CTL_ADD, member->get_fd(), &event) < 0) {
+                throw std::system_error(errno, std::generic_category(), "epoll_ctl failed.");
+            }
+        }
+        this->loop = std::thread(&CameraGroup::event_loop, this);
+        set_thread_realtime(this->loop.native_handle(), cpu, 0);
+    } catch (...) {
+        this->stop();
+        throw;
+    }
+}
+
+void CameraGroup::stop() {
+    if (!this->running) {
+        return;
+    }
+    this->stopping.store(true, std::memory_order_release);
+    this->signal();
+    if (this->loop.joinable()) {
+        this->loop.join();
+    }
+    for (auto& member : this->members) {
+        if (member->worker.joinable()) {
+            member->ready.store(1, std::memory_order_release);
+            member->ready.notify_one();
+            member->worker.join();
+        }
+    }
+    // the eventfd stays readable until it is read here
+    uint64_t value = 0;
+    while (::read(this->event, &value, sizeof(value)) > 0) {
+    }
+    this->running = false;
+    std::exception_ptr error;
+    for (auto& member : this->members) {
+        // not registered when start() failed before it
+        ::epoll_ctl(this->epoll, EPOLL_CTL_DEL, member->get_fd(), nullptr);
+        try {
+            member->stream_off();
+        } catch (...) {
+            if (!error) {
+                error = std::current_exception();
+            }
+        }
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void CameraGroup::signal() {
+    const uint64_t value = 1;
+    if (::write(this->event, &value, sizeof(value)) < 0 && errno != EAGAIN) {
+        throw std::system_error(errno, std::generic_category(), "write eventfd failed.");
+    }
+}
+
+void CameraGroup::event_loop() {
+    struct epoll_event events[16];
+    while (!this->stopping.load(std::memory_order_acquire)) {
+        const int num_events = ::epoll_wait(this->epoll, events, 16, -1);
+        if (num_events < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            this->failure = std::make_exception_ptr(
+                    std::system_error(errno, std::generic_category(), "epoll_wait failed."));
+            this->failed.store(true, std::memory_order_release);
+            return;
+        }
+        for (int i = 0; i < num_events; i++) {
+            const uint32_t index = events[i].data.u32;
+            if (index == STOP) {
+                continue;
+            }
+            Member& member = *this->members[index];
+            member.ready.store(1, std::memory_order_release);
+            member.ready.notify_one();
+        }
+    }
+}
+
+void CameraGroup::worker_loop(Member& member) {
+    while (true) {
+        member.ready.wait(0, std::memory_order_acquire);
+        // taken before `stopping` is read: a wakeup of stop() after this is left for the next wait
+        member.ready.exchange(0, std::memory_order_acquire);
+        if (this->stopping.load(std::memory_order_acquire)) {
+            return;
+        }
+        try {
+            while (!this->stopping.load(std::memory_order_relaxed) && member.convert()) {
+            }
+            struct epoll_event event = {};
+            event.events = EPOLLIN | EPOLLONESHOT;
+            event.data.u32 = member.index;
+            if (::epoll_ctl(this->epoll, EPOLL_CTL_MOD, member.get_fd(), &event) < 0) {
+                throw std::system_error(errno, std::generic_category(), "epoll_ctl failed.");
+            }
+        } catch (...) {
+            // the fd is not re-armed, the other cameras go on
+            member.failure = std::current_exception();
+            member.failed.store(true, std::memory_order_release);
+            return;
+        }
+    }
+}
+
+uint32_t CameraGroup::size() const {
+    return this->members.size();
+}
+
+CameraStats CameraGroup::get_stats(const uint32_t camera) {
+    Member& member = *this->members.at(camera);
+    const auto now = std::chrono::steady_clock::now();
+    const uint64_t frames = member.frames.load(std::memory_order_relaxed);
+    const double elapsed = std::chrono::duration<double>(now - member.last_time).count();
+    CameraStats stats;
+    stats.frames = frames;
+    stats.dropped = member.get_telemetry().dropped.load(std::memory_order_relaxed);
+    stats.skipped = member.skipped.load(std::memory_order_relaxed);
+    stats.fps = elapsed > 0.0 ? (frames - member.last_frames) / elapsed : 0.0;
+    member.last_frames = frames;
+    member.last_time = now;
+    return stats;
+}
+
+Telemetry& CameraGroup::get_telemetry(const uint32_t camera) {
+    return this->members.at(camera)->get_telemetry();
+}
+
+void CameraGroup::check() const {
+    if (this->failed.load(std::memory_order_acquire)) {
+        std::rethrow_exception(this->failure);
+    }
+    for (const auto& member : this->members) {
+        if (member->failed.load(std::memory_order_acquire)) {
+            std::rethrow_exception(member->failure);
+        }
+    }
+}
+
+} // namespace tofcam
@@ -0,0 +1,57 @@
+#include <cerrno>
+#include <realtime.hpp>
+#include <sched.h>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <system_error>
+
+namespace tofcam {
+
+void set_thread_realtime(const pthread_t thread, const int cpu, const int priority) {
+    if (priority < 0 || priority > 99) {
+        throw std::invalid_argument("The SCHED_FIFO priority must be 1 to 99, or 0.");
+    }
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (cpu >= 0) {
+        CPU_SET(cpu, &set);
+    } else {
+        // the kernel keeps the CPUs of the cpuset of the process
+        for (int i = 0; i < CPU_SETSIZE; i++) {
+            CPU_SET(i, &set);
+        }
+    }
+    int err = pthread_setaffinity_np(thread, sizeof(set), &set);
+    if (err != 0) {
+        throw std::system_error(err, std::generic_category(), "pthread_setaffinity_np failed.");
+    }
+    struct sched_param param = {};
+    param.sched_priority = priority;
+    err = pthread_setschedparam(thread, priority > 0 ? SCHED_FIFO : SCHED_OTHER, &param);
+    if (err != 0) {
+        throw std::system_error(err, std::generic_category(), "pthread_setschedparam failed.");
+    }
+}
+
+void lock_memory(const void* addr, const size_t size) {
+    if (!addr || size == 0) {
+        return;
+    }
+    // mlock() faults the pages in, the mappings of device memory (VM_IO) are skipped and stay mapped anyway
+    if (::mlock(addr, size) < 0) {
+        throw std::system_error(errno, std::generic_category(), "mlock failed.");
+    }
+}
+
+void lock_memory(const FrameBuffers& buffers) {
+    const auto lock = [](const auto& v) { lock_memory(v.data(), v.size() * sizeof(v[0])); };
+    lock(buffers.depth);
+    lock(buffers.confidence);
+    lock(buffers.depth_u16);
+    lock(buffers.confidence_u16);
+    lock(buffers.mask);
+    lock(buffers.points);
+    lock(buffers.points_i16);
+}
+
+} // namespace tofcam
@@ -0,0 +1,128 @@
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#include <realtime.hpp>
+#include <recorder.hpp>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <syscall.hpp>
+#include <system_error>
+
+namespace tofcam {
+
+Recorder::Recorder(const char* path, const RecordingFormat& format, const uint32_t num_slots, const int cpu)
+    : writer(path, format, true), ring(num_slots, Overflow::Block), stride(this->writer.get_stride()),
+      sizeimage(format.sizeimage) {
+    // page aligned for O_DIRECT, and zero from sizeimage to the end of each slot
+    this->length = num_slots * this->stride;
+    this->slots = syscall::mmap(
+            nullptr, this->length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_POPULATE, -1, 0);
+    if (this->slots == MAP_FAILED) {
+        this->slots = nullptr;
+        throw std::system_error(errno, std::generic_category(), "mmap failed.");
+    }
+    this->infos.resize(num_slots);
+    this->thread = std::thread(&Recorder::writer_loop, this);
+    try {
+        set_thread_realtime(this->thread.native_handle(), cpu, 0);
+    } catch (...) {
+        this->ring.close();
+        this->thread.join();
+        syscall::munmap(this->slots, this->length);
+        throw;
+    }
+}
+
+Recorder::~Recorder() noexcept {
+    try {
+        this->finish();
+    } catch (...) {
+    }
+    syscall::munmap(this->slots, this->length);
+}
+
+bool Recorder::record(const void* data, const FrameInfo& info) {
+    if (this->failed.load(std::memory_order_acquire)) {
+        std::rethrow_exception(this->failure);
+    }
+    if (this->finished) {
+        throw std::runtime_error("The recording is finished.");
+    }
+    const auto slot = this->ring.try_acquire();
+    if (!slot) {
+        this->dropped.fetch_add(1, std::memory_order_relaxed);
+        return false;
+    }
+    std::memcpy(static_cast<uint8_t*>(this->slots) + slot.value() * this->stride, data, this->sizeimage);
+    this->infos[slot.value()] = info;
+    this->ring.publish(slot.value());
+    const uint64_t recorded = this->recorded.fetch_add(1, std::memory_order_relaxed) + 1;
+    // only updated here, by the one producer
+    const uint32_t pending = recorded - this->written.load(std::memory_order_relaxed);
+    if (pending > this->max_pending.load(std::memory_order_relaxed)) {
+        this->max_pending.store(pending, std::memory_order_relaxed);
+    }
+    return true;
+}
+
+void Recorder::finish() {
+    if (this->finished) {
+        return;
+    }
+    this->finished = true;
+    this->ring.close();
+    if (this->thread.joinable()) {
+        this->thread.join();
+    }
+    // the frames written before an error make a valid recording
+    this->writer.finish();
+    if (this->failed.load(std::memory_order_acquire)) {
+        std::rethrow_exception(this->failure);
+    }
+}
+
+void Recorder::write(const uint32_t slot) {
+    const auto start = std::chrono::steady_clock::now();
+    this->writer.write(static_cast<uint8_t*>(this->slots) + slot * this->stride, this->infos[slot]);
+    this->latency.record(std::chrono::steady_clock::now() - start);
+    this->written.fetch_add(1, std::memory_order_relaxed);
+}
+
+void Recorder::writer_loop() {
+    try {
+        while (true) {
+            if (const auto slot = this->ring.pop(std::chrono::milliseconds(1000))) {
+                this->write(slot.value());
+                continue;
+            }
+            if (this->ring.is_closed()) {
+                // published before close() and after the last pop()
+                while (const auto slot = this->ring.try_pop()) {
+                    this->write(slot.value());
+                }
+                break;
+            }
+        }
+        this->ring.release();
+    } catch (...) {
+        // rethrown by the next record() and by finish()
+        this->failure = std::current_exception();
+        this->failed.store(true, std::memory_order_release);
+    }
+}
+
+RecorderStats Recorder::get_stats() const {
+    RecorderStats stats;
+    stats.written = this->written.load(std::memory_order_relaxed);
+    stats.recorded = this->recorded.load(std::memory_order_relaxed);
+    stats.dropped = this->dropped.load(std::memory_order_relaxed);
+    stats.pending = stats.recorded > stats.written ? stats.recorded - stats.written : 0;
+    stats.max_pending = this->max_pending.load(std::memory_order_relaxed);
+    return stats;
+}
+
+const Histogram& Recorder::get_write_latency() const {
+    return this->latency;
+}
+
+} // namespace tofcam
@@ -0,0 +1,215 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <recording.hpp>
+#include <stdexcept>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <syscall.hpp>
+#include <system_error>
+#include <unistd.h>
+#include <utility>
+
+namespace tofcam {
+
+static constexpr uint64_t PAGE = RecordingHeader::PAGE;
+
+static uint64_t round_up(const uint64_t size) {
+    return (size + PAGE - 1) & ~(PAGE - 1);
+}
+
+static void write_all(const int fd, const void* data, size_t size, off_t offset) {
+    const uint8_t* ptr = static_cast<const uint8_t*>(data);
+    while (size > 0) {
+        const ssize_t written = ::pwrite(fd, ptr, size, offset);
+        if (written < 0) {
+            if (errno == EINTR) {
+                continue;
+            }
+            throw std::system_error(errno, std::generic_category(), "pwrite failed.");
+        }
+        ptr += written;
+        size -= written;
+        offset += written;
+    }
+}
+
+RecordingWriter::RecordingWriter(const char* path, const RecordingFormat& format, const bool direct)
+    : path(path), format(format) {
+    if (format.sizeimage == 0) {
+        throw std::invalid_argument("The frames of a recording can not be empty.");
+    }
+    const int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+    if (direct) {
+        // tmpfs and a few others refuse O_DIRECT
+        this->fd = syscall::open(path, flags | O_DIRECT, 0644);
+        this->direct = this->fd >= 0;
+    }
+    if (this->fd < 0) {
+        this->fd = syscall::open(path, flags, 0644);
+    }
+    if (this->fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "Failed to create the recording.");
+    }
+    this->stride = round_up(format.sizeimage);
+    this->padding.resize(this->stride - format.sizeimage);
+}
+
+RecordingWriter::~RecordingWriter() noexcept {
+    try {
+        this->finish();
+    } catch (...) {
+    }
+}
+
+void RecordingWriter::write(const void* data, const FrameInfo& info) {
+    if (this->fd < 0) {
+        throw std::runtime_error("The recording is finished.");
+    }
+    const uint64_t offset = PAGE + this->index.size() * this->stride;
+    if (this->direct) {
+        write_all(this->fd, data, this->stride, offset);
+    } else {
+        write_all(this->fd, data, this->format.sizeimage, offset);
+        write_all(this->fd, this->padding.data(), this->padding.size(), offset + this->format.sizeimage);
+    }
+    RecordingEntry entry;
+    entry.offset = offset;
+    entry.sequence = info.sequence;
+    entry.timestamp_ns = std::chrono::nanoseconds(info.timestamp.time_since_epoch()).count();
+    this->index.push_back(entry);
+}
+
+void RecordingWriter::finish() {
+    if (this->fd < 0) {
+        return;
+    }
+    const int fd = std::exchange(this->fd, -1);
+    try {
+        // the index and the header are not aligned for O_DIRECT
+        if (this->direct && ::fcntl(fd, F_SETFL, ::fcntl(fd, F_GETFL) & ~O_DIRECT) < 0) {
+            throw std::system_error(errno, std::generic_category(), "fcntl F_SETFL failed.");
+        }
+        RecordingHeader header;
+        std::memcpy(header.magic, RecordingHeader::MAGIC, sizeof(header.magic));
+        header.entry_size = sizeof(RecordingEntry);
+        header.format = this->format;
+        header.num_frames = this->index.size();
+        header.index_offset = PAGE + this->index.size() * this->stride;
+        write_all(fd, this->index.data(), this->index.size() * sizeof(RecordingEntry), header.index_offset);
+        // the header page last, the recording is valid from here on
+        std::vector<uint8_t> page(PAGE);
+        std::memcpy(page.data(), &header, sizeof(header));
+        write_all(fd, page.data(), page.size(), 0);
+        if (syscall::close(fd) < 0) {
+            throw std::system_error(errno, std::generic_category(), "Failed to close the recording.");
+        }
+    } catch (...) {
+        syscall::close(fd);
+        throw;
+    }
+}
+
+uint64_t RecordingWriter::get_stride() const {
+    return this->stride;
+}
+
+uint64_t RecordingWriter::get_num_frames() const {
+    return this->index.size();
+}
+
+Recording::Recording(const char* path) {
+    this->fd = syscall::open(path, O_RDONLY | O_CLOEXEC, 0);
+    if (this->fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "Failed to open the recording.");
+    }
+    try {
+        struct stat st = {};
+        if (::fstat(this->fd, &st) < 0) {
+            throw std::system_error(errno, std::generic_category(), "fstat failed.");
+        }
+        if (uint64_t(st.st_size) < PAGE) {
+            throw std::runtime_error("Not a recording.");
+        }
+        this->length = st.st_size;
+        // private and writable, so that the frames can be handed out as the buffers of a camera
+        this->base = syscall::mmap(nullptr, this->length, PROT_READ | PROT_WRITE, MAP_PRIVATE, this->fd, 0);
+        if (this->base == MAP_FAILED) {
+            this->base = nullptr;
+            throw std::system_error(errno, std::generic_category(), "mmap failed.");
+        }
+        std::memcpy(&this->header, this->base, sizeof(this->header));
+        const RecordingHeader& header = this->header;
+        if (std::memcmp(header.magic, RecordingHeader::MAGIC, sizeof(header.magic)) != 0 ||
+            header.header_size != sizeof(RecordingHeader) || header.entry_size != sizeof(RecordingEntry)) {
+            throw std::runtime_error("Not a recording, or an unfinished one.");
+        }
+        // the frames and the index follow the header page
+        if (header.format.sizeimage == 0 || header.index_offset < PAGE || header.index_offset % PAGE != 0 ||
+            header.index_offset > this->length ||
+            header.num_frames > (this->length - header.index_offset) / sizeof(RecordingEntry)) {
+            throw std::runtime_error("The recording is truncated.");
+        }
+        this->entries = reinterpret_cast<const RecordingEntry*>(static_cast<uint8_t*>(this->base) + header.index_offset);
+        for (uint64_t i = 0; i < header.num_frames; i++) {
+            const uint64_t offset = this->entries[i].offset;
+            if (offset < PAGE || offset % PAGE != 0 || offset > this->length ||
+                this->length - offset < header.format.sizeimage) {
+                throw std::runtime_error("The recording is truncated.");
+            }
+        }
+        // the frames are read in order, advise() reads further ahead
+        syscall::madvise(this->base, this->length, MADV_SEQUENTIAL);
+    } catch (...) {
+        if (this->base) {
+            syscall::munmap(this->base, this->length);
+        }
+        syscall::close(this->fd);
+        throw;
+    }
+}
+
+Recording::~Recording() noexcept {
+    syscall::munmap(this->base, this->length);
+    syscall::close(this->fd);
+}
+
+const RecordingFormat& Recording::get_format() const {
+    return this->header.format;
+}
+
+uint64_t Recording::size() const {
+    return this->header.num_frames;
+}
+
+void* Recording::frame(const uint64_t index) const {
+    if (index >= this->header.num_frames) {
+        throw std::out_of_range("No such frame.");
+    }
+    return static_cast<uint8_t*>(this->base) + this->entries[index].offset;
+}
+
+FrameInfo Recording::info(const uint64_t index) const {
+    if (index >= this->header.num_frames) {
+        throw std::out_of_range("No such frame.");
+    }
+    const RecordingEntry& entry = this->entries[index];
+    return {entry.sequence, std::chrono::steady_clock::time_point(std::chrono::nanoseconds(entry.timestamp_ns))};
+}
+
+void Recording::advise(const uint64_t index, const uint64_t count) const {
+    const uint64_t size = round_up(this->header.format.sizeimage);
+    const uint64_t num_frames = this->header.num_frames;
+    // errors are ignored, the advice only changes when the pages are read
+    for (uint64_t i = index; i < std::min(index + count, num_frames); i++) {
+        syscall::madvise(this->frame(i), size, MADV_WILLNEED);
+    }
+    const uint64_t end = std::min(index > count ? index - count : 0, num_frames);
+    for (uint64_t i = index > 2 * count ? index - 2 * count : 0; i < end; i++) {
+        syscall::madvise(this->frame(i), size, MADV_DONTNEED);
+        ::posix_fadvise(this->fd, this->entries[i].offset, size, POSIX_FADV_DONTNEED);
+    }
+}
+
+} // namespace tofcam
@@ -0,0 +1,869 @@
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <fcntl.h>
+#include <limits>
+#include <linux/futex.h>
+#include <new>
+#include <share.hpp>
+#include <stdexcept>
+#include <sys/epoll.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/un.h>
+#include <syscall.hpp>
+#include <system_error>
+#include <unistd.h>
+
+namespace tofcam {
+
+namespace {
+
+constexpr uint32_t MAGIC = 0x31666f74;      // "tof1"
+constexpr uint32_t RING_MAGIC = 0x72666f74; // "tofr"
+constexpr uint32_t MAX_SLOTS = 64;
+constexpr size_t RING_ALIGNMENT = 4096;
+
+enum : uint32_t {
+    FRAME = 1,   // server to reader
+    RELEASE = 2, // reader to server
+};
+
+// the first message to a reader, with the fds of the slots
+struct Hello {
+    uint32_t magic;
+    uint32_t num_slots;
+    FrameLayout layout;
+};
+
+struct Message {
+    uint32_t type;
+    uint32_t slot;
+    uint32_t sequence;
+    uint32_t reserved;
+    int64_t timestamp; // ns of CLOCK_MONOTONIC, the same in every process
+};
+
+// the ring of a FramePublisher starts with this header, then the frames are page aligned
+struct alignas(64) RingSlot {
+    std::atomic<uint64_t> version; // odd while the frame is written
+    std::atomic<uint64_t> number;  // of the frame, 1 for the first one
+    std::atomic<int64_t> timestamp;
+    std::atomic<uint32_t> sequence;
+};
+
+struct RingHeader {
+    uint32_t magic;
+    uint32_t num_slots;
+    uint64_t stride; // bytes between two frames
+    FrameLayout layout;
+    alignas(64) std::atomic<uint64_t> published; // frames published, the newest is in slot (published - 1) % num_slots
+    std::atomic<uint32_t> futex;                 // low 32 bits of published, woken by each publish()
+    RingSlot slots[MAX_SLOTS];
+};
+
+static_assert(std::atomic<uint64_t>::is_always_lock_free, "The ring is shared by processes, its atomics can not lock.");
+
+constexpr size_t RING_HEADER_SIZE = (sizeof(RingHeader) + RING_ALIGNMENT - 1) & ~(RING_ALIGNMENT - 1);
+
+size_t ring_stride(const FrameLayout& layout) {
+    return (layout.size + RING_ALIGNMENT - 1) & ~(RING_ALIGNMENT - 1);
+}
+
+sockaddr_un socket_address(const char* path) {
+    struct sockaddr_un addr = {};
+    addr.sun_family = AF_UNIX;
+    if (strlen(path) >= sizeof(addr.sun_path)) {
+        throw std::invalid_argument("The socket path is too long.");
+    }
+    strcpy(addr.sun_path, path);
+    return addr;
+}
+
+// a listening socket at `path`, replacing the one of a server that did not exit cleanly
+int listen_socket(const char* path) {
+    const auto addr = socket_address(path);
+    const int fd = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "socket failed.");
+    }
+    ::unlink(path);
+    if (::bind(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) < 0) {
+        const int e = errno;
+        syscall::close(fd);
+        throw std::system_error(e, std::generic_category(), "bind failed.");
+    }
+    if (::listen(fd, 16) < 0) {
+        const int e = errno;
+        syscall::close(fd);
+        ::unlink(path);
+        throw std::system_error(e, std::generic_category(), "listen failed.");
+    }
+    return fd;
+}
+
+// a new connection, -1 when there is none
+int accept_socket(const int listener) {
+    while (true) {
+        const int fd = ::accept4(listener, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+        if (fd >= 0 || errno == EAGAIN || errno == EWOULDBLOCK) {
+            return fd;
+        }
+        if (errno != EINTR && errno != ECONNABORTED) {
+            throw std::system_error(errno, std::generic_category(), "accept4 failed.");
+        }
+    }
+}
+
+// false when the connection is already gone
+bool send_hello(const int fd, const Hello& hello, const std::vector<int>& fds) {
+    struct iovec iov = {const_cast<Hello*>(&hello), sizeof(hello)};
+    alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int) * MAX_SLOTS)] = {};
+    struct msghdr msg = {};
+    msg.msg_iov = &iov;
+    msg.msg_iovlen = 1;
+    msg.msg_control = control;
+    msg.msg_controllen = CMSG_SPACE(sizeof(int) * fds.size());
+    struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg);
+    cmsg->cmsg_level = SOL_SOCKET;
+    cmsg->cmsg_type = SCM_RIGHTS;
+    cmsg->cmsg_len = CMSG_LEN(sizeof(int) * fds.size());
+    memcpy(CMSG_DATA(cmsg), fds.data(), sizeof(int) * fds.size());
+    return ::sendmsg(fd, &msg, MSG_NOSIGNAL) == sizeof(hello);
+}
+
+// Connects to the server at `path` and receives its hello with the fds, which the caller closes. Blocks until the next
+// dispatch() of the server.
+int connect_socket(const char* path, const uint32_t magic, Hello& hello, std::vector<int>& fds) {
+    const auto addr = socket_address(path);
+    const int fd = ::socket(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0);
+    if (fd < 0) {
+        throw std::system_error(errno, std::generic_category(), "socket failed.");
+    }
+    try {
+        if (::connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) < 0) {
+            throw std::system_error(errno, std::generic_category(), "Failed to connect to the frame server.");
+        }
+        struct iovec iov = {&hello, sizeof(hello)};
+        alignas(struct cmsghdr) char control[CMSG_SPACE(sizeof(int) * MAX_SLOTS)] = {};
+        struct msghdr msg = {};
+        msg.msg_iov = &iov;
+        msg.msg_iovlen = 1;
+        msg.msg_control = control;
+        msg.msg_controllen = sizeof(control);
+        ssize_t r;
+        do {
+            r = ::recvmsg(fd, &msg, MSG_CMSG_CLOEXEC);
+        } while (r < 0 && errno == EINTR);
+        if (r < 0) {
+            throw std::system_error(errno, std::generic_category(), "recvmsg failed.");
+        }
+        for (struct cmsghdr* cmsg = CMSG_FIRSTHDR(&msg); cmsg; cmsg = CMSG_NXTHDR(&msg, cmsg)) {
+            if (cmsg->cmsg_level == SOL_SOCKET && cmsg->cmsg_type == SCM_RIGHTS) {
+                fds.resize((cmsg->cmsg_len - CMSG_LEN(0)) / sizeof(int));
+                memcpy(fds.data(), CMSG_DATA(cmsg), sizeof(int) * fds.size());
+            }
+        }
+        if (r != sizeof(hello) || hello.magic != magic || (msg.msg_flags & MSG_CTRUNC)) {
+            throw std::runtime_error("Unexpected handshake from the frame server.");
+        }
+    } catch (...) {
+        for (const int bfd : fds) {
+            syscall::close(bfd);
+        }
+        fds.clear();
+        syscall::close(fd);
+        throw;
+    }
+    return fd;
+}
+
+// the region of a frame at `base`, nullptr when it is empty
+const void* find_region(
+        const FrameLayout& layout, const void* base, const FrameLayout::Region FrameLayout::*region,
+        const uint32_t element_size) {
+    if (layout.element_size != element_size) {
+        throw std::invalid_argument("The frames are not of this type.");
+    }
+    const FrameLayout::Region& found = layout.*region;
+    return found.size ? static_cast<const uint8_t*>(base) + found.offset : nullptr;
+}
+
+} // namespace
+
+FrameServer::FrameServer(const char* path, const FrameLayout& layout) : layout(layout) {
+    this->listener = listen_socket(path);
+    this->path = path;
+    try {
+        this->epoll = ::epoll_create1(EPOLL_CLOEXEC);
+        if (this->epoll < 0) {
+            throw std::system_error(errno, std::generic_category(), "epoll_create1 failed.");
+        }
+        struct epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = this->listener;
+        if (::epoll_ctl(this->epoll, EPOLL_CTL_ADD, this->listener, &event) < 0) {
+            throw std::system_error(errno, std::generic_category(), "epoll_ctl failed.");
+        }
+    } catch (...) {
+        if (this->epoll >= 0) {
+            syscall::close(this->epoll);
+        }
+        syscall::close(this->listener);
+        ::unlink(path);
+        throw;
+    }
+}
+
+FrameServer::FrameServer(const char* path, const uint32_t num_slots, const FrameLayout& layout)
+    : FrameServer(path, layout) {
+    // the destructor cleans up from here
+    if (num_slots == 0 || num_slots > MAX_SLOTS || layout.size == 0) {
+        throw std::invalid_argument("A frame server needs 1 to 64 slots of a non-empty layout.");
+    }
+    for (uint32_t i = 0; i < num_slots; i++) {
+        const int fd = ::memfd_create("tofcam-frame", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        if (fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "memfd_create failed.");
+        }
+        this->fds.push_back(fd);
+        if (::ftruncate(fd, layout.size) < 0) {
+            throw std::system_error(errno, std::generic_category(), "ftruncate failed.");
+        }
+        void* const addr = syscall::mmap(nullptr, layout.size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+        if (addr == MAP_FAILED) {
+            throw std::system_error(errno, std::generic_category(), "mmap failed.");
+        }
+        this->addresses.push_back(addr);
+        // the readers can not resize the slots (SIGBUS here) nor map them writable, the mapping above stays writable
+        if (::fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_FUTURE_WRITE) < 0 &&
+            ::fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW) < 0) {
+            throw std::system_error(errno, std::generic_category(), "fcntl F_ADD_SEALS failed.");
+        }
+    }
+    this->infos.resize(num_slots);
+    this->references.resize(num_slots);
+    this->writing.resize(num_slots);
+}
+
+FrameServer::FrameServer(const char* path, std::vector<int> fds, const FrameLayout& layout)
+    : FrameServer(path, layout) {
+    this->fds = std::move(fds);
+    if (this->fds.empty() || this->fds.size() > MAX_SLOTS || layout.size == 0) {
+        throw std::invalid_argument("A frame server needs 1 to 64 slots of a non-empty layout.");
+    }
+    this->infos.resize(this->fds.size());
+    this->references.resize(this->fds.size());
+    this->writing.resize(this->fds.size());
+    this->raws.resize(this->fds.size());
+}
+
+FrameServer::~FrameServer() noexcept {
+    for (const Reader& reader : this->readers) {
+        syscall::close(reader.fd);
+    }
+    syscall::close(this->epoll);
+    syscall::close(this->listener);
+    ::unlink(this->path.c_str());
+    for (void* addr : this->addresses) {
+        syscall::munmap(addr, this->layout.size);
+    }
+    for (const int fd : this->fds) {
+        syscall::close(fd);
+    }
+}
+
+std::optional<uint32_t> FrameServer::acquire() {
+    if (!this->raws.empty()) {
+        throw std::runtime_error("Raw frames are published with publish(RawFrame).");
+    }
+    this->dispatch();
+    for (uint32_t i = 0; i < this->fds.size(); i++) {
+        if (!this->writing[i] && this->references[i] == 0) {
+            this->writing[i] = true;
+            return i;
+        }
+    }
+    return std::nullopt;
+}
+
+void* FrameServer::get_address(const uint32_t slot) const {
+    return this->addresses.at(slot);
+}
+
+void FrameServer::publish(const uint32_t slot) {
+    if (slot >= this->writing.size() || !this->writing[slot]) {
+        throw std::invalid_argument("The slot is not acquired.");
+    }
+    this->writing[slot] = false;
+    this->send(slot);
+}
+
+bool FrameServer::publish(RawFrame frame) {
+    const uint32_t slot = frame.index();
+    if (this->raws.empty() || slot >= this->raws.size()) {
+        throw std::invalid_argument("The frame is not one of the exported buffers.");
+    }
+    this->dispatch();
+    // without a queued buffer the driver stops capturing
+    const auto held = std::count_if(this->raws.begin(), this->raws.end(), [](const RawFrame& raw) { return bool(raw); });
+    if (held + 2 > static_cast<ptrdiff_t>(this->raws.size())) {
+        frame.reset();
+        return false;
+    }
+    this->infos[slot] = frame.info();
+    this->send(slot);
+    if (this->references[slot] > 0) {
+        this->raws[slot] = std::move(frame);
+    } else {
+        frame.reset();
+    }
+    return true;
+}
+
+void FrameServer::send(const uint32_t slot) {
+    // the readers that connected meanwhile get this frame too
+    this->dispatch();
+    const FrameInfo& info = this->infos[slot];
+    Message message = {};
+    message.type = FRAME;
+    message.slot = slot;
+    message.sequence = info.sequence;
+    message.timestamp = std::chrono::nanoseconds(info.timestamp.time_since_epoch()).count();
+    for (size_t i = 0; i < this->readers.size();) {
+        Reader& reader = this->readers[i];
+        if (::send(reader.fd, &message, sizeof(message), MSG_DONTWAIT | MSG_NOSIGNAL) == sizeof(message)) {
+            reader.held |= uint64_t(1) << slot;
+            this->references[slot]++;
+        } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+            this->drop(i);
+            continue;
+        }
+        // a full socket: the reader lags behind and misses this frame
+        i++;
+    }
+}
+
+void FrameServer::dispatch() {
+    const Hello hello = {MAGIC, static_cast<uint32_t>(this->fds.size()), this->layout};
+    for (int fd = accept_socket(this->listener); fd >= 0; fd = accept_socket(this->listener)) {
+        struct epoll_event event = {};
+        event.events = EPOLLIN;
+        event.data.fd = fd;
+        // a reader that is already gone is just not added
+        if (!send_hello(fd, hello, this->fds) || ::epoll_ctl(this->epoll, EPOLL_CTL_ADD, fd, &event) < 0) {
+            syscall::close(fd);
+            continue;
+        }
+        this->readers.push_back({fd, 0});
+    }
+    for (size_t i = 0; i < this->readers.size();) {
+        Reader& reader = this->readers[i];
+        bool lost = false;
+        while (true) {
+            Message message = {};
+            const ssize_t r = ::recv(reader.fd, &message, sizeof(message), MSG_DONTWAIT);
+            if (r < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+                break;
+            }
+            if (r < 0 && errno == EINTR) {
+                continue;
+            }
+            // hung up, failed or broke the protocol
+            const uint64_t bit = uint64_t(1) << (message.slot % MAX_SLOTS);
+            if (r != sizeof(message) || message.type != RELEASE || message.slot >= this->fds.size() ||
+                !(reader.held & bit)) {
+                lost = true;
+                break;
+            }
+            reader.held &= ~bit;
+            this->release(message.slot);
+        }
+        if (lost) {
+            this->drop(i);
+        } else {
+            i++;
+        }
+    }
+}
+
+int FrameServer::get_fd() const {
+    return this->epoll;
+}
+
+uint32_t FrameServer::get_num_readers() const {
+    return this->readers.size();
+}
+
+void FrameServer::release(const uint32_t slot) {
+    if (--this->references[slot] == 0 && !this->raws.empty()) {
+        this->raws[slot].reset();
+    }
+}
+
+void FrameServer::drop(const size_t index) {
+    const Reader reader = this->readers[index];
+    this->readers.erase(this->readers.begin() + index);
+    syscall::close(reader.fd);
+    for (uint32_t slot = 0; slot < this->fds.size(); slot++) {
+        if (reader.held & (uint64_t(1) << slot)) {
+            this->release(slot);
+        }
+    }
+}
+
+SharedFrame::SharedFrame(FrameClient* client, const uint32_t slot, const FrameInfo& info)
+    : client(client), index(slot), frame_info(info) {}
+
+SharedFrame::~SharedFrame() noexcept {
+    this->reset();
+}
+
+SharedFrame::SharedFrame(SharedFrame&& other) noexcept
+    : client(std::exchange(other.client, nullptr)), index(other.index), frame_info(other.frame_info) {}
+
+SharedFrame& SharedFrame::operator=(SharedFrame&& other) noexcept {
+    if (this != &other) {
+        this->reset();
+        this->client = std::exchange(other.client, nullptr);
+        this->index = other.index;
+        this->frame_info = other.frame_info;
+    }
+    return *this;
+}
+
+const void* SharedFrame::data() const {
+    return this->client ? this->client->get_address(this->index) : nullptr;
+}
+
+const void* SharedFrame::find(const FrameLayout::Region FrameLayout::*region, const uint32_t element_size) const {
+    return find_region(this->client->get_layout(), this->data(), region, element_size);
+}
+
+template <class T>
+const T* SharedFrame::depth() const {
+    return static_cast<const T*>(this->find(&FrameLayout::depth, sizeof(T)));
+}
+
+template <class T>
+const T* SharedFrame::confidence() const {
+    return static_cast<const T*>(this->find(&FrameLayout::confidence, sizeof(T)));
+}
+
+const uint8_t* SharedFrame::mask() const {
+    return static_cast<const uint8_t*>(this->find(&FrameLayout::mask, this->client->get_layout().element_size));
+}
+
+// the points are int16_t in the frames of uint16_t, both are 2 bytes
+template <class P>
+const P* SharedFrame::points() const {
+    return static_cast<const P*>(this->find(&FrameLayout::points, sizeof(P)));
+}
+
+template const float* SharedFrame::depth<float>() const;
+template const uint16_t* SharedFrame::depth<uint16_t>() const;
+template const float* SharedFrame::confidence<float>() const;
+template const uint16_t* SharedFrame::confidence<uint16_t>() const;
+template const float* SharedFrame::points<float>() const;
+template const int16_t* SharedFrame::points<int16_t>() const;
+
+uint32_t SharedFrame::slot() const {
+    return this->index;
+}
+
+const FrameInfo& SharedFrame::info() const {
+    return this->frame_info;
+}
+
+SharedFrame::operator bool() const {
+    return this->client != nullptr;
+}
+
+void SharedFrame::reset() noexcept {
+    if (this->client) {
+        std::exchange(this->client, nullptr)->release(this->index);
+    }
+}
+
+FrameClient::FrameClient(const char* path) {
+    Hello hello = {};
+    std::vector<int> fds;
+    this->fd = connect_socket(path, MAGIC, hello, fds);
+    this->layout = hello.layout;
+    try {
+        if (fds.size() != hello.num_slots) {
+            throw std::runtime_error("Unexpected handshake from the frame server.");
+        }
+        for (const int bfd : fds) {
+            void* const addr = syscall::mmap(nullptr, this->layout.size, PROT_READ, MAP_SHARED, bfd, 0);
+            if (addr == MAP_FAILED) {
+                throw std::system_error(errno, std::generic_category(), "mmap failed.");
+            }
+            this->addresses.push_back(addr);
+        }
+    } catch (...) {
+        for (void* addr : this->addresses) {
+            syscall::munmap(addr, this->layout.size);
+        }
+        for (const int bfd : fds) {
+            syscall::close(bfd);
+        }
+        syscall::close(this->fd);
+        throw;
+    }
+    // the mappings keep the buffers
+    for (const int bfd : fds) {
+        syscall::close(bfd);
+    }
+}
+
+FrameClient::~FrameClient() noexcept {
+    for (void* addr : this->addresses) {
+        syscall::munmap(addr, this->layout.size);
+    }
+    syscall::close(this->fd);
+}
+
+SharedFrame FrameClient::receive() {
+    while (true) {
+        if (auto frame = this->receive(std::chrono::milliseconds(std::numeric_limits<int>::max()))) {
+            return std::move(frame.value());
+        }
+    }
+}
+
+std::optional<SharedFrame> FrameClient::receive(const std::chrono::milliseconds timeout) {
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (true) {
+        Message message = {};
+        const ssize_t r = ::recv(this->fd, &message, sizeof(message), MSG_DONTWAIT);
+        if (r == sizeof(message) && message.type == FRAME && message.slot < this->addresses.size()) {
+            FrameInfo info = {};
+            info.sequence = message.sequence;
+            info.timestamp = std::chrono::steady_clock::time_point(std::chrono::nanoseconds(message.timestamp));
+            return SharedFrame(this, message.slot, info);
+        }
+        if (r == 0) {
+            throw std::runtime_error("The frame server is gone.");
+        }
+        if (r > 0) {
+            throw std::runtime_error("Unexpected message from the frame server.");
+        }
+        if (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR) {
+            throw std::system_error(errno, std::generic_category(), "recv failed.");
+        }
+        const auto left = std::chrono::ceil<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+        if (left.count() <= 0) {
+            return std::nullopt;
+        }
+        struct pollfd pfd = {};
+        pfd.fd = this->fd;
+        pfd.events = POLLIN;
+        if (syscall::poll(&pfd, 1, std::min<int64_t>(left.count(), std::numeric_limits<int>::max())) < 0 &&
+            errno != EINTR) {
+            throw std::system_error(errno, std::generic_category(), "poll failed.");
+        }
+    }
+}
+
+int FrameClient::get_fd() const {
+    return this->fd;
+}
+
+const FrameLayout& FrameClient::get_layout() const {
+    return this->layout;
+}
+
+uint32_t FrameClient::get_num_slots() const {
+    return this->addresses.size();
+}
+
+const void* FrameClient::get_address(const uint32_t slot) const {
+    return this->addresses.at(slot);
+}
+
+void FrameClient::release(const uint32_t slot) noexcept {
+    Message message = {};
+    message.type = RELEASE;
+    message.slot = slot;
+    ::send(this->fd, &message, sizeof(message), MSG_NOSIGNAL);
+}
+
+FramePublisher::FramePublisher(const char* path, const uint32_t num_slots, const FrameLayout& layout)
+    : num_slots(num_slots), layout(layout), size(RING_HEADER_SIZE + ring_stride(layout) * num_slots) {
+    // the slot after the newest frame is written, the one before it can be read meanwhile
+    if (num_slots < 2 || num_slots > MAX_SLOTS || layout.size == 0) {
+        throw std::invalid_argument("A frame publisher needs 2 to 64 slots of a non-empty layout.");
+    }
+    this->listener = listen_socket(path);
+    this->path = path;
+    try {
+        this->fd = ::memfd_create("tofcam-ring", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+        if (this->fd < 0) {
+            throw std::system_error(errno, std::generic_category(), "memfd_create failed.");
+        }
+        if (::ftruncate(this->fd, this->size) < 0) {
+            throw std::system_error(errno, std::generic_category(), "ftruncate failed.");
+        }
+        void* const addr = syscall::mmap(nullptr, this->size, PROT_READ | PROT_WRITE, MAP_SHARED, this->fd, 0);
+        if (addr == MAP_FAILED) {
+            throw std::system_error(errno, std::generic_category(), "mmap failed.");
+        }
+        this->ring = addr;
+        if (::fcntl(this->fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW | F_SEAL_FUTURE_WRITE) < 0 &&
+            ::fcntl(this->fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW) < 0) {
+            throw std::system_error(errno, std::generic_category(), "fcntl F_ADD_SEALS failed.");
+        }
+        RingHeader* const header = new (this->ring) RingHeader();
+        header->magic = RING_MAGIC;
+        header->num_slots = num_slots;
+        header->stride = ring_stride(layout);
+        header->layout = layout;
+    } catch (...) {
+        if (this->ring) {
+            syscall::munmap(this->ring, this->size);
+        }
+        if (this->fd >= 0) {
+            syscall::close(this->fd);
+        }
+        syscall::close(this->listener);
+        ::unlink(path);
+        throw;
+    }
+}
+
+FramePublisher::~FramePublisher() noexcept {
+    syscall::munmap(this->ring, this->size);
+    syscall::close(this->fd);
+    syscall::close(this->listener);
+    ::unlink(this->path.c_str());
+}
+
+void* FramePublisher::start() {
+    RingHeader* const header = static_cast<RingHeader*>(this->ring);
+    const uint32_t slot = header->published.load(std::memory_order_relaxed) % this->num_slots;
+    if (!this->writing) {
+        // odd: the readers of the frame that was in the slot see that it is overwritten
+        RingSlot& state = header->slots[slot];
+        state.version.store(state.version.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_release);
+        this->writing = true;
+    }
+    return static_cast<uint8_t*>(this->ring) + RING_HEADER_SIZE + header->stride * slot;
+}
+
+void FramePublisher::publish() {
+    if (!this->writing) {
+        throw std::runtime_error("Nothing to publish, begin() was not called.");
+    }
+    RingHeader* const header = static_cast<RingHeader*>(this->ring);
+    const uint64_t number = header->published.load(std::memory_order_relaxed) + 1;
+    RingSlot& state = header->slots[(number - 1) % this->num_slots];
+    state.number.store(number, std::memory_order_relaxed);
+    state.sequence.store(this->info.sequence, std::memory_order_relaxed);
+    state.timestamp.store(
+            std::chrono::nanoseconds(this->info.timestamp.time_since_epoch()).count(), std::memory_order_relaxed);
+    state.version.store(state.version.load(std::memory_order_relaxed) + 1, std::memory_order_release);
+    header->published.store(number, std::memory_order_release);
+    header->futex.store(static_cast<uint32_t>(number), std::memory_order_release);
+    this->writing = false;
+    // a futex in shared memory: FUTEX_WAKE, not the private variant of std::atomic::notify_all()
+    ::syscall(SYS_futex, &header->futex, FUTEX_WAKE, std::numeric_limits<int>::max(), nullptr, nullptr, 0);
+    this->dispatch();
+}
+
+void FramePublisher::dispatch() {
+    const Hello hello = {RING_MAGIC, this->num_slots, this->layout};
+    // the subscribers need nothing else from the socket
+    for (int fd = accept_socket(this->listener); fd >= 0; fd = accept_socket(this->listener)) {
+        send_hello(fd, hello, {this->fd});
+        syscall::close(fd);
+    }
+}
+
+int FramePublisher::get_fd() const {
+    return this->listener;
+}
+
+uint64_t FramePublisher::get_published() const {
+    return static_cast<const RingHeader*>(this->ring)->published.load(std::memory_order_relaxed);
+}
+
+PublishedFrame::PublishedFrame(
+        const FrameSubscriber* subscriber, const uint32_t slot, const uint64_t version, const uint64_t number,
+        const FrameInfo& info)
+    : subscriber(subscriber), slot(slot), version(version), frame_number(number), frame_info(info) {}
+
+const void* PublishedFrame::data() const {
+    return this->subscriber->get_address(this->slot);
+}
+
+template <class T>
+const T* PublishedFrame::depth() const {
+    return static_cast<const T*>(
+            find_region(this->subscriber->get_layout(), this->data(), &FrameLayout::depth, sizeof(T)));
+}
+
+template <class T>
+const T* PublishedFrame::confidence() const {
+    return static_cast<const T*>(
+            find_region(this->subscriber->get_layout(), this->data(), &FrameLayout::confidence, sizeof(T)));
+}
+
+const uint8_t* PublishedFrame::mask() const {
+    const FrameLayout& layout = this->subscriber->get_layout();
+    return static_cast<const uint8_t*>(find_region(layout, this->data(), &FrameLayout::mask, layout.element_size));
+}
+
+template <class P>
+const P* PublishedFrame::points() const {
+    return static_cast<const P*>(
+            find_region(this->subscriber->get_layout(), this->data(), &FrameLayout::points, sizeof(P)));
+}
+
+template const float* PublishedFrame::depth<float>() const;
+template const uint16_t* PublishedFrame::depth<uint16_t>() const;
+template const float* PublishedFrame::confidence<float>() const;
+template const uint16_t* PublishedFrame::confidence<uint16_t>() const;
+template const float* PublishedFrame::points<float>() const;
+template const int16_t* PublishedFrame::points<int16_t>() const;
+
+uint64_t PublishedFrame::number() const {
+    return this->frame_number;
+}
+
+const FrameInfo& PublishedFrame::info() const {
+    return this->frame_info;
+}
+
+bool PublishedFrame::valid() const {
+    // the reads of the frame before the version
+    std::atomic_thread_fence(std::memory_order_acquire);
+    return this->subscriber->get_version(this->slot) == this->version;
+}
+
+FrameSubscriber::FrameSubscriber(const char* path) {
+    Hello hello = {};
+    std::vector<int> fds;
+    syscall::close(connect_socket(path, RING_MAGIC, hello, fds));
+    this->num_slots = hello.num_slots;
+    this->layout = hello.layout;
+    this->size = RING_HEADER_SIZE + ring_stride(this->layout) * this->num_slots;
+    void* addr = MAP_FAILED;
+    if (fds.size() == 1) {
+        addr = syscall::mmap(nullptr, this->size, PROT_READ, MAP_SHARED, fds[0], 0);
+    }
+    const int e = errno;
+    for (const int bfd : fds) {
+        syscall::close(bfd);
+    }
+    if (addr == MAP_FAILED) {
+        throw std::system_error(fds.size() == 1 ? e : EPROTO, std::generic_category(), "Failed to map the frame ring.");
+    }
+    this->ring = addr;
+    const RingHeader* const header = static_cast<const RingHeader*>(this->ring);
+    if (header->magic != RING_MAGIC || header->num_slots != this->num_slots || header->stride != ring_stride(this->layout)) {
+        syscall::munmap(addr, this->size);
+        throw std::runtime_error("Unexpected frame ring.");
+    }
+}
+
+FrameSubscriber::~FrameSubscriber() noexcept {
+    syscall::munmap(const_cast<void*>(this->ring), this->size);
+}
+
+std::optional<PublishedFrame> FrameSubscriber::latest() {
+    const RingHeader* const header = static_cast<const RingHeader*>(this->ring);
+    while (true) {
+        const uint64_t published = header->published.load(std::memory_order_acquire);
+        if (published == 0) {
+            return std::nullopt;
+        }
+        // fails only when the publisher went around the ring meanwhile
+        if (auto frame = this->read(published)) {
+            this->last = published;
+            return frame;
+        }
+    }
+}
+
+std::optional<PublishedFrame> FrameSubscriber::next() {
+    const RingHeader* const header = static_cast<const RingHeader*>(this->ring);
+    while (true) {
+        const uint64_t published = header->published.load(std::memory_order_acquire);
+        if (published <= this->last) {
+            return std::nullopt;
+        }
+        // the slot after the newest frame may be being overwritten
+        const uint64_t oldest = published >= this->num_slots ? published - this->num_slots + 2 : 1;
+        const uint64_t number = std::max(this->last + 1, oldest);
+        if (auto frame = this->read(number)) {
+            this->lost += number - this->last - 1;
+            this->last = number;
+            return frame;
+        }
+    }
+}
+
+bool FrameSubscriber::wait(const std::chrono::milliseconds timeout) const {
+    const RingHeader* const header = static_cast<const RingHeader*>(this->ring);
+    const auto deadline = std::chrono::steady_clock::now() + timeout;
+    while (true) {
+        // read before published, so that a publish() in between changes it and FUTEX_WAIT returns at once
+        const uint32_t value = header->futex.load(std::memory_order_acquire);
+        if (header->published.load(std::memory_order_acquire) > this->last) {
+            return true;
+        }
+        const auto left = std::chrono::ceil<std::chrono::nanoseconds>(deadline - std::chrono::steady_clock::now());
+        if (left.count() <= 0) {
+            return false;
+        }
+        struct timespec ts = {};
+        ts.tv_sec = left.count() / 1000000000;
+        ts.tv_nsec = left.count() % 1000000000;
+        if (::syscall(SYS_futex, &header->futex, FUTEX_WAIT, value, &ts, nullptr, 0) < 0 && errno != EAGAIN &&
+            errno != EINTR && errno != ETIMEDOUT) {
+            throw std::system_error(errno, std::generic_category(), "futex failed.");
+        }
+    }
+}
+
+uint64_t FrameSubscriber::get_lost() const {
+    return this->lost;
+}
+
+const FrameLayout& FrameSubscriber::get_layout() const {
+    return this->layout;
+}
+
+std::optional<PublishedFrame> FrameSubscriber::read(const uint64_t number) const {
+    const RingHeader* const header = static_cast<const RingHeader*>(this->ring);
+    const uint32_t slot = (number - 1) % this->num_slots;
+    const RingSlot& state = header->slots[slot];
+    const uint64_t version = state.version.load(std::memory_order_acquire);
+    if ((version & 1) || state.number.load(std::memory_order_relaxed) != number) {
+        return std::nullopt;
+    }
+    FrameInfo info = {};
+    info.sequence = state.sequence.load(std::memory_order_relaxed);
+    info.timestamp = std::chrono::steady_clock::time_point(
+            std::chrono::nanoseconds(state.timestamp.load(std::memory_order_relaxed)));
+    std::atomic_thread_fence(std::memory_order_acquire);
+    if (state.version.load(std::memory_order_relaxed) != version) {
+        return std::nullopt;
+    }
+    return PublishedFrame(this, slot, version, number, info);
+}
+
+const void* FrameSubscriber::get_address(const uint32_t slot) const {
+    const RingHeader* const header = static_cast<const RingHeader*>(this->ring);
+    return static_cast<const uint8_t*>(this->ring) + RING_HEADER_SIZE + header->stride * slot;
+}
+
+uint64_t FrameSubscriber::get_version(const uint32_t slot) const {
+    return static_cast<const RingHeader*>(this->ring)->slots[slot].version.load(std::memory_order_relaxed);
+}
+
+} // namespace tofcam
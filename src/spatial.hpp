@@ -0,0 +1,140 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <type_traits>
+#include <utility.hpp>
+#include <vector>
+
+// Row pipeline shared by the spatial filter kernels. The rows of the depth map and of the amplitude are converted to
+// float into small rings of rows, padded by replicating the border pixels, so that the per instruction set row kernels
+// read the neighbours of every pixel, border included, with plain unaligned loads. Each input row is converted once per
+// band and the rings stay in L1.
+
+namespace tofcam {
+
+template <class Ops, class V>
+static inline void sort2(V& a, V& b) {
+    const V lo = Ops::min(a, b);
+    b = Ops::max(a, b);
+    a = lo;
+}
+
+// Median of N (odd) values by forgetful selection: the minimum and the maximum of N / 2 + 2 values can not be the
+// median, so both are dropped and the next value is taken in, until three values are left.
+template <class Ops, uint32_t N, class V>
+static inline V median(V (&v)[N]) {
+    static_assert(N % 2 == 1 && N >= 3);
+    uint32_t first = 0;
+    const uint32_t last = N / 2 + 2; // the working set is v[first, last)
+    // fully unrolled so that the indices into v are constants (3x faster for 5x5)
+#pragma GCC unroll 32
+    for (uint32_t next = last; next < N; next++) {
+#pragma GCC unroll 32
+        for (uint32_t i = first + 1; i < last; i++) {
+            sort2<Ops>(v[first], v[i]);
+        }
+#pragma GCC unroll 32
+        for (uint32_t i = first + 1; i < last - 1; i++) {
+            sort2<Ops>(v[i], v[last - 1]);
+        }
+        first++;
+        v[last - 1] = v[next];
+    }
+    sort2<Ops>(v[first], v[first + 1]);
+    sort2<Ops>(v[first + 1], v[first + 2]);
+    return Ops::max(v[first], v[first + 1]);
+}
+
+// Filters the rows [begin, end) of dst with Kernel, which provides
+//   lanes: the number of pixels per step, the kernels may read and write up to a whole step beyond width
+//   flying_median(out, rows, width, filter): flying pixel rejection and median of the row rows[2], rows[0, 5) being
+//     the rows from 2 above to 2 below it
+//   smooth(out, depth, amplitude, width, filter): the smoothing of the row depth[1] (amplitude may be null)
+template <class Kernel, class T>
+void filter_spatial_rows(
+        T* dst, const T* depth, const T* confidence, const uint32_t width, const uint32_t height, const uint32_t begin,
+        const uint32_t end, const SpatialFilter& filter) {
+    if (begin >= end) {
+        return;
+    }
+    constexpr uint32_t PAD = 2;
+    const uint32_t stride = (width + Kernel::lanes - 1) / Kernel::lanes * Kernel::lanes + PAD * 2 + Kernel::lanes;
+    const uint32_t radius = filter.median == 5 ? 2 : 1;
+    const bool smoothing = filter.smoothing > 0.0f;
+    const bool weighted = smoothing && confidence;
+    // 5 rows of depth, 3 rows of the first stage and of the amplitude, 1 output row
+    thread_local std::vector<float> scratch;
+    scratch.resize(stride * 12);
+    float* const raw = scratch.data();
+    float* const staged = raw + stride * 5;
+    float* const amplitude = staged + stride * 3;
+    float* const out = amplitude + stride * 3;
+
+    const auto clamp_row = [&](const int64_t y) { return uint32_t(std::clamp<int64_t>(y, 0, height - 1)); };
+    const auto pad = [&](float* row) {
+        std::fill(row, row + PAD, row[PAD]);
+        std::fill(row + PAD + width, row + stride, row[PAD + width - 1]);
+    };
+    const auto load = [&](float* row, const T* src) {
+        for (uint32_t x = 0; x < width; x++) {
+            row[PAD + x] = src[x];
+        }
+        pad(row);
+    };
+    const auto store = [&](const uint32_t y, const float* row) {
+        for (uint32_t x = 0; x < width; x++) {
+            if constexpr (std::is_same_v<T, uint16_t>) {
+                dst[size_t(y) * width + x] = std::clamp(std::nearbyint(row[x]), 0.0f, 65535.0f);
+            } else {
+                dst[size_t(y) * width + x] = row[x];
+            }
+        }
+    };
+
+    // the rows of depth up to next_raw, of the first stage and of the amplitude up to next_staged are in the rings
+    const uint32_t first = smoothing ? clamp_row(int64_t(begin) - 1) : begin;
+    uint32_t next_raw = clamp_row(int64_t(first) - radius);
+    uint32_t next_staged = first;
+    // the first stage of row y into `row`
+    const auto stage = [&](const uint32_t y, float* row) {
+        for (; next_raw <= std::min(y + radius, height - 1); next_raw++) {
+            load(raw + next_raw % 5 * stride, depth + size_t(next_raw) * width);
+        }
+        const float* rows[5];
+        for (int64_t i = 0; i < 5; i++) {
+            const int64_t dy = std::clamp<int64_t>(i - 2, -int64_t(radius), radius);
+            rows[i] = raw + clamp_row(int64_t(y) + dy) % 5 * stride + PAD;
+        }
+        Kernel::flying_median(row, rows, width, filter);
+    };
+    for (uint32_t y = begin; y < end; y++) {
+        if (!smoothing) {
+            stage(y, out);
+            store(y, out);
+            continue;
+        }
+        for (; next_staged <= std::min(y + 1, height - 1); next_staged++) {
+            float* row = staged + next_staged % 3 * stride;
+            stage(next_staged, row + PAD);
+            pad(row);
+            if (weighted) {
+                load(amplitude + next_staged % 3 * stride, confidence + size_t(next_staged) * width);
+            }
+        }
+        const float* rows[3];
+        const float* amplitudes[3] = {};
+        for (int64_t i = 0; i < 3; i++) {
+            const uint32_t slot = clamp_row(int64_t(y) + i - 1) % 3;
+            rows[i] = staged + slot * stride + PAD;
+            if (weighted) {
+                amplitudes[i] = amplitude + slot * stride + PAD;
+            }
+        }
+        Kernel::smooth(out, rows, weighted ? amplitudes : nullptr, width, filter);
+        store(y, out);
+    }
+}
+
+} // namespace tofcam
@@ -10,7 +10,7 @@ int ioctl(int fd, int request, void* arg) {
     int r;
     do {
         r = ::ioctl(fd, request, arg);
-    } while (r == -1 && (errno == EINTR || errno == EAGAIN));
+    } while (r == -1 && errno == EINTR);
     return r;
 }
 
@@ -30,4 +30,12 @@ int munmap(void* addr, size_t length) {
     return ::munmap(addr, length);
 }
 
+int madvise(void* addr, size_t length, int advice) {
+    return ::madvise(addr, length, advice);
+}
+
+int poll(struct pollfd* fds, nfds_t nfds, int timeout) {
+    return ::poll(fds, nfds, timeout);
+}
+
 } // namespace tofcam::syscall
@@ -0,0 +1,108 @@
+#include <algorithm>
+#include <bit>
+#include <telemetry.hpp>
+#include <utility>
+
+namespace tofcam {
+
+uint32_t Histogram::bucket_of(const uint64_t value) {
+    // values below 2^SUB_BITS have a bucket each, then 2^SUB_BITS buckets per power of two
+    if (value < (1u << SUB_BITS)) {
+        return value;
+    }
+    const uint32_t msb = std::min<uint32_t>(63 - std::countl_zero(value), MAX_BITS);
+    if (msb == MAX_BITS) {
+        return NUM_BUCKETS - 1;
+    }
+    const uint32_t sub = (value >> (msb - SUB_BITS)) & ((1u << SUB_BITS) - 1);
+    return ((msb - SUB_BITS + 1) << SUB_BITS) + sub;
+}
+
+uint64_t Histogram::upper_bound(const uint32_t bucket) {
+    if (bucket < (1u << SUB_BITS)) {
+        return bucket;
+    }
+    const uint32_t msb = (bucket >> SUB_BITS) + SUB_BITS - 1;
+    const uint64_t sub = bucket & ((1u << SUB_BITS) - 1);
+    return (((1ull << SUB_BITS) + sub + 1) << (msb - SUB_BITS)) - 1;
+}
+
+void Histogram::record(const std::chrono::nanoseconds value) {
+    const uint64_t ns = std::max<int64_t>(value.count(), 0);
+    this->buckets[bucket_of(ns)].fetch_add(1, std::memory_order_relaxed);
+    this->total.fetch_add(1, std::memory_order_relaxed);
+    this->sum.fetch_add(ns, std::memory_order_relaxed);
+    uint64_t maximum = this->maximum.load(std::memory_order_relaxed);
+    while (ns > maximum && !this->maximum.compare_exchange_weak(maximum, ns, std::memory_order_relaxed)) {
+    }
+}
+
+uint64_t Histogram::count() const {
+    return this->total.load(std::memory_order_relaxed);
+}
+
+std::chrono::nanoseconds Histogram::mean() const {
+    const uint64_t count = this->count();
+    return std::chrono::nanoseconds(count ? this->sum.load(std::memory_order_relaxed) / count : 0);
+}
+
+std::chrono::nanoseconds Histogram::max() const {
+    return std::chrono::nanoseconds(this->maximum.load(std::memory_order_relaxed));
+}
+
+std::chrono::nanoseconds Histogram::percentile(const double quantile) const {
+    // the buckets are summed rather than `total`, which may be ahead of them
+    uint64_t count = 0;
+    for (const auto& bucket : this->buckets) {
+        count += bucket.load(std::memory_order_relaxed);
+    }
+    if (count == 0) {
+        return std::chrono::nanoseconds(0);
+    }
+    const uint64_t rank = std::max<uint64_t>(1, std::min<double>(quantile, 1.0) * count + 0.5);
+    uint64_t seen = 0;
+    for (uint32_t i = 0; i < NUM_BUCKETS; i++) {
+        seen += this->buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank) {
+            // the last bucket is unbounded
+            return i == NUM_BUCKETS - 1 ? this->max() : std::min(std::chrono::nanoseconds(upper_bound(i)), this->max());
+        }
+    }
+    return this->max();
+}
+
+void Histogram::reset() {
+    for (auto& bucket : this->buckets) {
+        bucket.store(0, std::memory_order_relaxed);
+    }
+    this->total.store(0, std::memory_order_relaxed);
+    this->sum.store(0, std::memory_order_relaxed);
+    this->maximum.store(0, std::memory_order_relaxed);
+}
+
+void Telemetry::reset() {
+    this->frames.store(0, std::memory_order_relaxed);
+    this->dropped.store(0, std::memory_order_relaxed);
+    this->resyncs.store(0, std::memory_order_relaxed);
+    this->discarded.store(0, std::memory_order_relaxed);
+    for (Histogram* histogram : {&this->wait, &this->kernel, &this->sync, &this->queue, &this->convert}) {
+        histogram->reset();
+    }
+}
+
+void Telemetry::dump(FILE* fp) const {
+    fprintf(fp, "frames: %lu, dropped: %lu, resyncs: %lu, discarded: %lu\n", this->frames.load(std::memory_order_relaxed),
+            this->dropped.load(std::memory_order_relaxed), this->resyncs.load(std::memory_order_relaxed),
+            this->discarded.load(std::memory_order_relaxed));
+    const std::pair<const char*, const Histogram*> histograms[] = {
+            {"wait", &this->wait}, {"kernel", &this->kernel}, {"sync", &this->sync}, {"queue", &this->queue},
+            {"convert", &this->convert}};
+    for (const auto& [name, histogram] : histograms) {
+        const auto us = [](const std::chrono::nanoseconds ns) { return ns.count() / 1000.0; };
+        fprintf(fp, "%-8s n=%-8lu mean %9.1fus  p50 %9.1fus  p99 %9.1fus  p99.9 %9.1fus  max %9.1fus\n", name,
+                histogram->count(), us(histogram->mean()), us(histogram->percentile(0.5)), us(histogram->percentile(0.99)),
+                us(histogram->percentile(0.999)), us(histogram->max()));
+    }
+}
+
+} // namespace tofcam
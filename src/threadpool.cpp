@@ -0,0 +1,103 @@
+#include <pthread.h>
+#include <realtime.hpp>
+#include <sched.h>
+#include <stdexcept>
+#include <system_error>
+#include <threadpool.hpp>
+
+namespace tofcam {
+
+static std::vector<int> allowed_cpus() {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    if (sched_getaffinity(0, sizeof(set), &set) < 0) {
+        throw std::system_error(errno, std::generic_category(), "sched_getaffinity failed.");
+    }
+    std::vector<int> cpus;
+    for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+        if (CPU_ISSET(cpu, &set)) {
+            cpus.push_back(cpu);
+        }
+    }
+    return cpus;
+}
+
+ThreadPool::ThreadPool(const uint32_t num_threads, const std::vector<int>& cpus, const int priority) {
+    if (num_threads == 0) {
+        throw std::invalid_argument("The number of threads must be positive.");
+    }
+    const bool use_allowed = cpus.empty();
+    const std::vector<int> pins = use_allowed ? allowed_cpus() : cpus;
+    this->workers.reserve(num_threads - 1);
+    try {
+        for (uint32_t i = 0; i < num_threads - 1; i++) {
+            this->workers.emplace_back(&ThreadPool::worker_loop, this);
+            set_thread_realtime(
+                    this->workers.back().native_handle(), pins[(use_allowed ? i + 1 : i) % pins.size()], priority);
+        }
+    } catch (...) {
+        this->shutdown();
+        throw;
+    }
+}
+
+ThreadPool::~ThreadPool() noexcept {
+    this->shutdown();
+}
+
+void ThreadPool::shutdown() noexcept {
+    this->stopping = true;
+    this->generation.fetch_add(1, std::memory_order_release);
+    this->generation.notify_all();
+    for (auto& worker : this->workers) {
+        worker.join();
+    }
+    this->workers.clear();
+}
+
+uint32_t ThreadPool::size() const {
+    return this->workers.size() + 1;
+}
+
+void ThreadPool::dispatch(const uint32_t num_tasks, void* task, Trampoline trampoline) {
+    this->task = task;
+    this->trampoline = trampoline;
+    this->num_tasks = num_tasks;
+    this->next.store(0, std::memory_order_relaxed);
+    if (this->workers.empty() || num_tasks <= 1) {
+        this->drain();
+        return;
+    }
+    this->running.store(this->workers.size(), std::memory_order_relaxed);
+    this->generation.fetch_add(1, std::memory_order_release);
+    this->generation.notify_all();
+    this->drain();
+    for (uint32_t running = this->running.load(std::memory_order_acquire); running != 0;
+         running = this->running.load(std::memory_order_acquire)) {
+        this->running.wait(running, std::memory_order_acquire);
+    }
+}
+
+void ThreadPool::drain() {
+    for (uint32_t i = this->next.fetch_add(1, std::memory_order_relaxed); i < this->num_tasks;
+         i = this->next.fetch_add(1, std::memory_order_relaxed)) {
+        this->trampoline(this->task, i);
+    }
+}
+
+void ThreadPool::worker_loop() {
+    uint32_t seen = 0;
+    while (true) {
+        this->generation.wait(seen, std::memory_order_acquire);
+        seen = this->generation.load(std::memory_order_acquire);
+        if (this->stopping) {
+            return;
+        }
+        this->drain();
+        if (this->running.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            this->running.notify_one();
+        }
+    }
+}
+
+} // namespace tofcam
@@ -1,14 +1,21 @@
 #include "utility.hpp"
+#include "atan2.hpp"
+#include "spatial.hpp"
+#include <algorithm>
 #include <cassert>
 #include <cmath>
 #include <cstdio>
-#include <numbers>
-
-// #define NEON_APPROX_DIV
+#include <stdexcept>
+#include <threadpool.hpp>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
 
 namespace tofcam {
 
-void unpack_y12p(int16_t* dst, const void* src, const uint32_t width, const uint32_t height, const uint32_t bytesperline) {
+void unpack_y12p_scalar(
+        int16_t* dst, const void* src, const uint32_t width, const uint32_t height, const uint32_t bytesperline) {
     const uint32_t num_pairs = width / 2;
     for (uint32_t y = 0; y < height; y++) {
         const uint8_t* line = static_cast<const uint8_t*>(src) + y * bytesperline;
@@ -21,14 +28,32 @@ void unpack_y12p(int16_t* dst, const void* src, const uint32_t width, const uint
             dst[y * width + x * 2 + 0] = (int16_t)(p0 << 5) >> 5;
             dst[y * width + x * 2 + 1] = (int16_t)(p1 << 5) >> 5;
         }
+        if (width % 2) {
+            const uint16_t p0 = (line[num_pairs * 3 + 0] << 4) | (line[num_pairs * 3 + 2] & 0x0F);
+            dst[y * width + width - 1] = (int16_t)(p0 << 5) >> 5;
+        }
+    }
+}
+
+// atan(t) / pi for t in [0, 1]
+template <Atan2 accuracy>
+static inline float approx_atan(const float t) {
+    if constexpr (accuracy == Atan2::Poly3 || accuracy == Atan2::Poly5) {
+        constexpr auto& c = atan_poly<accuracy>();
+        constexpr int N = std::size(c);
+        float a = c[N - 1];
+        for (int i = N - 2; i >= 0; i--) {
+            a = a * t + c[i];
+        }
+        return a * t;
+    } else {
+        return t * (0.25f + ATAN_R - ATAN_R * t);
     }
 }
 
+// in units of pi
+template <Atan2 accuracy>
 static inline float approx_atan2(const int16_t y, const int16_t x) {
-    constexpr float PI = std::numbers::pi_v<float>;
-    constexpr float HPI = std::numbers::pi_v<float> / 2;
-    constexpr float QPI = std::numbers::pi_v<float> / 4;
-    constexpr float R = 0.273f;
     if (x == 0 && y == 0)
         return 0.0f;
     const int16_t ax = std::abs(int(x));
@@ -37,23 +62,45 @@ static inline float approx_atan2(const int16_t y, const int16_t x) {
     const int16_t amax = swap ? ay : ax;
     const int16_t amin = swap ? ax : ay;
     const float t = float(amin) / float(amax);
-    const float a = t * (QPI + R - R * t);
-    float theta = swap ? (HPI - a) : a;
+    const float a = approx_atan<accuracy>(t);
+    float theta = swap ? (0.5f - a) : a;
     if (x < 0)
-        theta = PI - theta;
+        theta = 1.0f - theta;
     if (y < 0)
         theta = -theta;
     return theta;
 }
 
-template <bool EnableConfidence, Rotation rotation>
-void compute_depth_confidence(
-        float* depth, float* confidence, const int16_t* frame0, const int16_t* frame1, const int16_t* frame2,
-        const int16_t* frame3, const uint32_t num_pixels, const float modfreq_hz) {
+template <class T>
+static inline T to_output(const float value) {
+    if constexpr (std::is_same_v<T, uint16_t>) {
+        return std::clamp(std::nearbyint(value), 0.0f, 65535.0f);
+    } else if constexpr (std::is_same_v<T, int16_t>) {
+        return std::clamp(std::nearbyint(value), -32768.0f, 32767.0f);
+    } else {
+        return value;
+    }
+}
+
+// `threshold` from mask byte `offset` on
+static Threshold at_mask_byte(const Threshold& threshold, const size_t offset) {
+    return {threshold.amplitude, threshold.mask ? threshold.mask + offset : nullptr};
+}
+
+// `threshold` from row `row` on of a depth map `width` pixels wide
+static Threshold at_mask_row(const Threshold& threshold, const uint32_t width, const uint32_t row) {
+    return at_mask_byte(threshold, size_t(width + 7) / 8 * row);
+}
+
+template <bool EnableConfidence, Rotation rotation, Atan2 accuracy, class T>
+void compute_depth_confidence_scalar(
+        T* depth, T* confidence, const int16_t* frame0, const int16_t* frame1, const int16_t* frame2, const int16_t* frame3,
+        const uint32_t num_pixels, const float modfreq_hz, const Threshold& threshold) {
     static constexpr float C = 3e8;
     const float range = C / (2.0f * modfreq_hz) * 1000.0f;
     const float bias = 0.5f * range;
-    const float scale = bias * std::numbers::inv_pi_v<float>;
+    const float scale = bias;
+    const bool thresholded = threshold.amplitude > 0.0f || threshold.mask;
 
     for (uint32_t i = 0; i < num_pixels; i++) {
         const int16_t I0 = frame0[i];
@@ -62,8 +109,12 @@ void compute_depth_confidence(
         const int16_t I3 = frame3[i];
         const int16_t sin = I3 - I1;
         const int16_t cos = I0 - I2;
+        float amplitude = 0.0f;
+        if (EnableConfidence || thresholded) {
+            amplitude = std::sqrt(float(cos) * cos + float(sin) * sin) * 8.0f;
+        }
         if constexpr (EnableConfidence) {
-            confidence[i] = std::sqrt(float(cos) * cos + float(sin) * sin) * 8.0f;
+            confidence[i] = to_output<T>(amplitude);
         }
         int16_t y, x;
         if constexpr (rotation == Rotation::Zero) {
@@ -79,204 +130,816 @@ void compute_depth_confidence(
             y = -cos;
             x = sin;
         }
-#if 0
-        const float phase = std::atan2(y, x);
-#else
-        const float phase = approx_atan2(y, x);
+        const float phase = approx_atan2<accuracy>(y, x);
+        // a zero amplitude is invalid whatever the threshold, as in the unwrapped and SIMD kernels
+        const bool valid = !thresholded || (amplitude > 0.0f && amplitude >= threshold.amplitude);
+        depth[i] = to_output<T>((!valid || phase >= 1.0f || ((y == 0) && (x == 0))) ? 0.0f : phase * scale + bias);
+        if (threshold.mask) {
+            threshold.mask[i / 8] = (i % 8 ? threshold.mask[i / 8] : 0) | (valid << (i % 8));
+        }
+    }
+}
+
+template <bool EnableConfidence, Rotation rotation, Atan2 accuracy, class T>
+void compute_depth_confidence_from_y12p_scalar(
+        T* depth, T* confidence, const void* frame0, const void* frame1, const void* frame2, const void* frame3,
+        const uint32_t width, const uint32_t height, const uint32_t bytesperline, const float modfreq_hz,
+        const Threshold& threshold) {
+    // unpack one line at a time so that the int16 planes stay in L1
+    thread_local std::vector<int16_t> lines;
+    lines.resize(width * 4);
+    int16_t* line0 = lines.data() + width * 0;
+    int16_t* line1 = lines.data() + width * 1;
+    int16_t* line2 = lines.data() + width * 2;
+    int16_t* line3 = lines.data() + width * 3;
+    for (uint32_t y = 0; y < height; y++) {
+        unpack_y12p_scalar(line0, static_cast<const uint8_t*>(frame0) + y * bytesperline, width, 1, bytesperline);
+        unpack_y12p_scalar(line1, static_cast<const uint8_t*>(frame1) + y * bytesperline, width, 1, bytesperline);
+        unpack_y12p_scalar(line2, static_cast<const uint8_t*>(frame2) + y * bytesperline, width, 1, bytesperline);
+        unpack_y12p_scalar(line3, static_cast<const uint8_t*>(frame3) + y * bytesperline, width, 1, bytesperline);
+        compute_depth_confidence_scalar<EnableConfidence, rotation, accuracy>(
+                depth + y * width, confidence + y * width, line0, line1, line2, line3, width, modfreq_hz,
+                at_mask_row(threshold, width, y));
+    }
+}
+
+template <bool EnableConfidence, Rotation rotation, Atan2 accuracy, class T>
+void compute_unwrapped_depth_confidence_from_y12p_scalar(
+        T* depth, T* confidence, const void* const fine[4], const void* const coarse[4], const uint32_t width,
+        const uint32_t height, const uint32_t bytesperline, const float fine_modfreq_hz, const float coarse_modfreq_hz,
+        const Threshold& threshold) {
+    static constexpr float C = 3e8;
+    const float range = C / (2.0f * fine_modfreq_hz) * 1000.0f;
+    const float inv_range = 1.0f / range;
+    const float num_wraps = std::round(fine_modfreq_hz / coarse_modfreq_hz);
+    // the eight unpacked lines, then the depth and amplitude of the line at both frequencies
+    thread_local std::vector<int16_t> lines;
+    thread_local std::vector<float> buffer;
+    lines.resize(width * 8);
+    buffer.resize(width * 4);
+    int16_t* line[8];
+    for (uint32_t i = 0; i < 8; i++) {
+        line[i] = lines.data() + width * i;
+    }
+    float* fine_depth = buffer.data() + width * 0;
+    float* fine_amplitude = buffer.data() + width * 1;
+    float* coarse_depth = buffer.data() + width * 2;
+    float* coarse_amplitude = buffer.data() + width * 3;
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t i = 0; i < 4; i++) {
+            unpack_y12p_scalar(line[i], static_cast<const uint8_t*>(fine[i]) + y * bytesperline, width, 1, bytesperline);
+            unpack_y12p_scalar(
+                    line[i + 4], static_cast<const uint8_t*>(coarse[i]) + y * bytesperline, width, 1, bytesperline);
+        }
+        // the amplitudes are needed for the validity even without confidence
+        compute_depth_confidence_scalar<true, rotation, accuracy>(
+                fine_depth, fine_amplitude, line[0], line[1], line[2], line[3], width, fine_modfreq_hz);
+        compute_depth_confidence_scalar<true, rotation, accuracy>(
+                coarse_depth, coarse_amplitude, line[4], line[5], line[6], line[7], width, coarse_modfreq_hz);
+        uint8_t* mask = threshold.mask ? threshold.mask + (width + 7) / 8 * y : nullptr;
+        for (uint32_t x = 0; x < width; x++) {
+            const float amplitude = std::min(fine_amplitude[x], coarse_amplitude[x]);
+            // modulo the number of wraps, see unwrap_f32x4 in utility_neon.cpp
+            float wraps = std::nearbyint((coarse_depth[x] - fine_depth[x]) * inv_range);
+            wraps = wraps < 0.0f ? wraps + num_wraps : wraps;
+            wraps = wraps >= num_wraps ? wraps - num_wraps : wraps;
+            const bool valid = amplitude > 0.0f && amplitude >= threshold.amplitude;
+            depth[y * width + x] = to_output<T>(valid ? fine_depth[x] + wraps * range : 0.0f);
+            if constexpr (EnableConfidence) {
+                confidence[y * width + x] = to_output<T>(amplitude);
+            }
+            if (mask) {
+                mask[x / 8] = (x % 8 ? mask[x / 8] : 0) | (valid << (x % 8));
+            }
+        }
+    }
+}
+
+template <bool EnableConfidence, Rotation rotation, Atan2 accuracy, class T>
+void compute_binned_depth_confidence_from_y12p_scalar(
+        T* depth, T* confidence, const void* frame0, const void* frame1, const void* frame2, const void* frame3,
+        const uint32_t width, const uint32_t height, const uint32_t bytesperline, const float modfreq_hz,
+        const Threshold& threshold) {
+    const void* frames[4] = {frame0, frame1, frame2, frame3};
+    const uint32_t binned_width = width / 2;
+    // the four binned phases, then the depth and amplitude of the binned line
+    thread_local std::vector<int16_t> lines;
+    thread_local std::vector<float> buffer;
+    lines.resize(binned_width * 4);
+    buffer.resize(binned_width * 2);
+    int16_t* binned[4];
+    for (uint32_t i = 0; i < 4; i++) {
+        binned[i] = lines.data() + binned_width * i;
+    }
+    float* d = buffer.data();
+    float* c = buffer.data() + binned_width;
+    const auto unpack_pair = [](const uint8_t* b) {
+        const uint16_t p0 = (b[0] << 4) | (b[2] & 0x0F);
+        const uint16_t p1 = (b[1] << 4) | (b[2] >> 4);
+        return ((int16_t)(p0 << 5) >> 5) + ((int16_t)(p1 << 5) >> 5);
+    };
+    for (uint32_t y = 0; y < height / 2; y++) {
+        for (uint32_t i = 0; i < 4; i++) {
+            const uint8_t* upper = static_cast<const uint8_t*>(frames[i]) + y * 2 * bytesperline;
+            const uint8_t* lower = upper + bytesperline;
+            // the sums of four 11-bit samples, and their differences in the kernel, fit in int16
+            for (uint32_t x = 0; x < binned_width; x++) {
+                binned[i][x] = unpack_pair(upper + x * 3) + unpack_pair(lower + x * 3);
+            }
+        }
+        // the amplitude of the sum is four times that of a pixel, the confidence is scaled back to the mean
+        compute_depth_confidence_scalar<EnableConfidence, rotation, accuracy>(
+                d, c, binned[0], binned[1], binned[2], binned[3], binned_width, modfreq_hz,
+                {threshold.amplitude * 4.0f, at_mask_row(threshold, binned_width, y).mask});
+        for (uint32_t x = 0; x < binned_width; x++) {
+            depth[y * binned_width + x] = to_output<T>(d[x]);
+            if constexpr (EnableConfidence) {
+                confidence[y * binned_width + x] = to_output<T>(c[x] * 0.25f);
+            }
+        }
+    }
+}
+
+template <class T, class P>
+void compute_xyz_scalar(P* xyz, const T* depth, const float* rays, const uint32_t num_pixels) {
+    for (uint32_t i = 0; i < num_pixels; i++) {
+        const float d = depth[i];
+        xyz[i * 3 + 0] = to_output<P>(d * rays[i * 3 + 0]);
+        xyz[i * 3 + 1] = to_output<P>(d * rays[i * 3 + 1]);
+        xyz[i * 3 + 2] = to_output<P>(d * rays[i * 3 + 2]);
+    }
+}
+
+template <class T>
+void compute_temporal_filter_scalar(
+        T* depth, const T* confidence, float* history, float* history_amplitude, const uint32_t num_pixels,
+        const TemporalFilter& filter) {
+    for (uint32_t i = 0; i < num_pixels; i++) {
+        const float d = depth[i];
+        const float h = history[i];
+        bool restart = d == 0.0f || h == 0.0f || std::fabs(d - h) > filter.depth_jump;
+        if (confidence) {
+            const float a = confidence[i];
+            restart |= std::fabs(a - history_amplitude[i]) > filter.amplitude_jump * history_amplitude[i];
+            history_amplitude[i] = a;
+        }
+        history[i] = restart ? d : h + filter.alpha * (d - h);
+        depth[i] = to_output<T>(history[i]);
+    }
+}
+
+// row kernels of filter_spatial_rows
+struct SpatialScalar {
+    static constexpr uint32_t lanes = 1;
+
+    static float min(const float a, const float b) {
+        return std::min(a, b);
+    }
+
+    static float max(const float a, const float b) {
+        return std::max(a, b);
+    }
+
+    template <int R>
+    static float median_x1(const float* const rows[5], const uint32_t x) {
+        float v[(R * 2 + 1) * (R * 2 + 1)];
+        uint32_t i = 0;
+        for (ptrdiff_t dy = -R; dy <= R; dy++) {
+            for (ptrdiff_t dx = -R; dx <= R; dx++) {
+                v[i++] = rows[2 + dy][x + dx];
+            }
+        }
+        return median<SpatialScalar>(v);
+    }
+
+    static void flying_median(float* out, const float* const rows[5], const uint32_t width, const SpatialFilter& filter) {
+        for (uint32_t x = 0; x < width; x++) {
+            const float c = rows[2][x];
+            const auto far = [&](const float n) { return std::fabs(c - n) > filter.flying_pixel; };
+            const bool flying = filter.flying_pixel > 0.0f && ((far(rows[2][ptrdiff_t(x) - 1]) && far(rows[2][x + 1])) ||
+                                                               (far(rows[1][x]) && far(rows[3][x])));
+            const float result = filter.median == 3 ? median_x1<1>(rows, x)
+                                 : filter.median == 5 ? median_x1<2>(rows, x)
+                                                      : c;
+            out[x] = c == 0.0f || flying ? 0.0f : result;
+        }
+    }
+
+    static void smooth(
+            float* out, const float* const depth[3], const float* const amplitude[3], const uint32_t width,
+            const SpatialFilter& filter) {
+        for (uint32_t x = 0; x < width; x++) {
+            const float c = depth[1][x];
+            float sum = 0.0f;
+            float weights = 0.0f;
+            for (uint32_t dy = 0; dy < 3; dy++) {
+                for (ptrdiff_t dx = -1; dx <= 1; dx++) {
+                    const float n = depth[dy][x + dx];
+                    const float a = amplitude ? amplitude[dy][x + dx] : 1.0f;
+                    const float w = n != 0.0f && std::fabs(n - c) <= filter.smoothing ? a * a : 0.0f;
+                    sum += w * n;
+                    weights += w;
+                }
+            }
+            out[x] = c == 0.0f ? 0.0f : weights > 0.0f ? sum / weights : c;
+        }
+    }
+};
+
+template <class T>
+void compute_spatial_filter_scalar(
+        T* dst, const T* depth, const T* confidence, const uint32_t width, const uint32_t height, const uint32_t begin,
+        const uint32_t end, const SpatialFilter& filter) {
+    filter_spatial_rows<SpatialScalar>(dst, depth, confidence, width, height, begin, end, filter);
+}
+
+void unpack_y12p(int16_t* dst, const void* src, const uint32_t width, const uint32_t height, const uint32_t bytesperline) {
+    switch (get_isa()) {
+#if defined(__aarch64__)
+    case Isa::NEON:
+        return unpack_y12p_neon(dst, src, width, height, bytesperline);
 #endif
-        depth[i] = (phase >= std::numbers::pi_v<float> || ((y == 0) && (x == 0))) ? 0.0f : phase * scale + bias;
-    }
-}
-
-template void compute_depth_confidence<true, Rotation::Zero>(
-        float*, float*, const int16_t*, const int16_t*, const int16_t*, const int16_t*, const uint32_t, const float);
-template void compute_depth_confidence<true, Rotation::Quarter>(
-        float*, float*, const int16_t*, const int16_t*, const int16_t*, const int16_t*, const uint32_t, const float);
-template void compute_depth_confidence<true, Rotation::Half>(
-        float*, float*, const int16_t*, const int16_t*, const int16_t*, const int16_t*, const uint32_t, const float);
-template void compute_depth_confidence<true, Rotation::ThreeQuarters>(
-        float*, float*, const int16_t*, const int16_t*, const int16_t*, const int16_t*, const uint32_t, const float);
-template void compute_depth_confidence<false, Rotation::Zero>(
-        float*, float*, const int16_t*, const int16_t*, const int16_t*, const int16_t*, const uint32_t, const float);
-template void compute_depth_confidence<false, Rotation::Quarter>(
-        float*, float*, const int16_t*, const int16_t*, const int16_t*, const int16_t*, const uint32_t, const float);
-template void compute_depth_confidence<false, Rotation::Half>(
-        float*, float*, const int16_t*, const int16_t*, const int16_t*, const int16_t*, const uint32_t, const float);
-template void compute_depth_confidence<false, Rotation::ThreeQuarters>(
-        float*, float*, const int16_t*, const int16_t*, const int16_t*, const int16_t*, const uint32_t, const float);
-
-#if defined(__ARM_NEON)
-
-static inline void unpack_y12p_s16x8x2(const uint8x8x3_t& b, int16x8_t& p0, int16x8_t& p1) {
-    // p0 = (b0 << 4) | (b2 & 0x0F);
-    uint8x8_t b2lo = vand_u8(b.val[2], vdup_n_u8(0x0F));
-    uint16x8_t p0u = vorrq_u16(vshll_n_u8(b.val[0], 4), vmovl_u8(b2lo));
-    // p1 = (b1 << 4) | (b2 >> 4);
-    uint8x8_t b2hi = vshr_n_u8(b.val[2], 4);
-    uint16x8_t p1u = vorrq_u16(vshll_n_u8(b.val[1], 4), vmovl_u8(b2hi));
-    // sign extension
-    p0 = vshrq_n_s16(vshlq_n_s16(vreinterpretq_s16_u16(p0u), 5), 5);
-    p1 = vshrq_n_s16(vshlq_n_s16(vreinterpretq_s16_u16(p1u), 5), 5);
-}
-
-static inline void approx_atan2x8(const int16x8_t& y, const int16x8_t& x, float32x4_t& thetalo, float32x4_t& thetahi) {
-    const float32x4_t vPI = vdupq_n_f32(1.0f);
-    const float32x4_t vHalfPI = vdupq_n_f32(0.5f);
-    const float32x4_t vQuadPI = vdupq_n_f32(0.25f);
-    const float32x4_t vR = vdupq_n_f32(0.273 * std::numbers::inv_pi_v<float>);
-    const float32x4_t vT = vaddq_f32(vQuadPI, vR);
-    const int16x8_t vZ = vdupq_n_s16(0);
-
-    const int16x8_t ay = vabsq_s16(y);
-    const int16x8_t ax = vabsq_s16(x);
-
-    const uint16x8_t swap = vcgtq_s16(ay, ax);
-    const int16x8_t amax = vbslq_s16(swap, ay, ax);
-    const int16x8_t amin = vbslq_s16(swap, ax, ay);
-
-    const float32x4_t amaxlo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(amax)));
-    const float32x4_t amaxhi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(amax)));
-    const float32x4_t aminlo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(amin)));
-    const float32x4_t aminhi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(amin)));
-
-#if defined(NEON_APPROX_DIV)
-    float32x4_t rlo = vrecpeq_f32(amaxlo);
-    rlo = vmulq_f32(vrecpsq_f32(amaxlo, rlo), rlo);
-    float32x4_t rhi = vrecpeq_f32(amaxhi);
-    rhi = vmulq_f32(vrecpsq_f32(amaxhi, rhi), rhi);
-    const float32x4_t tlo = vmulq_f32(aminlo, rlo);
-    const float32x4_t thi = vmulq_f32(aminhi, rhi);
-#else
-    const float32x4_t tlo = vdivq_f32(aminlo, amaxlo);
-    const float32x4_t thi = vdivq_f32(aminhi, amaxhi);
+#if defined(__x86_64__)
+    case Isa::AVX512:
+        return unpack_y12p_avx512(dst, src, width, height, bytesperline);
+    case Isa::AVX2:
+        return unpack_y12p_avx2(dst, src, width, height, bytesperline);
 #endif
+    default:
+        return unpack_y12p_scalar(dst, src, width, height, bytesperline);
+    }
+}
 
-    const float32x4_t alo = vmulq_f32(tlo, vfmsq_f32(vT, vR, tlo));
-    const float32x4_t ahi = vmulq_f32(thi, vfmsq_f32(vT, vR, thi));
-
-    const uint32x4_t swaplo = vmovl_u16(vget_low_u16(swap));
-    const uint32x4_t swaphi = vmovl_u16(vget_high_u16(swap));
-    thetalo = vbslq_f32(vcgtq_u32(swaplo, vdupq_n_u32(0)), vsubq_f32(vHalfPI, alo), alo);
-    thetahi = vbslq_f32(vcgtq_u32(swaphi, vdupq_n_u32(0)), vsubq_f32(vHalfPI, ahi), ahi);
-
-    const uint16x8_t xneg = vcltq_s16(x, vZ);
-    const uint32x4_t xneglo = vmovl_u16(vget_low_u16(xneg));
-    const uint32x4_t xneghi = vmovl_u16(vget_high_u16(xneg));
-    thetalo = vbslq_f32(vcgtq_u32(xneglo, vdupq_n_u32(0)), vsubq_f32(vPI, thetalo), thetalo);
-    thetahi = vbslq_f32(vcgtq_u32(xneghi, vdupq_n_u32(0)), vsubq_f32(vPI, thetahi), thetahi);
-
-    const uint16x8_t yneg = vcltq_s16(y, vZ);
-    const uint32x4_t yneglo = vmovl_u16(vget_low_u16(yneg));
-    const uint32x4_t yneghi = vmovl_u16(vget_high_u16(yneg));
-    thetalo = vbslq_f32(vcgtq_u32(yneglo, vdupq_n_u32(0)), vnegq_f32(thetalo), thetalo);
-    thetahi = vbslq_f32(vcgtq_u32(yneghi, vdupq_n_u32(0)), vnegq_f32(thetahi), thetahi);
-
-    const uint16x8_t xzero = vceqq_s16(x, vZ);
-    const uint16x8_t yzero = vceqq_s16(y, vZ);
-    const uint16x8_t bzero = vandq_u16(xzero, yzero);
-    const uint32x4_t bzerolo = vmovl_u16(vget_low_u16(bzero));
-    const uint32x4_t bzerohi = vmovl_u16(vget_high_u16(bzero));
-    thetalo = vbslq_f32(vorrq_u32(vcgtq_u32(bzerolo, vdupq_n_u32(0)), vcgeq_f32(thetalo, vPI)), vnegq_f32(vPI), thetalo);
-    thetahi = vbslq_f32(vorrq_u32(vcgtq_u32(bzerohi, vdupq_n_u32(0)), vcgeq_f32(thetahi, vPI)), vnegq_f32(vPI), thetahi);
-}
-
-template <bool EnableConfidence, Rotation rotation>
-void compute_depth_confidence_from_y12p_neon(
-        float* depth, float* confidence, const void* frame0, const void* frame1, const void* frame2, const void* frame3,
-        const uint32_t width, const uint32_t height, const uint32_t bytesperline, const float modfreq_hz) {
-    static constexpr float C = 3e8;
-    const float range = C / (2.0f * modfreq_hz) * 1000.0f;
-    const float bias = 0.5f * range;
-    const float scale = bias;
-    const float32x4_t vBias = vdupq_n_f32(bias);
-    const float32x4_t vScale = vdupq_n_f32(scale);
-    const float32x4_t vConfScale = vdupq_n_f32(8.0f);
+template <bool EnableConfidence, Rotation rotation, Atan2 accuracy, class T>
+void compute_depth_confidence(
+        T* depth, T* confidence, const int16_t* frame0, const int16_t* frame1, const int16_t* frame2, const int16_t* frame3,
+        const uint32_t num_pixels, const float modfreq_hz, const Threshold& threshold) {
+    switch (get_isa()) {
+#if defined(__aarch64__)
+    case Isa::NEON:
+        return compute_depth_confidence_neon<EnableConfidence, rotation, accuracy>(
+                depth, confidence, frame0, frame1, frame2, frame3, num_pixels, modfreq_hz, threshold);
+#endif
+#if defined(__x86_64__)
+    case Isa::AVX512:
+        return compute_depth_confidence_avx512<EnableConfidence, rotation, accuracy>(
+                depth, confidence, frame0, frame1, frame2, frame3, num_pixels, modfreq_hz, threshold);
+    case Isa::AVX2:
+        return compute_depth_confidence_avx2<EnableConfidence, rotation, accuracy>(
+                depth, confidence, frame0, frame1, frame2, frame3, num_pixels, modfreq_hz, threshold);
+#endif
+    default:
+        return compute_depth_confidence_scalar<EnableConfidence, rotation, accuracy>(
+                depth, confidence, frame0, frame1, frame2, frame3, num_pixels, modfreq_hz, threshold);
+    }
+}
+
+template <bool EnableConfidence, Rotation rotation, Atan2 accuracy, class T>
+void compute_depth_confidence_from_y12p(
+        T* depth, T* confidence, const void* frame0, const void* frame1, const void* frame2, const void* frame3,
+        const uint32_t width, const uint32_t height, const uint32_t bytesperline, const float modfreq_hz,
+        const Threshold& threshold) {
+    switch (get_isa()) {
+#if defined(__aarch64__)
+    case Isa::NEON:
+        return compute_depth_confidence_from_y12p_neon<EnableConfidence, rotation, accuracy>(
+                depth, confidence, frame0, frame1, frame2, frame3, width, height, bytesperline, modfreq_hz, threshold);
+#endif
+#if defined(__x86_64__)
+    case Isa::AVX512:
+        return compute_depth_confidence_from_y12p_avx512<EnableConfidence, rotation, accuracy>(
+                depth, confidence, frame0, frame1, frame2, frame3, width, height, bytesperline, modfreq_hz, threshold);
+    case Isa::AVX2:
+        return compute_depth_confidence_from_y12p_avx2<EnableConfidence, rotation, accuracy>(
+                depth, confidence, frame0, frame1, frame2, frame3, width, height, bytesperline, modfreq_hz, threshold);
+#endif
+    default:
+        return compute_depth_confidence_from_y12p_scalar<EnableConfidence, rotation, accuracy>(
+                depth, confidence, frame0, frame1, frame2, frame3, width, height, bytesperline, modfreq_hz, threshold);
+    }
+}
 
+template <bool EnableConfidence, Rotation rotation, Atan2 accuracy, class T>
+void compute_unwrapped_depth_confidence_from_y12p(
+        T* depth, T* confidence, const void* const fine[4], const void* const coarse[4], const uint32_t width,
+        const uint32_t height, const uint32_t bytesperline, const float fine_modfreq_hz, const float coarse_modfreq_hz,
+        const Threshold& threshold) {
+    if (!(fine_modfreq_hz > coarse_modfreq_hz && coarse_modfreq_hz > 0.0f)) {
+        throw std::invalid_argument("The fine modulation frequency must be higher than the coarse one.");
+    }
+    switch (get_isa()) {
+#if defined(__aarch64__)
+    case Isa::NEON:
+        return compute_unwrapped_depth_confidence_from_y12p_neon<EnableConfidence, rotation, accuracy>(
+                depth, confidence, fine, coarse, width, height, bytesperline, fine_modfreq_hz, coarse_modfreq_hz, threshold);
+#endif
+#if defined(__x86_64__)
+    case Isa::AVX512:
+        return compute_unwrapped_depth_confidence_from_y12p_avx512<EnableConfidence, rotation, accuracy>(
+                depth, confidence, fine, coarse, width, height, bytesperline, fine_modfreq_hz, coarse_modfreq_hz, threshold);
+    case Isa::AVX2:
+        return compute_unwrapped_depth_confidence_from_y12p_avx2<EnableConfidence, rotation, accuracy>(
+                depth, confidence, fine, coarse, width, height, bytesperline, fine_modfreq_hz, coarse_modfreq_hz, threshold);
+#endif
+    default:
+        return compute_unwrapped_depth_confidence_from_y12p_scalar<EnableConfidence, rotation, accuracy>(
+                depth, confidence, fine, coarse, width, height, bytesperline, fine_modfreq_hz, coarse_modfreq_hz, threshold);
+    }
+}
+
+template <bool EnableConfidence, Rotation rotation, Atan2 accuracy, class T>
+void compute_binned_depth_confidence_from_y12p(
+        T* depth, T* confidence, const void* frame0, const void* frame1, const void* frame2, const void* frame3,
+        const uint32_t width, const uint32_t height, const uint32_t bytesperline, const float modfreq_hz,
+        const Threshold& threshold) {
+    switch (get_isa()) {
+#if defined(__aarch64__)
+    case Isa::NEON:
+        return compute_binned_depth_confidence_from_y12p_neon<EnableConfidence, rotation, accuracy>(
+                depth, confidence, frame0, frame1, frame2, frame3, width, height, bytesperline, modfreq_hz, threshold);
+#endif
+#if defined(__x86_64__)
+    case Isa::AVX512:
+        return compute_binned_depth_confidence_from_y12p_avx512<EnableConfidence, rotation, accuracy>(
+                depth, confidence, frame0, frame1, frame2, frame3, width, height, bytesperline, modfreq_hz, threshold);
+    case Isa::AVX2:
+        return compute_binned_depth_confidence_from_y12p_avx2<EnableConfidence, rotation, accuracy>(
+                depth, confidence, frame0, frame1, frame2, frame3, width, height, bytesperline, modfreq_hz, threshold);
+#endif
+    default:
+        return compute_binned_depth_confidence_from_y12p_scalar<EnableConfidence, rotation, accuracy>(
+                depth, confidence, frame0, frame1, frame2, frame3, width, height, bytesperline, modfreq_hz, threshold);
+    }
+}
+
+template <class T, class P>
+void compute_xyz(P* xyz, const T* depth, const float* rays, const uint32_t num_pixels) {
+    switch (get_isa()) {
+#if defined(__aarch64__)
+    case Isa::NEON:
+        return compute_xyz_neon(xyz, depth, rays, num_pixels);
+#endif
+#if defined(__x86_64__)
+    case Isa::AVX512:
+        return compute_xyz_avx512(xyz, depth, rays, num_pixels);
+    case Isa::AVX2:
+        return compute_xyz_avx2(xyz, depth, rays, num_pixels);
+#endif
+    default:
+        return compute_xyz_scalar(xyz, depth, rays, num_pixels);
+    }
+}
+
+template <class T>
+void compute_temporal_filter(
+        T* depth, const T* confidence, float* history, float* history_amplitude, const uint32_t num_pixels,
+        const TemporalFilter& filter) {
+    switch (get_isa()) {
+#if defined(__aarch64__)
+    case Isa::NEON:
+        return compute_temporal_filter_neon(depth, confidence, history, history_amplitude, num_pixels, filter);
+#endif
+#if defined(__x86_64__)
+    case Isa::AVX512:
+        return compute_temporal_filter_avx512(depth, confidence, history, history_amplitude, num_pixels, filter);
+    case Isa::AVX2:
+        return compute_temporal_filter_avx2(depth, confidence, history, history_amplitude, num_pixels, filter);
+#endif
+    default:
+        return compute_temporal_filter_scalar(depth, confidence, history, history_amplitude, num_pixels, filter);
+    }
+}
+
+template <class T>
+void compute_spatial_filter(
+        T* dst, const T* depth, const T* confidence, const uint32_t width, const uint32_t height, const uint32_t begin,
+        const uint32_t end, const SpatialFilter& filter) {
+    if (filter.median != 0 && filter.median != 3 && filter.median != 5) {
+        throw std::invalid_argument("The median must be 3 (3x3), 5 (5x5) or 0.");
+    }
+    if (end > height || begin > end) {
+        throw std::invalid_argument("The rows must be within the depth map.");
+    }
+    switch (get_isa()) {
+#if defined(__aarch64__)
+    case Isa::NEON:
+        return compute_spatial_filter_neon(dst, depth, confidence, width, height, begin, end, filter);
+#endif
+#if defined(__x86_64__)
+    case Isa::AVX512:
+        return compute_spatial_filter_avx512(dst, depth, confidence, width, height, begin, end, filter);
+    case Isa::AVX2:
+        return compute_spatial_filter_avx2(dst, depth, confidence, width, height, begin, end, filter);
+#endif
+    default:
+        return compute_spatial_filter_scalar(dst, depth, confidence, width, height, begin, end, filter);
+    }
+}
+
+template <class T>
+void compute_spatial_filter(
+        T* dst, const T* depth, const T* confidence, const uint32_t width, const uint32_t height,
+        const SpatialFilter& filter) {
+    compute_spatial_filter(dst, depth, confidence, width, height, 0, height, filter);
+}
+
+// inverts the distortion of the normalized image point (x, y) by fixed point iteration, as cv::undistortPoints does
+static std::pair<double, double> undistort(const Intrinsics& in, const double x0, const double y0) {
+    double x = x0;
+    double y = y0;
+    for (int i = 0; i < 20; i++) {
+        const double r2 = x * x + y * y;
+        const double radial = 1.0 + ((in.k3 * r2 + in.k2) * r2 + in.k1) * r2;
+        const double dx = 2.0 * in.p1 * x * y + in.p2 * (r2 + 2.0 * x * x);
+        const double dy = in.p1 * (r2 + 2.0 * y * y) + 2.0 * in.p2 * x * y;
+        x = (x0 - dx) / radial;
+        y = (y0 - dy) / radial;
+    }
+    return {x, y};
+}
+
+void compute_rays(float* rays, const Intrinsics& intrinsics, const Roi& roi, const bool binning) {
+    if (!(intrinsics.fx > 0.0f && intrinsics.fy > 0.0f)) {
+        throw std::invalid_argument("The focal lengths must be positive.");
+    }
+    const uint32_t factor = binning ? 2 : 1;
+    const uint32_t width = roi.width / factor;
+    const uint32_t height = roi.height / factor;
+    const bool distorted = intrinsics.k1 != 0.0f || intrinsics.k2 != 0.0f || intrinsics.p1 != 0.0f ||
+                           intrinsics.p2 != 0.0f || intrinsics.k3 != 0.0f;
     for (uint32_t y = 0; y < height; y++) {
-        const uint8_t* line0 = static_cast<const uint8_t*>(frame0) + y * bytesperline;
-        const uint8_t* line1 = static_cast<const uint8_t*>(frame1) + y * bytesperline;
-        const uint8_t* line2 = static_cast<const uint8_t*>(frame2) + y * bytesperline;
-        const uint8_t* line3 = static_cast<const uint8_t*>(frame3) + y * bytesperline;
-
-        for (uint32_t x = 0; x < width; x += 16) {
-            const uint32_t offset = x / 2 * 3;
-            const uint8x8x3_t b0 = vld3_u8(line0 + offset);
-            const uint8x8x3_t b2 = vld3_u8(line2 + offset);
-            const uint8x8x3_t b3 = vld3_u8(line3 + offset);
-            const uint8x8x3_t b1 = vld3_u8(line1 + offset);
-            int16x8_t p0[2], p1[2], p2[2], p3[2];
-            unpack_y12p_s16x8x2(b0, p0[0], p0[1]);
-            unpack_y12p_s16x8x2(b1, p1[0], p1[1]);
-            unpack_y12p_s16x8x2(b2, p2[0], p2[1]);
-            unpack_y12p_s16x8x2(b3, p3[0], p3[1]);
-            float32x4x2_t depthlo;
-            float32x4x2_t depthhi;
-            float32x4x2_t amplo;
-            float32x4x2_t amphi;
-            for (uint32_t i = 0; i < 2; i++) {
-                const int16x8_t cos = vsubq_s16(p0[i], p2[i]);
-                const int16x8_t sin = vsubq_s16(p3[i], p1[i]);
-                int16x8_t vy, vx;
-                if constexpr (rotation == Rotation::Zero) {
-                    vy = sin;
-                    vx = cos;
-                } else if constexpr (rotation == Rotation::Quarter) {
-                    vy = cos;
-                    vx = vnegq_s16(sin);
-                } else if constexpr (rotation == Rotation::Half) {
-                    vy = vnegq_s16(sin);
-                    vx = vnegq_s16(cos);
-                } else {
-                    vy = vnegq_s16(cos);
-                    vx = sin;
+        for (uint32_t x = 0; x < width; x++) {
+            // the centre of a 2x2 block lies between its four pixels
+            const double u = roi.x + x * factor + (factor - 1) * 0.5;
+            const double v = roi.y + y * factor + (factor - 1) * 0.5;
+            double xn = (u - intrinsics.cx) / intrinsics.fx;
+            double yn = (v - intrinsics.cy) / intrinsics.fy;
+            if (distorted) {
+                std::tie(xn, yn) = undistort(intrinsics, xn, yn);
+            }
+            const double norm = 1.0 / std::sqrt(xn * xn + yn * yn + 1.0);
+            float* ray = rays + (size_t(y) * width + x) * 3;
+            ray[0] = xn * norm;
+            ray[1] = yn * norm;
+            ray[2] = norm;
+        }
+    }
+}
+
+static void check_roi(const Roi& roi, const uint32_t width, const uint32_t height) {
+    if (roi.x > width || roi.width > width - roi.x || roi.y > height || roi.height > height - roi.y) {
+        throw std::invalid_argument("The ROI must lie within the frame.");
+    }
+}
+
+// Unpacks `width` pixels of a line from pixel x on. An odd x starts in the middle of a Y12P pixel pair,
+// so the pair is unpacked whole into dst (width + 1 pixels) and the returned pointer skips its first pixel.
+static const int16_t* unpack_y12p_line(int16_t* dst, const void* line, const uint32_t x, const uint32_t width) {
+    unpack_y12p(dst, static_cast<const uint8_t*>(line) + x / 2 * 3, x % 2 + width, 1, 0);
+    return dst + x % 2;
+}
+
+template <bool EnableConfidence, Rotation rotation, Atan2 accuracy, class T>
+void compute_depth_confidence_from_y12p(
+        T* depth, T* confidence, const void* frame0, const void* frame1, const void* frame2, const void* frame3,
+        const uint32_t width, const uint32_t height, const uint32_t bytesperline, const float modfreq_hz, const Roi& roi,
+        const Threshold& threshold) {
+    check_roi(roi, width, height);
+    const void* frames[4] = {frame0, frame1, frame2, frame3};
+    const uint8_t* lines[4];
+    for (uint32_t i = 0; i < 4; i++) {
+        lines[i] = static_cast<const uint8_t*>(frames[i]) + roi.y * bytesperline;
+    }
+    if (roi.x % 2 == 0) {
+        const uint32_t offset = roi.x / 2 * 3;
+        return compute_depth_confidence_from_y12p<EnableConfidence, rotation, accuracy>(
+                depth, confidence, lines[0] + offset, lines[1] + offset, lines[2] + offset, lines[3] + offset, roi.width,
+                roi.height, bytesperline, modfreq_hz, threshold);
+    }
+    thread_local std::vector<int16_t> buffer;
+    buffer.resize((roi.width + 1) * 4);
+    for (uint32_t y = 0; y < roi.height; y++) {
+        const int16_t* unpacked[4];
+        for (uint32_t i = 0; i < 4; i++) {
+            unpacked[i] = unpack_y12p_line(buffer.data() + (roi.width + 1) * i, lines[i] + y * bytesperline, roi.x, roi.width);
+        }
+        compute_depth_confidence<EnableConfidence, rotation, accuracy>(
+                depth + y * roi.width, confidence + y * roi.width, unpacked[0], unpacked[1], unpacked[2], unpacked[3],
+                roi.width, modfreq_hz, at_mask_row(threshold, roi.width, y));
+    }
+}
+
+template <bool EnableConfidence, Rotation rotation, Atan2 accuracy, class T>
+void compute_binned_depth_confidence_from_y12p(
+        T* depth, T* confidence, const void* frame0, const void* frame1, const void* frame2, const void* frame3,
+        const uint32_t width, const uint32_t height, const uint32_t bytesperline, const float modfreq_hz, const Roi& roi,
+        const Threshold& threshold) {
+    check_roi(roi, width, height);
+    const void* frames[4] = {frame0, frame1, frame2, frame3};
+    if (roi.x % 2 == 0) {
+        const uint32_t offset = roi.y * bytesperline + roi.x / 2 * 3;
+        return compute_binned_depth_confidence_from_y12p<EnableConfidence, rotation, accuracy>(
+                depth, confidence, static_cast<const uint8_t*>(frame0) + offset,
+                static_cast<const uint8_t*>(frame1) + offset, static_cast<const uint8_t*>(frame2) + offset,
+                static_cast<const uint8_t*>(frame3) + offset, roi.width, roi.height, bytesperline, modfreq_hz, threshold);
+    }
+    const uint32_t binned_width = roi.width / 2;
+    const uint32_t binned_height = roi.height / 2;
+    // an odd roi.x splits the Y12P pairs, the lines are unpacked one by one
+    // two unpacked lines per phase, the binned phases, then the float depth and confidence of the binned line
+    thread_local std::vector<int16_t> lines;
+    thread_local std::vector<float> buffer;
+    lines.resize((roi.width + 1) * 8 + binned_width * 4);
+    buffer.resize(std::is_same_v<T, float> ? 0 : binned_width * 2);
+    int16_t* binned[4];
+    for (uint32_t i = 0; i < 4; i++) {
+        binned[i] = lines.data() + (roi.width + 1) * 8 + binned_width * i;
+    }
+    for (uint32_t y = 0; y < binned_height; y++) {
+        const Threshold binned_threshold = {threshold.amplitude * 4.0f, at_mask_row(threshold, binned_width, y).mask};
+        for (uint32_t i = 0; i < 4; i++) {
+            const uint8_t* line = static_cast<const uint8_t*>(frames[i]) + (roi.y + y * 2) * bytesperline;
+            const int16_t* upper = unpack_y12p_line(lines.data() + (roi.width + 1) * (i * 2), line, roi.x, roi.width);
+            const int16_t* lower =
+                    unpack_y12p_line(lines.data() + (roi.width + 1) * (i * 2 + 1), line + bytesperline, roi.x, roi.width);
+            // the sums of four 11-bit samples, and their differences in the kernel, fit in int16
+            for (uint32_t x = 0; x < binned_width; x++) {
+                binned[i][x] = upper[x * 2] + upper[x * 2 + 1] + lower[x * 2] + lower[x * 2 + 1];
+            }
+        }
+        // the amplitude of the sum is four times that of a pixel, the confidence is scaled back to the mean
+        if constexpr (std::is_same_v<T, float>) {
+            compute_depth_confidence<EnableConfidence, rotation, accuracy>(
+                    depth + y * binned_width, confidence + y * binned_width, binned[0], binned[1], binned[2], binned[3],
+                    binned_width, modfreq_hz, binned_threshold);
+            if constexpr (EnableConfidence) {
+                for (uint32_t x = 0; x < binned_width; x++) {
+                    confidence[y * binned_width + x] *= 0.25f;
                 }
-                approx_atan2x8(vy, vx, depthlo.val[i], depthhi.val[i]);
-                depthlo.val[i] = vfmaq_f32(vBias, depthlo.val[i], vScale);
-                depthhi.val[i] = vfmaq_f32(vBias, depthhi.val[i], vScale);
+            }
+        } else {
+            float* d = buffer.data();
+            float* c = buffer.data() + binned_width;
+            compute_depth_confidence<EnableConfidence, rotation, accuracy>(
+                    d, c, binned[0], binned[1], binned[2], binned[3], binned_width, modfreq_hz, binned_threshold);
+            for (uint32_t x = 0; x < binned_width; x++) {
+                depth[y * binned_width + x] = to_output<T>(d[x]);
                 if constexpr (EnableConfidence) {
-                    const float32x4_t xlo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(vx)));
-                    const float32x4_t xhi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(vx)));
-                    const float32x4_t ylo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(vy)));
-                    const float32x4_t yhi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(vy)));
-                    amplo.val[i] = vmulq_f32(vsqrtq_f32(vaddq_f32(vmulq_f32(xlo, xlo), vmulq_f32(ylo, ylo))), vConfScale);
-                    amphi.val[i] = vmulq_f32(vsqrtq_f32(vaddq_f32(vmulq_f32(xhi, xhi), vmulq_f32(yhi, yhi))), vConfScale);
+                    confidence[y * binned_width + x] = to_output<T>(c[x] * 0.25f);
                 }
             }
-            vst2q_f32(depth + y * width + x + 0, depthlo);
-            vst2q_f32(depth + y * width + x + 8, depthhi);
-            if constexpr (EnableConfidence) {
-                vst2q_f32(confidence + y * width + x + 0, amplo);
-                vst2q_f32(confidence + y * width + x + 8, amphi);
-            }
         }
     }
 }
 
-template void compute_depth_confidence_from_y12p_neon<true, Rotation::Zero>(
-        float*, float*, const void*, const void*, const void*, const void*, const uint32_t, const uint32_t, const uint32_t,
-        const float);
-template void compute_depth_confidence_from_y12p_neon<true, Rotation::Quarter>(
-        float*, float*, const void*, const void*, const void*, const void*, const uint32_t, const uint32_t, const uint32_t,
-        const float);
-template void compute_depth_confidence_from_y12p_neon<true, Rotation::Half>(
-        float*, float*, const void*, const void*, const void*, const void*, const uint32_t, const uint32_t, const uint32_t,
-        const float);
-template void compute_depth_confidence_from_y12p_neon<true, Rotation::ThreeQuarters>(
-        float*, float*, const void*, const void*, const void*, const void*, const uint32_t, const uint32_t, const uint32_t,
-        const float);
-template void compute_depth_confidence_from_y12p_neon<false, Rotation::Zero>(
-        float*, float*, const void*, const void*, const void*, const void*, const uint32_t, const uint32_t, const uint32_t,
-        const float);
-template void compute_depth_confidence_from_y12p_neon<false, Rotation::Quarter>(
-        float*, float*, const void*, const void*, const void*, const void*, const uint32_t, const uint32_t, const uint32_t,
-        const float);
-template void compute_depth_confidence_from_y12p_neon<false, Rotation::Half>(
-        float*, float*, const void*, const void*, const void*, const void*, const uint32_t, const uint32_t, const uint32_t,
-        const float);
-template void compute_depth_confidence_from_y12p_neon<false, Rotation::ThreeQuarters>(
-        float*, float*, const void*, const void*, const void*, const void*, const uint32_t, const uint32_t, const uint32_t,
-        const float);
+// a few bands per thread so that a preempted core does not hold back the whole frame
+static uint32_t num_bands(const ThreadPool& pool, const uint32_t rows) {
+    return std::max(1u, std::min(rows, pool.size() * 4));
+}
 
-#endif
+template <bool EnableConfidence, Rotation rotation, Atan2 accuracy, class T>
+void compute_depth_confidence(
+        T* depth, T* confidence, const int16_t* frame0, const int16_t* frame1, const int16_t* frame2, const int16_t* frame3,
+        const uint32_t num_pixels, const float modfreq_hz, ThreadPool& pool, const Threshold& threshold) {
+    // bands are 64 pixel aligned so that every band takes the same vector path as a single threaded call
+    const uint32_t num_blocks = (num_pixels + 63) / 64;
+    const uint32_t bands = num_bands(pool, num_blocks);
+    pool.run(bands, [&](const uint32_t band) {
+        const uint32_t begin = std::min(num_pixels, num_blocks * band / bands * 64);
+        const uint32_t end = std::min(num_pixels, num_blocks * (band + 1) / bands * 64);
+        compute_depth_confidence<EnableConfidence, rotation, accuracy>(
+                depth + begin, confidence + begin, frame0 + begin, frame1 + begin, frame2 + begin, frame3 + begin, end - begin,
+                modfreq_hz, at_mask_byte(threshold, begin / 8));
+    });
+}
+
+template <bool EnableConfidence, Rotation rotation, Atan2 accuracy, class T>
+void compute_depth_confidence_from_y12p(
+        T* depth, T* confidence, const void* frame0, const void* frame1, const void* frame2, const void* frame3,
+        const uint32_t width, const uint32_t height, const uint32_t bytesperline, const float modfreq_hz, ThreadPool& pool,
+        const Threshold& threshold) {
+    const uint32_t bands = num_bands(pool, height);
+    pool.run(bands, [&](const uint32_t band) {
+        const uint32_t begin = height * band / bands;
+        const uint32_t end = height * (band + 1) / bands;
+        const uint32_t offset = begin * bytesperline;
+        compute_depth_confidence_from_y12p<EnableConfidence, rotation, accuracy>(
+                depth + begin * width, confidence + begin * width, static_cast<const uint8_t*>(frame0) + offset,
+                static_cast<const uint8_t*>(frame1) + offset, static_cast<const uint8_t*>(frame2) + offset,
+                static_cast<const uint8_t*>(frame3) + offset, width, end - begin, bytesperline, modfreq_hz,
+                at_mask_row(threshold, width, begin));
+    });
+}
+
+template <bool EnableConfidence, Rotation rotation, Atan2 accuracy, class T>
+void compute_unwrapped_depth_confidence_from_y12p(
+        T* depth, T* confidence, const void* const fine[4], const void* const coarse[4], const uint32_t width,
+        const uint32_t height, const uint32_t bytesperline, const float fine_modfreq_hz, const float coarse_modfreq_hz,
+        ThreadPool& pool, const Threshold& threshold) {
+    if (!(fine_modfreq_hz > coarse_modfreq_hz && coarse_modfreq_hz > 0.0f)) {
+        throw std::invalid_argument("The fine modulation frequency must be higher than the coarse one.");
+    }
+    const uint32_t bands = num_bands(pool, height);
+    pool.run(bands, [&](const uint32_t band) {
+        const uint32_t begin = height * band / bands;
+        const uint32_t end = height * (band + 1) / bands;
+        const void* fine_band[4];
+        const void* coarse_band[4];
+        for (uint32_t i = 0; i < 4; i++) {
+            fine_band[i] = static_cast<const uint8_t*>(fine[i]) + begin * bytesperline;
+            coarse_band[i] = static_cast<const uint8_t*>(coarse[i]) + begin * bytesperline;
+        }
+        compute_unwrapped_depth_confidence_from_y12p<EnableConfidence, rotation, accuracy>(
+                depth + begin * width, confidence + begin * width, fine_band, coarse_band, width, end - begin, bytesperline,
+                fine_modfreq_hz, coarse_modfreq_hz, at_mask_row(threshold, width, begin));
+    });
+}
+
+template <bool EnableConfidence, Rotation rotation, Atan2 accuracy, class T>
+void compute_depth_confidence_from_y12p(
+        T* depth, T* confidence, const void* frame0, const void* frame1, const void* frame2, const void* frame3,
+        const uint32_t width, const uint32_t height, const uint32_t bytesperline, const float modfreq_hz, const Roi& roi,
+        ThreadPool& pool, const Threshold& threshold) {
+    check_roi(roi, width, height);
+    const uint32_t bands = num_bands(pool, roi.height);
+    pool.run(bands, [&](const uint32_t band) {
+        const uint32_t begin = roi.height * band / bands;
+        const uint32_t end = roi.height * (band + 1) / bands;
+        compute_depth_confidence_from_y12p<EnableConfidence, rotation, accuracy>(
+                depth + begin * roi.width, confidence + begin * roi.width, frame0, frame1, frame2, frame3, width, height,
+                bytesperline, modfreq_hz, Roi{roi.x, roi.y + begin, roi.width, end - begin},
+                at_mask_row(threshold, roi.width, begin));
+    });
+}
+
+template <bool EnableConfidence, Rotation rotation, Atan2 accuracy, class T>
+void compute_binned_depth_confidence_from_y12p(
+        T* depth, T* confidence, const void* frame0, const void* frame1, const void* frame2, const void* frame3,
+        const uint32_t width, const uint32_t height, const uint32_t bytesperline, const float modfreq_hz, const Roi& roi,
+        ThreadPool& pool, const Threshold& threshold) {
+    check_roi(roi, width, height);
+    const uint32_t binned_width = roi.width / 2;
+    const uint32_t binned_height = roi.height / 2;
+    const uint32_t bands = num_bands(pool, binned_height);
+    pool.run(bands, [&](const uint32_t band) {
+        const uint32_t begin = binned_height * band / bands;
+        const uint32_t end = binned_height * (band + 1) / bands;
+        compute_binned_depth_confidence_from_y12p<EnableConfidence, rotation, accuracy>(
+                depth + begin * binned_width, confidence + begin * binned_width, frame0, frame1, frame2, frame3, width, height,
+                bytesperline, modfreq_hz, Roi{roi.x, roi.y + begin * 2, roi.width, (end - begin) * 2},
+                at_mask_row(threshold, binned_width, begin));
+    });
+}
+
+template <bool EnableConfidence, Rotation rotation, Atan2 accuracy, class T>
+void compute_binned_depth_confidence_from_y12p(
+        T* depth, T* confidence, const void* frame0, const void* frame1, const void* frame2, const void* frame3,
+        const uint32_t width, const uint32_t height, const uint32_t bytesperline, const float modfreq_hz, ThreadPool& pool,
+        const Threshold& threshold) {
+    compute_binned_depth_confidence_from_y12p<EnableConfidence, rotation, accuracy>(
+            depth, confidence, frame0, frame1, frame2, frame3, width, height, bytesperline, modfreq_hz,
+            Roi{0, 0, width, height}, pool, threshold);
+}
+
+template <class T, class P>
+void compute_xyz(P* xyz, const T* depth, const float* rays, const uint32_t num_pixels, ThreadPool& pool) {
+    const uint32_t num_blocks = (num_pixels + 63) / 64;
+    const uint32_t bands = num_bands(pool, num_blocks);
+    pool.run(bands, [&](const uint32_t band) {
+        const uint32_t begin = std::min(num_pixels, num_blocks * band / bands * 64);
+        const uint32_t end = std::min(num_pixels, num_blocks * (band + 1) / bands * 64);
+        compute_xyz(xyz + size_t(begin) * 3, depth + begin, rays + size_t(begin) * 3, end - begin);
+    });
+}
+
+template <class T>
+void compute_temporal_filter(
+        T* depth, const T* confidence, float* history, float* history_amplitude, const uint32_t num_pixels,
+        const TemporalFilter& filter, ThreadPool& pool) {
+    const uint32_t num_blocks = (num_pixels + 63) / 64;
+    const uint32_t bands = num_bands(pool, num_blocks);
+    pool.run(bands, [&](const uint32_t band) {
+        const uint32_t begin = std::min(num_pixels, num_blocks * band / bands * 64);
+        const uint32_t end = std::min(num_pixels, num_blocks * (band + 1) / bands * 64);
+        compute_temporal_filter(
+                depth + begin, confidence ? confidence + begin : nullptr, history + begin,
+                confidence ? history_amplitude + begin : nullptr, end - begin, filter);
+    });
+}
+
+template <class T>
+void compute_spatial_filter(
+        T* dst, const T* depth, const T* confidence, const uint32_t width, const uint32_t height,
+        const SpatialFilter& filter, ThreadPool& pool) {
+    const uint32_t bands = num_bands(pool, height);
+    pool.run(bands, [&](const uint32_t band) {
+        compute_spatial_filter(
+                dst, depth, confidence, width, height, height * band / bands, height * (band + 1) / bands, filter);
+    });
+}
+
+#define INSTANTIATE(EnableConfidence, rotation, accuracy, T)                                                                 \
+    template void compute_depth_confidence<EnableConfidence, rotation, accuracy, T>(                                         \
+            T*, T*, const int16_t*, const int16_t*, const int16_t*, const int16_t*, const uint32_t, const float,             \
+            const Threshold&);                                                                                               \
+    template void compute_depth_confidence<EnableConfidence, rotation, accuracy, T>(                                         \
+            T*, T*, const int16_t*, const int16_t*, const int16_t*, const int16_t*, const uint32_t, const float,             \
+            ThreadPool&, const Threshold&);                                                                                  \
+    template void compute_depth_confidence_scalar<EnableConfidence, rotation, accuracy, T>(                                  \
+            T*, T*, const int16_t*, const int16_t*, const int16_t*, const int16_t*, const uint32_t, const float,             \
+            const Threshold&);                                                                                               \
+    template void compute_depth_confidence_from_y12p<EnableConfidence, rotation, accuracy, T>(                               \
+            T*, T*, const void*, const void*, const void*, const void*, const uint32_t, const uint32_t, const uint32_t,      \
+            const float, const Threshold&);                                                                                  \
+    template void compute_depth_confidence_from_y12p<EnableConfidence, rotation, accuracy, T>(                               \
+            T*, T*, const void*, const void*, const void*, const void*, const uint32_t, const uint32_t, const uint32_t,      \
+            const float, ThreadPool&, const Threshold&);                                                                     \
+    template void compute_depth_confidence_from_y12p_scalar<EnableConfidence, rotation, accuracy, T>(                        \
+            T*, T*, const void*, const void*, const void*, const void*, const uint32_t, const uint32_t, const uint32_t,      \
+            const float, const Threshold&);                                                                                  \
+    template void compute_unwrapped_depth_confidence_from_y12p<EnableConfidence, rotation, accuracy, T>(                     \
+            T*, T*, const void* const[4], const void* const[4], const uint32_t, const uint32_t, const uint32_t, const float, \
+            const float, const Threshold&);                                                                                  \
+    template void compute_unwrapped_depth_confidence_from_y12p<EnableConfidence, rotation, accuracy, T>(                     \
+            T*, T*, const void* const[4], const void* const[4], const uint32_t, const uint32_t, const uint32_t, const float, \
+            const float, ThreadPool&, const Threshold&);                                                                     \
+    template void compute_unwrapped_depth_confidence_from_y12p_scalar<EnableConfidence, rotation, accuracy, T>(              \
+            T*, T*, const void* const[4], const void* const[4], const uint32_t, const uint32_t, const uint32_t, const float, \
+            const float, const Threshold&);                                                                                  \
+    template void compute_depth_confidence_from_y12p<EnableConfidence, rotation, accuracy, T>(                               \
+            T*, T*, const void*, const void*, const void*, const void*, const uint32_t, const uint32_t, const uint32_t,      \
+            const float, const Roi&, const Threshold&);                                                                      \
+    template void compute_depth_confidence_from_y12p<EnableConfidence, rotation, accuracy, T>(                               \
+            T*, T*, const void*, const void*, const void*, const void*, const uint32_t, const uint32_t, const uint32_t,      \
+            const float, const Roi&, ThreadPool&, const Threshold&);                                                         \
+    template void compute_binned_depth_confidence_from_y12p<EnableConfidence, rotation, accuracy, T>(                        \
+            T*, T*, const void*, const void*, const void*, const void*, const uint32_t, const uint32_t, const uint32_t,      \
+            const float, const Roi&, const Threshold&);                                                                      \
+    template void compute_binned_depth_confidence_from_y12p<EnableConfidence, rotation, accuracy, T>(                        \
+            T*, T*, const void*, const void*, const void*, const void*, const uint32_t, const uint32_t, const uint32_t,      \
+            const float, const Roi&, ThreadPool&, const Threshold&);                                                         \
+    template void compute_binned_depth_confidence_from_y12p<EnableConfidence, rotation, accuracy, T>(                        \
+            T*, T*, const void*, const void*, const void*, const void*, const uint32_t, const uint32_t, const uint32_t,      \
+            const float, const Threshold&);                                                                                  \
+    template void compute_binned_depth_confidence_from_y12p<EnableConfidence, rotation, accuracy, T>(                        \
+            T*, T*, const void*, const void*, const void*, const void*, const uint32_t, const uint32_t, const uint32_t,      \
+            const float, ThreadPool&, const Threshold&);                                                                     \
+    template void compute_binned_depth_confidence_from_y12p_scalar<EnableConfidence, rotation, accuracy, T>(                 \
+            T*, T*, const void*, const void*, const void*, const void*, const uint32_t, const uint32_t, const uint32_t,      \
+            const float, const Threshold&);
+
+#define INSTANTIATE_ATAN2(EnableConfidence, rotation, T)                                                                     \
+    INSTANTIATE(EnableConfidence, rotation, Atan2::Fast, T)                                                                  \
+    INSTANTIATE(EnableConfidence, rotation, Atan2::Default, T)                                                               \
+    INSTANTIATE(EnableConfidence, rotation, Atan2::Poly3, T)                                                                 \
+    INSTANTIATE(EnableConfidence, rotation, Atan2::Poly5, T)
+
+INSTANTIATE_ATAN2(true, Rotation::Zero, float)
+INSTANTIATE_ATAN2(true, Rotation::Quarter, float)
+INSTANTIATE_ATAN2(true, Rotation::Half, float)
+INSTANTIATE_ATAN2(true, Rotation::ThreeQuarters, float)
+INSTANTIATE_ATAN2(false, Rotation::Zero, float)
+INSTANTIATE_ATAN2(false, Rotation::Quarter, float)
+INSTANTIATE_ATAN2(false, Rotation::Half, float)
+INSTANTIATE_ATAN2(false, Rotation::ThreeQuarters, float)
+INSTANTIATE_ATAN2(true, Rotation::Zero, uint16_t)
+INSTANTIATE_ATAN2(true, Rotation::Quarter, uint16_t)
+INSTANTIATE_ATAN2(true, Rotation::Half, uint16_t)
+INSTANTIATE_ATAN2(true, Rotation::ThreeQuarters, uint16_t)
+INSTANTIATE_ATAN2(false, Rotation::Zero, uint16_t)
+INSTANTIATE_ATAN2(false, Rotation::Quarter, uint16_t)
+INSTANTIATE_ATAN2(false, Rotation::Half, uint16_t)
+INSTANTIATE_ATAN2(false, Rotation::ThreeQuarters, uint16_t)
+
+#define INSTANTIATE_XYZ(T, P)                                                                                                \
+    template void compute_xyz<T, P>(P*, const T*, const float*, const uint32_t);                                             \
+    template void compute_xyz<T, P>(P*, const T*, const float*, const uint32_t, ThreadPool&);                                \
+    template void compute_xyz_scalar<T, P>(P*, const T*, const float*, const uint32_t);
+
+INSTANTIATE_XYZ(float, float)
+INSTANTIATE_XYZ(float, int16_t)
+INSTANTIATE_XYZ(uint16_t, float)
+INSTANTIATE_XYZ(uint16_t, int16_t)
+
+#define INSTANTIATE_FILTER(T)                                                                                                \
+    template void compute_temporal_filter<T>(T*, const T*, float*, float*, const uint32_t, const TemporalFilter&);           \
+    template void compute_temporal_filter<T>(                                                                                \
+            T*, const T*, float*, float*, const uint32_t, const TemporalFilter&, ThreadPool&);                               \
+    template void compute_temporal_filter_scalar<T>(T*, const T*, float*, float*, const uint32_t, const TemporalFilter&);
+
+INSTANTIATE_FILTER(float)
+INSTANTIATE_FILTER(uint16_t)
+
+#define INSTANTIATE_SPATIAL(T)                                                                                               \
+    template void compute_spatial_filter<T>(                                                                                 \
+            T*, const T*, const T*, const uint32_t, const uint32_t, const uint32_t, const uint32_t, const SpatialFilter&);   \
+    template void compute_spatial_filter<T>(T*, const T*, const T*, const uint32_t, const uint32_t, const SpatialFilter&);   \
+    template void compute_spatial_filter<T>(                                                                                 \
+            T*, const T*, const T*, const uint32_t, const uint32_t, const SpatialFilter&, ThreadPool&);                      \
+    template void compute_spatial_filter_scalar<T>(                                                                          \
+            T*, const T*, const T*, const uint32_t, const uint32_t, const uint32_t, const uint32_t, const SpatialFilter&);
+
+INSTANTIATE_SPATIAL(float)
+INSTANTIATE_SPATIAL(uint16_t)
 
 } // namespace tofcam
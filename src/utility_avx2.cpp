@@ -0,0 +1,693 @@
+#include "utility.hpp"
+#include "atan2.hpp"
+#include "spatial.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <immintrin.h>
+#include <limits>
+
+namespace tofcam {
+
+static inline __m256i load_y12p_s16x16(const uint8_t* src) {
+    // 24 bytes (16 pixels); lane 0 holds bytes [0, 12), lane 1 holds bytes [12, 24) starting at its 4th byte.
+    const __m128i lo = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+    const __m128i hi = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 8));
+    const __m256i b = _mm256_inserti128_si256(_mm256_castsi128_si256(lo), hi, 1);
+    // even pixels: b0 | (b2 << 8), odd pixels: b1 | (b2 << 8)
+    const __m256i shuffle = _mm256_setr_epi8(
+            0, 2, 1, 2, 3, 5, 4, 5, 6, 8, 7, 8, 9, 11, 10, 11, 4, 6, 5, 6, 7, 9, 8, 9, 10, 12, 11, 12, 13, 15, 14, 15);
+    const __m256i u = _mm256_shuffle_epi8(b, shuffle);
+    // p0 = (b0 << 4) | (b2 & 0x0F);
+    // p1 = (b1 << 4) | (b2 >> 4);
+    const __m256i hi8 = _mm256_and_si256(_mm256_slli_epi16(u, 4), _mm256_set1_epi16(0x0FF0));
+    const __m256i lo4even = _mm256_and_si256(_mm256_srli_epi16(u, 8), _mm256_set1_epi16(0x000F));
+    const __m256i lo4odd = _mm256_srli_epi16(u, 12);
+    const __m256i p = _mm256_or_si256(hi8, _mm256_blend_epi16(lo4even, lo4odd, 0xAA));
+    // sign extension
+    return _mm256_srai_epi16(_mm256_slli_epi16(p, 5), 5);
+}
+
+// the sums of the 2x2 blocks of 32 pixels of two lines, they fit in int16
+static inline __m256i load_binned_s16x16(const uint8_t* upper, const uint8_t* lower) {
+    const __m256i ones = _mm256_set1_epi16(1);
+    const __m256i lo = _mm256_madd_epi16(_mm256_add_epi16(load_y12p_s16x16(upper), load_y12p_s16x16(lower)), ones);
+    const __m256i hi =
+            _mm256_madd_epi16(_mm256_add_epi16(load_y12p_s16x16(upper + 24), load_y12p_s16x16(lower + 24)), ones);
+    // packs works within 128-bit lanes, the permutation puts the four quarters back in order
+    return _mm256_permute4x64_epi64(_mm256_packs_epi32(lo, hi), 0xD8);
+}
+
+static inline __m256 cvt_lo_ps(const __m256i v) {
+    return _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_castsi256_si128(v)));
+}
+
+static inline __m256 cvt_hi_ps(const __m256i v) {
+    return _mm256_cvtepi32_ps(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(v, 1)));
+}
+
+static inline __m256 mask_lo_ps(const __m256i m) {
+    return _mm256_castsi256_ps(_mm256_cvtepi16_epi32(_mm256_castsi256_si128(m)));
+}
+
+static inline __m256 mask_hi_ps(const __m256i m) {
+    return _mm256_castsi256_ps(_mm256_cvtepi16_epi32(_mm256_extracti128_si256(m, 1)));
+}
+
+// atan(t) / pi for t in [0, 1]
+template <Atan2 accuracy>
+static inline __m256 approx_atan_ps(const __m256 t) {
+    if constexpr (accuracy == Atan2::Poly3 || accuracy == Atan2::Poly5) {
+        constexpr auto& c = atan_poly<accuracy>();
+        constexpr int N = std::size(c);
+        __m256 a = _mm256_set1_ps(c[N - 1]);
+        for (int i = N - 2; i >= 0; i--) {
+            a = _mm256_fmadd_ps(a, t, _mm256_set1_ps(c[i]));
+        }
+        return _mm256_mul_ps(a, t);
+    } else {
+        const __m256 vR = _mm256_set1_ps(ATAN_R);
+        const __m256 vT = _mm256_set1_ps(0.25f + ATAN_R);
+        return _mm256_mul_ps(t, _mm256_fnmadd_ps(vR, t, vT));
+    }
+}
+
+template <Atan2 accuracy>
+static inline __m256 div_ps(const __m256 a, const __m256 b) {
+    if constexpr (accuracy == Atan2::Fast) {
+        // reciprocal estimate refined by one Newton-Raphson step
+        const __m256 r = _mm256_rcp_ps(b);
+        return _mm256_mul_ps(a, _mm256_mul_ps(r, _mm256_fnmadd_ps(b, r, _mm256_set1_ps(2.0f))));
+    } else {
+        return _mm256_div_ps(a, b);
+    }
+}
+
+template <Atan2 accuracy>
+static inline __m256 approx_atan2x8_finish(
+        const __m256 amin, const __m256 amax, const __m256 swap, const __m256 xneg, const __m256 yneg, const __m256 bzero) {
+    const __m256 vPI = _mm256_set1_ps(1.0f);
+    const __m256 vHalfPI = _mm256_set1_ps(0.5f);
+    const __m256 vSign = _mm256_set1_ps(-0.0f);
+
+    const __m256 a = approx_atan_ps<accuracy>(div_ps<accuracy>(amin, amax));
+    __m256 theta = _mm256_blendv_ps(a, _mm256_sub_ps(vHalfPI, a), swap);
+    theta = _mm256_blendv_ps(theta, _mm256_sub_ps(vPI, theta), xneg);
+    theta = _mm256_blendv_ps(theta, _mm256_xor_ps(theta, vSign), yneg);
+    const __m256 wrap = _mm256_or_ps(bzero, _mm256_cmp_ps(theta, vPI, _CMP_GE_OQ));
+    return _mm256_blendv_ps(theta, _mm256_xor_ps(vPI, vSign), wrap);
+}
+
+// Same arithmetic as approx_atan2x8 in utility_neon.cpp, in units of pi.
+template <Atan2 accuracy>
+static inline void approx_atan2x16(const __m256i y, const __m256i x, __m256& thetalo, __m256& thetahi) {
+    const __m256i vZ = _mm256_setzero_si256();
+
+    const __m256i ay = _mm256_abs_epi16(y);
+    const __m256i ax = _mm256_abs_epi16(x);
+
+    const __m256i swap = _mm256_cmpgt_epi16(ay, ax);
+    const __m256i amax = _mm256_max_epi16(ay, ax);
+    const __m256i amin = _mm256_min_epi16(ay, ax);
+
+    const __m256i xneg = _mm256_cmpgt_epi16(vZ, x);
+    const __m256i yneg = _mm256_cmpgt_epi16(vZ, y);
+    const __m256i bzero = _mm256_and_si256(_mm256_cmpeq_epi16(x, vZ), _mm256_cmpeq_epi16(y, vZ));
+
+    thetalo = approx_atan2x8_finish<accuracy>(
+            cvt_lo_ps(amin), cvt_lo_ps(amax), mask_lo_ps(swap), mask_lo_ps(xneg), mask_lo_ps(yneg), mask_lo_ps(bzero));
+    thetahi = approx_atan2x8_finish<accuracy>(
+            cvt_hi_ps(amin), cvt_hi_ps(amax), mask_hi_ps(swap), mask_hi_ps(xneg), mask_hi_ps(yneg), mask_hi_ps(bzero));
+}
+
+// depth and amplitude of 16 pixels
+template <bool EnableConfidence, Rotation rotation, Atan2 accuracy>
+static inline void compute_depth_confidence_s16x16(
+        const __m256i p0, const __m256i p1, const __m256i p2, const __m256i p3, const __m256 vBias, const __m256 vScale,
+        __m256& depthlo, __m256& depthhi, __m256& amplo, __m256& amphi) {
+    const __m256 vConfScale = _mm256_set1_ps(8.0f);
+    const __m256i cos = _mm256_sub_epi16(p0, p2);
+    const __m256i sin = _mm256_sub_epi16(p3, p1);
+    __m256i vy, vx;
+    if constexpr (rotation == Rotation::Zero) {
+        vy = sin;
+        vx = cos;
+    } else if constexpr (rotation == Rotation::Quarter) {
+        vy = cos;
+        vx = _mm256_sub_epi16(_mm256_setzero_si256(), sin);
+    } else if constexpr (rotation == Rotation::Half) {
+        vy = _mm256_sub_epi16(_mm256_setzero_si256(), sin);
+        vx = _mm256_sub_epi16(_mm256_setzero_si256(), cos);
+    } else {
+        vy = _mm256_sub_epi16(_mm256_setzero_si256(), cos);
+        vx = sin;
+    }
+    approx_atan2x16<accuracy>(vy, vx, depthlo, depthhi);
+    depthlo = _mm256_fmadd_ps(depthlo, vScale, vBias);
+    depthhi = _mm256_fmadd_ps(depthhi, vScale, vBias);
+    if constexpr (EnableConfidence) {
+        const __m256 xlo = cvt_lo_ps(vx);
+        const __m256 xhi = cvt_hi_ps(vx);
+        const __m256 ylo = cvt_lo_ps(vy);
+        const __m256 yhi = cvt_hi_ps(vy);
+        amplo = _mm256_mul_ps(_mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(xlo, xlo), _mm256_mul_ps(ylo, ylo))), vConfScale);
+        amphi = _mm256_mul_ps(_mm256_sqrt_ps(_mm256_add_ps(_mm256_mul_ps(xhi, xhi), _mm256_mul_ps(yhi, yhi))), vConfScale);
+    }
+}
+
+// the vThreshold of threshold_x16: a zero amplitude is invalid whatever the threshold, as in the scalar kernel
+static inline __m256 set1_threshold_ps(const float amplitude) {
+    return _mm256_set1_ps(std::max(amplitude, std::numeric_limits<float>::min()));
+}
+
+// sets the depth of the pixels whose amplitude is below the threshold to 0, returns their validity bits
+static inline uint32_t threshold_x16(
+        __m256& depthlo, __m256& depthhi, const __m256 amplo, const __m256 amphi, const __m256 vThreshold) {
+    const __m256 validlo = _mm256_cmp_ps(amplo, vThreshold, _CMP_GE_OQ);
+    const __m256 validhi = _mm256_cmp_ps(amphi, vThreshold, _CMP_GE_OQ);
+    depthlo = _mm256_and_ps(depthlo, validlo);
+    depthhi = _mm256_and_ps(depthhi, validhi);
+    return _mm256_movemask_ps(validlo) | (_mm256_movemask_ps(validhi) << 8);
+}
+
+// compute_depth_confidence_s16x16 followed by threshold_x16, the amplitude is computed for it even without confidence
+template <bool EnableConfidence, Rotation rotation, Atan2 accuracy>
+static inline uint32_t compute_thresholded_s16x16(
+        const bool thresholded, const __m256i p0, const __m256i p1, const __m256i p2, const __m256i p3, const __m256 vBias,
+        const __m256 vScale, const __m256 vThreshold, __m256& depthlo, __m256& depthhi, __m256& amplo, __m256& amphi) {
+    if (!thresholded) {
+        compute_depth_confidence_s16x16<EnableConfidence, rotation, accuracy>(
+                p0, p1, p2, p3, vBias, vScale, depthlo, depthhi, amplo, amphi);
+        return 0xFFFF;
+    }
+    compute_depth_confidence_s16x16<true, rotation, accuracy>(p0, p1, p2, p3, vBias, vScale, depthlo, depthhi, amplo, amphi);
+    return threshold_x16(depthlo, depthhi, amplo, amphi, vThreshold);
+}
+
+// Picks the wrap of the fine depth that lies closest to the coarse depth, see unwrap_f32x4 in utility_neon.cpp.
+static inline __m256 unwrap_ps(
+        const __m256 fine, const __m256 coarse, const __m256 amp, const __m256 vRange, const __m256 vInvRange,
+        const __m256 vNumWraps) {
+    const __m256 vZero = _mm256_setzero_ps();
+    __m256 wraps = _mm256_round_ps(
+            _mm256_mul_ps(_mm256_sub_ps(coarse, fine), vInvRange), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    wraps = _mm256_blendv_ps(wraps, _mm256_add_ps(wraps, vNumWraps), _mm256_cmp_ps(wraps, vZero, _CMP_LT_OQ));
+    wraps = _mm256_blendv_ps(wraps, _mm256_sub_ps(wraps, vNumWraps), _mm256_cmp_ps(wraps, vNumWraps, _CMP_GE_OQ));
+    const __m256 valid = _mm256_cmp_ps(amp, vZero, _CMP_GT_OQ);
+    return _mm256_and_ps(valid, _mm256_add_ps(fine, _mm256_mul_ps(wraps, vRange)));
+}
+
+// stores 16 pixels
+static inline void store_x16(float* dst, const __m256 lo, const __m256 hi) {
+    _mm256_storeu_ps(dst + 0, lo);
+    _mm256_storeu_ps(dst + 8, hi);
+}
+
+static inline void store_x16(uint16_t* dst, const __m256 lo, const __m256 hi) {
+    // packus works within 128-bit lanes, the permutation puts the four quarters back in order
+    const __m256i packed = _mm256_packus_epi32(_mm256_cvtps_epi32(lo), _mm256_cvtps_epi32(hi));
+    _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), _mm256_permute4x64_epi64(packed, 0xD8));
+}
+
+// stores the validity bits of 16 pixels
+static inline void store_mask_x16(uint8_t* dst, const uint32_t valid) {
+    const uint16_t bits = valid;
+    std::memcpy(dst, &bits, sizeof(bits));
+}
+
+void unpack_y12p_avx2(int16_t* dst, const void* src, const uint32_t width, const uint32_t height, const uint32_t bytesperline) {
+    for (uint32_t y = 0; y < height; y++) {
+        const uint8_t* line = static_cast<const uint8_t*>(src) + y * bytesperline;
+        uint32_t x = 0;
+        for (; x + 16 <= width; x += 16) {
+            _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + y * width + x), load_y12p_s16x16(line + x / 2 * 3));
+        }
+        unpack_y12p_scalar(dst + y * width + x, line + x / 2 * 3, width - x, 1, bytesperline);
+    }
+}
+
+static inline __m256i load_s16x16(const int16_t* src) {
+    return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(src));
+}
+
+template <bool EnableConfidence, Rotation rotation, Atan2 accuracy, class T>
+void compute_depth_confidence_avx2(
+        T* depth, T* confidence, const int16_t* frame0, const int16_t* frame1, const int16_t* frame2, const int16_t* frame3,
+        const uint32_t num_pixels, const float modfreq_hz, const Threshold& threshold) {
+    static constexpr float C = 3e8;
+    const float range = C / (2.0f * modfreq_hz) * 1000.0f;
+    const float bias = 0.5f * range;
+    const __m256 vBias = _mm256_set1_ps(bias);
+    const __m256 vScale = _mm256_set1_ps(bias);
+    const bool thresholded = threshold.amplitude > 0.0f || threshold.mask;
+    const __m256 vThreshold = set1_threshold_ps(threshold.amplitude);
+
+    uint32_t i = 0;
+    for (; i + 16 <= num_pixels; i += 16) {
+        __m256 depthlo, depthhi, amplo, amphi;
+        const uint32_t valid = compute_thresholded_s16x16<EnableConfidence, rotation, accuracy>(
+                thresholded, load_s16x16(frame0 + i), load_s16x16(frame1 + i), load_s16x16(frame2 + i),
+                load_s16x16(frame3 + i), vBias, vScale, vThreshold, depthlo, depthhi, amplo, amphi);
+        store_x16(depth + i, depthlo, depthhi);
+        if constexpr (EnableConfidence) {
+            store_x16(confidence + i, amplo, amphi);
+        }
+        if (threshold.mask) {
+            store_mask_x16(threshold.mask + i / 8, valid);
+        }
+    }
+    if (i < num_pixels) {
+        // the remaining (< 16) pixels go through a zero padded copy
+        int16_t p[4][16] = {};
+        T d[16], c[16];
+        for (uint32_t j = 0; i + j < num_pixels; j++) {
+            p[0][j] = frame0[i + j];
+            p[1][j] = frame1[i + j];
+            p[2][j] = frame2[i + j];
+            p[3][j] = frame3[i + j];
+        }
+        __m256 depthlo, depthhi, amplo, amphi;
+        const uint32_t valid = compute_thresholded_s16x16<EnableConfidence, rotation, accuracy>(
+                thresholded, load_s16x16(p[0]), load_s16x16(p[1]), load_s16x16(p[2]), load_s16x16(p[3]), vBias, vScale,
+                vThreshold, depthlo, depthhi, amplo, amphi);
+        store_x16(d, depthlo, depthhi);
+        if constexpr (EnableConfidence) {
+            store_x16(c, amplo, amphi);
+        }
+        for (uint32_t j = 0; i + j < num_pixels; j++) {
+            depth[i + j] = d[j];
+            if constexpr (EnableConfidence) {
+                confidence[i + j] = c[j];
+            }
+        }
+        if (threshold.mask) {
+            // the bits of the padding are cleared
+            const uint16_t bits = valid & ((1u << (num_pixels - i)) - 1);
+            std::memcpy(threshold.mask + i / 8, &bits, (num_pixels - i + 7) / 8);
+        }
+    }
+}
+
+template <bool EnableConfidence, Rotation rotation, Atan2 accuracy, class T>
+void compute_depth_confidence_from_y12p_avx2(
+        T* depth, T* confidence, const void* frame0, const void* frame1, const void* frame2, const void* frame3,
+        const uint32_t width, const uint32_t height, const uint32_t bytesperline, const float modfreq_hz,
+        const Threshold& threshold) {
+    static constexpr float C = 3e8;
+    const float range = C / (2.0f * modfreq_hz) * 1000.0f;
+    const float bias = 0.5f * range;
+    const float scale = bias;
+    const __m256 vBias = _mm256_set1_ps(bias);
+    const __m256 vScale = _mm256_set1_ps(scale);
+    const bool thresholded = threshold.amplitude > 0.0f || threshold.mask;
+    const __m256 vThreshold = set1_threshold_ps(threshold.amplitude);
+
+    for (uint32_t y = 0; y < height; y++) {
+        const uint8_t* line0 = static_cast<const uint8_t*>(frame0) + y * bytesperline;
+        const uint8_t* line1 = static_cast<const uint8_t*>(frame1) + y * bytesperline;
+        const uint8_t* line2 = static_cast<const uint8_t*>(frame2) + y * bytesperline;
+        const uint8_t* line3 = static_cast<const uint8_t*>(frame3) + y * bytesperline;
+        uint8_t* mask = threshold.mask ? threshold.mask + (width + 7) / 8 * y : nullptr;
+
+        uint32_t x = 0;
+        for (; x + 16 <= width; x += 16) {
+            const uint32_t offset = x / 2 * 3;
+            __m256 depthlo, depthhi, amplo, amphi;
+            const uint32_t valid = compute_thresholded_s16x16<EnableConfidence, rotation, accuracy>(
+                    thresholded, load_y12p_s16x16(line0 + offset), load_y12p_s16x16(line1 + offset),
+                    load_y12p_s16x16(line2 + offset), load_y12p_s16x16(line3 + offset), vBias, vScale, vThreshold, depthlo,
+                    depthhi, amplo, amphi);
+            store_x16(depth + y * width + x, depthlo, depthhi);
+            if constexpr (EnableConfidence) {
+                store_x16(confidence + y * width + x, amplo, amphi);
+            }
+            if (mask) {
+                store_mask_x16(mask + x / 8, valid);
+            }
+        }
+        if (x < width) {
+            // the remaining (< 16) pixels are unpacked and converted from int16
+            int16_t p[4][16];
+            unpack_y12p_scalar(p[0], line0 + x / 2 * 3, width - x, 1, bytesperline);
+            unpack_y12p_scalar(p[1], line1 + x / 2 * 3, width - x, 1, bytesperline);
+            unpack_y12p_scalar(p[2], line2 + x / 2 * 3, width - x, 1, bytesperline);
+            unpack_y12p_scalar(p[3], line3 + x / 2 * 3, width - x, 1, bytesperline);
+            compute_depth_confidence_avx2<EnableConfidence, rotation, accuracy>(
+                    depth + y * width + x, confidence + y * width + x, p[0], p[1], p[2], p[3], width - x, modfreq_hz,
+                    {threshold.amplitude, mask ? mask + x / 8 : nullptr});
+        }
+    }
+}
+
+template <bool EnableConfidence, Rotation rotation, Atan2 accuracy, class T>
+void compute_unwrapped_depth_confidence_from_y12p_avx2(
+        T* depth, T* confidence, const void* const fine[4], const void* const coarse[4], const uint32_t width,
+        const uint32_t height, const uint32_t bytesperline, const float fine_modfreq_hz, const float coarse_modfreq_hz,
+        const Threshold& threshold) {
+    static constexpr float C = 3e8;
+    const float fine_range = C / (2.0f * fine_modfreq_hz) * 1000.0f;
+    const float coarse_range = C / (2.0f * coarse_modfreq_hz) * 1000.0f;
+    const __m256 vFineBias = _mm256_set1_ps(0.5f * fine_range);
+    const __m256 vCoarseBias = _mm256_set1_ps(0.5f * coarse_range);
+    const __m256 vRange = _mm256_set1_ps(fine_range);
+    const __m256 vInvRange = _mm256_set1_ps(1.0f / fine_range);
+    const __m256 vNumWraps = _mm256_set1_ps(std::round(fine_modfreq_hz / coarse_modfreq_hz));
+    const bool thresholded = threshold.amplitude > 0.0f || threshold.mask;
+    const __m256 vThreshold = set1_threshold_ps(threshold.amplitude);
+
+    for (uint32_t y = 0; y < height; y++) {
+        const uint8_t* line[8];
+        for (uint32_t i = 0; i < 4; i++) {
+            line[i] = static_cast<const uint8_t*>(fine[i]) + y * bytesperline;
+            line[i + 4] = static_cast<const uint8_t*>(coarse[i]) + y * bytesperline;
+        }
+        uint8_t* mask = threshold.mask ? threshold.mask + (width + 7) / 8 * y : nullptr;
+
+        uint32_t x = 0;
+        for (; x + 16 <= width; x += 16) {
+            const uint32_t offset = x / 2 * 3;
+            // the amplitudes are needed for the validity even without confidence
+            __m256 depthlo, depthhi, amplo, amphi;
+            __m256 coarselo, coarsehi, coarseamplo, coarseamphi;
+            compute_depth_confidence_s16x16<true, rotation, accuracy>(
+                    load_y12p_s16x16(line[0] + offset), load_y12p_s16x16(line[1] + offset),
+                    load_y12p_s16x16(line[2] + offset), load_y12p_s16x16(line[3] + offset), vFineBias, vFineBias, depthlo,
+                    depthhi, amplo, amphi);
+            compute_depth_confidence_s16x16<true, rotation, accuracy>(
+                    load_y12p_s16x16(line[4] + offset), load_y12p_s16x16(line[5] + offset),
+                    load_y12p_s16x16(line[6] + offset), load_y12p_s16x16(line[7] + offset), vCoarseBias, vCoarseBias,
+                    coarselo, coarsehi, coarseamplo, coarseamphi);
+            amplo = _mm256_min_ps(amplo, coarseamplo);
+            amphi = _mm256_min_ps(amphi, coarseamphi);
+            depthlo = unwrap_ps(depthlo, coarselo, amplo, vRange, vInvRange, vNumWraps);
+            depthhi = unwrap_ps(depthhi, coarsehi, amphi, vRange, vInvRange, vNumWraps);
+            if (thresholded) {
+                const uint32_t valid = threshold_x16(depthlo, depthhi, amplo, amphi, vThreshold);
+                if (mask) {
+                    store_mask_x16(mask + x / 8, valid);
+                }
+            }
+            store_x16(depth + y * width + x, depthlo, depthhi);
+            if constexpr (EnableConfidence) {
+                store_x16(confidence + y * width + x, amplo, amphi);
+            }
+        }
+        if (x < width) {
+            // the remaining (< 16) pixels
+            const void* fine_tail[4];
+            const void* coarse_tail[4];
+            for (uint32_t i = 0; i < 4; i++) {
+                fine_tail[i] = line[i] + x / 2 * 3;
+                coarse_tail[i] = line[i + 4] + x / 2 * 3;
+            }
+            compute_unwrapped_depth_confidence_from_y12p_scalar<EnableConfidence, rotation, accuracy>(
+                    depth + y * width + x, confidence + y * width + x, fine_tail, coarse_tail, width - x, 1, bytesperline,
+                    fine_modfreq_hz, coarse_modfreq_hz, {threshold.amplitude, mask ? mask + x / 8 : nullptr});
+        }
+    }
+}
+
+template <bool EnableConfidence, Rotation rotation, Atan2 accuracy, class T>
+void compute_binned_depth_confidence_from_y12p_avx2(
+        T* depth, T* confidence, const void* frame0, const void* frame1, const void* frame2, const void* frame3,
+        const uint32_t width, const uint32_t height, const uint32_t bytesperline, const float modfreq_hz,
+        const Threshold& threshold) {
+    static constexpr float C = 3e8;
+    const float range = C / (2.0f * modfreq_hz) * 1000.0f;
+    const __m256 vBias = _mm256_set1_ps(0.5f * range);
+    const __m256 vQuarter = _mm256_set1_ps(0.25f);
+    const bool thresholded = threshold.amplitude > 0.0f || threshold.mask;
+    // against the amplitude of the sum, four times the mean
+    const __m256 vThreshold = set1_threshold_ps(threshold.amplitude * 4.0f);
+    const void* frames[4] = {frame0, frame1, frame2, frame3};
+    const uint32_t binned_width = width / 2;
+
+    for (uint32_t y = 0; y < height / 2; y++) {
+        const uint8_t* line[4];
+        for (uint32_t i = 0; i < 4; i++) {
+            line[i] = static_cast<const uint8_t*>(frames[i]) + y * 2 * bytesperline;
+        }
+        T* depth_line = depth + y * binned_width;
+        T* confidence_line = confidence + y * binned_width;
+        uint8_t* mask = threshold.mask ? threshold.mask + (binned_width + 7) / 8 * y : nullptr;
+
+        uint32_t x = 0;
+        for (; x + 32 <= width; x += 32) {
+            const uint32_t offset = x / 2 * 3;
+            __m256i p[4];
+            for (uint32_t i = 0; i < 4; i++) {
+                p[i] = load_binned_s16x16(line[i] + offset, line[i] + bytesperline + offset);
+            }
+            __m256 depthlo, depthhi, amplo, amphi;
+            const uint32_t valid = compute_thresholded_s16x16<EnableConfidence, rotation, accuracy>(
+                    thresholded, p[0], p[1], p[2], p[3], vBias, vBias, vThreshold, depthlo, depthhi, amplo, amphi);
+            store_x16(depth_line + x / 2, depthlo, depthhi);
+            if constexpr (EnableConfidence) {
+                // the mean amplitude of the 2x2 block
+                store_x16(confidence_line + x / 2, _mm256_mul_ps(amplo, vQuarter), _mm256_mul_ps(amphi, vQuarter));
+            }
+            if (mask) {
+                store_mask_x16(mask + x / 16, valid);
+            }
+        }
+        if (x + 1 < width) {
+            // the remaining (< 32) pixels
+            const uint32_t offset = x / 2 * 3;
+            compute_binned_depth_confidence_from_y12p_scalar<EnableConfidence, rotation, accuracy>(
+                    depth_line + x / 2, confidence_line + x / 2, line[0] + offset, line[1] + offset, line[2] + offset,
+                    line[3] + offset, width - x, 2, bytesperline, modfreq_hz,
+                    {threshold.amplitude, mask ? mask + x / 16 : nullptr});
+        }
+    }
+}
+
+static inline __m256 load_ps(const float* src) {
+    return _mm256_loadu_ps(src);
+}
+
+static inline __m256 load_ps(const uint16_t* src) {
+    return _mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(_mm_loadu_si128(reinterpret_cast<const __m128i*>(src))));
+}
+
+// stores the coordinates of 16 points
+static inline void store_xyz_x16(float* dst, const __m256 (&xyz)[6]) {
+    for (uint32_t k = 0; k < 6; k++) {
+        _mm256_storeu_ps(dst + k * 8, xyz[k]);
+    }
+}
+
+static inline void store_xyz_x16(int16_t* dst, const __m256 (&xyz)[6]) {
+    for (uint32_t k = 0; k < 3; k++) {
+        const __m256i packed = _mm256_packs_epi32(_mm256_cvtps_epi32(xyz[k * 2]), _mm256_cvtps_epi32(xyz[k * 2 + 1]));
+        _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst + k * 16), _mm256_permute4x64_epi64(packed, 0xD8));
+    }
+}
+
+template <class T, class P>
+void compute_xyz_avx2(P* xyz, const T* depth, const float* rays, const uint32_t num_pixels) {
+    // repeats the depth of 8 pixels for their x, y and z
+    const __m256i vSpread[3] = {
+            _mm256_setr_epi32(0, 0, 0, 1, 1, 1, 2, 2),
+            _mm256_setr_epi32(2, 3, 3, 3, 4, 4, 4, 5),
+            _mm256_setr_epi32(5, 5, 6, 6, 6, 7, 7, 7),
+    };
+    uint32_t i = 0;
+    for (; i + 16 <= num_pixels; i += 16) {
+        __m256 points[6];
+        for (uint32_t j = 0; j < 2; j++) {
+            const __m256 d = load_ps(depth + i + j * 8);
+            for (uint32_t k = 0; k < 3; k++) {
+                const __m256 ray = _mm256_loadu_ps(rays + (i + j * 8) * 3 + k * 8);
+                points[j * 3 + k] = _mm256_mul_ps(_mm256_permutevar8x32_ps(d, vSpread[k]), ray);
+            }
+        }
+        store_xyz_x16(xyz + i * 3, points);
+    }
+    compute_xyz_scalar(xyz + i * 3, depth + i, rays + i * 3, num_pixels - i);
+}
+
+// the filtered depth of 8 pixels, the history is updated
+static inline __m256 temporal_filter_x8(
+        const __m256 depth, const __m256 amplitude, float* history, float* history_amplitude, const __m256 vAlpha,
+        const __m256 vDepthJump, const __m256 vAmplitudeJump) {
+    const __m256 vAbs = _mm256_castsi256_ps(_mm256_set1_epi32(0x7FFFFFFF));
+    const __m256 zero = _mm256_setzero_ps();
+    const __m256 h = _mm256_loadu_ps(history);
+    const __m256 diff = _mm256_sub_ps(depth, h);
+    __m256 restart = _mm256_or_ps(_mm256_cmp_ps(depth, zero, _CMP_EQ_OQ), _mm256_cmp_ps(h, zero, _CMP_EQ_OQ));
+    restart = _mm256_or_ps(restart, _mm256_cmp_ps(_mm256_and_ps(diff, vAbs), vDepthJump, _CMP_GT_OQ));
+    if (history_amplitude) {
+        const __m256 ha = _mm256_loadu_ps(history_amplitude);
+        const __m256 jump = _mm256_and_ps(_mm256_sub_ps(amplitude, ha), vAbs);
+        restart = _mm256_or_ps(restart, _mm256_cmp_ps(jump, _mm256_mul_ps(vAmplitudeJump, ha), _CMP_GT_OQ));
+        _mm256_storeu_ps(history_amplitude, amplitude);
+    }
+    const __m256 filtered = _mm256_blendv_ps(_mm256_fmadd_ps(vAlpha, diff, h), depth, restart);
+    _mm256_storeu_ps(history, filtered);
+    return filtered;
+}
+
+template <class T>
+void compute_temporal_filter_avx2(
+        T* depth, const T* confidence, float* history, float* history_amplitude, const uint32_t num_pixels,
+        const TemporalFilter& filter) {
+    const __m256 vAlpha = _mm256_set1_ps(filter.alpha);
+    const __m256 vDepthJump = _mm256_set1_ps(filter.depth_jump);
+    const __m256 vAmplitudeJump = _mm256_set1_ps(filter.amplitude_jump);
+    uint32_t i = 0;
+    for (; i + 16 <= num_pixels; i += 16) {
+        __m256 filtered[2];
+        for (uint32_t j = 0; j < 2; j++) {
+            const uint32_t k = i + j * 8;
+            const __m256 amplitude = confidence ? load_ps(confidence + k) : _mm256_setzero_ps();
+            filtered[j] = temporal_filter_x8(
+                    load_ps(depth + k), amplitude, history + k, confidence ? history_amplitude + k : nullptr, vAlpha,
+                    vDepthJump, vAmplitudeJump);
+        }
+        store_x16(depth + i, filtered[0], filtered[1]);
+    }
+    compute_temporal_filter_scalar(
+            depth + i, confidence ? confidence + i : nullptr, history + i, confidence ? history_amplitude + i : nullptr,
+            num_pixels - i, filter);
+}
+
+// row kernels of filter_spatial_rows
+struct SpatialAvx2 {
+    static constexpr uint32_t lanes = 8;
+
+    static __m256 min(const __m256 a, const __m256 b) {
+        return _mm256_min_ps(a, b);
+    }
+
+    static __m256 max(const __m256 a, const __m256 b) {
+        return _mm256_max_ps(a, b);
+    }
+
+    static __m256 abs(const __m256 a) {
+        return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), a);
+    }
+
+    template <int R>
+    static __m256 median_x8(const float* const rows[5], const uint32_t x) {
+        __m256 v[(R * 2 + 1) * (R * 2 + 1)];
+        uint32_t i = 0;
+        for (ptrdiff_t dy = -R; dy <= R; dy++) {
+            for (ptrdiff_t dx = -R; dx <= R; dx++) {
+                v[i++] = _mm256_loadu_ps(rows[2 + dy] + x + dx);
+            }
+        }
+        return median<SpatialAvx2>(v);
+    }
+
+    static void flying_median(float* out, const float* const rows[5], const uint32_t width, const SpatialFilter& filter) {
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 limit = _mm256_set1_ps(filter.flying_pixel);
+        for (uint32_t x = 0; x < width; x += 8) {
+            const __m256 c = _mm256_loadu_ps(rows[2] + x);
+            const auto far = [&](const float* n) {
+                return _mm256_cmp_ps(abs(_mm256_sub_ps(c, _mm256_loadu_ps(n))), limit, _CMP_GT_OQ);
+            };
+            __m256 invalid = _mm256_cmp_ps(c, zero, _CMP_EQ_OQ);
+            if (filter.flying_pixel > 0.0f) {
+                const __m256 horizontal = _mm256_and_ps(far(rows[2] + x - 1), far(rows[2] + x + 1));
+                const __m256 vertical = _mm256_and_ps(far(rows[1] + x), far(rows[3] + x));
+                invalid = _mm256_or_ps(invalid, _mm256_or_ps(horizontal, vertical));
+            }
+            const __m256 result = filter.median == 3 ? median_x8<1>(rows, x)
+                                  : filter.median == 5 ? median_x8<2>(rows, x)
+                                                       : c;
+            _mm256_storeu_ps(out + x, _mm256_andnot_ps(invalid, result));
+        }
+    }
+
+    static void smooth(
+            float* out, const float* const depth[3], const float* const amplitude[3], const uint32_t width,
+            const SpatialFilter& filter) {
+        const __m256 zero = _mm256_setzero_ps();
+        const __m256 limit = _mm256_set1_ps(filter.smoothing);
+        for (uint32_t x = 0; x < width; x += 8) {
+            const __m256 c = _mm256_loadu_ps(depth[1] + x);
+            __m256 sum = zero;
+            __m256 weights = zero;
+            for (uint32_t dy = 0; dy < 3; dy++) {
+                for (ptrdiff_t dx = -1; dx <= 1; dx++) {
+                    const __m256 n = _mm256_loadu_ps(depth[dy] + x + dx);
+                    const __m256 close = _mm256_cmp_ps(abs(_mm256_sub_ps(n, c)), limit, _CMP_LE_OQ);
+                    const __m256 keep = _mm256_andnot_ps(_mm256_cmp_ps(n, zero, _CMP_EQ_OQ), close);
+                    const __m256 a = amplitude ? _mm256_loadu_ps(amplitude[dy] + x + dx) : _mm256_set1_ps(1.0f);
+                    const __m256 w = _mm256_and_ps(keep, _mm256_mul_ps(a, a));
+                    sum = _mm256_fmadd_ps(w, n, sum);
+                    weights = _mm256_add_ps(weights, w);
+                }
+            }
+            const __m256 mean = _mm256_blendv_ps(c, _mm256_div_ps(sum, weights), _mm256_cmp_ps(weights, zero, _CMP_GT_OQ));
+            _mm256_storeu_ps(out + x, _mm256_andnot_ps(_mm256_cmp_ps(c, zero, _CMP_EQ_OQ), mean));
+        }
+    }
+};
+
+template <class T>
+void compute_spatial_filter_avx2(
+        T* dst, const T* depth, const T* confidence, const uint32_t width, const uint32_t height, const uint32_t begin,
+        const uint32_t end, const SpatialFilter& filter) {
+    filter_spatial_rows<SpatialAvx2>(dst, depth, confidence, width, height, begin, end, filter);
+}
+
+#define INSTANTIATE(EnableConfidence, rotation, accuracy, T)                                                                 \
+    template void compute_depth_confidence_avx2<EnableConfidence, rotation, accuracy, T>(                                    \
+            T*, T*, const int16_t*, const int16_t*, const int16_t*, const int16_t*, const uint32_t, const float,             \
+            const Threshold&);                                                                                               \
+    template void compute_depth_confidence_from_y12p_avx2<EnableConfidence, rotation, accuracy, T>(                          \
+            T*, T*, const void*, const void*, const void*, const void*, const uint32_t, const uint32_t, const uint32_t,      \
+            const float, const Threshold&);                                                                                  \
+    template void compute_unwrapped_depth_confidence_from_y12p_avx2<EnableConfidence, rotation, accuracy, T>(                \
+            T*, T*, const void* const[4], const void* const[4], const uint32_t, const uint32_t, const uint32_t, const float, \
+            const float, const Threshold&);                                                                                  \
+    template void compute_binned_depth_confidence_from_y12p_avx2<EnableConfidence, rotation, accuracy, T>(                   \
+            T*, T*, const void*, const void*, const void*, const void*, const uint32_t, const uint32_t, const uint32_t,      \
+            const float, const Threshold&);
+
+#define INSTANTIATE_ATAN2(EnableConfidence, rotation, T)                                                                     \
+    INSTANTIATE(EnableConfidence, rotation, Atan2::Fast, T)                                                                  \
+    INSTANTIATE(EnableConfidence, rotation, Atan2::Default, T)                                                               \
+    INSTANTIATE(EnableConfidence, rotation, Atan2::Poly3, T)                                                                 \
+    INSTANTIATE(EnableConfidence, rotation, Atan2::Poly5, T)
+
+INSTANTIATE_ATAN2(true, Rotation::Zero, float)
+INSTANTIATE_ATAN2(true, Rotation::Quarter, float)
+INSTANTIATE_ATAN2(true, Rotation::Half, float)
+INSTANTIATE_ATAN2(true, Rotation::ThreeQuarters, float)
+INSTANTIATE_ATAN2(false, Rotation::Zero, float)
+INSTANTIATE_ATAN2(false, Rotation::Quarter, float)
+INSTANTIATE_ATAN2(false, Rotation::Half, float)
+INSTANTIATE_ATAN2(false, Rotation::ThreeQuarters, float)
+INSTANTIATE_ATAN2(true, Rotation::Zero, uint16_t)
+INSTANTIATE_ATAN2(true, Rotation::Quarter, uint16_t)
+INSTANTIATE_ATAN2(true, Rotation::Half, uint16_t)
+INSTANTIATE_ATAN2(true, Rotation::ThreeQuarters, uint16_t)
+INSTANTIATE_ATAN2(false, Rotation::Zero, uint16_t)
+INSTANTIATE_ATAN2(false, Rotation::Quarter, uint16_t)
+INSTANTIATE_ATAN2(false, Rotation::Half, uint16_t)
+INSTANTIATE_ATAN2(false, Rotation::ThreeQuarters, uint16_t)
+
+#define INSTANTIATE_XYZ(T, P) template void compute_xyz_avx2<T, P>(P*, const T*, const float*, const uint32_t);
+
+INSTANTIATE_XYZ(float, float)
+INSTANTIATE_XYZ(float, int16_t)
+INSTANTIATE_XYZ(uint16_t, float)
+INSTANTIATE_XYZ(uint16_t, int16_t)
+
+#define INSTANTIATE_FILTER(T)                                                                                                \
+    template void compute_temporal_filter_avx2<T>(T*, const T*, float*, float*, const uint32_t, const TemporalFilter&);
+
+INSTANTIATE_FILTER(float)
+INSTANTIATE_FILTER(uint16_t)
+
+#define INSTANTIATE_SPATIAL(T)                                                                                               \
+    template void compute_spatial_filter_avx2<T>(                                                                            \
+            T*, const T*, const T*, const uint32_t, const uint32_t, const uint32_t, const uint32_t, const SpatialFilter&);
+
+INSTANTIATE_SPATIAL(float)
+INSTANTIATE_SPATIAL(uint16_t)
+
+} // namespace tofcam
@@ -0,0 +1,629 @@
+#include "utility.hpp"
+#include "atan2.hpp"
+#include "spatial.hpp"
+// GCC 12 reports the _mm512_undefined_*() placeholders inside the intrinsics headers (GCC bug 105593).
+#pragma GCC diagnostic ignored "-Wmaybe-uninitialized"
+#pragma GCC diagnostic ignored "-Wuninitialized"
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstring>
+#include <immintrin.h>
+#include <limits>
+#include <utility>
+
+namespace tofcam {
+
+static inline __m512i load_y12p_s16x32(const uint8_t* src, const __mmask64 bytes) {
+    // 48 bytes (32 pixels); spread into four 128-bit lanes of 12 bytes each.
+    const __m512i packed = _mm512_maskz_loadu_epi8(bytes, src);
+    const __m512i spread = _mm512_setr_epi32(0, 1, 2, 0, 3, 4, 5, 0, 6, 7, 8, 0, 9, 10, 11, 0);
+    const __m512i b = _mm512_permutexvar_epi32(spread, packed);
+    // even pixels: b0 | (b2 << 8), odd pixels: b1 | (b2 << 8)
+    const __m512i shuffle = _mm512_broadcast_i32x4(_mm_setr_epi8(0, 2, 1, 2, 3, 5, 4, 5, 6, 8, 7, 8, 9, 11, 10, 11));
+    const __m512i u = _mm512_shuffle_epi8(b, shuffle);
+    // p0 = (b0 << 4) | (b2 & 0x0F);
+    // p1 = (b1 << 4) | (b2 >> 4);
+    const __m512i hi8 = _mm512_and_si512(_mm512_slli_epi16(u, 4), _mm512_set1_epi16(0x0FF0));
+    const __m512i lo4 = _mm512_and_si512(_mm512_srlv_epi16(u, _mm512_set1_epi32(0x000C0008)), _mm512_set1_epi16(0x000F));
+    const __m512i p = _mm512_or_si512(hi8, lo4);
+    // sign extension
+    return _mm512_srai_epi16(_mm512_slli_epi16(p, 5), 5);
+}
+
+static inline __m512 cvt_lo_ps(const __m512i v) {
+    return _mm512_cvtepi32_ps(_mm512_cvtepi16_epi32(_mm512_castsi512_si256(v)));
+}
+
+static inline __m512 cvt_hi_ps(const __m512i v) {
+    return _mm512_cvtepi32_ps(_mm512_cvtepi16_epi32(_mm512_extracti64x4_epi64(v, 1)));
+}
+
+// atan(t) / pi for t in [0, 1]
+template <Atan2 accuracy>
+static inline __m512 approx_atan_ps(const __m512 t) {
+    if constexpr (accuracy == Atan2::Poly3 || accuracy == Atan2::Poly5) {
+        constexpr auto& c = atan_poly<accuracy>();
+        constexpr int N = std::size(c);
+        __m512 a = _mm512_set1_ps(c[N - 1]);
+        for (int i = N - 2; i >= 0; i--) {
+            a = _mm512_fmadd_ps(a, t, _mm512_set1_ps(c[i]));
+        }
+        return _mm512_mul_ps(a, t);
+    } else {
+        const __m512 vR = _mm512_set1_ps(ATAN_R);
+        const __m512 vT = _mm512_set1_ps(0.25f + ATAN_R);
+        return _mm512_mul_ps(t, _mm512_fnmadd_ps(vR, t, vT));
+    }
+}
+
+template <Atan2 accuracy>
+static inline __m512 div_ps(const __m512 a, const __m512 b) {
+    if constexpr (accuracy == Atan2::Fast) {
+        // reciprocal estimate refined by one Newton-Raphson step
+        const __m512 r = _mm512_rcp14_ps(b);
+        return _mm512_mul_ps(a, _mm512_mul_ps(r, _mm512_fnmadd_ps(b, r, _mm512_set1_ps(2.0f))));
+    } else {
+        return _mm512_div_ps(a, b);
+    }
+}
+
+template <Atan2 accuracy>
+static inline __m512 approx_atan2x16_finish(
+        const __m512 amin, const __m512 amax, const __mmask16 swap, const __mmask16 xneg, const __mmask16 yneg,
+        const __mmask16 bzero) {
+    const __m512 vPI = _mm512_set1_ps(1.0f);
+    const __m512 vHalfPI = _mm512_set1_ps(0.5f);
+    const __m512i vSign = _mm512_set1_epi32(0x80000000);
+
+    const __m512 a = approx_atan_ps<accuracy>(div_ps<accuracy>(amin, amax));
+    __m512 theta = _mm512_mask_sub_ps(a, swap, vHalfPI, a);
+    theta = _mm512_mask_sub_ps(theta, xneg, vPI, theta);
+    theta = _mm512_castsi512_ps(_mm512_mask_xor_epi32(_mm512_castps_si512(theta), yneg, _mm512_castps_si512(theta), vSign));
+    const __mmask16 wrap = bzero | _mm512_cmp_ps_mask(theta, vPI, _CMP_GE_OQ);
+    return _mm512_mask_blend_ps(wrap, theta, _mm512_set1_ps(-1.0f));
+}
+
+// Same arithmetic as approx_atan2x8 in utility_neon.cpp, in units of pi.
+template <Atan2 accuracy>
+static inline void approx_atan2x32(const __m512i y, const __m512i x, __m512& thetalo, __m512& thetahi) {
+    const __m512i vZ = _mm512_setzero_si512();
+
+    const __m512i ay = _mm512_abs_epi16(y);
+    const __m512i ax = _mm512_abs_epi16(x);
+
+    const __mmask32 swap = _mm512_cmpgt_epi16_mask(ay, ax);
+    const __m512i amax = _mm512_max_epi16(ay, ax);
+    const __m512i amin = _mm512_min_epi16(ay, ax);
+
+    const __mmask32 xneg = _mm512_cmplt_epi16_mask(x, vZ);
+    const __mmask32 yneg = _mm512_cmplt_epi16_mask(y, vZ);
+    const __mmask32 bzero = _mm512_cmpeq_epi16_mask(x, vZ) & _mm512_cmpeq_epi16_mask(y, vZ);
+
+    thetalo = approx_atan2x16_finish<accuracy>(cvt_lo_ps(amin), cvt_lo_ps(amax), swap, xneg, yneg, bzero);
+    thetahi = approx_atan2x16_finish<accuracy>(
+            cvt_hi_ps(amin), cvt_hi_ps(amax), swap >> 16, xneg >> 16, yneg >> 16, bzero >> 16);
+}
+
+// depth and amplitude of 32 pixels
+template <bool EnableConfidence, Rotation rotation, Atan2 accuracy>
+static inline void compute_depth_confidence_s16x32(
+        const __m512i p0, const __m512i p1, const __m512i p2, const __m512i p3, const __m512 vBias, const __m512 vScale,
+        __m512& depthlo, __m512& depthhi, __m512& amplo, __m512& amphi) {
+    const __m512 vConfScale = _mm512_set1_ps(8.0f);
+    const __m512i cos = _mm512_sub_epi16(p0, p2);
+    const __m512i sin = _mm512_sub_epi16(p3, p1);
+    __m512i vy, vx;
+    if constexpr (rotation == Rotation::Zero) {
+        vy = sin;
+        vx = cos;
+    } else if constexpr (rotation == Rotation::Quarter) {
+        vy = cos;
+        vx = _mm512_sub_epi16(_mm512_setzero_si512(), sin);
+    } else if constexpr (rotation == Rotation::Half) {
+        vy = _mm512_sub_epi16(_mm512_setzero_si512(), sin);
+        vx = _mm512_sub_epi16(_mm512_setzero_si512(), cos);
+    } else {
+        vy = _mm512_sub_epi16(_mm512_setzero_si512(), cos);
+        vx = sin;
+    }
+    approx_atan2x32<accuracy>(vy, vx, depthlo, depthhi);
+    depthlo = _mm512_fmadd_ps(depthlo, vScale, vBias);
+    depthhi = _mm512_fmadd_ps(depthhi, vScale, vBias);
+    if constexpr (EnableConfidence) {
+        const __m512 xlo = cvt_lo_ps(vx);
+        const __m512 xhi = cvt_hi_ps(vx);
+        const __m512 ylo = cvt_lo_ps(vy);
+        const __m512 yhi = cvt_hi_ps(vy);
+        amplo = _mm512_mul_ps(_mm512_sqrt_ps(_mm512_add_ps(_mm512_mul_ps(xlo, xlo), _mm512_mul_ps(ylo, ylo))), vConfScale);
+        amphi = _mm512_mul_ps(_mm512_sqrt_ps(_mm512_add_ps(_mm512_mul_ps(xhi, xhi), _mm512_mul_ps(yhi, yhi))), vConfScale);
+    }
+}
+
+// the vThreshold of threshold_x32: a zero amplitude is invalid whatever the threshold, as in the scalar kernel
+static inline __m512 set1_threshold_ps(const float amplitude) {
+    return _mm512_set1_ps(std::max(amplitude, std::numeric_limits<float>::min()));
+}
+
+// sets the depth of the pixels whose amplitude is below the threshold to 0, returns their validity bits
+static inline uint32_t threshold_x32(
+        __m512& depthlo, __m512& depthhi, const __m512 amplo, const __m512 amphi, const __m512 vThreshold) {
+    const __mmask16 validlo = _mm512_cmp_ps_mask(amplo, vThreshold, _CMP_GE_OQ);
+    const __mmask16 validhi = _mm512_cmp_ps_mask(amphi, vThreshold, _CMP_GE_OQ);
+    depthlo = _mm512_maskz_mov_ps(validlo, depthlo);
+    depthhi = _mm512_maskz_mov_ps(validhi, depthhi);
+    return validlo | (uint32_t(validhi) << 16);
+}
+
+// compute_depth_confidence_s16x32 followed by threshold_x32, the amplitude is computed for it even without confidence
+template <bool EnableConfidence, Rotation rotation, Atan2 accuracy>
+static inline uint32_t compute_thresholded_s16x32(
+        const bool thresholded, const __m512i p0, const __m512i p1, const __m512i p2, const __m512i p3, const __m512 vBias,
+        const __m512 vScale, const __m512 vThreshold, __m512& depthlo, __m512& depthhi, __m512& amplo, __m512& amphi) {
+    if (!thresholded) {
+        compute_depth_confidence_s16x32<EnableConfidence, rotation, accuracy>(
+                p0, p1, p2, p3, vBias, vScale, depthlo, depthhi, amplo, amphi);
+        return 0xFFFFFFFFu;
+    }
+    compute_depth_confidence_s16x32<true, rotation, accuracy>(p0, p1, p2, p3, vBias, vScale, depthlo, depthhi, amplo, amphi);
+    return threshold_x32(depthlo, depthhi, amplo, amphi, vThreshold);
+}
+
+// Picks the wrap of the fine depth that lies closest to the coarse depth, see unwrap_f32x4 in utility_neon.cpp.
+static inline __m512 unwrap_ps(
+        const __m512 fine, const __m512 coarse, const __m512 amp, const __m512 vRange, const __m512 vInvRange,
+        const __m512 vNumWraps) {
+    const __m512 vZero = _mm512_setzero_ps();
+    __m512 wraps = _mm512_roundscale_ps(
+            _mm512_mul_ps(_mm512_sub_ps(coarse, fine), vInvRange), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+    wraps = _mm512_mask_add_ps(wraps, _mm512_cmp_ps_mask(wraps, vZero, _CMP_LT_OQ), wraps, vNumWraps);
+    wraps = _mm512_mask_sub_ps(wraps, _mm512_cmp_ps_mask(wraps, vNumWraps, _CMP_GE_OQ), wraps, vNumWraps);
+    const __mmask16 valid = _mm512_cmp_ps_mask(amp, vZero, _CMP_GT_OQ);
+    return _mm512_maskz_add_ps(valid, fine, _mm512_mul_ps(wraps, vRange));
+}
+
+// load and store masks of the 32 pixel block starting at `remain` pixels before the end of the line
+static inline std::pair<__mmask64, __mmask32> tail_masks(const uint32_t remain) {
+    if (remain >= 32) {
+        return {0xFFFFFFFFFFFFull, 0xFFFFFFFFu};
+    }
+    return {(1ull << ((remain + 1) / 2 * 3)) - 1, (1u << remain) - 1};
+}
+
+// the sums of the 2x2 blocks of 64 pixels of two lines (fewer at the end of the line), they fit in int16
+static inline __m512i load_binned_s16x32(const uint8_t* upper, const uint8_t* lower, const uint32_t remain) {
+    const __m512i ones = _mm512_set1_epi16(1);
+    const __mmask64 lo_bytes = tail_masks(remain).first;
+    const __mmask64 hi_bytes = remain > 32 ? tail_masks(remain - 32).first : 0;
+    const __m512i lo = _mm512_madd_epi16(
+            _mm512_add_epi16(load_y12p_s16x32(upper, lo_bytes), load_y12p_s16x32(lower, lo_bytes)), ones);
+    const __m512i hi = _mm512_madd_epi16(
+            _mm512_add_epi16(load_y12p_s16x32(upper + 48, hi_bytes), load_y12p_s16x32(lower + 48, hi_bytes)), ones);
+    return _mm512_inserti64x4(_mm512_castsi256_si512(_mm512_cvtepi32_epi16(lo)), _mm512_cvtepi32_epi16(hi), 1);
+}
+
+// stores the pixels of a 32 pixel block selected by `pixels`
+static inline void store_x32(float* dst, const __mmask32 pixels, const __m512 lo, const __m512 hi) {
+    _mm512_mask_storeu_ps(dst + 0, pixels, lo);
+    _mm512_mask_storeu_ps(dst + 16, pixels >> 16, hi);
+}
+
+static inline void store_x32(uint16_t* dst, const __mmask32 pixels, const __m512 lo, const __m512 hi) {
+    const __m256i lo16 = _mm512_cvtusepi32_epi16(_mm512_cvtps_epu32(lo));
+    const __m256i hi16 = _mm512_cvtusepi32_epi16(_mm512_cvtps_epu32(hi));
+    _mm512_mask_storeu_epi16(dst, pixels, _mm512_inserti64x4(_mm512_castsi256_si512(lo16), hi16, 1));
+}
+
+// stores the validity bits of the pixels of a 32 pixel block selected by `pixels`, the others are cleared
+static inline void store_mask_x32(uint8_t* dst, const __mmask32 pixels, const uint32_t valid) {
+    const uint32_t bits = valid & pixels;
+    std::memcpy(dst, &bits, (std::bit_width(uint32_t(pixels)) + 7) / 8);
+}
+
+void unpack_y12p_avx512(
+        int16_t* dst, const void* src, const uint32_t width, const uint32_t height, const uint32_t bytesperline) {
+    for (uint32_t y = 0; y < height; y++) {
+        const uint8_t* line = static_cast<const uint8_t*>(src) + y * bytesperline;
+        for (uint32_t x = 0; x < width; x += 32) {
+            const auto [bytes, pixels] = tail_masks(width - x);
+            _mm512_mask_storeu_epi16(dst + y * width + x, pixels, load_y12p_s16x32(line + x / 2 * 3, bytes));
+        }
+    }
+}
+
+template <bool EnableConfidence, Rotation rotation, Atan2 accuracy, class T>
+void compute_depth_confidence_avx512(
+        T* depth, T* confidence, const int16_t* frame0, const int16_t* frame1, const int16_t* frame2, const int16_t* frame3,
+        const uint32_t num_pixels, const float modfreq_hz, const Threshold& threshold) {
+    static constexpr float C = 3e8;
+    const float range = C / (2.0f * modfreq_hz) * 1000.0f;
+    const float bias = 0.5f * range;
+    const __m512 vBias = _mm512_set1_ps(bias);
+    const __m512 vScale = _mm512_set1_ps(bias);
+    const bool thresholded = threshold.amplitude > 0.0f || threshold.mask;
+    const __m512 vThreshold = set1_threshold_ps(threshold.amplitude);
+
+    for (uint32_t i = 0; i < num_pixels; i += 32) {
+        const __mmask32 pixels = tail_masks(num_pixels - i).second;
+        __m512 depthlo, depthhi, amplo, amphi;
+        const uint32_t valid = compute_thresholded_s16x32<EnableConfidence, rotation, accuracy>(
+                thresholded, _mm512_maskz_loadu_epi16(pixels, frame0 + i), _mm512_maskz_loadu_epi16(pixels, frame1 + i),
+                _mm512_maskz_loadu_epi16(pixels, frame2 + i), _mm512_maskz_loadu_epi16(pixels, frame3 + i), vBias, vScale,
+                vThreshold, depthlo, depthhi, amplo, amphi);
+        store_x32(depth + i, pixels, depthlo, depthhi);
+        if constexpr (EnableConfidence) {
+            store_x32(confidence + i, pixels, amplo, amphi);
+        }
+        if (threshold.mask) {
+            store_mask_x32(threshold.mask + i / 8, pixels, valid);
+        }
+    }
+}
+
+template <bool EnableConfidence, Rotation rotation, Atan2 accuracy, class T>
+void compute_depth_confidence_from_y12p_avx512(
+        T* depth, T* confidence, const void* frame0, const void* frame1, const void* frame2, const void* frame3,
+        const uint32_t width, const uint32_t height, const uint32_t bytesperline, const float modfreq_hz,
+        const Threshold& threshold) {
+    static constexpr float C = 3e8;
+    const float range = C / (2.0f * modfreq_hz) * 1000.0f;
+    const float bias = 0.5f * range;
+    const float scale = bias;
+    const __m512 vBias = _mm512_set1_ps(bias);
+    const __m512 vScale = _mm512_set1_ps(scale);
+    const bool thresholded = threshold.amplitude > 0.0f || threshold.mask;
+    const __m512 vThreshold = set1_threshold_ps(threshold.amplitude);
+
+    for (uint32_t y = 0; y < height; y++) {
+        const uint8_t* line0 = static_cast<const uint8_t*>(frame0) + y * bytesperline;
+        const uint8_t* line1 = static_cast<const uint8_t*>(frame1) + y * bytesperline;
+        const uint8_t* line2 = static_cast<const uint8_t*>(frame2) + y * bytesperline;
+        const uint8_t* line3 = static_cast<const uint8_t*>(frame3) + y * bytesperline;
+        uint8_t* mask = threshold.mask ? threshold.mask + (width + 7) / 8 * y : nullptr;
+
+        for (uint32_t x = 0; x < width; x += 32) {
+            // the last iteration covers the remaining (< 32) pixels with masked loads and stores
+            const auto [bytes, pixels] = tail_masks(width - x);
+            const uint32_t offset = x / 2 * 3;
+            __m512 depthlo, depthhi, amplo, amphi;
+            const uint32_t valid = compute_thresholded_s16x32<EnableConfidence, rotation, accuracy>(
+                    thresholded, load_y12p_s16x32(line0 + offset, bytes), load_y12p_s16x32(line1 + offset, bytes),
+                    load_y12p_s16x32(line2 + offset, bytes), load_y12p_s16x32(line3 + offset, bytes), vBias, vScale,
+                    vThreshold, depthlo, depthhi, amplo, amphi);
+            store_x32(depth + y * width + x, pixels, depthlo, depthhi);
+            if constexpr (EnableConfidence) {
+                store_x32(confidence + y * width + x, pixels, amplo, amphi);
+            }
+            if (mask) {
+                store_mask_x32(mask + x / 8, pixels, valid);
+            }
+        }
+    }
+}
+
+template <bool EnableConfidence, Rotation rotation, Atan2 accuracy, class T>
+void compute_unwrapped_depth_confidence_from_y12p_avx512(
+        T* depth, T* confidence, const void* const fine[4], const void* const coarse[4], const uint32_t width,
+        const uint32_t height, const uint32_t bytesperline, const float fine_modfreq_hz, const float coarse_modfreq_hz,
+        const Threshold& threshold) {
+    static constexpr float C = 3e8;
+    const float fine_range = C / (2.0f * fine_modfreq_hz) * 1000.0f;
+    const float coarse_range = C / (2.0f * coarse_modfreq_hz) * 1000.0f;
+    const __m512 vFineBias = _mm512_set1_ps(0.5f * fine_range);
+    const __m512 vCoarseBias = _mm512_set1_ps(0.5f * coarse_range);
+    const __m512 vRange = _mm512_set1_ps(fine_range);
+    const __m512 vInvRange = _mm512_set1_ps(1.0f / fine_range);
+    const __m512 vNumWraps = _mm512_set1_ps(std::round(fine_modfreq_hz / coarse_modfreq_hz));
+    const bool thresholded = threshold.amplitude > 0.0f || threshold.mask;
+    const __m512 vThreshold = set1_threshold_ps(threshold.amplitude);
+
+    for (uint32_t y = 0; y < height; y++) {
+        const uint8_t* line[8];
+        for (uint32_t i = 0; i < 4; i++) {
+            line[i] = static_cast<const uint8_t*>(fine[i]) + y * bytesperline;
+            line[i + 4] = static_cast<const uint8_t*>(coarse[i]) + y * bytesperline;
+        }
+        uint8_t* mask = threshold.mask ? threshold.mask + (width + 7) / 8 * y : nullptr;
+
+        for (uint32_t x = 0; x < width; x += 32) {
+            // the last iteration covers the remaining (< 32) pixels with masked loads and stores
+            const auto [bytes, pixels] = tail_masks(width - x);
+            const uint32_t offset = x / 2 * 3;
+            // the amplitudes are needed for the validity even without confidence
+            __m512 depthlo, depthhi, amplo, amphi;
+            __m512 coarselo, coarsehi, coarseamplo, coarseamphi;
+            compute_depth_confidence_s16x32<true, rotation, accuracy>(
+                    load_y12p_s16x32(line[0] + offset, bytes), load_y12p_s16x32(line[1] + offset, bytes),
+                    load_y12p_s16x32(line[2] + offset, bytes), load_y12p_s16x32(line[3] + offset, bytes), vFineBias,
+                    vFineBias, depthlo, depthhi, amplo, amphi);
+            compute_depth_confidence_s16x32<true, rotation, accuracy>(
+                    load_y12p_s16x32(line[4] + offset, bytes), load_y12p_s16x32(line[5] + offset, bytes),
+                    load_y12p_s16x32(line[6] + offset, bytes), load_y12p_s16x32(line[7] + offset, bytes), vCoarseBias,
+                    vCoarseBias, coarselo, coarsehi, coarseamplo, coarseamphi);
+            amplo = _mm512_min_ps(amplo, coarseamplo);
+            amphi = _mm512_min_ps(amphi, coarseamphi);
+            depthlo = unwrap_ps(depthlo, coarselo, amplo, vRange, vInvRange, vNumWraps);
+            depthhi = unwrap_ps(depthhi, coarsehi, amphi, vRange, vInvRange, vNumWraps);
+            if (thresholded) {
+                const uint32_t valid = threshold_x32(depthlo, depthhi, amplo, amphi, vThreshold);
+                if (mask) {
+                    store_mask_x32(mask + x / 8, pixels, valid);
+                }
+            }
+            store_x32(depth + y * width + x, pixels, depthlo, depthhi);
+            if constexpr (EnableConfidence) {
+                store_x32(confidence + y * width + x, pixels, amplo, amphi);
+            }
+        }
+    }
+}
+
+template <bool EnableConfidence, Rotation rotation, Atan2 accuracy, class T>
+void compute_binned_depth_confidence_from_y12p_avx512(
+        T* depth, T* confidence, const void* frame0, const void* frame1, const void* frame2, const void* frame3,
+        const uint32_t width, const uint32_t height, const uint32_t bytesperline, const float modfreq_hz,
+        const Threshold& threshold) {
+    static constexpr float C = 3e8;
+    const float range = C / (2.0f * modfreq_hz) * 1000.0f;
+    const __m512 vBias = _mm512_set1_ps(0.5f * range);
+    const __m512 vQuarter = _mm512_set1_ps(0.25f);
+    const bool thresholded = threshold.amplitude > 0.0f || threshold.mask;
+    // against the amplitude of the sum, four times the mean
+    const __m512 vThreshold = set1_threshold_ps(threshold.amplitude * 4.0f);
+    const void* frames[4] = {frame0, frame1, frame2, frame3};
+    const uint32_t binned_width = width / 2;
+
+    for (uint32_t y = 0; y < height / 2; y++) {
+        const uint8_t* line[4];
+        for (uint32_t i = 0; i < 4; i++) {
+            line[i] = static_cast<const uint8_t*>(frames[i]) + y * 2 * bytesperline;
+        }
+        T* depth_line = depth + y * binned_width;
+        T* confidence_line = confidence + y * binned_width;
+        uint8_t* mask = threshold.mask ? threshold.mask + (binned_width + 7) / 8 * y : nullptr;
+
+        for (uint32_t x = 0; x + 1 < width; x += 64) {
+            // the last iteration covers the remaining (< 64) pixels with masked loads and stores
+            const uint32_t remain = width - x;
+            const __mmask32 pixels = tail_masks(remain / 2).second;
+            const uint32_t offset = x / 2 * 3;
+            __m512i p[4];
+            for (uint32_t i = 0; i < 4; i++) {
+                p[i] = load_binned_s16x32(line[i] + offset, line[i] + bytesperline + offset, remain);
+            }
+            __m512 depthlo, depthhi, amplo, amphi;
+            const uint32_t valid = compute_thresholded_s16x32<EnableConfidence, rotation, accuracy>(
+                    thresholded, p[0], p[1], p[2], p[3], vBias, vBias, vThreshold, depthlo, depthhi, amplo, amphi);
+            store_x32(depth_line + x / 2, pixels, depthlo, depthhi);
+            if constexpr (EnableConfidence) {
+                // the mean amplitude of the 2x2 block
+                store_x32(
+                        confidence_line + x / 2, pixels, _mm512_mul_ps(amplo, vQuarter), _mm512_mul_ps(amphi, vQuarter));
+            }
+            if (mask) {
+                store_mask_x32(mask + x / 16, pixels, valid);
+            }
+        }
+    }
+}
+
+static inline __m512 load_ps(const float* src, const __mmask16 pixels) {
+    return _mm512_maskz_loadu_ps(pixels, src);
+}
+
+static inline __m512 load_ps(const uint16_t* src, const __mmask16 pixels) {
+    return _mm512_cvtepi32_ps(_mm512_cvtepu16_epi32(_mm512_castsi512_si256(_mm512_maskz_loadu_epi16(pixels, src))));
+}
+
+// stores the coordinates of 16 points selected by `values`, 3 bits per point
+static inline void store_xyz_x16(float* dst, const __mmask64 values, const __m512 (&xyz)[3]) {
+    for (uint32_t k = 0; k < 3; k++) {
+        _mm512_mask_storeu_ps(dst + k * 16, values >> (k * 16), xyz[k]);
+    }
+}
+
+static inline void store_xyz_x16(int16_t* dst, const __mmask64 values, const __m512 (&xyz)[3]) {
+    const __m256i x = _mm512_cvtsepi32_epi16(_mm512_cvtps_epi32(xyz[0]));
+    const __m256i y = _mm512_cvtsepi32_epi16(_mm512_cvtps_epi32(xyz[1]));
+    const __m256i z = _mm512_cvtsepi32_epi16(_mm512_cvtps_epi32(xyz[2]));
+    _mm512_mask_storeu_epi16(dst, values, _mm512_inserti64x4(_mm512_castsi256_si512(x), y, 1));
+    _mm512_mask_storeu_epi16(dst + 32, values >> 32, _mm512_castsi256_si512(z));
+}
+
+template <class T, class P>
+void compute_xyz_avx512(P* xyz, const T* depth, const float* rays, const uint32_t num_pixels) {
+    // repeats the depth of 16 pixels for their x, y and z
+    const __m512i vSpread[3] = {
+            _mm512_setr_epi32(0, 0, 0, 1, 1, 1, 2, 2, 2, 3, 3, 3, 4, 4, 4, 5),
+            _mm512_setr_epi32(5, 5, 6, 6, 6, 7, 7, 7, 8, 8, 8, 9, 9, 9, 10, 10),
+            _mm512_setr_epi32(10, 11, 11, 11, 12, 12, 12, 13, 13, 13, 14, 14, 14, 15, 15, 15),
+    };
+    for (uint32_t i = 0; i < num_pixels; i += 16) {
+        const uint32_t remain = std::min(num_pixels - i, 16u);
+        const __mmask64 values = (1ull << (remain * 3)) - 1;
+        const __m512 d = load_ps(depth + i, (1u << remain) - 1);
+        __m512 points[3];
+        for (uint32_t k = 0; k < 3; k++) {
+            const __m512 ray = _mm512_maskz_loadu_ps(values >> (k * 16), rays + i * 3 + k * 16);
+            points[k] = _mm512_mul_ps(_mm512_permutexvar_ps(vSpread[k], d), ray);
+        }
+        store_xyz_x16(xyz + i * 3, values, points);
+    }
+}
+
+// the filtered depth of the pixels of a 16 pixel block selected by `pixels`, the history is updated
+static inline __m512 temporal_filter_x16(
+        const __mmask16 pixels, const __m512 depth, const __m512 amplitude, float* history, float* history_amplitude,
+        const __m512 vAlpha, const __m512 vDepthJump, const __m512 vAmplitudeJump) {
+    const __m512 zero = _mm512_setzero_ps();
+    const __m512 h = _mm512_maskz_loadu_ps(pixels, history);
+    const __m512 diff = _mm512_sub_ps(depth, h);
+    __mmask16 restart = _mm512_cmp_ps_mask(depth, zero, _CMP_EQ_OQ) | _mm512_cmp_ps_mask(h, zero, _CMP_EQ_OQ) |
+                        _mm512_cmp_ps_mask(_mm512_abs_ps(diff), vDepthJump, _CMP_GT_OQ);
+    if (history_amplitude) {
+        const __m512 ha = _mm512_maskz_loadu_ps(pixels, history_amplitude);
+        const __m512 jump = _mm512_abs_ps(_mm512_sub_ps(amplitude, ha));
+        restart |= _mm512_cmp_ps_mask(jump, _mm512_mul_ps(vAmplitudeJump, ha), _CMP_GT_OQ);
+        _mm512_mask_storeu_ps(history_amplitude, pixels, amplitude);
+    }
+    const __m512 filtered = _mm512_mask_blend_ps(restart, _mm512_fmadd_ps(vAlpha, diff, h), depth);
+    _mm512_mask_storeu_ps(history, pixels, filtered);
+    return filtered;
+}
+
+template <class T>
+void compute_temporal_filter_avx512(
+        T* depth, const T* confidence, float* history, float* history_amplitude, const uint32_t num_pixels,
+        const TemporalFilter& filter) {
+    const __m512 vAlpha = _mm512_set1_ps(filter.alpha);
+    const __m512 vDepthJump = _mm512_set1_ps(filter.depth_jump);
+    const __m512 vAmplitudeJump = _mm512_set1_ps(filter.amplitude_jump);
+    for (uint32_t i = 0; i < num_pixels; i += 32) {
+        const __mmask32 pixels = tail_masks(num_pixels - i).second;
+        __m512 filtered[2];
+        for (uint32_t j = 0; j < 2; j++) {
+            const uint32_t k = i + j * 16;
+            const __mmask16 half = pixels >> (j * 16);
+            const __m512 amplitude = confidence ? load_ps(confidence + k, half) : _mm512_setzero_ps();
+            filtered[j] = temporal_filter_x16(
+                    half, load_ps(depth + k, half), amplitude, history + k, confidence ? history_amplitude + k : nullptr,
+                    vAlpha, vDepthJump, vAmplitudeJump);
+        }
+        store_x32(depth + i, pixels, filtered[0], filtered[1]);
+    }
+}
+
+// row kernels of filter_spatial_rows
+struct SpatialAvx512 {
+    static constexpr uint32_t lanes = 16;
+
+    static __m512 min(const __m512 a, const __m512 b) {
+        return _mm512_min_ps(a, b);
+    }
+
+    static __m512 max(const __m512 a, const __m512 b) {
+        return _mm512_max_ps(a, b);
+    }
+
+    template <int R>
+    static __m512 median_x16(const float* const rows[5], const uint32_t x) {
+        __m512 v[(R * 2 + 1) * (R * 2 + 1)];
+        uint32_t i = 0;
+        for (ptrdiff_t dy = -R; dy <= R; dy++) {
+            for (ptrdiff_t dx = -R; dx <= R; dx++) {
+                v[i++] = _mm512_loadu_ps(rows[2 + dy] + x + dx);
+            }
+        }
+        return median<SpatialAvx512>(v);
+    }
+
+    static void flying_median(float* out, const float* const rows[5], const uint32_t width, const SpatialFilter& filter) {
+        const __m512 zero = _mm512_setzero_ps();
+        const __m512 limit = _mm512_set1_ps(filter.flying_pixel);
+        for (uint32_t x = 0; x < width; x += 16) {
+            const __m512 c = _mm512_loadu_ps(rows[2] + x);
+            const auto far = [&](const float* n) {
+                return _mm512_cmp_ps_mask(_mm512_abs_ps(_mm512_sub_ps(c, _mm512_loadu_ps(n))), limit, _CMP_GT_OQ);
+            };
+            __mmask16 invalid = _mm512_cmp_ps_mask(c, zero, _CMP_EQ_OQ);
+            if (filter.flying_pixel > 0.0f) {
+                invalid |= (far(rows[2] + x - 1) & far(rows[2] + x + 1)) | (far(rows[1] + x) & far(rows[3] + x));
+            }
+            const __m512 result = filter.median == 3 ? median_x16<1>(rows, x)
+                                  : filter.median == 5 ? median_x16<2>(rows, x)
+                                                       : c;
+            _mm512_storeu_ps(out + x, _mm512_maskz_mov_ps(__mmask16(~invalid), result));
+        }
+    }
+
+    static void smooth(
+            float* out, const float* const depth[3], const float* const amplitude[3], const uint32_t width,
+            const SpatialFilter& filter) {
+        const __m512 zero = _mm512_setzero_ps();
+        const __m512 limit = _mm512_set1_ps(filter.smoothing);
+        for (uint32_t x = 0; x < width; x += 16) {
+            const __m512 c = _mm512_loadu_ps(depth[1] + x);
+            __m512 sum = zero;
+            __m512 weights = zero;
+            for (uint32_t dy = 0; dy < 3; dy++) {
+                for (ptrdiff_t dx = -1; dx <= 1; dx++) {
+                    const __m512 n = _mm512_loadu_ps(depth[dy] + x + dx);
+                    const __mmask16 keep = _mm512_cmp_ps_mask(n, zero, _CMP_NEQ_UQ) &
+                                           _mm512_cmp_ps_mask(_mm512_abs_ps(_mm512_sub_ps(n, c)), limit, _CMP_LE_OQ);
+                    const __m512 a = amplitude ? _mm512_loadu_ps(amplitude[dy] + x + dx) : _mm512_set1_ps(1.0f);
+                    const __m512 w = _mm512_maskz_mul_ps(keep, a, a);
+                    sum = _mm512_fmadd_ps(w, n, sum);
+                    weights = _mm512_add_ps(weights, w);
+                }
+            }
+            const __m512 mean = _mm512_mask_div_ps(c, _mm512_cmp_ps_mask(weights, zero, _CMP_GT_OQ), sum, weights);
+            _mm512_storeu_ps(out + x, _mm512_maskz_mov_ps(_mm512_cmp_ps_mask(c, zero, _CMP_NEQ_UQ), mean));
+        }
+    }
+};
+
+template <class T>
+void compute_spatial_filter_avx512(
+        T* dst, const T* depth, const T* confidence, const uint32_t width, const uint32_t height, const uint32_t begin,
+        const uint32_t end, const SpatialFilter& filter) {
+    filter_spatial_rows<SpatialAvx512>(dst, depth, confidence, width, height, begin, end, filter);
+}
+
+#define INSTANTIATE(EnableConfidence, rotation, accuracy, T)                                                                 \
+    template void compute_depth_confidence_avx512<EnableConfidence, rotation, accuracy, T>(                                  \
+            T*, T*, const int16_t*, const int16_t*, const int16_t*, const int16_t*, const uint32_t, const float,             \
+            const Threshold&);                                                                                               \
+    template void compute_depth_confidence_from_y12p_avx512<EnableConfidence, rotation, accuracy, T>(                        \
+            T*, T*, const void*, const void*, const void*, const void*, const uint32_t, const uint32_t, const uint32_t,      \
+            const float, const Threshold&);                                                                                  \
+    template void compute_unwrapped_depth_confidence_from_y12p_avx512<EnableConfidence, rotation, accuracy, T>(              \
+            T*, T*, const void* const[4], const void* const[4], const uint32_t, const uint32_t, const uint32_t, const float, \
+            const float, const Threshold&);                                                                                  \
+    template void compute_binned_depth_confidence_from_y12p_avx512<EnableConfidence, rotation, accuracy, T>(                 \
+            T*, T*, const void*, const void*, const void*, const void*, const uint32_t, const uint32_t, const uint32_t,      \
+            const float, const Threshold&);
+
+#define INSTANTIATE_ATAN2(EnableConfidence, rotation, T)                                                                     \
+    INSTANTIATE(EnableConfidence, rotation, Atan2::Fast, T)                                                                  \
+    INSTANTIATE(EnableConfidence, rotation, Atan2::Default, T)                                                               \
+    INSTANTIATE(EnableConfidence, rotation, Atan2::Poly3, T)                                                                 \
+    INSTANTIATE(EnableConfidence, rotation, Atan2::Poly5, T)
+
+INSTANTIATE_ATAN2(true, Rotation::Zero, float)
+INSTANTIATE_ATAN2(true, Rotation::Quarter, float)
+INSTANTIATE_ATAN2(true, Rotation::Half, float)
+INSTANTIATE_ATAN2(true, Rotation::ThreeQuarters, float)
+INSTANTIATE_ATAN2(false, Rotation::Zero, float)
+INSTANTIATE_ATAN2(false, Rotation::Quarter, float)
+INSTANTIATE_ATAN2(false, Rotation::Half, float)
+INSTANTIATE_ATAN2(false, Rotation::ThreeQuarters, float)
+INSTANTIATE_ATAN2(true, Rotation::Zero, uint16_t)
+INSTANTIATE_ATAN2(true, Rotation::Quarter, uint16_t)
+INSTANTIATE_ATAN2(true, Rotation::Half, uint16_t)
+INSTANTIATE_ATAN2(true, Rotation::ThreeQuarters, uint16_t)
+INSTANTIATE_ATAN2(false, Rotation::Zero, uint16_t)
+INSTANTIATE_ATAN2(false, Rotation::Quarter, uint16_t)
+INSTANTIATE_ATAN2(false, Rotation::Half, uint16_t)
+INSTANTIATE_ATAN2(false, Rotation::ThreeQuarters, uint16_t)
+
+#define INSTANTIATE_XYZ(T, P) template void compute_xyz_avx512<T, P>(P*, const T*, const float*, const uint32_t);
+
+INSTANTIATE_XYZ(float, float)
+INSTANTIATE_XYZ(float, int16_t)
+INSTANTIATE_XYZ(uint16_t, float)
+INSTANTIATE_XYZ(uint16_t, int16_t)
+
+#define INSTANTIATE_FILTER(T)                                                                                                \
+    template void compute_temporal_filter_avx512<T>(T*, const T*, float*, float*, const uint32_t, const TemporalFilter&);
+
+INSTANTIATE_FILTER(float)
+INSTANTIATE_FILTER(uint16_t)
+
+#define INSTANTIATE_SPATIAL(T)                                                                                               \
+    template void compute_spatial_filter_avx512<T>(                                                                          \
+            T*, const T*, const T*, const uint32_t, const uint32_t, const uint32_t, const uint32_t, const SpatialFilter&);
+
+INSTANTIATE_SPATIAL(float)
+INSTANTIATE_SPATIAL(uint16_t)
+
+} // namespace tofcam
@@ -0,0 +1,689 @@
+#include "utility.hpp"
+#include "atan2.hpp"
+#include "spatial.hpp"
+#include <algorithm>
+#include <arm_neon.h>
+#include <cmath>
+#include <limits>
+
+namespace tofcam {
+
+static inline void unpack_y12p_s16x8x2(const uint8x8x3_t& b, int16x8_t& p0, int16x8_t& p1) {
+    // p0 = (b0 << 4) | (b2 & 0x0F);
+    uint8x8_t b2lo = vand_u8(b.val[2], vdup_n_u8(0x0F));
+    uint16x8_t p0u = vorrq_u16(vshll_n_u8(b.val[0], 4), vmovl_u8(b2lo));
+    // p1 = (b1 << 4) | (b2 >> 4);
+    uint8x8_t b2hi = vshr_n_u8(b.val[2], 4);
+    uint16x8_t p1u = vorrq_u16(vshll_n_u8(b.val[1], 4), vmovl_u8(b2hi));
+    // sign extension
+    p0 = vshrq_n_s16(vshlq_n_s16(vreinterpretq_s16_u16(p0u), 5), 5);
+    p1 = vshrq_n_s16(vshlq_n_s16(vreinterpretq_s16_u16(p1u), 5), 5);
+}
+
+// atan(t) / pi for t in [0, 1]
+template <Atan2 accuracy>
+static inline float32x4_t approx_atan_f32x4(const float32x4_t& t) {
+    if constexpr (accuracy == Atan2::Poly3 || accuracy == Atan2::Poly5) {
+        constexpr auto& c = atan_poly<accuracy>();
+        constexpr int N = std::size(c);
+        float32x4_t a = vdupq_n_f32(c[N - 1]);
+        for (int i = N - 2; i >= 0; i--) {
+            a = vfmaq_f32(vdupq_n_f32(c[i]), a, t);
+        }
+        return vmulq_f32(a, t);
+    } else {
+        const float32x4_t vR = vdupq_n_f32(ATAN_R);
+        const float32x4_t vT = vdupq_n_f32(0.25f + ATAN_R);
+        return vmulq_f32(t, vfmsq_f32(vT, vR, t));
+    }
+}
+
+template <Atan2 accuracy>
+static inline float32x4_t div_f32x4(const float32x4_t& a, const float32x4_t& b) {
+    if constexpr (accuracy == Atan2::Fast) {
+        // reciprocal estimate refined by one Newton-Raphson step
+        float32x4_t r = vrecpeq_f32(b);
+        r = vmulq_f32(vrecpsq_f32(b, r), r);
+        return vmulq_f32(a, r);
+    } else {
+        return vdivq_f32(a, b);
+    }
+}
+
+template <Atan2 accuracy>
+static inline void approx_atan2x8(const int16x8_t& y, const int16x8_t& x, float32x4_t& thetalo, float32x4_t& thetahi) {
+    const float32x4_t vPI = vdupq_n_f32(1.0f);
+    const float32x4_t vHalfPI = vdupq_n_f32(0.5f);
+    const int16x8_t vZ = vdupq_n_s16(0);
+
+    const int16x8_t ay = vabsq_s16(y);
+    const int16x8_t ax = vabsq_s16(x);
+
+    const uint16x8_t swap = vcgtq_s16(ay, ax);
+    const int16x8_t amax = vbslq_s16(swap, ay, ax);
+    const int16x8_t amin = vbslq_s16(swap, ax, ay);
+
+    const float32x4_t amaxlo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(amax)));
+    const float32x4_t amaxhi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(amax)));
+    const float32x4_t aminlo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(amin)));
+    const float32x4_t aminhi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(amin)));
+
+    const float32x4_t alo = approx_atan_f32x4<accuracy>(div_f32x4<accuracy>(aminlo, amaxlo));
+    const float32x4_t ahi = approx_atan_f32x4<accuracy>(div_f32x4<accuracy>(aminhi, amaxhi));
+
+    const uint32x4_t swaplo = vmovl_u16(vget_low_u16(swap));
+    const uint32x4_t swaphi = vmovl_u16(vget_high_u16(swap));
+    thetalo = vbslq_f32(vcgtq_u32(swaplo, vdupq_n_u32(0)), vsubq_f32(vHalfPI, alo), alo);
+    thetahi = vbslq_f32(vcgtq_u32(swaphi, vdupq_n_u32(0)), vsubq_f32(vHalfPI, ahi), ahi);
+
+    const uint16x8_t xneg = vcltq_s16(x, vZ);
+    const uint32x4_t xneglo = vmovl_u16(vget_low_u16(xneg));
+    const uint32x4_t xneghi = vmovl_u16(vget_high_u16(xneg));
+    thetalo = vbslq_f32(vcgtq_u32(xneglo, vdupq_n_u32(0)), vsubq_f32(vPI, thetalo), thetalo);
+    thetahi = vbslq_f32(vcgtq_u32(xneghi, vdupq_n_u32(0)), vsubq_f32(vPI, thetahi), thetahi);
+
+    const uint16x8_t yneg = vcltq_s16(y, vZ);
+    const uint32x4_t yneglo = vmovl_u16(vget_low_u16(yneg));
+    const uint32x4_t yneghi = vmovl_u16(vget_high_u16(yneg));
+    thetalo = vbslq_f32(vcgtq_u32(yneglo, vdupq_n_u32(0)), vnegq_f32(thetalo), thetalo);
+    thetahi = vbslq_f32(vcgtq_u32(yneghi, vdupq_n_u32(0)), vnegq_f32(thetahi), thetahi);
+
+    const uint16x8_t xzero = vceqq_s16(x, vZ);
+    const uint16x8_t yzero = vceqq_s16(y, vZ);
+    const uint16x8_t bzero = vandq_u16(xzero, yzero);
+    const uint32x4_t bzerolo = vmovl_u16(vget_low_u16(bzero));
+    const uint32x4_t bzerohi = vmovl_u16(vget_high_u16(bzero));
+    thetalo = vbslq_f32(vorrq_u32(vcgtq_u32(bzerolo, vdupq_n_u32(0)), vcgeq_f32(thetalo, vPI)), vnegq_f32(vPI), thetalo);
+    thetahi = vbslq_f32(vorrq_u32(vcgtq_u32(bzerohi, vdupq_n_u32(0)), vcgeq_f32(thetahi, vPI)), vnegq_f32(vPI), thetahi);
+}
+
+// depth and amplitude of 8 pixels
+template <bool EnableConfidence, Rotation rotation, Atan2 accuracy>
+static inline void compute_depth_confidence_s16x8(
+        const int16x8_t& p0, const int16x8_t& p1, const int16x8_t& p2, const int16x8_t& p3, const float32x4_t& vBias,
+        const float32x4_t& vScale, float32x4_t& depthlo, float32x4_t& depthhi, float32x4_t& amplo, float32x4_t& amphi) {
+    const float32x4_t vConfScale = vdupq_n_f32(8.0f);
+    const int16x8_t cos = vsubq_s16(p0, p2);
+    const int16x8_t sin = vsubq_s16(p3, p1);
+    int16x8_t vy, vx;
+    if constexpr (rotation == Rotation::Zero) {
+        vy = sin;
+        vx = cos;
+    } else if constexpr (rotation == Rotation::Quarter) {
+        vy = cos;
+        vx = vnegq_s16(sin);
+    } else if constexpr (rotation == Rotation::Half) {
+        vy = vnegq_s16(sin);
+        vx = vnegq_s16(cos);
+    } else {
+        vy = vnegq_s16(cos);
+        vx = sin;
+    }
+    approx_atan2x8<accuracy>(vy, vx, depthlo, depthhi);
+    depthlo = vfmaq_f32(vBias, depthlo, vScale);
+    depthhi = vfmaq_f32(vBias, depthhi, vScale);
+    if constexpr (EnableConfidence) {
+        const float32x4_t xlo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(vx)));
+        const float32x4_t xhi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(vx)));
+        const float32x4_t ylo = vcvtq_f32_s32(vmovl_s16(vget_low_s16(vy)));
+        const float32x4_t yhi = vcvtq_f32_s32(vmovl_s16(vget_high_s16(vy)));
+        amplo = vmulq_f32(vsqrtq_f32(vaddq_f32(vmulq_f32(xlo, xlo), vmulq_f32(ylo, ylo))), vConfScale);
+        amphi = vmulq_f32(vsqrtq_f32(vaddq_f32(vmulq_f32(xhi, xhi), vmulq_f32(yhi, yhi))), vConfScale);
+    }
+}
+
+// the vThreshold of threshold_x8: a zero amplitude is invalid whatever the threshold, as in the scalar kernel
+static inline float32x4_t dup_threshold_f32x4(const float amplitude) {
+    return vdupq_n_f32(std::max(amplitude, std::numeric_limits<float>::min()));
+}
+
+// sets the depth of the pixels whose amplitude is below the threshold to 0, returns their validity as lane masks
+static inline uint16x8_t threshold_x8(
+        float32x4_t& depthlo, float32x4_t& depthhi, const float32x4_t& amplo, const float32x4_t& amphi,
+        const float32x4_t& vThreshold) {
+    const uint32x4_t validlo = vcgeq_f32(amplo, vThreshold);
+    const uint32x4_t validhi = vcgeq_f32(amphi, vThreshold);
+    depthlo = vreinterpretq_f32_u32(vandq_u32(validlo, vreinterpretq_u32_f32(depthlo)));
+    depthhi = vreinterpretq_f32_u32(vandq_u32(validhi, vreinterpretq_u32_f32(depthhi)));
+    return vcombine_u16(vmovn_u32(validlo), vmovn_u32(validhi));
+}
+
+// compute_depth_confidence_s16x8 followed by threshold_x8, the amplitude is computed for it even without confidence
+template <bool EnableConfidence, Rotation rotation, Atan2 accuracy>
+static inline uint16x8_t compute_thresholded_s16x8(
+        const bool thresholded, const int16x8_t& p0, const int16x8_t& p1, const int16x8_t& p2, const int16x8_t& p3,
+        const float32x4_t& vBias, const float32x4_t& vScale, const float32x4_t& vThreshold, float32x4_t& depthlo,
+        float32x4_t& depthhi, float32x4_t& amplo, float32x4_t& amphi) {
+    if (!thresholded) {
+        compute_depth_confidence_s16x8<EnableConfidence, rotation, accuracy>(
+                p0, p1, p2, p3, vBias, vScale, depthlo, depthhi, amplo, amphi);
+        return vdupq_n_u16(0xFFFF);
+    }
+    compute_depth_confidence_s16x8<true, rotation, accuracy>(p0, p1, p2, p3, vBias, vScale, depthlo, depthhi, amplo, amphi);
+    return threshold_x8(depthlo, depthhi, amplo, amphi, vThreshold);
+}
+
+// packs the lane masks of 8 pixels into a byte of validity bits
+static inline uint8_t mask_bits_x8(const uint16x8_t& valid) {
+    const uint16x8_t bits = {1, 2, 4, 8, 16, 32, 64, 128};
+    return vaddvq_u16(vandq_u16(valid, bits));
+}
+
+// Picks the wrap of the fine depth that lies closest to the coarse depth. The wrap count is taken modulo the
+// number of fine ranges in the coarse one, since both depths wrap around together at the end of the coarse range.
+// A zero amplitude (of either frequency) marks the pixel invalid; a zero depth is a valid phase of 0.
+static inline float32x4_t unwrap_f32x4(
+        const float32x4_t& fine, const float32x4_t& coarse, const float32x4_t& amp, const float32x4_t& vRange,
+        const float32x4_t& vInvRange, const float32x4_t& vNumWraps) {
+    const float32x4_t vZero = vdupq_n_f32(0.0f);
+    float32x4_t wraps = vrndnq_f32(vmulq_f32(vsubq_f32(coarse, fine), vInvRange));
+    wraps = vbslq_f32(vcltq_f32(wraps, vZero), vaddq_f32(wraps, vNumWraps), wraps);
+    wraps = vbslq_f32(vcgeq_f32(wraps, vNumWraps), vsubq_f32(wraps, vNumWraps), wraps);
+    const uint32x4_t valid = vcgtq_f32(amp, vZero);
+    return vreinterpretq_f32_u32(vandq_u32(valid, vreinterpretq_u32_f32(vaddq_f32(fine, vmulq_f32(wraps, vRange)))));
+}
+
+static inline uint16x8_t cvt_u16x8(const float32x4_t& lo, const float32x4_t& hi) {
+    return vcombine_u16(vqmovn_u32(vcvtnq_u32_f32(lo)), vqmovn_u32(vcvtnq_u32_f32(hi)));
+}
+
+// stores 8 pixels
+static inline void store_x8(float* dst, const float32x4_t& lo, const float32x4_t& hi) {
+    vst1q_f32(dst + 0, lo);
+    vst1q_f32(dst + 4, hi);
+}
+
+static inline void store_x8(uint16_t* dst, const float32x4_t& lo, const float32x4_t& hi) {
+    vst1q_u16(dst, cvt_u16x8(lo, hi));
+}
+
+// stores 16 pixels whose even and odd pixels are held in val[0] and val[1]
+static inline void store_x16_interleaved(float* dst, const float32x4x2_t& lo, const float32x4x2_t& hi) {
+    vst2q_f32(dst + 0, lo);
+    vst2q_f32(dst + 8, hi);
+}
+
+static inline void store_x16_interleaved(uint16_t* dst, const float32x4x2_t& lo, const float32x4x2_t& hi) {
+    uint16x8x2_t v;
+    v.val[0] = cvt_u16x8(lo.val[0], hi.val[0]);
+    v.val[1] = cvt_u16x8(lo.val[1], hi.val[1]);
+    vst2q_u16(dst, v);
+}
+
+void unpack_y12p_neon(int16_t* dst, const void* src, const uint32_t width, const uint32_t height, const uint32_t bytesperline) {
+    for (uint32_t y = 0; y < height; y++) {
+        const uint8_t* line = static_cast<const uint8_t*>(src) + y * bytesperline;
+        uint32_t x = 0;
+        for (; x + 16 <= width; x += 16) {
+            int16x8x2_t p;
+            unpack_y12p_s16x8x2(vld3_u8(line + x / 2 * 3), p.val[0], p.val[1]);
+            vst2q_s16(dst + y * width + x, p);
+        }
+        unpack_y12p_scalar(dst + y * width + x, line + x / 2 * 3, width - x, 1, bytesperline);
+    }
+}
+
+template <bool EnableConfidence, Rotation rotation, Atan2 accuracy, class T>
+void compute_depth_confidence_neon(
+        T* depth, T* confidence, const int16_t* frame0, const int16_t* frame1, const int16_t* frame2, const int16_t* frame3,
+        const uint32_t num_pixels, const float modfreq_hz, const Threshold& threshold) {
+    static constexpr float C = 3e8;
+    const float range = C / (2.0f * modfreq_hz) * 1000.0f;
+    const float bias = 0.5f * range;
+    const float32x4_t vBias = vdupq_n_f32(bias);
+    const float32x4_t vScale = vdupq_n_f32(bias);
+    const bool thresholded = threshold.amplitude > 0.0f || threshold.mask;
+    const float32x4_t vThreshold = dup_threshold_f32x4(threshold.amplitude);
+
+    uint32_t i = 0;
+    for (; i + 8 <= num_pixels; i += 8) {
+        float32x4_t depthlo, depthhi, amplo, amphi;
+        const uint16x8_t valid = compute_thresholded_s16x8<EnableConfidence, rotation, accuracy>(
+                thresholded, vld1q_s16(frame0 + i), vld1q_s16(frame1 + i), vld1q_s16(frame2 + i), vld1q_s16(frame3 + i),
+                vBias, vScale, vThreshold, depthlo, depthhi, amplo, amphi);
+        store_x8(depth + i, depthlo, depthhi);
+        if constexpr (EnableConfidence) {
+            store_x8(confidence + i, amplo, amphi);
+        }
+        if (threshold.mask) {
+            threshold.mask[i / 8] = mask_bits_x8(valid);
+        }
+    }
+    if (i < num_pixels) {
+        // the remaining (< 8) pixels go through a zero padded copy
+        int16_t p[4][8] = {};
+        T d[8], c[8];
+        for (uint32_t j = 0; i + j < num_pixels; j++) {
+            p[0][j] = frame0[i + j];
+            p[1][j] = frame1[i + j];
+            p[2][j] = frame2[i + j];
+            p[3][j] = frame3[i + j];
+        }
+        float32x4_t depthlo, depthhi, amplo, amphi;
+        const uint16x8_t valid = compute_thresholded_s16x8<EnableConfidence, rotation, accuracy>(
+                thresholded, vld1q_s16(p[0]), vld1q_s16(p[1]), vld1q_s16(p[2]), vld1q_s16(p[3]), vBias, vScale, vThreshold,
+                depthlo, depthhi, amplo, amphi);
+        store_x8(d, depthlo, depthhi);
+        if constexpr (EnableConfidence) {
+            store_x8(c, amplo, amphi);
+        }
+        for (uint32_t j = 0; i + j < num_pixels; j++) {
+            depth[i + j] = d[j];
+            if constexpr (EnableConfidence) {
+                confidence[i + j] = c[j];
+            }
+        }
+        if (threshold.mask) {
+            // the bits of the padding are cleared
+            threshold.mask[i / 8] = mask_bits_x8(valid) & ((1u << (num_pixels - i)) - 1);
+        }
+    }
+}
+
+template <bool EnableConfidence, Rotation rotation, Atan2 accuracy, class T>
+void compute_depth_confidence_from_y12p_neon(
+        T* depth, T* confidence, const void* frame0, const void* frame1, const void* frame2, const void* frame3,
+        const uint32_t width, const uint32_t height, const uint32_t bytesperline, const float modfreq_hz,
+        const Threshold& threshold) {
+    static constexpr float C = 3e8;
+    const float range = C / (2.0f * modfreq_hz) * 1000.0f;
+    const float bias = 0.5f * range;
+    const float scale = bias;
+    const float32x4_t vBias = vdupq_n_f32(bias);
+    const float32x4_t vScale = vdupq_n_f32(scale);
+    const bool thresholded = threshold.amplitude > 0.0f || threshold.mask;
+    const float32x4_t vThreshold = dup_threshold_f32x4(threshold.amplitude);
+
+    for (uint32_t y = 0; y < height; y++) {
+        const uint8_t* line0 = static_cast<const uint8_t*>(frame0) + y * bytesperline;
+        const uint8_t* line1 = static_cast<const uint8_t*>(frame1) + y * bytesperline;
+        const uint8_t* line2 = static_cast<const uint8_t*>(frame2) + y * bytesperline;
+        const uint8_t* line3 = static_cast<const uint8_t*>(frame3) + y * bytesperline;
+        uint8_t* mask = threshold.mask ? threshold.mask + (width + 7) / 8 * y : nullptr;
+
+        uint32_t x = 0;
+        for (; x + 16 <= width; x += 16) {
+            const uint32_t offset = x / 2 * 3;
+            const uint8x8x3_t b0 = vld3_u8(line0 + offset);
+            const uint8x8x3_t b2 = vld3_u8(line2 + offset);
+            const uint8x8x3_t b3 = vld3_u8(line3 + offset);
+            const uint8x8x3_t b1 = vld3_u8(line1 + offset);
+            int16x8_t p0[2], p1[2], p2[2], p3[2];
+            unpack_y12p_s16x8x2(b0, p0[0], p0[1]);
+            unpack_y12p_s16x8x2(b1, p1[0], p1[1]);
+            unpack_y12p_s16x8x2(b2, p2[0], p2[1]);
+            unpack_y12p_s16x8x2(b3, p3[0], p3[1]);
+            float32x4x2_t depthlo;
+            float32x4x2_t depthhi;
+            float32x4x2_t amplo;
+            float32x4x2_t amphi;
+            uint16x8_t valid[2];
+            for (uint32_t i = 0; i < 2; i++) {
+                valid[i] = compute_thresholded_s16x8<EnableConfidence, rotation, accuracy>(
+                        thresholded, p0[i], p1[i], p2[i], p3[i], vBias, vScale, vThreshold, depthlo.val[i], depthhi.val[i],
+                        amplo.val[i], amphi.val[i]);
+            }
+            store_x16_interleaved(depth + y * width + x, depthlo, depthhi);
+            if constexpr (EnableConfidence) {
+                store_x16_interleaved(confidence + y * width + x, amplo, amphi);
+            }
+            if (mask) {
+                // interleaves the even and odd pixels back
+                mask[x / 8 + 0] = mask_bits_x8(vzip1q_u16(valid[0], valid[1]));
+                mask[x / 8 + 1] = mask_bits_x8(vzip2q_u16(valid[0], valid[1]));
+            }
+        }
+        if (x < width) {
+            // the remaining (< 16) pixels are unpacked and converted from int16
+            int16_t p[4][16];
+            unpack_y12p_scalar(p[0], line0 + x / 2 * 3, width - x, 1, bytesperline);
+            unpack_y12p_scalar(p[1], line1 + x / 2 * 3, width - x, 1, bytesperline);
+            unpack_y12p_scalar(p[2], line2 + x / 2 * 3, width - x, 1, bytesperline);
+            unpack_y12p_scalar(p[3], line3 + x / 2 * 3, width - x, 1, bytesperline);
+            compute_depth_confidence_neon<EnableConfidence, rotation, accuracy>(
+                    depth + y * width + x, confidence + y * width + x, p[0], p[1], p[2], p[3], width - x, modfreq_hz,
+                    {threshold.amplitude, mask ? mask + x / 8 : nullptr});
+        }
+    }
+}
+
+template <bool EnableConfidence, Rotation rotation, Atan2 accuracy, class T>
+void compute_unwrapped_depth_confidence_from_y12p_neon(
+        T* depth, T* confidence, const void* const fine[4], const void* const coarse[4], const uint32_t width,
+        const uint32_t height, const uint32_t bytesperline, const float fine_modfreq_hz, const float coarse_modfreq_hz,
+        const Threshold& threshold) {
+    static constexpr float C = 3e8;
+    const float fine_range = C / (2.0f * fine_modfreq_hz) * 1000.0f;
+    const float coarse_range = C / (2.0f * coarse_modfreq_hz) * 1000.0f;
+    const float32x4_t vFineBias = vdupq_n_f32(0.5f * fine_range);
+    const float32x4_t vCoarseBias = vdupq_n_f32(0.5f * coarse_range);
+    const float32x4_t vRange = vdupq_n_f32(fine_range);
+    const float32x4_t vInvRange = vdupq_n_f32(1.0f / fine_range);
+    const float32x4_t vNumWraps = vdupq_n_f32(std::round(fine_modfreq_hz / coarse_modfreq_hz));
+    const bool thresholded = threshold.amplitude > 0.0f || threshold.mask;
+    const float32x4_t vThreshold = dup_threshold_f32x4(threshold.amplitude);
+
+    for (uint32_t y = 0; y < height; y++) {
+        const uint8_t* line[8];
+        for (uint32_t i = 0; i < 4; i++) {
+            line[i] = static_cast<const uint8_t*>(fine[i]) + y * bytesperline;
+            line[i + 4] = static_cast<const uint8_t*>(coarse[i]) + y * bytesperline;
+        }
+        uint8_t* mask = threshold.mask ? threshold.mask + (width + 7) / 8 * y : nullptr;
+
+        uint32_t x = 0;
+        for (; x + 16 <= width; x += 16) {
+            const uint32_t offset = x / 2 * 3;
+            int16x8_t p[8][2];
+            for (uint32_t i = 0; i < 8; i++) {
+                unpack_y12p_s16x8x2(vld3_u8(line[i] + offset), p[i][0], p[i][1]);
+            }
+            float32x4x2_t depthlo;
+            float32x4x2_t depthhi;
+            float32x4x2_t amplo;
+            float32x4x2_t amphi;
+            uint16x8_t valid[2] = {vdupq_n_u16(0xFFFF), vdupq_n_u16(0xFFFF)};
+            for (uint32_t i = 0; i < 2; i++) {
+                // the amplitudes are needed for the validity even without confidence
+                float32x4_t coarselo, coarsehi, coarseamplo, coarseamphi;
+                compute_depth_confidence_s16x8<true, rotation, accuracy>(
+                        p[0][i], p[1][i], p[2][i], p[3][i], vFineBias, vFineBias, depthlo.val[i], depthhi.val[i],
+                        amplo.val[i], amphi.val[i]);
+                compute_depth_confidence_s16x8<true, rotation, accuracy>(
+                        p[4][i], p[5][i], p[6][i], p[7][i], vCoarseBias, vCoarseBias, coarselo, coarsehi, coarseamplo,
+                        coarseamphi);
+                amplo.val[i] = vminq_f32(amplo.val[i], coarseamplo);
+                amphi.val[i] = vminq_f32(amphi.val[i], coarseamphi);
+                depthlo.val[i] = unwrap_f32x4(depthlo.val[i], coarselo, amplo.val[i], vRange, vInvRange, vNumWraps);
+                depthhi.val[i] = unwrap_f32x4(depthhi.val[i], coarsehi, amphi.val[i], vRange, vInvRange, vNumWraps);
+                if (thresholded) {
+                    valid[i] = threshold_x8(depthlo.val[i], depthhi.val[i], amplo.val[i], amphi.val[i], vThreshold);
+                }
+            }
+            store_x16_interleaved(depth + y * width + x, depthlo, depthhi);
+            if constexpr (EnableConfidence) {
+                store_x16_interleaved(confidence + y * width + x, amplo, amphi);
+            }
+            if (mask) {
+                mask[x / 8 + 0] = mask_bits_x8(vzip1q_u16(valid[0], valid[1]));
+                mask[x / 8 + 1] = mask_bits_x8(vzip2q_u16(valid[0], valid[1]));
+            }
+        }
+        if (x < width) {
+            // the remaining (< 16) pixels
+            const void* fine_tail[4];
+            const void* coarse_tail[4];
+            for (uint32_t i = 0; i < 4; i++) {
+                fine_tail[i] = line[i] + x / 2 * 3;
+                coarse_tail[i] = line[i + 4] + x / 2 * 3;
+            }
+            compute_unwrapped_depth_confidence_from_y12p_scalar<EnableConfidence, rotation, accuracy>(
+                    depth + y * width + x, confidence + y * width + x, fine_tail, coarse_tail, width - x, 1, bytesperline,
+                    fine_modfreq_hz, coarse_modfreq_hz, {threshold.amplitude, mask ? mask + x / 8 : nullptr});
+        }
+    }
+}
+
+template <bool EnableConfidence, Rotation rotation, Atan2 accuracy, class T>
+void compute_binned_depth_confidence_from_y12p_neon(
+        T* depth, T* confidence, const void* frame0, const void* frame1, const void* frame2, const void* frame3,
+        const uint32_t width, const uint32_t height, const uint32_t bytesperline, const float modfreq_hz,
+        const Threshold& threshold) {
+    static constexpr float C = 3e8;
+    const float range = C / (2.0f * modfreq_hz) * 1000.0f;
+    const float32x4_t vBias = vdupq_n_f32(0.5f * range);
+    const float32x4_t vQuarter = vdupq_n_f32(0.25f);
+    const bool thresholded = threshold.amplitude > 0.0f || threshold.mask;
+    // against the amplitude of the sum, four times the mean
+    const float32x4_t vThreshold = dup_threshold_f32x4(threshold.amplitude * 4.0f);
+    const void* frames[4] = {frame0, frame1, frame2, frame3};
+    const uint32_t binned_width = width / 2;
+
+    for (uint32_t y = 0; y < height / 2; y++) {
+        const uint8_t* line[4];
+        for (uint32_t i = 0; i < 4; i++) {
+            line[i] = static_cast<const uint8_t*>(frames[i]) + y * 2 * bytesperline;
+        }
+        T* depth_line = depth + y * binned_width;
+        T* confidence_line = confidence + y * binned_width;
+        uint8_t* mask = threshold.mask ? threshold.mask + (binned_width + 7) / 8 * y : nullptr;
+
+        uint32_t x = 0;
+        for (; x + 16 <= width; x += 16) {
+            const uint32_t offset = x / 2 * 3;
+            int16x8_t p[4];
+            for (uint32_t i = 0; i < 4; i++) {
+                // the even and odd pixels of both lines, their sum fits in int16
+                int16x8_t upper[2], lower[2];
+                unpack_y12p_s16x8x2(vld3_u8(line[i] + offset), upper[0], upper[1]);
+                unpack_y12p_s16x8x2(vld3_u8(line[i] + bytesperline + offset), lower[0], lower[1]);
+                p[i] = vaddq_s16(vaddq_s16(upper[0], upper[1]), vaddq_s16(lower[0], lower[1]));
+            }
+            float32x4_t depthlo, depthhi, amplo, amphi;
+            const uint16x8_t valid = compute_thresholded_s16x8<EnableConfidence, rotation, accuracy>(
+                    thresholded, p[0], p[1], p[2], p[3], vBias, vBias, vThreshold, depthlo, depthhi, amplo, amphi);
+            store_x8(depth_line + x / 2, depthlo, depthhi);
+            if constexpr (EnableConfidence) {
+                // the mean amplitude of the 2x2 block
+                store_x8(confidence_line + x / 2, vmulq_f32(amplo, vQuarter), vmulq_f32(amphi, vQuarter));
+            }
+            if (mask) {
+                mask[x / 16] = mask_bits_x8(valid);
+            }
+        }
+        if (x + 1 < width) {
+            // the remaining (< 16) pixels
+            const uint32_t offset = x / 2 * 3;
+            compute_binned_depth_confidence_from_y12p_scalar<EnableConfidence, rotation, accuracy>(
+                    depth_line + x / 2, confidence_line + x / 2, line[0] + offset, line[1] + offset, line[2] + offset,
+                    line[3] + offset, width - x, 2, bytesperline, modfreq_hz,
+                    {threshold.amplitude, mask ? mask + x / 16 : nullptr});
+        }
+    }
+}
+
+static inline float32x4_t load_f32x4(const float* src) {
+    return vld1q_f32(src);
+}
+
+static inline float32x4_t load_f32x4(const uint16_t* src) {
+    return vcvtq_f32_u32(vmovl_u16(vld1_u16(src)));
+}
+
+// stores 4 points whose x, y and z are held in val[0], val[1] and val[2]
+static inline void store_xyz_x4(float* dst, const float32x4x3_t& xyz) {
+    vst3q_f32(dst, xyz);
+}
+
+static inline void store_xyz_x4(int16_t* dst, const float32x4x3_t& xyz) {
+    int16x4x3_t v;
+    for (uint32_t k = 0; k < 3; k++) {
+        v.val[k] = vqmovn_s32(vcvtnq_s32_f32(xyz.val[k]));
+    }
+    vst3_s16(dst, v);
+}
+
+template <class T, class P>
+void compute_xyz_neon(P* xyz, const T* depth, const float* rays, const uint32_t num_pixels) {
+    uint32_t i = 0;
+    for (; i + 4 <= num_pixels; i += 4) {
+        const float32x4_t d = load_f32x4(depth + i);
+        float32x4x3_t points = vld3q_f32(rays + i * 3);
+        for (uint32_t k = 0; k < 3; k++) {
+            points.val[k] = vmulq_f32(points.val[k], d);
+        }
+        store_xyz_x4(xyz + i * 3, points);
+    }
+    compute_xyz_scalar(xyz + i * 3, depth + i, rays + i * 3, num_pixels - i);
+}
+
+// the filtered depth of 4 pixels, the history is updated
+static inline float32x4_t temporal_filter_x4(
+        const float32x4_t& depth, const float32x4_t& amplitude, float* history, float* history_amplitude,
+        const TemporalFilter& filter) {
+    const float32x4_t h = vld1q_f32(history);
+    const float32x4_t diff = vsubq_f32(depth, h);
+    uint32x4_t restart = vorrq_u32(vceqzq_f32(depth), vceqzq_f32(h));
+    restart = vorrq_u32(restart, vcagtq_f32(diff, vdupq_n_f32(filter.depth_jump)));
+    if (history_amplitude) {
+        const float32x4_t ha = vld1q_f32(history_amplitude);
+        restart = vorrq_u32(restart, vcagtq_f32(vsubq_f32(amplitude, ha), vmulq_n_f32(ha, filter.amplitude_jump)));
+        vst1q_f32(history_amplitude, amplitude);
+    }
+    const float32x4_t filtered = vbslq_f32(restart, depth, vfmaq_n_f32(h, diff, filter.alpha));
+    vst1q_f32(history, filtered);
+    return filtered;
+}
+
+template <class T>
+void compute_temporal_filter_neon(
+        T* depth, const T* confidence, float* history, float* history_amplitude, const uint32_t num_pixels,
+        const TemporalFilter& filter) {
+    uint32_t i = 0;
+    for (; i + 8 <= num_pixels; i += 8) {
+        float32x4_t filtered[2];
+        for (uint32_t j = 0; j < 2; j++) {
+            const uint32_t k = i + j * 4;
+            const float32x4_t amplitude = confidence ? load_f32x4(confidence + k) : vdupq_n_f32(0.0f);
+            filtered[j] = temporal_filter_x4(
+                    load_f32x4(depth + k), amplitude, history + k, confidence ? history_amplitude + k : nullptr, filter);
+        }
+        store_x8(depth + i, filtered[0], filtered[1]);
+    }
+    compute_temporal_filter_scalar(
+            depth + i, confidence ? confidence + i : nullptr, history + i, confidence ? history_amplitude + i : nullptr,
+            num_pixels - i, filter);
+}
+
+// row kernels of filter_spatial_rows
+struct SpatialNeon {
+    static constexpr uint32_t lanes = 4;
+
+    static float32x4_t min(const float32x4_t a, const float32x4_t b) {
+        return vminq_f32(a, b);
+    }
+
+    static float32x4_t max(const float32x4_t a, const float32x4_t b) {
+        return vmaxq_f32(a, b);
+    }
+
+    template <int R>
+    static float32x4_t median_x4(const float* const rows[5], const uint32_t x) {
+        float32x4_t v[(R * 2 + 1) * (R * 2 + 1)];
+        uint32_t i = 0;
+        for (ptrdiff_t dy = -R; dy <= R; dy++) {
+            for (ptrdiff_t dx = -R; dx <= R; dx++) {
+                v[i++] = vld1q_f32(rows[2 + dy] + x + dx);
+            }
+        }
+        return median<SpatialNeon>(v);
+    }
+
+    static void flying_median(float* out, const float* const rows[5], const uint32_t width, const SpatialFilter& filter) {
+        const float32x4_t limit = vdupq_n_f32(filter.flying_pixel);
+        for (uint32_t x = 0; x < width; x += 4) {
+            const float32x4_t c = vld1q_f32(rows[2] + x);
+            const auto far = [&](const float* n) { return vcagtq_f32(vsubq_f32(c, vld1q_f32(n)), limit); };
+            uint32x4_t invalid = vceqzq_f32(c);
+            if (filter.flying_pixel > 0.0f) {
+                const uint32x4_t horizontal = vandq_u32(far(rows[2] + x - 1), far(rows[2] + x + 1));
+                const uint32x4_t vertical = vandq_u32(far(rows[1] + x), far(rows[3] + x));
+                invalid = vorrq_u32(invalid, vorrq_u32(horizontal, vertical));
+            }
+            const float32x4_t result = filter.median == 3 ? median_x4<1>(rows, x)
+                                       : filter.median == 5 ? median_x4<2>(rows, x)
+                                                            : c;
+            vst1q_f32(out + x, vbslq_f32(invalid, vdupq_n_f32(0.0f), result));
+        }
+    }
+
+    static void smooth(
+            float* out, const float* const depth[3], const float* const amplitude[3], const uint32_t width,
+            const SpatialFilter& filter) {
+        const float32x4_t zero = vdupq_n_f32(0.0f);
+        const float32x4_t limit = vdupq_n_f32(filter.smoothing);
+        for (uint32_t x = 0; x < width; x += 4) {
+            const float32x4_t c = vld1q_f32(depth[1] + x);
+            float32x4_t sum = zero;
+            float32x4_t weights = zero;
+            for (uint32_t dy = 0; dy < 3; dy++) {
+                for (ptrdiff_t dx = -1; dx <= 1; dx++) {
+                    const float32x4_t n = vld1q_f32(depth[dy] + x + dx);
+                    const uint32x4_t drop = vorrq_u32(vceqzq_f32(n), vcagtq_f32(vsubq_f32(n, c), limit));
+                    const float32x4_t a = amplitude ? vld1q_f32(amplitude[dy] + x + dx) : vdupq_n_f32(1.0f);
+                    const float32x4_t w = vbslq_f32(drop, zero, vmulq_f32(a, a));
+                    sum = vfmaq_f32(sum, w, n);
+                    weights = vaddq_f32(weights, w);
+                }
+            }
+            const float32x4_t mean = vbslq_f32(vcgtzq_f32(weights), vdivq_f32(sum, weights), c);
+            vst1q_f32(out + x, vbslq_f32(vceqzq_f32(c), zero, mean));
+        }
+    }
+};
+
+template <class T>
+void compute_spatial_filter_neon(
+        T* dst, const T* depth, const T* confidence, const uint32_t width, const uint32_t height, const uint32_t begin,
+        const uint32_t end, const SpatialFilter& filter) {
+    filter_spatial_rows<SpatialNeon>(dst, depth, confidence, width, height, begin, end, filter);
+}
+
+#define INSTANTIATE(EnableConfidence, rotation, accuracy, T)                                                                 \
+    template void compute_depth_confidence_neon<EnableConfidence, rotation, accuracy, T>(                                    \
+            T*, T*, const int16_t*, const int16_t*, const int16_t*, const int16_t*, const uint32_t, const float,             \
+            const Threshold&);                                                                                               \
+    template void compute_depth_confidence_from_y12p_neon<EnableConfidence, rotation, accuracy, T>(                          \
+            T*, T*, const void*, const void*, const void*, const void*, const uint32_t, const uint32_t, const uint32_t,      \
+            const float, const Threshold&);                                                                                  \
+    template void compute_unwrapped_depth_confidence_from_y12p_neon<EnableConfidence, rotation, accuracy, T>(                \
+            T*, T*, const void* const[4], const void* const[4], const uint32_t, const uint32_t, const uint32_t, const float, \
+            const float, const Threshold&);                                                                                  \
+    template void compute_binned_depth_confidence_from_y12p_neon<EnableConfidence, rotation, accuracy, T>(                   \
+            T*, T*, const void*, const void*, const void*, const void*, const uint32_t, const uint32_t, const uint32_t,      \
+            const float, const Threshold&);
+
+#define INSTANTIATE_ATAN2(EnableConfidence, rotation, T)                                                                     \
+    INSTANTIATE(EnableConfidence, rotation, Atan2::Fast, T)                                                                  \
+    INSTANTIATE(EnableConfidence, rotation, Atan2::Default, T)                                                               \
+    INSTANTIATE(EnableConfidence, rotation, Atan2::Poly3, T)                                                                 \
+    INSTANTIATE(EnableConfidence, rotation, Atan2::Poly5, T)
+
+INSTANTIATE_ATAN2(true, Rotation::Zero, float)
+INSTANTIATE_ATAN2(true, Rotation::Quarter, float)
+INSTANTIATE_ATAN2(true, Rotation::Half, float)
+INSTANTIATE_ATAN2(true, Rotation::ThreeQuarters, float)
+INSTANTIATE_ATAN2(false, Rotation::Zero, float)
+INSTANTIATE_ATAN2(false, Rotation::Quarter, float)
+INSTANTIATE_ATAN2(false, Rotation::Half, float)
+INSTANTIATE_ATAN2(false, Rotation::ThreeQuarters, float)
+INSTANTIATE_ATAN2(true, Rotation::Zero, uint16_t)
+INSTANTIATE_ATAN2(true, Rotation::Quarter, uint16_t)
+INSTANTIATE_ATAN2(true, Rotation::Half, uint16_t)
+INSTANTIATE_ATAN2(true, Rotation::ThreeQuarters, uint16_t)
+INSTANTIATE_ATAN2(false, Rotation::Zero, uint16_t)
+INSTANTIATE_ATAN2(false, Rotation::Quarter, uint16_t)
+INSTANTIATE_ATAN2(false, Rotation::Half, uint16_t)
+INSTANTIATE_ATAN2(false, Rotation::ThreeQuarters, uint16_t)
+
+#define INSTANTIATE_XYZ(T, P) template void compute_xyz_neon<T, P>(P*, const T*, const float*, const uint32_t);
+
+INSTANTIATE_XYZ(float, float)
+INSTANTIATE_XYZ(float, int16_t)
+INSTANTIATE_XYZ(uint16_t, float)
+INSTANTIATE_XYZ(uint16_t, int16_t)
+
+#define INSTANTIATE_FILTER(T)                                                                                                \
+    template void compute_temporal_filter_neon<T>(T*, const T*, float*, float*, const uint32_t, const TemporalFilter&);
+
+INSTANTIATE_FILTER(float)
+INSTANTIATE_FILTER(uint16_t)
+
+#define INSTANTIATE_SPATIAL(T)                                                                                               \
+    template void compute_spatial_filter_neon<T>(                                                                            \
+            T*, const T*, const T*, const uint32_t, const uint32_t, const uint32_t, const uint32_t, const SpatialFilter&);
+
+INSTANTIATE_SPATIAL(float)
+INSTANTIATE_SPATIAL(uint16_t)
+
+} // namespace tofcam
@@ -0,0 +1,32 @@
+#pragma once
+
+#include <cstdint>
+#include <cstdio>
+
+// The checks of the tests: a failed expect() is printed and counted, report() prints the verdict of the test and
+// returns its exit code.
+
+inline uint32_t failures = 0;
+
+inline void expect(const bool condition, const char* test, const char* what) {
+    if (!condition) {
+        fprintf(stderr, "%s: %s\n", test, what);
+        failures++;
+    }
+}
+
+// true when `f` throws E
+template <class E, class F>
+bool throws(const F& f) {
+    try {
+        f();
+    } catch (const E&) {
+        return true;
+    }
+    return false;
+}
+
+inline int report(const char* name) {
+    printf("%s: %s\n", name, failures == 0 ? "ok" : "failed");
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,191 @@
+#include "check.hpp"
+#include <chrono>
+#include <cstdint>
+#include <fakecam.hpp>
+#include <recording.hpp>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#include <vector>
+
+// The paced replay of FakeCamera: consecutive frames while a buffer is queued, frames lost as gaps in the sequence
+// numbers while every buffer is held, the timeouts of dequeue(), the checks of enqueue(), the error when no buffer is
+// queued, and the same jitter for the same seed.
+
+using namespace tofcam;
+
+static constexpr uint32_t NUM_FRAMES = 6;
+
+// a recording of NUM_FRAMES small frames, each filled with its index
+static void write_recording(const std::string& path) {
+    RecordingFormat format;
+    format.width = 16;
+    format.height = 4;
+    format.bytesperline = 24;
+    format.sizeimage = format.bytesperline * format.height;
+    RecordingWriter writer(path.c_str(), format);
+    std::vector<uint8_t> frame(format.sizeimage);
+    for (uint32_t i = 0; i < NUM_FRAMES; i++) {
+        std::fill(frame.begin(), frame.end(), uint8_t(i));
+        writer.write(frame.data(), {i, {}});
+    }
+}
+
+static ReplayPacing make_pacing(const double fps, const uint32_t num_buffers) {
+    ReplayPacing pacing;
+    pacing.fps = fps;
+    pacing.num_buffers = num_buffers;
+    return pacing;
+}
+
+// unpaced: every frame is ready at once, in the order of the recording
+static void test_unpaced(const std::string& path) {
+    const char* test = "unpaced";
+    FakeCamera camera(path.c_str());
+    camera.stream_on();
+    for (uint32_t i = 0; i < NUM_FRAMES * 2; i++) {
+        const auto frame = camera.try_dequeue();
+        expect(frame && frame->second == i % NUM_FRAMES, test, "wrong buffer");
+        expect(frame && *static_cast<uint8_t*>(frame->first) == i % NUM_FRAMES, test, "wrong frame");
+        expect(camera.get_info().sequence == i, test, "wrong sequence");
+        camera.enqueue(frame->second);
+    }
+    expect(camera.get_telemetry().dropped.load() == 0, test, "frames are lost");
+}
+
+// a buffer is always queued: consecutive frames completing one period apart
+static void test_consecutive(const std::string& path) {
+    const char* test = "consecutive";
+    const auto period = std::chrono::milliseconds(5);
+    FakeCamera camera(path.c_str());
+    camera.set_pacing(make_pacing(200, 4));
+    camera.stream_on();
+    FrameInfo previous = {};
+    for (uint32_t i = 0; i < NUM_FRAMES + 2; i++) {
+        const auto frame = camera.dequeue();
+        const FrameInfo info = camera.get_info();
+        expect(info.sequence == i, test, "the sequence has a gap");
+        expect(*static_cast<uint8_t*>(frame.first) == i % NUM_FRAMES, test, "wrong frame");
+        expect(frame.second < 4, test, "wrong buffer");
+        // the period is rounded to nanoseconds
+        expect(i == 0 || std::chrono::abs(info.timestamp - previous.timestamp - period) < std::chrono::microseconds(1), test,
+               "the frames are not one period apart");
+        expect(info.timestamp <= std::chrono::steady_clock::now(), test, "the frame completes in the future");
+        previous = info;
+        camera.enqueue(frame.second);
+    }
+    expect(camera.get_telemetry().frames.load() == NUM_FRAMES + 2, test, "wrong frame count");
+    expect(camera.get_telemetry().dropped.load() == 0, test, "frames are lost");
+}
+
+// the frames that complete while the caller holds every buffer are lost
+static void test_drops(const std::string& path) {
+    const char* test = "drops";
+    FakeCamera camera(path.c_str());
+    camera.set_pacing(make_pacing(500, 2));
+    camera.stream_on();
+    const auto first = camera.dequeue();
+    const auto second = camera.dequeue();
+    const uint32_t last = camera.get_info().sequence;
+    expect(first.second != second.second, test, "a buffer is dequeued twice");
+    // 10 periods with no buffer queued
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    camera.enqueue(first.second);
+    const auto next = camera.dequeue();
+    const uint32_t sequence = camera.get_info().sequence;
+    expect(next.second == first.second, test, "not the buffer given back");
+    expect(sequence >= last + 10, test, "no frame is lost while every buffer is held");
+    expect(camera.get_telemetry().dropped.load() == sequence - last - 1, test, "the lost frames are not counted");
+    camera.enqueue(second.second);
+    camera.enqueue(next.second);
+}
+
+// dequeue() with a timeout returns std::nullopt before the first frame completes
+static void test_timeout(const std::string& path) {
+    const char* test = "timeout";
+    FakeCamera camera(path.c_str());
+    camera.set_pacing(make_pacing(5, 2)); // the first frame completes after 200ms
+    camera.stream_on();
+    expect(!camera.try_dequeue(), test, "a frame is ready at once");
+    const auto start = std::chrono::steady_clock::now();
+    expect(!camera.dequeue(std::chrono::milliseconds(20)), test, "a frame completes within the timeout");
+    expect(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(20), test, "dequeue() returns early");
+    expect(camera.dequeue(std::chrono::seconds(5)).has_value(), test, "no frame completes");
+    expect(camera.get_telemetry().wait.count() == 1, test, "the timeouts are recorded as waits");
+}
+
+// enqueue() only takes dequeued buffers, dequeue() throws when no buffer is queued or the stream is off
+static void test_errors(const std::string& path) {
+    const char* test = "errors";
+    FakeCamera camera(path.c_str());
+    camera.set_pacing(make_pacing(1000, 2));
+    expect(throws<std::runtime_error>([&] { camera.try_dequeue(); }), test, "dequeue() before stream_on()");
+    camera.stream_on();
+    expect(throws<std::runtime_error>([&] { camera.set_pacing(make_pacing(10, 2)); }), test,
+           "the pacing changes while streaming");
+    expect(throws<std::invalid_argument>([&] { camera.enqueue(0); }), test, "a queued buffer is enqueued");
+    expect(throws<std::invalid_argument>([&] { camera.enqueue(2); }), test, "a buffer out of range is enqueued");
+    const auto first = camera.dequeue();
+    const auto second = camera.dequeue();
+    // every buffer held, as POLLERR on the camera
+    expect(throws<std::runtime_error>([&] { camera.dequeue(); }), test, "dequeue() waits with no buffer queued");
+    expect(throws<std::runtime_error>([&] { camera.dequeue(std::chrono::milliseconds(10)); }), test,
+           "dequeue(timeout) waits with no buffer queued");
+    camera.enqueue(first.second);
+    expect(throws<std::invalid_argument>([&] { camera.enqueue(first.second); }), test, "a buffer is enqueued twice");
+    camera.enqueue(second.second);
+    camera.stream_off();
+    expect(throws<std::runtime_error>([&] { camera.dequeue(); }), test, "dequeue() after stream_off()");
+    ReplayPacing pacing = make_pacing(30, 0);
+    expect(throws<std::invalid_argument>([&] { camera.set_pacing(pacing); }), test, "a paced replay without buffers");
+    pacing = make_pacing(-1, 2);
+    expect(throws<std::invalid_argument>([&] { camera.set_pacing(pacing); }), test, "a negative frame rate");
+}
+
+// the intervals between the frames of `count` frames replayed with jitter
+static std::vector<std::chrono::nanoseconds> intervals(const std::string& path, const uint64_t seed, const uint32_t count) {
+    FakeCamera camera(path.c_str());
+    ReplayPacing pacing = make_pacing(200, 4);
+    pacing.jitter = std::chrono::microseconds(3000);
+    pacing.seed = seed;
+    camera.set_pacing(pacing);
+    camera.stream_on();
+    std::vector<std::chrono::nanoseconds> intervals;
+    FrameInfo previous = {};
+    for (uint32_t i = 0; i < count; i++) {
+        const auto frame = camera.dequeue();
+        if (i > 0) {
+            intervals.push_back(camera.get_info().timestamp - previous.timestamp);
+        }
+        previous = camera.get_info();
+        camera.enqueue(frame.second);
+    }
+    return intervals;
+}
+
+// the same seed replays the same jitter, and late frames do not overtake each other
+static void test_jitter(const std::string& path) {
+    const char* test = "jitter";
+    const auto first = intervals(path, 42, 16);
+    const auto second = intervals(path, 42, 16);
+    const auto other = intervals(path, 7, 16);
+    expect(first == second, test, "the same seed gives another jitter");
+    expect(first != other, test, "another seed gives the same jitter");
+    for (const auto interval : first) {
+        expect(interval.count() >= 0, test, "a frame overtakes the previous one");
+    }
+}
+
+int main() {
+    const std::string path = "/tmp/tofcam_fakecam_test_" + std::to_string(::getpid()) + ".rec";
+    write_recording(path);
+    test_unpaced(path);
+    test_consecutive(path);
+    test_drops(path);
+    test_timeout(path);
+    test_errors(path);
+    test_jitter(path);
+    ::unlink(path.c_str());
+    return report("fakecam");
+}
@@ -0,0 +1,156 @@
+#include "check.hpp"
+#include <chrono>
+#include <cstdint>
+#include <framering.hpp>
+#include <optional>
+#include <poll.h>
+#include <thread>
+#include <vector>
+
+// The hand-over of FrameRing: the order of the frames with Overflow::Block, the newest frame and the dropped count with
+// Overflow::DropOldest, close() waking both sides, the timeouts of pop() and the readiness of the fd.
+
+using namespace tofcam;
+
+static bool readable(const FrameRing& ring) {
+    struct pollfd pfd = {};
+    pfd.fd = ring.get_fd();
+    pfd.events = POLLIN;
+    return ::poll(&pfd, 1, 0) == 1 && (pfd.revents & POLLIN);
+}
+
+// every frame is read once and in order, while the producer waits for the slots
+static void test_block_order() {
+    const char* test = "block order";
+    constexpr uint32_t NUM_SLOTS = 3;
+    constexpr uint64_t NUM_FRAMES = 20000;
+    FrameRing ring(NUM_SLOTS, Overflow::Block);
+    std::vector<uint64_t> payload(NUM_SLOTS);
+    std::thread producer([&] {
+        for (uint64_t i = 0; i < NUM_FRAMES; i++) {
+            const auto slot = ring.acquire();
+            if (!slot) {
+                return;
+            }
+            payload[slot.value()] = i;
+            ring.publish(slot.value());
+        }
+    });
+    uint64_t expected = 0;
+    bool ordered = true;
+    while (expected < NUM_FRAMES) {
+        const auto slot = ring.pop(std::chrono::seconds(5));
+        if (!slot) {
+            break;
+        }
+        ordered = ordered && payload[slot.value()] == expected;
+        expected++;
+    }
+    ring.close();
+    producer.join();
+    expect(expected == NUM_FRAMES, test, "frames are missing");
+    expect(ordered, test, "frames are out of order");
+    expect(ring.get_dropped() == 0, test, "frames are dropped");
+    expect(!ring.try_acquire() && !ring.acquire(), test, "a closed ring lends slots");
+}
+
+// the consumer gets the newest frame, the older unread ones are dropped
+static void test_drop_oldest() {
+    const char* test = "drop oldest";
+    constexpr uint32_t NUM_SLOTS = 3;
+    FrameRing ring(NUM_SLOTS, Overflow::DropOldest);
+    std::vector<uint64_t> payload(NUM_SLOTS);
+    expect(!readable(ring), test, "an empty ring is readable");
+    // 2 frames overwritten by the producer
+    for (uint64_t i = 0; i < 5; i++) {
+        const auto slot = ring.acquire();
+        expect(slot.has_value(), test, "the producer waits");
+        payload[slot.value()] = i;
+        ring.publish(slot.value());
+    }
+    expect(ring.get_dropped() == 2, test, "frames overwritten by the producer are not counted");
+    expect(readable(ring), test, "the ring is not readable with frames ready");
+    const auto slot = ring.try_pop();
+    expect(slot && payload[slot.value()] == 4, test, "not the newest frame");
+    // 2 more dropped by the consumer
+    expect(ring.get_dropped() == 4, test, "frames skipped by the consumer are not counted");
+    expect(!readable(ring), test, "the ring is readable without frames ready");
+    // the slot held by the consumer is not overwritten
+    for (uint64_t i = 5; i < 10; i++) {
+        const auto next = ring.try_acquire();
+        expect(next && next.value() != slot.value(), test, "the producer takes the slot held by the consumer");
+        payload[next.value()] = i;
+        ring.publish(next.value());
+    }
+    expect(payload[slot.value()] == 4, test, "the slot held by the consumer is overwritten");
+    const auto last = ring.try_pop();
+    expect(last && payload[last.value()] == 9, test, "not the newest frame");
+    expect(!ring.try_pop(), test, "a dropped frame is read");
+}
+
+// close() wakes a producer waiting for a slot and a consumer waiting for a frame
+static void test_close() {
+    const char* test = "close";
+    const auto timeout = std::chrono::seconds(5);
+    {
+        FrameRing ring(3, Overflow::Block);
+        for (uint32_t i = 0; i < 3; i++) {
+            ring.publish(ring.acquire().value());
+        }
+        expect(!ring.try_acquire(), test, "a full ring lends a slot");
+        std::optional<uint32_t> slot = 0;
+        std::thread producer([&] { slot = ring.acquire(); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        const auto start = std::chrono::steady_clock::now();
+        ring.close();
+        producer.join();
+        expect(!slot, test, "the producer gets a slot after close()");
+        expect(std::chrono::steady_clock::now() - start < timeout, test, "the producer is not woken");
+        // the frames published before are still read
+        uint32_t read = 0;
+        while (ring.pop(timeout)) {
+            read++;
+        }
+        expect(read == 3, test, "the frames ready are lost on close()");
+    }
+    {
+        FrameRing ring(3, Overflow::Block);
+        std::optional<uint32_t> slot = 0;
+        const auto start = std::chrono::steady_clock::now();
+        std::thread consumer([&] { slot = ring.pop(timeout); });
+        std::this_thread::sleep_for(std::chrono::milliseconds(50));
+        ring.close();
+        consumer.join();
+        expect(!slot, test, "the consumer gets a frame after close()");
+        expect(std::chrono::steady_clock::now() - start < timeout, test, "the consumer is not woken");
+        expect(ring.is_closed(), test, "the ring is not closed");
+    }
+}
+
+// pop() waits for `timeout` at least when nothing is published, and returns a frame published meanwhile
+static void test_timeout() {
+    const char* test = "timeout";
+    FrameRing ring(3, Overflow::Block);
+    expect(!ring.try_pop(), test, "an empty ring returns a frame");
+    expect(!ring.pop(std::chrono::milliseconds(0)), test, "an empty ring returns a frame");
+    auto start = std::chrono::steady_clock::now();
+    expect(!ring.pop(std::chrono::milliseconds(50)), test, "an empty ring returns a frame");
+    expect(std::chrono::steady_clock::now() - start >= std::chrono::milliseconds(50), test, "pop() returns early");
+    std::thread producer([&] {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        ring.publish(ring.acquire().value());
+    });
+    start = std::chrono::steady_clock::now();
+    const auto slot = ring.pop(std::chrono::seconds(5));
+    producer.join();
+    expect(slot.has_value(), test, "a frame published during the wait is not returned");
+    expect(std::chrono::steady_clock::now() - start < std::chrono::seconds(5), test, "pop() waits for the timeout");
+}
+
+int main() {
+    test_block_order();
+    test_drop_oldest();
+    test_close();
+    test_timeout();
+    return report("framering");
+}
@@ -0,0 +1,493 @@
+#include "check.hpp"
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <string>
+#include <threadpool.hpp>
+#include <type_traits>
+#include <utility.hpp>
+#include <utility>
+#include <vector>
+
+// Every kernel family on every instruction set the CPU supports against the scalar one, at odd widths that leave a
+// tail to the 8, 16 and 32 pixel loops: the outputs agree within 1e-4 (a rounding step for the 16-bit ones) and the
+// masks bit for bit. Then the ThreadPool overloads and the row bands of BO548 against one single threaded call, to the
+// bit, with heights that the bands do not divide evenly.
+
+using namespace tofcam;
+
+static constexpr uint32_t WIDTH = 77;
+static constexpr uint32_t HEIGHT = 6;
+static constexpr uint32_t BYTESPERLINE = (WIDTH + 1) / 2 * 3 + 6; // padded
+static constexpr uint32_t NUM_PIXELS = WIDTH * HEIGHT;
+static constexpr float MODFREQ_HZ = 75e6;
+static constexpr float AMPLITUDE = 6000.0f; // the threshold, about a third of the random pixels are below it
+
+static const Roi ROI = {3, 1, 61, 4}; // an odd x splits the Y12P pairs
+
+static constexpr uint32_t BAND_HEIGHT = 37; // split unevenly into the bands of 2 to 4 threads
+static const Roi BAND_ROI = {3, 2, 61, 33};
+
+// the outputs of a kernel, as floats, and its mask if any
+struct Outputs {
+    std::vector<float> values;
+    std::vector<uint8_t> mask;
+};
+
+template <class T>
+static void append(Outputs& outputs, const std::vector<T>& values) {
+    const size_t offset = outputs.values.size();
+    outputs.values.resize(offset + values.size());
+    std::transform(values.begin(), values.end(), outputs.values.begin() + offset, [](const T v) { return float(v); });
+}
+
+// random Y12P phases
+static std::vector<uint8_t> make_phase(std::mt19937& random, const uint32_t height = HEIGHT) {
+    std::uniform_int_distribution<uint32_t> byte(0, 255);
+    std::vector<uint8_t> frame(BYTESPERLINE * height);
+    for (uint8_t& b : frame) {
+        b = byte(random);
+    }
+    return frame;
+}
+
+// a depth map of 500 to 1500mm with steps and holes (0), as the filters see them
+template <class T>
+static std::vector<T> make_depth(std::mt19937& random, const uint32_t num_pixels) {
+    std::uniform_real_distribution<float> noise(-20.0f, 20.0f);
+    std::uniform_int_distribution<uint32_t> kind(0, 15);
+    std::vector<T> depth(num_pixels);
+    for (uint32_t i = 0; i < num_pixels; i++) {
+        const uint32_t k = kind(random);
+        const float d = k == 0 ? 0.0f : k == 1 ? 1500.0f + noise(random) : 800.0f + i % 7 * 10.0f + noise(random);
+        depth[i] = std::is_same_v<T, float> ? T(d) : T(std::lround(d));
+    }
+    return depth;
+}
+
+static Intrinsics make_intrinsics() {
+    Intrinsics intrinsics;
+    intrinsics.fx = 210.0f;
+    intrinsics.fy = 211.0f;
+    intrinsics.cx = 39.5f;
+    intrinsics.cy = 2.5f;
+    intrinsics.k1 = -0.1f;
+    intrinsics.p1 = 0.001f;
+    return intrinsics;
+}
+
+// the depth, confidence and mask that `kernel` writes for width x height pixels
+template <class T, class Kernel>
+static Outputs convert(const uint32_t width, const uint32_t height, const Kernel& kernel) {
+    std::vector<T> depth(width * height);
+    std::vector<T> confidence(width * height);
+    std::vector<uint8_t> mask((width + 7) / 8 * height);
+    kernel(depth.data(), confidence.data(), Threshold{AMPLITUDE, mask.data()});
+    Outputs outputs;
+    append(outputs, depth);
+    append(outputs, confidence);
+    outputs.mask = mask;
+    return outputs;
+}
+
+// the values agree within 1e-4, a rounding step when `rounded`, or to the bit when `exact`
+static void verify(
+        const char* name, const char* kernel, const Outputs& expected, const Outputs& actual, const bool rounded,
+        const bool exact) {
+    if (actual.values.size() != expected.values.size() || actual.mask != expected.mask) {
+        fprintf(stderr, "%s %s: the mask differs\n", name, kernel);
+        failures++;
+        return;
+    }
+    uint32_t differences = 0;
+    for (size_t i = 0; i < expected.values.size(); i++) {
+        const float e = expected.values[i];
+        const float a = actual.values[i];
+        const float tolerance = exact ? 0.0f : rounded ? 1.0f : 1e-4f * std::max(1.0f, std::fabs(e));
+        if (!(std::fabs(a - e) <= tolerance)) {
+            if (differences++ == 0) {
+                fprintf(stderr, "%s %s: value %zu is %g, expected %g\n", name, kernel, i, a, e);
+            }
+        }
+    }
+    if (differences > 0) {
+        fprintf(stderr, "%s %s: %u values differ\n", name, kernel, differences);
+        failures++;
+    }
+}
+
+// runs `kernel` on the scalar path and on `isa`, and compares their outputs
+template <class Kernel>
+static void compare(const Isa isa, const char* name, const char* kernel, const bool rounded, const Kernel& run) {
+    set_isa(Isa::Scalar);
+    const Outputs expected = run();
+    set_isa(isa);
+    const Outputs actual = run();
+    verify(name, kernel, expected, actual, rounded, false);
+}
+
+static void test_unpack(const Isa isa, const char* name, const std::vector<uint8_t>& frame) {
+    compare(isa, name, "unpack", false, [&] {
+        std::vector<int16_t> unpacked(NUM_PIXELS);
+        unpack_y12p(unpacked.data(), frame.data(), WIDTH, HEIGHT, BYTESPERLINE);
+        Outputs outputs;
+        append(outputs, unpacked);
+        return outputs;
+    });
+}
+
+template <Atan2 accuracy, class T>
+static void test_depth(const Isa isa, const char* name, const std::vector<uint8_t> (&phases)[8]) {
+    constexpr bool rounded = std::is_same_v<T, uint16_t>;
+    const void* const frames[4] = {phases[0].data(), phases[1].data(), phases[2].data(), phases[3].data()};
+    const void* const coarse[4] = {phases[4].data(), phases[5].data(), phases[6].data(), phases[7].data()};
+    // runs a kernel writing width x height pixels
+    const auto convert = [&](const uint32_t width, const uint32_t height, const auto& kernel) {
+        return [=] { return ::convert<T>(width, height, kernel); };
+    };
+    std::vector<int16_t> unpacked[4];
+    set_isa(Isa::Scalar);
+    for (uint32_t i = 0; i < 4; i++) {
+        unpacked[i].resize(NUM_PIXELS);
+        unpack_y12p(unpacked[i].data(), frames[i], WIDTH, HEIGHT, BYTESPERLINE);
+    }
+    compare(isa, name, "depth", rounded, convert(WIDTH, HEIGHT, [&](T* depth, T* confidence, const Threshold& threshold) {
+                compute_depth_confidence<true, Rotation::Zero, accuracy>(
+                        depth, confidence, unpacked[0].data(), unpacked[1].data(), unpacked[2].data(),
+                        unpacked[3].data(), NUM_PIXELS, MODFREQ_HZ, threshold);
+            }));
+    compare(isa, name, "y12p", rounded, convert(WIDTH, HEIGHT, [&](T* depth, T* confidence, const Threshold& threshold) {
+                compute_depth_confidence_from_y12p<true, Rotation::Zero, accuracy>(
+                        depth, confidence, frames[0], frames[1], frames[2], frames[3], WIDTH, HEIGHT, BYTESPERLINE,
+                        MODFREQ_HZ, threshold);
+            }));
+    compare(isa, name, "y12p roi", rounded,
+            convert(ROI.width, ROI.height, [&](T* depth, T* confidence, const Threshold& threshold) {
+                compute_depth_confidence_from_y12p<true, Rotation::Zero, accuracy>(
+                        depth, confidence, frames[0], frames[1], frames[2], frames[3], WIDTH, HEIGHT, BYTESPERLINE,
+                        MODFREQ_HZ, ROI, threshold);
+            }));
+    compare(isa, name, "binned", rounded,
+            convert(WIDTH / 2, HEIGHT / 2, [&](T* depth, T* confidence, const Threshold& threshold) {
+                compute_binned_depth_confidence_from_y12p<true, Rotation::Zero, accuracy>(
+                        depth, confidence, frames[0], frames[1], frames[2], frames[3], WIDTH, HEIGHT, BYTESPERLINE,
+                        MODFREQ_HZ, threshold);
+            }));
+    compare(isa, name, "binned roi", rounded,
+            convert(ROI.width / 2, ROI.height / 2, [&](T* depth, T* confidence, const Threshold& threshold) {
+                compute_binned_depth_confidence_from_y12p<true, Rotation::Zero, accuracy>(
+                        depth, confidence, frames[0], frames[1], frames[2], frames[3], WIDTH, HEIGHT, BYTESPERLINE,
+                        MODFREQ_HZ, ROI, threshold);
+            }));
+    compare(isa, name, "unwrapped", rounded,
+            convert(WIDTH, HEIGHT, [&](T* depth, T* confidence, const Threshold& threshold) {
+                compute_unwrapped_depth_confidence_from_y12p<true, Rotation::Zero, accuracy>(
+                        depth, confidence, frames, coarse, WIDTH, HEIGHT, BYTESPERLINE, MODFREQ_HZ, MODFREQ_HZ / 5,
+                        threshold);
+            }));
+}
+
+template <class T, class P>
+static void test_xyz(const Isa isa, const char* name, std::mt19937& random) {
+    std::vector<float> rays(NUM_PIXELS * 3);
+    compute_rays(rays.data(), make_intrinsics(), {0, 0, WIDTH, HEIGHT});
+    const std::vector<T> depth = make_depth<T>(random, NUM_PIXELS);
+    compare(isa, name, "xyz", std::is_same_v<P, int16_t>, [&] {
+        std::vector<P> xyz(NUM_PIXELS * 3);
+        compute_xyz(xyz.data(), depth.data(), rays.data(), NUM_PIXELS);
+        Outputs outputs;
+        append(outputs, xyz);
+        return outputs;
+    });
+}
+
+// three frames through the filter, with and without the confidence
+template <class T>
+static void test_temporal(const Isa isa, const char* name, std::mt19937& random) {
+    std::vector<T> depths[3];
+    std::vector<T> confidences[3];
+    for (uint32_t i = 0; i < 3; i++) {
+        depths[i] = make_depth<T>(random, NUM_PIXELS);
+        confidences[i] = make_depth<T>(random, NUM_PIXELS);
+    }
+    for (const bool with_confidence : {true, false}) {
+        compare(isa, name, with_confidence ? "temporal" : "temporal without confidence", std::is_same_v<T, uint16_t>,
+                [&] {
+                    std::vector<float> history(NUM_PIXELS, 0.0f);
+                    std::vector<float> history_amplitude(NUM_PIXELS, 0.0f);
+                    Outputs outputs;
+                    for (uint32_t i = 0; i < 3; i++) {
+                        std::vector<T> depth = depths[i];
+                        compute_temporal_filter(
+                                depth.data(), with_confidence ? confidences[i].data() : nullptr, history.data(),
+                                history_amplitude.data(), NUM_PIXELS, TemporalFilter{});
+                        append(outputs, depth);
+                        append(outputs, history);
+                    }
+                    return outputs;
+                });
+    }
+}
+
+template <class T>
+static void test_spatial(const Isa isa, const char* name, std::mt19937& random) {
+    const std::vector<T> depth = make_depth<T>(random, NUM_PIXELS);
+    const std::vector<T> confidence = make_depth<T>(random, NUM_PIXELS);
+    const std::pair<SpatialFilter, const char*> filters[] = {
+            {{100.0f, 0, 0.0f}, "flying pixel"},
+            {{0.0f, 3, 0.0f}, "median 3"},
+            {{0.0f, 5, 0.0f}, "median 5"},
+            {{0.0f, 0, 30.0f}, "smoothing"},
+            {{100.0f, 5, 30.0f}, "spatial"},
+    };
+    for (const auto& [filter, kernel] : filters) {
+        for (const bool with_confidence : {true, false}) {
+            compare(isa, name, kernel, std::is_same_v<T, uint16_t>, [&] {
+                std::vector<T> dst(NUM_PIXELS);
+                compute_spatial_filter(
+                        dst.data(), depth.data(), with_confidence ? confidence.data() : nullptr, WIDTH, HEIGHT, filter);
+                Outputs outputs;
+                append(outputs, dst);
+                return outputs;
+            });
+        }
+    }
+}
+
+// the ThreadPool overloads against the single threaded calls
+template <class T>
+static void test_threads(ThreadPool& pool, const char* name, std::mt19937& random) {
+    std::vector<uint8_t> phases[8];
+    for (auto& phase : phases) {
+        phase = make_phase(random, BAND_HEIGHT);
+    }
+    const void* const frames[4] = {phases[0].data(), phases[1].data(), phases[2].data(), phases[3].data()};
+    const void* const coarse[4] = {phases[4].data(), phases[5].data(), phases[6].data(), phases[7].data()};
+    const uint32_t num_pixels = WIDTH * BAND_HEIGHT;
+    std::vector<int16_t> unpacked[4];
+    for (uint32_t i = 0; i < 4; i++) {
+        unpacked[i].resize(num_pixels);
+        unpack_y12p(unpacked[i].data(), frames[i], WIDTH, BAND_HEIGHT, BYTESPERLINE);
+    }
+    // kernel(depth, confidence, threshold, pool) converts width x height pixels, single threaded without a pool
+    const auto same = [&](const char* kernel, const uint32_t width, const uint32_t height, const auto& run) {
+        const Outputs expected = convert<T>(width, height, [&](T* depth, T* confidence, const Threshold& threshold) {
+            run(depth, confidence, threshold, nullptr);
+        });
+        const Outputs actual = convert<T>(width, height, [&](T* depth, T* confidence, const Threshold& threshold) {
+            run(depth, confidence, threshold, &pool);
+        });
+        verify(name, kernel, expected, actual, false, true);
+    };
+    same("depth", WIDTH, BAND_HEIGHT, [&](T* depth, T* confidence, const Threshold& threshold, ThreadPool* pool) {
+        const auto f = [&](auto&... p) {
+            compute_depth_confidence(
+                    depth, confidence, unpacked[0].data(), unpacked[1].data(), unpacked[2].data(), unpacked[3].data(),
+                    num_pixels, MODFREQ_HZ, p..., threshold);
+        };
+        pool ? f(*pool) : f();
+    });
+    same("y12p", WIDTH, BAND_HEIGHT, [&](T* depth, T* confidence, const Threshold& threshold, ThreadPool* pool) {
+        const auto f = [&](auto&... p) {
+            compute_depth_confidence_from_y12p(
+                    depth, confidence, frames[0], frames[1], frames[2], frames[3], WIDTH, BAND_HEIGHT, BYTESPERLINE,
+                    MODFREQ_HZ, p..., threshold);
+        };
+        pool ? f(*pool) : f();
+    });
+    same("y12p roi", BAND_ROI.width, BAND_ROI.height,
+         [&](T* depth, T* confidence, const Threshold& threshold, ThreadPool* pool) {
+             const auto f = [&](auto&... p) {
+                 compute_depth_confidence_from_y12p(
+                         depth, confidence, frames[0], frames[1], frames[2], frames[3], WIDTH, BAND_HEIGHT,
+                         BYTESPERLINE, MODFREQ_HZ, BAND_ROI, p..., threshold);
+             };
+             pool ? f(*pool) : f();
+         });
+    same("binned", WIDTH / 2, BAND_HEIGHT / 2, [&](T* depth, T* confidence, const Threshold& threshold, ThreadPool* pool) {
+        const auto f = [&](auto&... p) {
+            compute_binned_depth_confidence_from_y12p(
+                    depth, confidence, frames[0], frames[1], frames[2], frames[3], WIDTH, BAND_HEIGHT, BYTESPERLINE,
+                    MODFREQ_HZ, p..., threshold);
+        };
+        pool ? f(*pool) : f();
+    });
+    same("binned roi", BAND_ROI.width / 2, BAND_ROI.height / 2,
+         [&](T* depth, T* confidence, const Threshold& threshold, ThreadPool* pool) {
+             const auto f = [&](auto&... p) {
+                 compute_binned_depth_confidence_from_y12p(
+                         depth, confidence, frames[0], frames[1], frames[2], frames[3], WIDTH, BAND_HEIGHT,
+                         BYTESPERLINE, MODFREQ_HZ, BAND_ROI, p..., threshold);
+             };
+             pool ? f(*pool) : f();
+         });
+    same("unwrapped", WIDTH, BAND_HEIGHT, [&](T* depth, T* confidence, const Threshold& threshold, ThreadPool* pool) {
+        const auto f = [&](auto&... p) {
+            compute_unwrapped_depth_confidence_from_y12p(
+                    depth, confidence, frames, coarse, WIDTH, BAND_HEIGHT, BYTESPERLINE, MODFREQ_HZ, MODFREQ_HZ / 5,
+                    p..., threshold);
+        };
+        pool ? f(*pool) : f();
+    });
+    // the filters and the points of a depth map, depth and confidence as outputs for convert()
+    std::vector<float> rays(num_pixels * 3);
+    compute_rays(rays.data(), make_intrinsics(), {0, 0, WIDTH, BAND_HEIGHT});
+    const std::vector<T> depth = make_depth<T>(random, num_pixels);
+    const std::vector<T> confidence = make_depth<T>(random, num_pixels);
+    const auto filter = [&](const bool threaded) {
+        using P = std::conditional_t<std::is_same_v<T, float>, float, int16_t>;
+        std::vector<T> filtered(num_pixels);
+        std::vector<float> history(num_pixels, 0.0f);
+        std::vector<float> history_amplitude(num_pixels, 0.0f);
+        std::vector<P> xyz(num_pixels * 3);
+        const SpatialFilter spatial = {100.0f, 5, 30.0f};
+        Outputs outputs;
+        if (threaded) {
+            compute_spatial_filter(filtered.data(), depth.data(), confidence.data(), WIDTH, BAND_HEIGHT, spatial, pool);
+        } else {
+            compute_spatial_filter(filtered.data(), depth.data(), confidence.data(), WIDTH, BAND_HEIGHT, spatial);
+        }
+        append(outputs, filtered);
+        // two frames, the second one on the history of the first
+        for (const std::vector<T>* frame : {&std::as_const(filtered), &depth}) {
+            std::vector<T> averaged = *frame;
+            if (threaded) {
+                compute_temporal_filter(
+                        averaged.data(), confidence.data(), history.data(), history_amplitude.data(), num_pixels,
+                        TemporalFilter{}, pool);
+            } else {
+                compute_temporal_filter(
+                        averaged.data(), confidence.data(), history.data(), history_amplitude.data(), num_pixels,
+                        TemporalFilter{});
+            }
+            append(outputs, averaged);
+        }
+        if (threaded) {
+            compute_xyz(xyz.data(), depth.data(), rays.data(), num_pixels, pool);
+        } else {
+            compute_xyz(xyz.data(), depth.data(), rays.data(), num_pixels);
+        }
+        append(outputs, xyz);
+        return outputs;
+    };
+    verify(name, "filters", filter(false), filter(true), false, true);
+}
+
+// The schedule of BO548::convert_frame with a pool and a spatial filter: the ROI, binned or not, converted into row
+// bands with the mask rows of each band, then the spatial and temporal filters and the points of each band in a second
+// run, against the same stages over the whole depth map.
+template <class T>
+static void test_bands(ThreadPool& pool, const char* name, const bool binning, std::mt19937& random) {
+    using P = std::conditional_t<std::is_same_v<T, float>, float, int16_t>;
+    std::vector<uint8_t> phases[4];
+    for (auto& phase : phases) {
+        phase = make_phase(random, BAND_HEIGHT);
+    }
+    const Roi roi = BAND_ROI;
+    const uint32_t out_width = binning ? roi.width / 2 : roi.width;
+    const uint32_t out_height = binning ? roi.height / 2 : roi.height;
+    const uint32_t num_pixels = out_width * out_height;
+    const uint32_t mask_stride = (out_width + 7) / 8;
+    const SpatialFilter spatial = {100.0f, 3, 30.0f};
+    std::vector<float> rays(num_pixels * 3);
+    compute_rays(rays.data(), make_intrinsics(), roi, binning);
+    const auto run = [&](const bool banded) {
+        std::vector<T> converted(num_pixels);
+        std::vector<T> depth(num_pixels);
+        std::vector<T> confidence(num_pixels);
+        std::vector<uint8_t> mask(mask_stride * out_height);
+        std::vector<float> history(num_pixels, 0.0f);
+        std::vector<float> history_amplitude(num_pixels, 0.0f);
+        std::vector<P> points(num_pixels * 3);
+        const auto convert_rows = [&](const uint32_t begin, const uint32_t end) {
+            const uint32_t offset = out_width * begin;
+            const Threshold threshold = {AMPLITUDE, mask.data() + mask_stride * begin};
+            if (binning) {
+                compute_binned_depth_confidence_from_y12p(
+                        converted.data() + offset, confidence.data() + offset, phases[0].data(), phases[1].data(),
+                        phases[2].data(), phases[3].data(), WIDTH, BAND_HEIGHT, BYTESPERLINE, MODFREQ_HZ,
+                        Roi{roi.x, roi.y + begin * 2, roi.width, (end - begin) * 2}, threshold);
+            } else {
+                compute_depth_confidence_from_y12p(
+                        converted.data() + offset, confidence.data() + offset, phases[0].data(), phases[1].data(),
+                        phases[2].data(), phases[3].data(), WIDTH, BAND_HEIGHT, BYTESPERLINE, MODFREQ_HZ,
+                        Roi{roi.x, roi.y + begin, roi.width, end - begin}, threshold);
+            }
+        };
+        const auto finish_rows = [&](const uint32_t begin, const uint32_t end) {
+            const uint32_t offset = out_width * begin;
+            compute_spatial_filter(
+                    depth.data(), converted.data(), confidence.data(), out_width, out_height, begin, end, spatial);
+            compute_temporal_filter(
+                    depth.data() + offset, confidence.data() + offset, history.data() + offset,
+                    history_amplitude.data() + offset, out_width * (end - begin), TemporalFilter{});
+            compute_xyz(points.data() + offset * 3, depth.data() + offset, rays.data() + offset * 3, out_width * (end - begin));
+        };
+        if (banded) {
+            const uint32_t bands = std::min(out_height, pool.size() * 4);
+            const auto stage = [&](const auto& rows) {
+                pool.run(bands, [&](const uint32_t band) {
+                    rows(out_height * band / bands, out_height * (band + 1) / bands);
+                });
+            };
+            stage(convert_rows);
+            stage(finish_rows);
+        } else {
+            convert_rows(0, out_height);
+            finish_rows(0, out_height);
+        }
+        Outputs outputs;
+        append(outputs, depth);
+        append(outputs, confidence);
+        append(outputs, points);
+        outputs.mask = mask;
+        return outputs;
+    };
+    verify(name, binning ? "binned bands" : "bands", run(false), run(true), false, true);
+}
+
+int main() {
+    const std::pair<Isa, const char*> isas[] = {
+            {Isa::NEON, "neon"},
+            {Isa::AVX2, "avx2"},
+            {Isa::AVX512, "avx512"},
+    };
+    for (const auto& [isa, name] : isas) {
+        if (!is_supported(isa)) {
+            continue;
+        }
+        const uint32_t before = failures;
+        std::mt19937 random(1);
+        std::vector<uint8_t> phases[8];
+        for (auto& phase : phases) {
+            phase = make_phase(random);
+        }
+        test_unpack(isa, name, phases[0]);
+        test_depth<Atan2::Default, float>(isa, name, phases);
+        test_depth<Atan2::Default, uint16_t>(isa, name, phases);
+        test_depth<Atan2::Poly5, float>(isa, name, phases);
+        test_xyz<float, float>(isa, name, random);
+        test_xyz<uint16_t, int16_t>(isa, name, random);
+        test_temporal<float>(isa, name, random);
+        test_temporal<uint16_t>(isa, name, random);
+        test_spatial<float>(isa, name, random);
+        test_spatial<uint16_t>(isa, name, random);
+        printf("%s: %s\n", name, failures == before ? "ok" : "failed");
+    }
+    set_isa(detect_isa());
+    for (uint32_t num_threads = 2; num_threads <= 4; num_threads++) {
+        const uint32_t before = failures;
+        const std::string name = std::to_string(num_threads) + " threads";
+        ThreadPool pool(num_threads);
+        std::mt19937 random(num_threads);
+        test_threads<float>(pool, name.c_str(), random);
+        test_threads<uint16_t>(pool, name.c_str(), random);
+        test_bands<float>(pool, name.c_str(), false, random);
+        test_bands<float>(pool, name.c_str(), true, random);
+        test_bands<uint16_t>(pool, name.c_str(), true, random);
+        printf("%s: %s\n", name.c_str(), failures == before ? "ok" : "failed");
+    }
+    return failures == 0 ? 0 : 1;
+}
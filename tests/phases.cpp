@@ -0,0 +1,114 @@
+#include "check.hpp"
+#include <bo410.hpp>
+#include <cstdint>
+#include <cstdio>
+#include <initializer_list>
+
+// The phase tracking of BO410 from the driver sequence numbers: the phases kept, the frames discarded when phases are
+// lost and the resynchronization at the next phase 0, with the counters of the telemetry.
+
+using namespace tofcam;
+
+using Step = PhaseTracker::Step;
+
+// feeds `sequences` and checks that each one is `step`
+static void feed(
+        PhaseTracker& tracker, Telemetry& telemetry, const std::initializer_list<uint32_t> sequences, const Step step,
+        const char* test) {
+    for (const uint32_t sequence : sequences) {
+        if (tracker.take(sequence, telemetry) != step) {
+            fprintf(stderr, "%s: unexpected step for sequence %u\n", test, sequence);
+            failures++;
+        }
+    }
+}
+
+static void expect_counters(const Telemetry& telemetry, const uint64_t resyncs, const uint64_t discarded, const char* test) {
+    expect(telemetry.resyncs.load() == resyncs, test, "wrong resyncs");
+    expect(telemetry.discarded.load() == discarded, test, "wrong discarded");
+}
+
+// consecutive frames, and a whole frame lost between two frames, which needs no resynchronization
+static void test_in_order() {
+    const char* test = "in order";
+    PhaseTracker tracker;
+    Telemetry telemetry;
+    feed(tracker, telemetry, {0, 1, 2, 3}, Step::Next, test);
+    expect(tracker.size() == 4, test, "the frame is not complete");
+    tracker.clear();
+    feed(tracker, telemetry, {4, 5}, Step::Next, test);
+    expect(tracker.size() == 2, test, "wrong phases held");
+    tracker.clear(); // the frame dropped by the caller
+    feed(tracker, telemetry, {12, 13, 14, 15}, Step::Next, test);
+    expect(tracker.size() == 4, test, "the frame is not complete");
+    expect_counters(telemetry, 0, 0, test);
+}
+
+// phase 2 lost: the phases held and the frames up to the next phase 0 are discarded
+static void test_lost_in_frame() {
+    const char* test = "lost in frame";
+    PhaseTracker tracker;
+    Telemetry telemetry;
+    feed(tracker, telemetry, {0, 1}, Step::Next, test);
+    feed(tracker, telemetry, {3}, Step::Discard, test);
+    expect(tracker.size() == 0, test, "phases are held after a loss");
+    expect_counters(telemetry, 1, 3, test);
+    feed(tracker, telemetry, {4, 5, 6, 7}, Step::Next, test);
+    expect(tracker.size() == 4, test, "the frame is not complete");
+    expect_counters(telemetry, 1, 3, test);
+}
+
+// 4 frames lost in a frame: the phase of the next frame is the expected one, but not its sequence
+static void test_jump_of_four() {
+    const char* test = "jump of four";
+    PhaseTracker tracker;
+    Telemetry telemetry;
+    feed(tracker, telemetry, {0, 1}, Step::Next, test);
+    feed(tracker, telemetry, {6, 7}, Step::Discard, test);
+    expect_counters(telemetry, 1, 4, test);
+    feed(tracker, telemetry, {8, 9, 10, 11}, Step::Next, test);
+    expect(tracker.size() == 4, test, "the frame is not complete");
+    expect_counters(telemetry, 1, 4, test);
+}
+
+// phases 2 and 3 lost: the next frame is phase 0 and starts a new frame at once
+static void test_resync_on_phase_zero() {
+    const char* test = "resync on phase 0";
+    PhaseTracker tracker;
+    Telemetry telemetry;
+    feed(tracker, telemetry, {0, 1}, Step::Next, test);
+    feed(tracker, telemetry, {4}, Step::Restart, test);
+    expect(tracker.size() == 1, test, "the phase 0 is not held");
+    expect_counters(telemetry, 1, 2, test);
+    feed(tracker, telemetry, {5, 6, 7}, Step::Next, test);
+    expect(tracker.size() == 4, test, "the frame is not complete");
+    expect_counters(telemetry, 1, 2, test);
+}
+
+// a stream that starts after phase 0 is discarded up to the first phase 0, a resynchronization each time phases are lost
+static void test_counters() {
+    const char* test = "counters";
+    PhaseTracker tracker;
+    Telemetry telemetry;
+    feed(tracker, telemetry, {2, 3}, Step::Discard, test);
+    expect_counters(telemetry, 1, 2, test);
+    feed(tracker, telemetry, {4, 5, 6}, Step::Next, test);
+    feed(tracker, telemetry, {9, 10, 11}, Step::Discard, test);
+    expect_counters(telemetry, 2, 8, test);
+    feed(tracker, telemetry, {12}, Step::Next, test);
+    feed(tracker, telemetry, {16}, Step::Restart, test);
+    expect_counters(telemetry, 3, 9, test);
+    feed(tracker, telemetry, {17, 18, 19}, Step::Next, test);
+    expect(tracker.size() == 4, test, "the frame is not complete");
+    telemetry.reset();
+    expect_counters(telemetry, 0, 0, test);
+}
+
+int main() {
+    test_in_order();
+    test_lost_in_frame();
+    test_jump_of_four();
+    test_resync_on_phase_zero();
+    test_counters();
+    return report("phases");
+}
@@ -0,0 +1,86 @@
+#include "check.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <recorder.hpp>
+#include <recording.hpp>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// Frames recorded by a Recorder with 3 slots read back through Recording: the frames it accepted are in the file in
+// order, with their data, sequence and timestamp, and the stats count every frame as written or dropped.
+
+using namespace tofcam;
+
+static constexpr uint32_t NUM_FRAMES = 64;
+static constexpr uint32_t NUM_SLOTS = 3;
+
+static RecordingFormat make_format() {
+    RecordingFormat format;
+    format.width = 240;
+    format.height = 180 * 4;
+    format.bytesperline = 240 / 2 * 3;
+    format.sizeimage = format.bytesperline * format.height; // not a multiple of the page size
+    format.pixelformat = 0x50323159;                        // Y12P
+    format.mode = 1;
+    format.modfreq_hz[0] = 90e6;
+    format.modfreq_hz[1] = 15e6;
+    return format;
+}
+
+static uint8_t pixel(const uint32_t frame, const uint32_t i) {
+    return uint8_t(frame * 31 + i * 7);
+}
+
+static FrameInfo make_info(const uint32_t frame) {
+    return {frame * 2 + 10, std::chrono::steady_clock::time_point(std::chrono::microseconds(1000 + frame * 33333))};
+}
+
+int main() {
+    const char* test = "recorder";
+    const std::string path = "/tmp/tofcam_recorder_test_" + std::to_string(::getpid()) + ".rec";
+    const RecordingFormat format = make_format();
+    std::vector<uint32_t> accepted; // the frames record() queued
+    RecorderStats stats;
+    {
+        Recorder recorder(path.c_str(), format, NUM_SLOTS);
+        std::vector<uint8_t> data(format.sizeimage);
+        // as fast as possible, the writer falls behind and frames are dropped
+        for (uint32_t frame = 0; frame < NUM_FRAMES; frame++) {
+            for (uint32_t i = 0; i < format.sizeimage; i++) {
+                data[i] = pixel(frame, i);
+            }
+            if (recorder.record(data.data(), make_info(frame))) {
+                accepted.push_back(frame);
+            }
+        }
+        recorder.finish();
+        stats = recorder.get_stats();
+        expect(throws<std::exception>([&] { recorder.record(data.data(), make_info(0)); }), test,
+               "a frame is recorded after finish()");
+    }
+    expect(stats.recorded == accepted.size(), test, "wrong number of frames recorded");
+    expect(stats.recorded == stats.written && stats.pending == 0, test, "a recorded frame is not written");
+    expect(stats.dropped + stats.recorded == NUM_FRAMES, test, "a frame is neither recorded nor dropped");
+    expect(stats.max_pending >= 1 && stats.max_pending <= NUM_SLOTS, test, "wrong max_pending");
+
+    Recording recording(path.c_str());
+    expect(recording.get_format().sizeimage == format.sizeimage, test, "wrong format");
+    expect(recording.size() == accepted.size(), test, "wrong number of frames in the recording");
+    for (uint64_t index = 0; index < recording.size() && index < accepted.size(); index++) {
+        const uint32_t frame = accepted[index];
+        const auto data = static_cast<const uint8_t*>(recording.frame(index));
+        bool same = true;
+        for (uint32_t i = 0; i < format.sizeimage; i++) {
+            same &= data[i] == pixel(frame, i);
+        }
+        expect(same, test, "wrong frame data");
+        const FrameInfo info = recording.info(index);
+        expect(info.sequence == make_info(frame).sequence && info.timestamp == make_info(frame).timestamp, test,
+               "wrong frame info");
+    }
+    ::unlink(path.c_str());
+
+    return report("recorder");
+}
@@ -0,0 +1,170 @@
+#include "check.hpp"
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fcntl.h>
+#include <memory>
+#include <recording.hpp>
+#include <string>
+#include <unistd.h>
+#include <vector>
+
+// A recording written by RecordingWriter, buffered and with O_DIRECT, reads back through Recording with its format,
+// frames and FrameInfo, and unfinished, truncated or inconsistent files are rejected.
+
+using namespace tofcam;
+
+static constexpr uint32_t NUM_FRAMES = 5;
+static constexpr uint64_t PAGE = RecordingHeader::PAGE;
+
+static RecordingFormat make_format() {
+    RecordingFormat format;
+    format.width = 240;
+    format.height = 180 * 4;
+    format.bytesperline = 240 / 2 * 3;
+    format.sizeimage = format.bytesperline * format.height; // not a multiple of the page size
+    format.pixelformat = 0x50323159;                        // Y12P
+    format.mode = 1;
+    format.modfreq_hz[0] = 90e6;
+    format.modfreq_hz[1] = 15e6;
+    return format;
+}
+
+static uint8_t pixel(const uint32_t frame, const uint32_t i) {
+    return uint8_t(frame * 31 + i * 7);
+}
+
+static FrameInfo make_info(const uint32_t frame) {
+    return {frame * 2 + 10, std::chrono::steady_clock::time_point(std::chrono::microseconds(1000 + frame * 33333))};
+}
+
+// writes NUM_FRAMES frames, page aligned and padded to the stride for `direct`
+static void write_frames(RecordingWriter& writer, const RecordingFormat& format) {
+    const uint64_t stride = writer.get_stride();
+    std::unique_ptr<uint8_t, decltype(&std::free)> data(static_cast<uint8_t*>(std::aligned_alloc(PAGE, stride)), &std::free);
+    for (uint32_t frame = 0; frame < NUM_FRAMES; frame++) {
+        for (uint32_t i = 0; i < stride; i++) {
+            data.get()[i] = i < format.sizeimage ? pixel(frame, i) : 0;
+        }
+        writer.write(data.get(), make_info(frame));
+    }
+}
+
+// true when Recording(path) throws
+static bool rejected(const std::string& path) {
+    try {
+        Recording recording(path.c_str());
+    } catch (const std::exception&) {
+        return true;
+    }
+    return false;
+}
+
+static void test_round_trip(const std::string& path, const bool direct) {
+    const char* test = direct ? "round trip direct" : "round trip";
+    const RecordingFormat format = make_format();
+    {
+        RecordingWriter writer(path.c_str(), format, direct);
+        expect(writer.get_stride() % PAGE == 0 && writer.get_stride() >= format.sizeimage, test, "wrong stride");
+        write_frames(writer, format);
+        expect(writer.get_num_frames() == NUM_FRAMES, test, "wrong number of frames written");
+        writer.finish();
+    }
+    Recording recording(path.c_str());
+    const RecordingFormat& read = recording.get_format();
+    expect(read.width == format.width && read.height == format.height && read.bytesperline == format.bytesperline &&
+                   read.sizeimage == format.sizeimage && read.pixelformat == format.pixelformat &&
+                   read.mode == format.mode && read.modfreq_hz[0] == format.modfreq_hz[0] &&
+                   read.modfreq_hz[1] == format.modfreq_hz[1],
+           test, "the format differs");
+    expect(recording.size() == NUM_FRAMES, test, "wrong number of frames");
+    for (uint32_t frame = 0; frame < recording.size(); frame++) {
+        const FrameInfo info = recording.info(frame);
+        expect(info.sequence == make_info(frame).sequence && info.timestamp == make_info(frame).timestamp, test,
+               "the FrameInfo differs");
+        const uint8_t* const data = static_cast<const uint8_t*>(recording.frame(frame));
+        bool same = true;
+        for (uint32_t i = 0; i < format.sizeimage; i++) {
+            same = same && data[i] == pixel(frame, i);
+        }
+        expect(same, test, "the frame differs");
+    }
+    recording.advise(0, 2);
+    recording.advise(NUM_FRAMES - 1, 2);
+    try {
+        recording.frame(NUM_FRAMES);
+        expect(false, test, "a frame past the end is returned");
+    } catch (const std::out_of_range&) {
+    }
+}
+
+// overwrites `size` bytes at `offset` of the file
+static void patch(const std::string& path, const void* data, const size_t size, const off_t offset) {
+    const int fd = ::open(path.c_str(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0 || ::pwrite(fd, data, size, offset) != ssize_t(size)) {
+        fprintf(stderr, "patch: can not write %s\n", path.c_str());
+        failures++;
+    }
+    ::close(fd);
+}
+
+static void test_rejected(const std::string& path) {
+    const char* test = "rejected";
+    const RecordingFormat format = make_format();
+    {
+        RecordingWriter writer(path.c_str(), format);
+        write_frames(writer, format);
+        // the header is written by finish()
+        expect(rejected(path), test, "an unfinished recording is opened");
+    }
+    expect(!rejected(path), test, "a finished recording is rejected");
+    RecordingHeader header;
+    {
+        const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+        expect(::pread(fd, &header, sizeof(header), 0) == sizeof(header), test, "can not read the header");
+        ::close(fd);
+    }
+    // the index cut short
+    const off_t length = header.index_offset + header.num_frames * sizeof(RecordingEntry);
+    expect(::truncate(path.c_str(), length - 1) == 0, test, "truncate failed");
+    expect(rejected(path), test, "a truncated index is accepted");
+    // the frames cut short, the index is past the end
+    expect(::truncate(path.c_str(), header.index_offset - 1) == 0, test, "truncate failed");
+    expect(rejected(path), test, "truncated frames are accepted");
+    // an index in the header page
+    {
+        RecordingWriter writer(path.c_str(), format);
+        write_frames(writer, format);
+    }
+    RecordingHeader inside = header;
+    inside.index_offset = 0;
+    patch(path, &inside, sizeof(inside), 0);
+    expect(rejected(path), test, "an index in the header page is accepted");
+    patch(path, &header, sizeof(header), 0);
+    expect(!rejected(path), test, "a restored recording is rejected");
+    // a frame in the header page
+    RecordingEntry entry;
+    const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+    expect(::pread(fd, &entry, sizeof(entry), header.index_offset) == sizeof(entry), test, "can not read the index");
+    ::close(fd);
+    entry.offset = 0;
+    patch(path, &entry, sizeof(entry), header.index_offset);
+    expect(rejected(path), test, "a frame in the header page is accepted");
+    // not a recording
+    std::vector<uint8_t> zeros(PAGE * 2);
+    patch(path, zeros.data(), zeros.size(), 0);
+    expect(rejected(path), test, "a file without the magic is accepted");
+    expect(::truncate(path.c_str(), 100) == 0, test, "truncate failed");
+    expect(rejected(path), test, "a file shorter than the header is accepted");
+}
+
+int main() {
+    const std::string path = "/tmp/tofcam_recording_test_" + std::to_string(::getpid()) + ".rec";
+    test_round_trip(path, false);
+    test_round_trip(path, true);
+    test_rejected(path);
+    ::unlink(path.c_str());
+    return report("recording");
+}
@@ -0,0 +1,211 @@
+#include "check.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <frame.hpp>
+#include <memory>
+#include <share.hpp>
+#include <optional>
+#include <string>
+#include <sys/socket.h>
+#include <thread>
+#include <unistd.h>
+
+// The seqlock ring of FramePublisher read by a FrameSubscriber in the same process: latest() and next(), the frames
+// lost by next() when the publisher went around the ring, valid() once a frame is being overwritten, and the futex of
+// wait(). Then the slots of a FrameServer counted over two FrameClients: a slot is written again only once every
+// reader released it, a reader that disconnects releases what it held, and a bad release drops the reader.
+
+using namespace tofcam;
+
+static constexpr uint32_t NUM_SLOTS = 4;
+static constexpr uint32_t WIDTH = 4;
+static constexpr uint32_t HEIGHT = 2;
+
+// publishes the frame `number`, its depth and sequence are the number
+static void publish(FramePublisher& publisher, const uint32_t number) {
+    const auto view = publisher.begin<float>();
+    for (uint32_t i = 0; i < WIDTH * HEIGHT; i++) {
+        view.depth[i] = number;
+        view.confidence[i] = number * 2;
+    }
+    view.info->sequence = number;
+    view.info->timestamp = std::chrono::steady_clock::time_point(std::chrono::milliseconds(number));
+    publisher.publish();
+}
+
+// the frame holds the frame `number` as publish() wrote it
+static bool holds(const PublishedFrame& frame, const uint32_t number) {
+    bool same = frame.number() == number && frame.info().sequence == number &&
+                frame.info().timestamp == std::chrono::steady_clock::time_point(std::chrono::milliseconds(number));
+    for (uint32_t i = 0; i < WIDTH * HEIGHT; i++) {
+        same = same && frame.depth<float>()[i] == number && frame.confidence<float>()[i] == number * 2;
+    }
+    return same && frame.mask() == nullptr && frame.points<float>() == nullptr && frame.valid();
+}
+
+// connects a subscriber, the publisher sends it the ring on dispatch()
+static std::unique_ptr<FrameSubscriber> subscribe(FramePublisher& publisher, const std::string& path) {
+    std::unique_ptr<FrameSubscriber> subscriber;
+    std::atomic<bool> connected{false};
+    std::thread thread([&] {
+        subscriber = std::make_unique<FrameSubscriber>(path.c_str());
+        connected.store(true);
+    });
+    while (!connected.load()) {
+        publisher.dispatch();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    thread.join();
+    return subscriber;
+}
+
+// connects a client, the server sends it the slots on dispatch()
+static std::unique_ptr<FrameClient> connect(FrameServer& server, const std::string& path) {
+    std::unique_ptr<FrameClient> client;
+    std::atomic<bool> connected{false};
+    std::thread thread([&] {
+        client = std::make_unique<FrameClient>(path.c_str());
+        connected.store(true);
+    });
+    while (!connected.load()) {
+        server.dispatch();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+    }
+    thread.join();
+    return client;
+}
+
+// a RELEASE of `slot` in the wire format of src/share.cpp, sent behind the back of the SharedFrames
+static void send_release(const FrameClient& client, const uint32_t slot) {
+    struct {
+        uint32_t type = 2;
+        uint32_t slot;
+        uint32_t sequence = 0;
+        uint32_t reserved = 0;
+        int64_t timestamp = 0;
+    } message;
+    message.slot = slot;
+    expect(::send(client.get_fd(), &message, sizeof(message), MSG_NOSIGNAL) == sizeof(message), "server",
+           "the release is not sent");
+}
+
+// publishes an acquired slot, both clients receive it
+static void publish(
+        FrameServer& server, const uint32_t slot, FrameClient& first, FrameClient& second,
+        std::optional<SharedFrame> (&frames)[2]) {
+    server.publish(slot);
+    frames[0] = first.receive(std::chrono::seconds(5));
+    frames[1] = second.receive(std::chrono::seconds(5));
+    expect(frames[0] && frames[0]->slot() == slot && frames[1] && frames[1]->slot() == slot, "server",
+           "a reader misses a frame");
+}
+
+static void test_server(const std::string& path) {
+    const char* test = "server";
+    const auto layout = FrameLayout::pack<float>(WIDTH, HEIGHT, 1, WIDTH * HEIGHT, 0, 0);
+    FrameServer server(path.c_str(), 3, layout);
+    auto first = connect(server, path);
+    auto second = connect(server, path);
+    expect(server.get_num_readers() == 2, test, "wrong number of readers");
+    std::optional<SharedFrame> frames[3][2];
+    for (uint32_t slot = 0; slot < 2; slot++) {
+        expect(server.acquire() == slot, test, "a free slot is not acquired");
+        publish(server, slot, *first, *second, frames[slot]);
+    }
+
+    // slot 0 is skipped while the second reader holds it, and free once both released it
+    frames[0][0].reset();
+    expect(server.acquire() == 2u, test, "a slot still held by a reader is acquired");
+    publish(server, 2, *first, *second, frames[2]);
+    expect(!server.acquire(), test, "a slot is acquired while the readers hold all of them");
+    frames[0][1].reset();
+    expect(server.acquire() == 0u, test, "a slot released by every reader is not acquired");
+    publish(server, 0, *first, *second, frames[0]);
+
+    // the second reader disconnects holding every slot, its releases are left to the server
+    frames[1][0].reset();
+    frames[2][0].reset();
+    expect(!server.acquire(), test, "a slot held by the second reader is acquired");
+    expect(::shutdown(second->get_fd(), SHUT_RDWR) == 0, test, "shutdown failed");
+    expect(server.acquire() == 1u, test, "the slots of a disconnected reader are not released");
+    expect(server.get_num_readers() == 1, test, "a disconnected reader is kept");
+    for (auto& frame : frames) {
+        frame[1].reset(); // sent to the server that is gone, ignored
+    }
+    second.reset();
+
+    // a release of a slot the reader does not hold drops it, without releasing the slot of the first reader
+    auto third = connect(server, path);
+    send_release(*third, 0);
+    expect(server.acquire() == 2u, test, "a slot held by a reader is acquired");
+    expect(server.get_num_readers() == 1, test, "a bad release does not drop the reader");
+    // a second release of the same slot drops the reader, which held nothing more
+    frames[0][0].reset();
+    send_release(*first, 0);
+    expect(server.acquire() == 0u, test, "a released slot is not acquired");
+    expect(server.get_num_readers() == 0, test, "a duplicate release does not drop the reader");
+    expect(!server.acquire(), test, "a slot is counted twice");
+}
+
+static void test_publisher(const std::string& path) {
+    const char* test = "publisher";
+    const auto layout = FrameLayout::pack<float>(WIDTH, HEIGHT, 1, WIDTH * HEIGHT, 0, 0);
+    FramePublisher publisher(path.c_str(), NUM_SLOTS, layout);
+    auto subscriber = subscribe(publisher, path);
+    expect(subscriber->get_layout().size == layout.size, test, "the layout differs");
+
+    // nothing published yet
+    expect(!subscriber->latest() && !subscriber->next(), test, "a frame is read before the first publish()");
+    expect(!subscriber->wait(std::chrono::milliseconds(10)), test, "wait() returns without a frame");
+
+    publish(publisher, 1);
+    expect(subscriber->wait(std::chrono::milliseconds(0)), test, "wait() misses a published frame");
+    const auto first = subscriber->next();
+    expect(first && holds(first.value(), 1), test, "next() misses the first frame");
+    expect(!subscriber->next(), test, "next() reads a frame twice");
+
+    // around the ring: frames 2 to 8 are overwritten or being written, 9 is the oldest one left
+    for (uint32_t number = 2; number <= 11; number++) {
+        publish(publisher, number);
+    }
+    expect(publisher.get_published() == 11, test, "wrong published count");
+    expect(first && !first->valid(), test, "an overwritten frame is valid");
+    const auto oldest = subscriber->next();
+    expect(oldest && holds(oldest.value(), 9), test, "next() is not the oldest frame left");
+    expect(subscriber->get_lost() == 7, test, "wrong lost count");
+    for (uint32_t number = 10; number <= 11; number++) {
+        const auto frame = subscriber->next();
+        expect(frame && holds(frame.value(), number), test, "next() skips a frame");
+    }
+    expect(!subscriber->next(), test, "next() reads past the newest frame");
+    expect(subscriber->get_lost() == 7, test, "frames read in order are lost");
+
+    // frame 9 is valid until begin() of frame 13 in its slot, before the frame is published
+    publish(publisher, 12);
+    expect(oldest && oldest->valid(), test, "a frame in another slot is invalidated");
+    publisher.begin<float>();
+    expect(oldest && !oldest->valid(), test, "a frame being overwritten is valid");
+    publisher.publish();
+    const auto latest = subscriber->latest();
+    expect(latest && latest->number() == 13 && latest->valid(), test, "latest() is not the newest frame");
+
+    // wait() sleeps on the futex until the next publish()
+    std::atomic<bool> woken{false};
+    const auto start = std::chrono::steady_clock::now();
+    std::thread waiter([&] { woken.store(subscriber->wait(std::chrono::seconds(5))); });
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    publish(publisher, 14);
+    waiter.join();
+    expect(woken.load(), test, "wait() misses the publish()");
+    expect(std::chrono::steady_clock::now() - start < std::chrono::seconds(5), test, "wait() is not woken");
+    const auto next = subscriber->next();
+    expect(next && holds(next.value(), 14), test, "next() misses the frame woken for");
+}
+
+int main() {
+    const std::string path = "/tmp/tofcam_share_test_" + std::to_string(::getpid()) + ".sock";
+    test_publisher(path);
+    test_server(path);
+    return report("share");
+}
@@ -0,0 +1,146 @@
+#include "check.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <random>
+#include <telemetry.hpp>
+#include <vector>
+
+// The percentiles of Histogram against the exact ones of known distributions: never below them and within one bucket
+// (12.5%) above, the clamp of the values from 2^40ns on, and reset().
+
+using namespace tofcam;
+
+using std::chrono::nanoseconds;
+
+static constexpr double QUANTILES[] = {0.0, 0.01, 0.1, 0.25, 0.5, 0.75, 0.9, 0.99, 0.999, 1.0};
+
+// records `values` and checks every quantile against the exact one
+static void check(const char* test, std::vector<uint64_t> values) {
+    Histogram histogram;
+    uint64_t sum = 0;
+    for (const uint64_t value : values) {
+        histogram.record(nanoseconds(value));
+        sum += value;
+    }
+    std::sort(values.begin(), values.end());
+    expect(histogram.count() == values.size(), test, "wrong count");
+    expect(uint64_t(histogram.max().count()) == values.back(), test, "wrong max");
+    expect(uint64_t(histogram.mean().count()) == sum / values.size(), test, "wrong mean");
+    for (const double quantile : QUANTILES) {
+        // the rank of percentile()
+        const uint64_t rank = std::max<uint64_t>(1, quantile * values.size() + 0.5);
+        const uint64_t exact = values[rank - 1];
+        const uint64_t estimate = histogram.percentile(quantile).count();
+        if (estimate < exact || estimate > exact + exact / 8) {
+            fprintf(stderr, "%s: p%g is %lu, exact %lu\n", test, quantile * 100, estimate, exact);
+            failures++;
+        }
+    }
+}
+
+static void test_empty() {
+    const char* test = "empty";
+    Histogram histogram;
+    expect(histogram.count() == 0, test, "wrong count");
+    expect(histogram.mean().count() == 0 && histogram.max().count() == 0, test, "wrong mean or max");
+    for (const double quantile : QUANTILES) {
+        expect(histogram.percentile(quantile).count() == 0, test, "a percentile without values");
+    }
+}
+
+// below 8ns every value has a bucket of its own
+static void test_exact() {
+    const char* test = "exact";
+    Histogram histogram;
+    for (uint64_t value = 0; value < 8; value++) {
+        histogram.record(nanoseconds(value));
+    }
+    for (uint64_t value = 0; value < 8; value++) {
+        expect(uint64_t(histogram.percentile((value + 1) / 8.0).count()) == value, test, "a small value is not exact");
+    }
+    histogram.record(nanoseconds(-5)); // counted as 0
+    expect(histogram.count() == 9 && histogram.percentile(0.0).count() == 0, test, "a negative value is not 0");
+}
+
+static void test_distributions() {
+    std::vector<uint64_t> uniform;
+    for (uint64_t value = 1000; value <= 100000; value += 7) {
+        uniform.push_back(value);
+    }
+    check("uniform", uniform);
+    // from 1ns to 1s
+    std::mt19937_64 random(1);
+    std::uniform_real_distribution<double> exponent(0.0, 30.0);
+    std::vector<uint64_t> logarithmic;
+    for (uint32_t i = 0; i < 100000; i++) {
+        logarithmic.push_back(uint64_t(std::exp2(exponent(random))));
+    }
+    check("logarithmic", logarithmic);
+    // a latency distribution with a tail
+    std::lognormal_distribution<double> latency(std::log(300000.0), 0.5);
+    std::vector<uint64_t> tail;
+    for (uint32_t i = 0; i < 100000; i++) {
+        tail.push_back(uint64_t(latency(random)));
+    }
+    check("tail", tail);
+    // every bucket boundary
+    std::vector<uint64_t> boundaries;
+    for (uint32_t bit = 3; bit < 40; bit++) {
+        for (uint64_t sub = 0; sub < 8; sub++) {
+            const uint64_t value = (8 + sub) << (bit - 3);
+            boundaries.insert(boundaries.end(), {value - 1, value, value + 1});
+        }
+    }
+    check("boundaries", boundaries);
+}
+
+// the values from 2^40ns (18 minutes) on share the last bucket, whose percentile is the max
+static void test_clamp() {
+    const char* test = "clamp";
+    const uint64_t limit = uint64_t(1) << 40;
+    Histogram histogram;
+    histogram.record(nanoseconds(limit - 1));
+    expect(uint64_t(histogram.percentile(1.0).count()) == limit - 1, test, "the last regular bucket is not bounded");
+    histogram.record(nanoseconds(limit));
+    histogram.record(nanoseconds(limit * 8));
+    histogram.record(nanoseconds(limit * 2));
+    expect(uint64_t(histogram.percentile(0.25).count()) == limit - 1, test, "a value below 2^40 is clamped");
+    expect(uint64_t(histogram.percentile(0.5).count()) == limit * 8, test, "the last bucket is not the max");
+    expect(uint64_t(histogram.percentile(1.0).count()) == limit * 8, test, "the last bucket is not the max");
+    expect(uint64_t(histogram.max().count()) == limit * 8, test, "wrong max");
+}
+
+static void test_reset() {
+    const char* test = "reset";
+    Histogram histogram;
+    for (uint64_t value = 1; value <= 1000; value++) {
+        histogram.record(nanoseconds(value * 1000));
+    }
+    histogram.reset();
+    expect(histogram.count() == 0 && histogram.mean().count() == 0 && histogram.max().count() == 0, test,
+           "the histogram is not cleared");
+    expect(histogram.percentile(0.5).count() == 0, test, "a percentile after reset()");
+    histogram.record(nanoseconds(42));
+    expect(histogram.count() == 1 && histogram.max().count() == 42, test, "wrong values after reset()");
+    expect(histogram.percentile(0.5).count() >= 42 && histogram.percentile(0.5).count() <= 42 + 42 / 8, test,
+           "wrong percentile after reset()");
+    Telemetry telemetry;
+    telemetry.frames.store(3);
+    telemetry.discarded.store(2);
+    telemetry.convert.record(nanoseconds(1000));
+    telemetry.reset();
+    expect(telemetry.frames.load() == 0 && telemetry.discarded.load() == 0 && telemetry.convert.count() == 0, test,
+           "the telemetry is not cleared");
+}
+
+int main() {
+    test_empty();
+    test_exact();
+    test_distributions();
+    test_clamp();
+    test_reset();
+    return report("telemetry");
+}
@@ -0,0 +1,136 @@
+#include <cstdint>
+#include <cstdio>
+#include <type_traits>
+#include <utility.hpp>
+#include <utility>
+#include <vector>
+
+// A zero threshold with a mask still marks the pixels of zero amplitude invalid, on every instruction set the CPU
+// supports and with every output of the kernels.
+
+using namespace tofcam;
+
+static constexpr uint32_t WIDTH = 72; // 64 and a row tail for the 16 and 32 pixel loops
+static constexpr uint32_t HEIGHT = 4;
+static constexpr uint32_t BYTESPERLINE = WIDTH / 2 * 3;
+static constexpr float MODFREQ_HZ = 75e6;
+
+// columns 4k to 4k + 3 of the frames have a zero amplitude, the others a positive one
+static bool lit(const uint32_t column) {
+    return column / 2 % 4 >= 2;
+}
+
+// only phase 0 is lit, the amplitude is 0 where the four phases are equal
+static std::vector<uint8_t> make_phase(const bool lit_phase) {
+    std::vector<uint8_t> frame(BYTESPERLINE * HEIGHT, 0);
+    for (uint32_t y = 0; y < HEIGHT; y++) {
+        for (uint32_t x = 0; x < WIDTH; x += 2) {
+            if (lit_phase && lit(x)) {
+                // both pixels of the Y12P pair are 256
+                frame[y * BYTESPERLINE + x / 2 * 3 + 0] = 0x10;
+                frame[y * BYTESPERLINE + x / 2 * 3 + 1] = 0x10;
+            }
+        }
+    }
+    return frame;
+}
+
+// the number of pixels whose mask bit or depth disagrees with expected(x)
+template <bool EnableConfidence, class T, class Convert, class Expected>
+static uint32_t check(
+        const char* isa, const char* kernel, const uint32_t width, const uint32_t height, const Convert& convert,
+        const Expected& expected) {
+    const uint32_t mask_stride = (width + 7) / 8;
+    std::vector<T> depth(width * height, T(1));
+    std::vector<T> confidence(width * height, T(1));
+    std::vector<uint8_t> mask(mask_stride * height, 0xFF);
+    convert(depth.data(), confidence.data(), Threshold{0.0f, mask.data()});
+    uint32_t failures = 0;
+    for (uint32_t y = 0; y < height; y++) {
+        for (uint32_t x = 0; x < width; x++) {
+            const bool valid = expected(x);
+            const bool bit = (mask[mask_stride * y + x / 8] >> (x % 8)) & 1;
+            const bool kept = depth[y * width + x] != T(0);
+            if (bit != valid || kept != valid) {
+                fprintf(
+                        stderr, "%s %s %s confidence=%d: pixel (%u, %u) mask %d depth %d, expected %d\n", isa, kernel,
+                        std::is_same_v<T, float> ? "float" : "uint16_t", EnableConfidence, x, y, bit, kept, valid);
+                failures++;
+            }
+        }
+    }
+    return failures;
+}
+
+template <bool EnableConfidence, class T>
+static uint32_t test_kernels(const char* isa) {
+    const auto lit_frame = make_phase(true);
+    const auto dark_frame = make_phase(false);
+    const void* const frames[4] = {lit_frame.data(), dark_frame.data(), dark_frame.data(), dark_frame.data()};
+    const Roi roi = {1, 0, WIDTH - 2, HEIGHT}; // an odd x splits the Y12P pairs
+    uint32_t failures = 0;
+    failures += check<EnableConfidence, T>(
+            isa, "y12p", WIDTH, HEIGHT,
+            [&](T* depth, T* confidence, const Threshold& threshold) {
+                compute_depth_confidence_from_y12p<EnableConfidence>(
+                        depth, confidence, frames[0], frames[1], frames[2], frames[3], WIDTH, HEIGHT, BYTESPERLINE,
+                        MODFREQ_HZ, threshold);
+            },
+            [](const uint32_t x) { return lit(x); });
+    failures += check<EnableConfidence, T>(
+            isa, "y12p roi", roi.width, roi.height,
+            [&](T* depth, T* confidence, const Threshold& threshold) {
+                compute_depth_confidence_from_y12p<EnableConfidence>(
+                        depth, confidence, frames[0], frames[1], frames[2], frames[3], WIDTH, HEIGHT, BYTESPERLINE,
+                        MODFREQ_HZ, roi, threshold);
+            },
+            [&](const uint32_t x) { return lit(roi.x + x); });
+    failures += check<EnableConfidence, T>(
+            isa, "binned", WIDTH / 2, HEIGHT / 2,
+            [&](T* depth, T* confidence, const Threshold& threshold) {
+                compute_binned_depth_confidence_from_y12p<EnableConfidence>(
+                        depth, confidence, frames[0], frames[1], frames[2], frames[3], WIDTH, HEIGHT, BYTESPERLINE,
+                        MODFREQ_HZ, threshold);
+            },
+            [](const uint32_t x) { return lit(x * 2) || lit(x * 2 + 1); });
+    failures += check<EnableConfidence, T>(
+            isa, "binned roi", roi.width / 2, roi.height / 2,
+            [&](T* depth, T* confidence, const Threshold& threshold) {
+                compute_binned_depth_confidence_from_y12p<EnableConfidence>(
+                        depth, confidence, frames[0], frames[1], frames[2], frames[3], WIDTH, HEIGHT, BYTESPERLINE,
+                        MODFREQ_HZ, roi, threshold);
+            },
+            [&](const uint32_t x) { return lit(roi.x + x * 2) || lit(roi.x + x * 2 + 1); });
+    failures += check<EnableConfidence, T>(
+            isa, "unwrapped", WIDTH, HEIGHT,
+            [&](T* depth, T* confidence, const Threshold& threshold) {
+                compute_unwrapped_depth_confidence_from_y12p<EnableConfidence>(
+                        depth, confidence, frames, frames, WIDTH, HEIGHT, BYTESPERLINE, MODFREQ_HZ, MODFREQ_HZ / 5,
+                        threshold);
+            },
+            [](const uint32_t x) { return lit(x); });
+    return failures;
+}
+
+int main() {
+    const std::pair<Isa, const char*> isas[] = {
+            {Isa::Scalar, "scalar"},
+            {Isa::NEON, "neon"},
+            {Isa::AVX2, "avx2"},
+            {Isa::AVX512, "avx512"},
+    };
+    uint32_t failures = 0;
+    for (const auto& [isa, name] : isas) {
+        if (!is_supported(isa)) {
+            continue;
+        }
+        set_isa(isa);
+        const uint32_t before = failures;
+        failures += test_kernels<true, float>(name);
+        failures += test_kernels<false, float>(name);
+        failures += test_kernels<true, uint16_t>(name);
+        failures += test_kernels<false, uint16_t>(name);
+        printf("%s: %s\n", name, failures == before ? "ok" : "failed");
+    }
+    return failures == 0 ? 0 : 1;
+}